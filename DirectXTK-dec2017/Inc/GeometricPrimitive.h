@@ -32,24 +32,41 @@ namespace DirectX
         GeometricPrimitive& operator= (GeometricPrimitive const&) = delete;
 
         using VertexType = VertexPositionNormalTexture;
+        using PackedVertexType = VertexPositionNormalTexturePacked;
+
+        // Vertex buffer layout of a primitive created on a device. Packed halves its size, but BasicEffect can't decode
+        // its normals, so packed primitives must be drawn with a custom effect whose vertex shader does.
+        enum class VertexFormat
+        {
+            Default,    // VertexType
+            Packed,     // PackedVertexType
+        };
+
+        // Calls job(index) for every index in [0, count) and returns once all have finished, in any order or
+        // concurrently. CreateTeapot takes one to tessellate its patches on the caller's worker threads; the output
+        // is the same either way.
+        using ParallelFor = std::function<void(size_t count, const std::function<void(size_t index)>& job)>;
 
         virtual ~GeometricPrimitive();
         
-        // Factory methods.
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCube         (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateBox          (_In_ ID3D11DeviceContext* deviceContext, const XMFLOAT3& size, bool rhcoords = true, bool invertn = false);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateSphere       (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, size_t tessellation = 16, bool rhcoords = true, bool invertn = false);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateGeoSphere    (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, size_t tessellation = 3, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCylinder     (_In_ ID3D11DeviceContext* deviceContext, float height = 1, float diameter = 1, size_t tessellation = 32, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCone         (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, float height = 1, size_t tessellation = 32, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateTorus        (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, float thickness = 0.333f, size_t tessellation = 32, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateTetrahedron  (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateOctahedron   (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateDodecahedron (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateIcosahedron  (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
-        static std::unique_ptr<GeometricPrimitive> __cdecl CreateTeapot       (_In_ ID3D11DeviceContext* deviceContext, float size = 1, size_t tessellation = 8, bool rhcoords = true);
+        // Factory methods. Primitives with fewer than 65535 vertices get a 16-bit index buffer, larger ones 32-bit.
+        // Their vertex buffer is in vertexFormat.
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCube         (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateBox          (_In_ ID3D11DeviceContext* deviceContext, const XMFLOAT3& size, bool rhcoords = true, bool invertn = false, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateSphere       (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, size_t tessellation = 16, bool rhcoords = true, bool invertn = false, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateGeoSphere    (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, size_t tessellation = 3, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCylinder     (_In_ ID3D11DeviceContext* deviceContext, float height = 1, float diameter = 1, size_t tessellation = 32, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCone         (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, float height = 1, size_t tessellation = 32, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateTorus        (_In_ ID3D11DeviceContext* deviceContext, float diameter = 1, float thickness = 0.333f, size_t tessellation = 32, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateTetrahedron  (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateOctahedron   (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateDodecahedron (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateIcosahedron  (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateTeapot       (_In_ ID3D11DeviceContext* deviceContext, float size = 1, size_t tessellation = 8, bool rhcoords = true, VertexFormat vertexFormat = VertexFormat::Default);
         static std::unique_ptr<GeometricPrimitive> __cdecl CreateCustom       (_In_ ID3D11DeviceContext* deviceContext, const std::vector<VertexType>& vertices, const std::vector<uint16_t>& indices);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCustom       (_In_ ID3D11DeviceContext* deviceContext, const std::vector<VertexType>& vertices, const std::vector<uint32_t>& indices);
 
+        // Generators for 16-bit indices throw if the mesh needs 65535 vertices or more; use the 32-bit ones for those.
         static void __cdecl CreateCube          (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float size = 1, bool rhcoords = true);
         static void __cdecl CreateBox           (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, const XMFLOAT3& size, bool rhcoords = true, bool invertn = false);
         static void __cdecl CreateSphere        (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float diameter = 1, size_t tessellation = 16, bool rhcoords = true, bool invertn = false);
@@ -61,7 +78,57 @@ namespace DirectX
         static void __cdecl CreateOctahedron    (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float size = 1, bool rhcoords = true);
         static void __cdecl CreateDodecahedron  (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float size = 1, bool rhcoords = true);
         static void __cdecl CreateIcosahedron   (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float size = 1, bool rhcoords = true);
-        static void __cdecl CreateTeapot        (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float size = 1, size_t tessellation = 8, bool rhcoords = true);
+        static void __cdecl CreateTeapot        (std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, float size = 1, size_t tessellation = 8, bool rhcoords = true, const ParallelFor& parallelFor = nullptr);
+
+        static void __cdecl CreateCube          (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl CreateBox           (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, const XMFLOAT3& size, bool rhcoords = true, bool invertn = false);
+        static void __cdecl CreateSphere        (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, size_t tessellation = 16, bool rhcoords = true, bool invertn = false);
+        static void __cdecl CreateGeoSphere     (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, size_t tessellation = 3, bool rhcoords = true);
+        static void __cdecl CreateCylinder      (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float height = 1, float diameter = 1, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl CreateCone          (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, float height = 1, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl CreateTorus         (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, float thickness = 0.333f, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl CreateTetrahedron   (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl CreateOctahedron    (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl CreateDodecahedron  (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl CreateIcosahedron   (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl CreateTeapot        (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, size_t tessellation = 8, bool rhcoords = true, const ParallelFor& parallelFor = nullptr);
+
+        // Encodes generated vertices as PackedVertexType, e.g. for a custom vertex buffer.
+        static void __cdecl Pack(const std::vector<VertexType>& vertices, std::vector<PackedVertexType>& packed);
+
+        // On-disk cache of generated geometry, off until a directory is set; nullptr turns it off again. The factory
+        // methods and generators above look up their output there by a hash of the generator, its parameters and the
+        // library's geometry version, load it from a memory-mapped file on a hit, and write one on a miss. Entries are
+        // VBO files, as read by Model::CreateFromVBO, or the same layout with 32-bit indices under a .vbo32 extension.
+        // The directory must exist. Failing to read or write an entry only costs the tessellation.
+        struct CacheStats
+        {
+            size_t hits;
+            size_t misses;
+            size_t writes;
+            size_t writeFailures;
+        };
+
+        static void __cdecl SetCacheDirectory(_In_opt_z_ const wchar_t* directory);
+        static CacheStats __cdecl GetCacheStats();
+
+        // Mesh optimization. The ACMR (post-transform vertex cache misses per triangle) is for a 16 entry FIFO cache.
+        struct OptimizeStats
+        {
+            size_t verticesBefore;
+            size_t verticesAfter;
+            size_t trianglesBefore;
+            size_t trianglesAfter;
+            float acmrBefore;
+            float acmrAfter;
+        };
+
+        // Welds coincident vertices with matching normals (and texture coordinates, unless weldTextureSeams), drops the
+        // triangles that leaves degenerate, then reorders triangles for the post-transform vertex cache and vertices for
+        // fetch locality. The factory methods that create a primitive apply it, keeping texture seams; those that return
+        // vertices and indices don't, so leave the generators' vertex layout intact.
+        static void __cdecl Optimize(std::vector<VertexType>& vertices, std::vector<uint16_t>& indices, bool weldTextureSeams = false, _Out_opt_ OptimizeStats* stats = nullptr);
+        static void __cdecl Optimize(std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, bool weldTextureSeams = false, _Out_opt_ OptimizeStats* stats = nullptr);
 
         // Draw the primitive.
         void XM_CALLCONV Draw(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, FXMVECTOR color = Colors::White, _In_opt_ ID3D11ShaderResourceView* texture = nullptr, bool wireframe = false,
@@ -71,8 +138,21 @@ namespace DirectX
         void __cdecl Draw( _In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha = false, bool wireframe = false,
                            _In_opt_ std::function<void __cdecl()> setCustomState = nullptr ) const;
 
+        // Draw the primitive using a custom effect with instancing. The per-instance vertex buffer(s) should be bound by setCustomState.
+        void __cdecl DrawInstanced( _In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, uint32_t instanceCount, bool alpha = false, bool wireframe = false,
+                                    uint32_t startInstanceLocation = 0, _In_opt_ std::function<void __cdecl()> setCustomState = nullptr ) const;
+
         // Create input layout for drawing with a custom effect.
         void __cdecl CreateInputLayout( _In_ IEffect* effect, _Outptr_ ID3D11InputLayout** inputLayout ) const;
+
+        // Vertex and index buffers (triangle list), for callers that issue their own draws. The returned pointers are
+        // not AddRef'd and remain owned by the primitive. The vertex stride follows from GetVertexFormat.
+        void __cdecl GetBuffers( _Outptr_ ID3D11Buffer** vertexBuffer, _Outptr_ ID3D11Buffer** indexBuffer, _Out_ uint32_t* indexCount ) const;
+
+        // DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT.
+        DXGI_FORMAT __cdecl GetIndexFormat() const;
+
+        VertexFormat __cdecl GetVertexFormat() const;
         
     private:
         GeometricPrimitive();
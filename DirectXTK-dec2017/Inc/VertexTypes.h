@@ -20,6 +20,7 @@
 #endif
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 
 namespace DirectX
@@ -227,6 +228,42 @@ namespace DirectX
     };
 
 
+    // Vertex struct holding position, normal vector, and texture mapping information in 16 bytes rather than 32: the
+    // position as half floats (w = 1), the normal octahedral encoded into two SNORM16s and the texture coordinate as
+    // UNORM16s. Decoded, each position component is within 2^-11 of its magnitude, or within 2^-25 where that is
+    // below the smallest normal half, 2^-14; a unit normal is within 1e-4 (as a vector distance, or radians) and a
+    // texture coordinate within 8e-6, after clamping to [0, 1]. Vertex shaders read the normal as a float2 and unfold
+    // it to 3D as Decode does.
+    struct VertexPositionNormalTexturePacked
+    {
+        VertexPositionNormalTexturePacked() = default;
+
+        VertexPositionNormalTexturePacked(XMFLOAT3 const& position, XMFLOAT3 const& normal, XMFLOAT2 const& textureCoordinate)
+        {
+            VertexPositionNormalTexture vertex(position, normal, textureCoordinate);
+            Encode(&vertex, 1, this);
+        }
+
+        VertexPositionNormalTexturePacked(FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
+        {
+            VertexPositionNormalTexture vertex(position, normal, textureCoordinate);
+            Encode(&vertex, 1, this);
+        }
+
+        PackedVector::XMHALF4 position;
+        PackedVector::XMSHORTN2 normal;
+        PackedVector::XMUSHORTN2 textureCoordinate;
+
+        // Convert count vertices to and from VertexPositionNormalTexture, four at a time. Normals to encode must be
+        // unit length; a zero normal encodes as +Z.
+        static void __cdecl Encode(_In_reads_(count) const VertexPositionNormalTexture* vertices, size_t count, _Out_writes_(count) VertexPositionNormalTexturePacked* packed);
+        static void __cdecl Decode(_In_reads_(count) const VertexPositionNormalTexturePacked* packed, size_t count, _Out_writes_(count) VertexPositionNormalTexture* vertices);
+
+        static const int InputElementCount = 3;
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+    };
+
+
     // Vertex struct holding position, normal vector, color, and texture mapping information.
     struct VertexPositionNormalColorTexture
     {
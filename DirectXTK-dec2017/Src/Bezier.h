@@ -15,6 +15,7 @@
 
 #include <array>
 #include <algorithm>
+#include <vector>
 #include <DirectXMath.h>
 
 
@@ -131,7 +132,200 @@ namespace Bezier
         }
     }
 
-    
+
+    // The weights CubicInterpolate and CubicTangent give their four points at each of the tessellation + 1 sample
+    // positions along a patch edge, computed once per tessellation level instead of once per vertex. The weights are
+    // also kept four samples to a vector, padded out with the last sample, so that the optimized CreatePatchVertices
+    // can evaluate four vertices of a row at once.
+    class PatchBasis
+    {
+    public:
+        explicit PatchBasis(size_t tessellation) :
+            mTessellation(tessellation),
+            mGroupCount(tessellation / 4 + 1),
+            mWeights(mGroupCount * 4 * 8),
+            mLanes(mGroupCount * 8)
+        {
+            for (size_t i = 0; i < mGroupCount * 4; i++)
+            {
+                float t = (float)std::min(i, tessellation) / tessellation;
+                float s = 1 - t;
+
+                float* weights = &mWeights[i * 8];
+
+                // CubicInterpolate.
+                weights[0] = s * s * s;
+                weights[1] = 3 * t * s * s;
+                weights[2] = 3 * t * t * s;
+                weights[3] = t * t * t;
+
+                // CubicTangent.
+                weights[4] = -1 + 2 * t - t * t;
+                weights[5] = 1 - 4 * t + 3 * t * t;
+                weights[6] = 2 * t - 3 * t * t;
+                weights[7] = t * t;
+            }
+
+            for (size_t group = 0; group < mGroupCount; group++)
+            {
+                const float* weights = &mWeights[group * 4 * 8];
+
+                for (size_t k = 0; k < 8; k++)
+                {
+                    mLanes[group * 8 + k] = DirectX::XMFLOAT4(weights[k], weights[8 + k], weights[16 + k], weights[24 + k]);
+                }
+            }
+        }
+
+        size_t GetTessellation() const { return mTessellation; }
+
+        // Samples 4 * group to 4 * group + 3, some of which may be padding.
+        size_t GetGroupCount() const { return mGroupCount; }
+
+        // The four interpolation weights at a sample, followed by the four tangent weights.
+        const float* GetWeights(size_t sample) const { return &mWeights[sample * 8]; }
+
+        // The same for a group of samples, one sample per lane.
+        const DirectX::XMFLOAT4* GetLanes(size_t group) const { return &mLanes[group * 8]; }
+
+    private:
+        size_t mTessellation;
+        size_t mGroupCount;
+        std::vector<float> mWeights;
+        std::vector<DirectX::XMFLOAT4> mLanes;
+    };
+
+
+    // Equivalent to the generic CreatePatchVertices above, to within rounding, using the weights precomputed in
+    // basis. Each row of control points is first reduced to the four points (and four tangents) that every vertex of
+    // that patch row is a weighted sum of; the row is then evaluated four vertices at a time, with the x, y and z
+    // components of four positions, tangents and normals held in one vector each.
+    template<typename TOutputFunc>
+    void CreatePatchVertices(_In_reads_(16) DirectX::XMVECTOR patch[16], PatchBasis const& basis, bool isMirrored, TOutputFunc outputVertex)
+    {
+        using namespace DirectX;
+
+        const size_t tessellation = basis.GetTessellation();
+
+        for (size_t i = 0; i <= tessellation; i++)
+        {
+            float u = (float)i / tessellation;
+
+            const float* weights = basis.GetWeights(i);
+
+            // The horizontal interpolations and horizontal tangents of the four rows of control points at u, with
+            // each component splatted across a vector: rows[r][c] for interpolations, rows[4 + r][c] for tangents.
+            XMVECTOR rows[8][3];
+
+            for (size_t r = 0; r < 4; r++)
+            {
+                const XMVECTOR* row = &patch[r * 4];
+
+                XMVECTOR p = XMVectorScale(row[0], weights[0]);
+                p = XMVectorMultiplyAdd(row[1], XMVectorReplicate(weights[1]), p);
+                p = XMVectorMultiplyAdd(row[2], XMVectorReplicate(weights[2]), p);
+                p = XMVectorMultiplyAdd(row[3], XMVectorReplicate(weights[3]), p);
+
+                XMVECTOR d = XMVectorScale(row[0], weights[4]);
+                d = XMVectorMultiplyAdd(row[1], XMVectorReplicate(weights[5]), d);
+                d = XMVectorMultiplyAdd(row[2], XMVectorReplicate(weights[6]), d);
+                d = XMVectorMultiplyAdd(row[3], XMVectorReplicate(weights[7]), d);
+
+                rows[r][0] = XMVectorSplatX(p);
+                rows[r][1] = XMVectorSplatY(p);
+                rows[r][2] = XMVectorSplatZ(p);
+                rows[4 + r][0] = XMVectorSplatX(d);
+                rows[4 + r][1] = XMVectorSplatY(d);
+                rows[4 + r][2] = XMVectorSplatZ(d);
+            }
+
+            // Compute the texture coordinate.
+            float mirroredU = isMirrored ? 1 - u : u;
+
+            for (size_t group = 0; group < basis.GetGroupCount(); group++)
+            {
+                const XMFLOAT4* lanes = basis.GetLanes(group);
+
+                XMVECTOR b[4], db[4];
+
+                for (size_t k = 0; k < 4; k++)
+                {
+                    b[k] = XMLoadFloat4(&lanes[k]);
+                    db[k] = XMLoadFloat4(&lanes[4 + k]);
+                }
+
+                // The vertical interpolation of the rows gives the position, their vertical tangent the first
+                // tangent, and the vertical interpolation of their horizontal tangents the second.
+                XMVECTOR position[3], tangent1[3], tangent2[3];
+
+                for (size_t c = 0; c < 3; c++)
+                {
+                    position[c] = XMVectorMultiply(b[0], rows[0][c]);
+                    tangent1[c] = XMVectorMultiply(db[0], rows[0][c]);
+                    tangent2[c] = XMVectorMultiply(b[0], rows[4][c]);
+
+                    for (size_t r = 1; r < 4; r++)
+                    {
+                        position[c] = XMVectorMultiplyAdd(b[r], rows[r][c], position[c]);
+                        tangent1[c] = XMVectorMultiplyAdd(db[r], rows[r][c], tangent1[c]);
+                        tangent2[c] = XMVectorMultiplyAdd(b[r], rows[4 + r][c], tangent2[c]);
+                    }
+                }
+
+                // Cross the two tangent vectors to compute the normal.
+                XMVECTOR normal[3] =
+                {
+                    XMVectorNegativeMultiplySubtract(tangent1[2], tangent2[1], XMVectorMultiply(tangent1[1], tangent2[2])),
+                    XMVectorNegativeMultiplySubtract(tangent1[0], tangent2[2], XMVectorMultiply(tangent1[2], tangent2[0])),
+                    XMVectorNegativeMultiplySubtract(tangent1[1], tangent2[0], XMVectorMultiply(tangent1[0], tangent2[1])),
+                };
+
+                // As in the generic version, a normal too near zero to normalize comes from degenerate geometry at
+                // the top or bottom of the teapot, and is replaced with one pointing straight up or down.
+                XMVECTOR degenerate = XMVectorAndInt(
+                    XMVectorAndInt(XMVectorNearEqual(normal[0], g_XMZero, g_XMEpsilon), XMVectorNearEqual(normal[1], g_XMZero, g_XMEpsilon)),
+                    XMVectorNearEqual(normal[2], g_XMZero, g_XMEpsilon));
+
+                XMVECTOR length = XMVectorMultiply(normal[0], normal[0]);
+                length = XMVectorMultiplyAdd(normal[1], normal[1], length);
+                length = XMVectorMultiplyAdd(normal[2], normal[2], length);
+                length = XMVectorSqrt(length);
+
+                // If this patch is mirrored, we must invert the normal.
+                if (isMirrored)
+                {
+                    length = XMVectorNegate(length);
+                }
+
+                XMVECTOR fallbackY = XMVectorSelect(g_XMOne, g_XMNegativeOne, XMVectorLess(position[1], g_XMZero));
+
+                normal[0] = XMVectorSelect(XMVectorDivide(normal[0], length), g_XMZero, degenerate);
+                normal[1] = XMVectorSelect(XMVectorDivide(normal[1], length), fallbackY, degenerate);
+                normal[2] = XMVectorSelect(XMVectorDivide(normal[2], length), g_XMZero, degenerate);
+
+                // Back to one vector per vertex.
+                XMMATRIX positions = XMMatrixTranspose(XMMATRIX(position[0], position[1], position[2], g_XMZero));
+                XMMATRIX normals = XMMatrixTranspose(XMMATRIX(normal[0], normal[1], normal[2], g_XMZero));
+
+                for (size_t k = 0; k < 4; k++)
+                {
+                    size_t j = group * 4 + k;
+
+                    if (j > tessellation)
+                        break;
+
+                    float v = (float)j / tessellation;
+
+                    XMVECTOR textureCoordinate = XMVectorSet(mirroredU, v, 0, 0);
+
+                    // Output this vertex.
+                    outputVertex(positions.r[k], normals.r[k], textureCoordinate);
+                }
+            }
+        }
+    }
+
+
     // Creates indices for a patch that is tessellated at the specified level.
     // Calls the specified outputIndex function for each generated index value.
     template<typename TOutputFunc>
@@ -18,6 +18,7 @@
 #include "DirectXHelpers.h"
 #include "SharedResourcePool.h"
 #include "Geometry.h"
+#include "GeometryCache.h"
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
@@ -51,8 +52,25 @@ namespace
     }
 
 
+    // Helper for creating a vertex buffer in the given format.
+    void CreateVertexBuffer(_In_ ID3D11Device* device, const VertexCollection& vertices, GeometricPrimitive::VertexFormat vertexFormat, _Outptr_ ID3D11Buffer** pBuffer)
+    {
+        if (vertexFormat == GeometricPrimitive::VertexFormat::Packed)
+        {
+            std::vector<GeometricPrimitive::PackedVertexType> packed(vertices.size());
+            GeometricPrimitive::PackedVertexType::Encode(vertices.data(), vertices.size(), packed.data());
+
+            CreateBuffer(device, packed, D3D11_BIND_VERTEX_BUFFER, pBuffer);
+        }
+        else
+        {
+            CreateBuffer(device, vertices, D3D11_BIND_VERTEX_BUFFER, pBuffer);
+        }
+    }
+
+
     // Helper for creating a D3D input layout.
-    void CreateInputLayout(_In_ ID3D11Device* device, IEffect* effect, _Outptr_ ID3D11InputLayout** pInputLayout)
+    void CreateInputLayout(_In_ ID3D11Device* device, IEffect* effect, GeometricPrimitive::VertexFormat vertexFormat, _Outptr_ ID3D11InputLayout** pInputLayout)
     {
         assert(pInputLayout != 0);
 
@@ -61,10 +79,12 @@ namespace
 
         effect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
 
+        bool packed = (vertexFormat == GeometricPrimitive::VertexFormat::Packed);
+
         ThrowIfFailed(
             device->CreateInputLayout(
-            GeometricPrimitive::VertexType::InputElements,
-            GeometricPrimitive::VertexType::InputElementCount,
+            packed ? GeometricPrimitive::PackedVertexType::InputElements : GeometricPrimitive::VertexType::InputElements,
+            packed ? GeometricPrimitive::PackedVertexType::InputElementCount : GeometricPrimitive::VertexType::InputElementCount,
             shaderByteCode, byteCodeLength,
             pInputLayout)
             );
@@ -80,19 +100,37 @@ namespace
 class GeometricPrimitive::Impl
 {
 public:
-    void Initialize(_In_ ID3D11DeviceContext* deviceContext, const VertexCollection& vertices, const IndexCollection& indices);
+    void Initialize(_In_ ID3D11DeviceContext* deviceContext, const VertexCollection& vertices, const IndexCollection& indices, VertexFormat vertexFormat = VertexFormat::Default);
+    void Initialize(_In_ ID3D11DeviceContext* deviceContext, const VertexCollection& vertices, const IndexCollection32& indices, VertexFormat vertexFormat = VertexFormat::Default);
 
     void XM_CALLCONV Draw(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, FXMVECTOR color, _In_opt_ ID3D11ShaderResourceView* texture, bool wireframe, std::function<void()>& setCustomState) const;
 
     void Draw(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()>& setCustomState) const;
 
+    void DrawInstanced(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, uint32_t instanceCount, bool alpha, bool wireframe, uint32_t startInstanceLocation, std::function<void()>& setCustomState) const;
+
     void CreateInputLayout(_In_ IEffect* effect, _Outptr_ ID3D11InputLayout** inputLayout) const;
 
+    void GetBuffers(_Outptr_ ID3D11Buffer** vertexBuffer, _Outptr_ ID3D11Buffer** indexBuffer, _Out_ uint32_t* indexCount) const
+    {
+        *vertexBuffer = mVertexBuffer.Get();
+        *indexBuffer = mIndexBuffer.Get();
+        *indexCount = mIndexCount;
+    }
+
+    DXGI_FORMAT GetIndexFormat() const { return mIndexFormat; }
+
+    VertexFormat GetVertexFormat() const { return mVertexFormat; }
+
 private:
+    ID3D11DeviceContext* PrepareForDraw(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()>& setCustomState) const;
+
     ComPtr<ID3D11Buffer> mVertexBuffer;
     ComPtr<ID3D11Buffer> mIndexBuffer;
 
     UINT mIndexCount;
+    DXGI_FORMAT mIndexFormat;
+    VertexFormat mVertexFormat;
 
     // Only one of these helpers is allocated per D3D device context, even if there are multiple GeometricPrimitive instances.
     class SharedResources
@@ -140,10 +178,10 @@ GeometricPrimitive::Impl::SharedResources::SharedResources(_In_ ID3D11DeviceCont
 
     // Create input layouts.
     effect->SetTextureEnabled(true);
-    ::CreateInputLayout(device.Get(), effect.get(), &inputLayoutTextured);
+    ::CreateInputLayout(device.Get(), effect.get(), VertexFormat::Default, &inputLayoutTextured);
 
     effect->SetTextureEnabled(false);
-    ::CreateInputLayout(device.Get(), effect.get(), &inputLayoutUntextured);
+    ::CreateInputLayout(device.Get(), effect.get(), VertexFormat::Default, &inputLayoutUntextured);
 }
 
 
@@ -184,7 +222,7 @@ void GeometricPrimitive::Impl::SharedResources::PrepareForRendering(bool alpha,
 
 // Initializes a geometric primitive instance that will draw the specified vertex and index data.
 _Use_decl_annotations_
-void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, const VertexCollection& vertices, const IndexCollection& indices)
+void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, const VertexCollection& vertices, const IndexCollection& indices, VertexFormat vertexFormat)
 {
     if (vertices.size() >= USHRT_MAX)
         throw std::exception("Too many vertices for 16-bit index buffer");
@@ -194,10 +232,42 @@ void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, co
     ComPtr<ID3D11Device> device;
     deviceContext->GetDevice(&device);
 
-    CreateBuffer(device.Get(), vertices, D3D11_BIND_VERTEX_BUFFER, &mVertexBuffer);
+    CreateVertexBuffer(device.Get(), vertices, vertexFormat, &mVertexBuffer);
+    CreateBuffer(device.Get(), indices, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
+
+    mIndexCount = static_cast<UINT>(indices.size());
+    mIndexFormat = DXGI_FORMAT_R16_UINT;
+    mVertexFormat = vertexFormat;
+}
+
+
+// Initializes a geometric primitive instance from 32-bit indices, which are narrowed to 16 bits if the vertices allow.
+_Use_decl_annotations_
+void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, const VertexCollection& vertices, const IndexCollection32& indices, VertexFormat vertexFormat)
+{
+    if (vertices.size() < USHRT_MAX)
+    {
+        IndexCollection narrowIndices(indices.size());
+        std::transform(indices.cbegin(), indices.cend(), narrowIndices.begin(), [](uint32_t index) { return static_cast<uint16_t>(index); });
+
+        Initialize(deviceContext, vertices, narrowIndices, vertexFormat);
+        return;
+    }
+
+    if (vertices.size() >= UINT32_MAX)
+        throw std::exception("Too many vertices for 32-bit index buffer");
+
+    mResources = sharedResourcesPool.DemandCreate(deviceContext);
+
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice(&device);
+
+    CreateVertexBuffer(device.Get(), vertices, vertexFormat, &mVertexBuffer);
     CreateBuffer(device.Get(), indices, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
 
     mIndexCount = static_cast<UINT>(indices.size());
+    mIndexFormat = DXGI_FORMAT_R32_UINT;
+    mVertexFormat = vertexFormat;
 }
 
 
@@ -212,6 +282,10 @@ void XM_CALLCONV GeometricPrimitive::Impl::Draw(
     bool wireframe,
     std::function<void()>& setCustomState) const
 {
+    // BasicEffect reads the normal as a plain vector.
+    if (mVertexFormat == VertexFormat::Packed)
+        throw std::exception("Packed vertices need a custom effect to draw");
+
     assert(mResources != 0);
     auto effect = mResources->effect.get();
     assert(effect != 0);
@@ -249,6 +323,38 @@ void GeometricPrimitive::Impl::Draw(
     bool alpha,
     bool wireframe,
     std::function<void()>& setCustomState) const
+{
+    auto deviceContext = PrepareForDraw(effect, inputLayout, alpha, wireframe, setCustomState);
+
+    deviceContext->DrawIndexed(mIndexCount, 0, 0);
+}
+
+
+// Draw the primitive using a custom effect with instancing.
+_Use_decl_annotations_
+void GeometricPrimitive::Impl::DrawInstanced(
+    IEffect* effect,
+    ID3D11InputLayout* inputLayout,
+    uint32_t instanceCount,
+    bool alpha,
+    bool wireframe,
+    uint32_t startInstanceLocation,
+    std::function<void()>& setCustomState) const
+{
+    auto deviceContext = PrepareForDraw(effect, inputLayout, alpha, wireframe, setCustomState);
+
+    deviceContext->DrawIndexedInstanced(mIndexCount, instanceCount, 0, 0, startInstanceLocation);
+}
+
+
+// Sets all the state for drawing with a custom effect, apart from the draw call itself.
+_Use_decl_annotations_
+ID3D11DeviceContext* GeometricPrimitive::Impl::PrepareForDraw(
+    IEffect* effect,
+    ID3D11InputLayout* inputLayout,
+    bool alpha,
+    bool wireframe,
+    std::function<void()>& setCustomState) const
 {
     assert(mResources != 0);
     auto deviceContext = mResources->deviceContext.Get();
@@ -267,12 +373,12 @@ void GeometricPrimitive::Impl::Draw(
 
     // Set the vertex and index buffer.
     auto vertexBuffer = mVertexBuffer.Get();
-    UINT vertexStride = sizeof(VertexType);
+    UINT vertexStride = (mVertexFormat == VertexFormat::Packed) ? sizeof(PackedVertexType) : sizeof(VertexType);
     UINT vertexOffset = 0;
 
     deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
 
-    deviceContext->IASetIndexBuffer(mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    deviceContext->IASetIndexBuffer(mIndexBuffer.Get(), mIndexFormat, 0);
 
     // Hook lets the caller replace our shaders or state settings with whatever else they see fit.
     if (setCustomState)
@@ -280,10 +386,9 @@ void GeometricPrimitive::Impl::Draw(
         setCustomState();
     }
 
-    // Draw the primitive.
     deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    deviceContext->DrawIndexed(mIndexCount, 0, 0);
+    return deviceContext;
 }
 
 
@@ -301,7 +406,7 @@ void GeometricPrimitive::Impl::CreateInputLayout(IEffect* effect, ID3D11InputLay
     ComPtr<ID3D11Device> device;
     deviceContext->GetDevice(&device);
 
-    ::CreateInputLayout(device.Get(), effect, inputLayout);
+    ::CreateInputLayout(device.Get(), effect, mVertexFormat, inputLayout);
 }
 
 
@@ -349,6 +454,39 @@ void GeometricPrimitive::Draw(
 }
 
 
+_Use_decl_annotations_
+void GeometricPrimitive::DrawInstanced(
+    IEffect* effect,
+    ID3D11InputLayout* inputLayout,
+    uint32_t instanceCount,
+    bool alpha,
+    bool wireframe,
+    uint32_t startInstanceLocation,
+    std::function<void()> setCustomState) const
+{
+    pImpl->DrawInstanced(effect, inputLayout, instanceCount, alpha, wireframe, startInstanceLocation, setCustomState);
+}
+
+
+_Use_decl_annotations_
+void GeometricPrimitive::GetBuffers(ID3D11Buffer** vertexBuffer, ID3D11Buffer** indexBuffer, uint32_t* indexCount) const
+{
+    pImpl->GetBuffers(vertexBuffer, indexBuffer, indexCount);
+}
+
+
+DXGI_FORMAT GeometricPrimitive::GetIndexFormat() const
+{
+    return pImpl->GetIndexFormat();
+}
+
+
+GeometricPrimitive::VertexFormat GeometricPrimitive::GetVertexFormat() const
+{
+    return pImpl->GetVertexFormat();
+}
+
+
 _Use_decl_annotations_
 void GeometricPrimitive::CreateInputLayout(IEffect* effect, ID3D11InputLayout** inputLayout) const
 {
@@ -364,16 +502,21 @@ _Use_decl_annotations_
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(
     ID3D11DeviceContext* deviceContext,
     float size,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeBox(vertices, indices, XMFLOAT3(size, size, size), rhcoords, false);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Box", true) << XMFLOAT3(size, size, size) << rhcoords << false, vertices, indices, [&]()
+    {
+        ComputeBox(vertices, indices, XMFLOAT3(size, size, size), rhcoords, false);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -384,7 +527,22 @@ void GeometricPrimitive::CreateCube(
     float size,
     bool rhcoords)
 {
-    ComputeBox(vertices, indices, XMFLOAT3(size, size, size), rhcoords, false);
+    ComputeCached(GeometryCacheKey("Box") << XMFLOAT3(size, size, size) << rhcoords << false, vertices, indices, [&]()
+    {
+        ComputeBox(vertices, indices, XMFLOAT3(size, size, size), rhcoords, false);
+    });
+}
+
+void GeometricPrimitive::CreateCube(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float size,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Box") << XMFLOAT3(size, size, size) << rhcoords << false, vertices, indices, [&]()
+    {
+        ComputeBox(vertices, indices, XMFLOAT3(size, size, size), rhcoords, false);
+    });
 }
 
 
@@ -394,16 +552,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateBox(
     ID3D11DeviceContext* deviceContext,
     const XMFLOAT3& size,
     bool rhcoords,
-    bool invertn)
+    bool invertn,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeBox(vertices, indices, size, rhcoords, invertn);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Box", true) << size << rhcoords << invertn, vertices, indices, [&]()
+    {
+        ComputeBox(vertices, indices, size, rhcoords, invertn);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -415,7 +578,23 @@ void GeometricPrimitive::CreateBox(
     bool rhcoords,
     bool invertn)
 {
-    ComputeBox(vertices, indices, size, rhcoords, invertn);
+    ComputeCached(GeometryCacheKey("Box") << size << rhcoords << invertn, vertices, indices, [&]()
+    {
+        ComputeBox(vertices, indices, size, rhcoords, invertn);
+    });
+}
+
+void GeometricPrimitive::CreateBox(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    const XMFLOAT3& size,
+    bool rhcoords,
+    bool invertn)
+{
+    ComputeCached(GeometryCacheKey("Box") << size << rhcoords << invertn, vertices, indices, [&]()
+    {
+        ComputeBox(vertices, indices, size, rhcoords, invertn);
+    });
 }
 
 
@@ -429,16 +608,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(
     float diameter,
     size_t tessellation,
     bool rhcoords,
-    bool invertn)
+    bool invertn,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeSphere(vertices, indices, diameter, tessellation, rhcoords, invertn);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Sphere", true) << diameter << tessellation << rhcoords << invertn, vertices, indices, [&]()
+    {
+        ComputeSphere(vertices, indices, diameter, tessellation, rhcoords, invertn);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -451,7 +635,24 @@ void GeometricPrimitive::CreateSphere(
     bool rhcoords,
     bool invertn)
 {
-    ComputeSphere(vertices, indices, diameter, tessellation, rhcoords, invertn);
+    ComputeCached(GeometryCacheKey("Sphere") << diameter << tessellation << rhcoords << invertn, vertices, indices, [&]()
+    {
+        ComputeSphere(vertices, indices, diameter, tessellation, rhcoords, invertn);
+    });
+}
+
+void GeometricPrimitive::CreateSphere(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float diameter,
+    size_t tessellation,
+    bool rhcoords,
+    bool invertn)
+{
+    ComputeCached(GeometryCacheKey("Sphere") << diameter << tessellation << rhcoords << invertn, vertices, indices, [&]()
+    {
+        ComputeSphere(vertices, indices, diameter, tessellation, rhcoords, invertn);
+    });
 }
 
 
@@ -464,16 +665,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(
     ID3D11DeviceContext* deviceContext,
     float diameter,
     size_t tessellation,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("GeoSphere", true) << diameter << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -484,7 +690,22 @@ void GeometricPrimitive::CreateGeoSphere(
     float diameter,
     size_t tessellation, bool rhcoords)
 {
-    ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+    ComputeCached(GeometryCacheKey("GeoSphere") << diameter << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateGeoSphere(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float diameter,
+    size_t tessellation, bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("GeoSphere") << diameter << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+    });
 }
 
 
@@ -499,16 +720,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(
     float height,
     float diameter,
     size_t tessellation,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeCylinder(vertices, indices, height, diameter, tessellation, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Cylinder", true) << height << diameter << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeCylinder(vertices, indices, height, diameter, tessellation, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -521,7 +747,24 @@ void GeometricPrimitive::CreateCylinder(
     size_t tessellation,
     bool rhcoords)
 {
-    ComputeCylinder(vertices, indices, height, diameter, tessellation, rhcoords);
+    ComputeCached(GeometryCacheKey("Cylinder") << height << diameter << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeCylinder(vertices, indices, height, diameter, tessellation, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateCylinder(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float height,
+    float diameter,
+    size_t tessellation,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Cylinder") << height << diameter << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeCylinder(vertices, indices, height, diameter, tessellation, rhcoords);
+    });
 }
 
 
@@ -532,16 +775,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(
     float diameter,
     float height,
     size_t tessellation,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeCone(vertices, indices, diameter, height, tessellation, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Cone", true) << diameter << height << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeCone(vertices, indices, diameter, height, tessellation, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -554,7 +802,24 @@ void GeometricPrimitive::CreateCone(
     size_t tessellation,
     bool rhcoords)
 {
-    ComputeCone(vertices, indices, diameter, height, tessellation, rhcoords);
+    ComputeCached(GeometryCacheKey("Cone") << diameter << height << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeCone(vertices, indices, diameter, height, tessellation, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateCone(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float diameter,
+    float height,
+    size_t tessellation,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Cone") << diameter << height << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeCone(vertices, indices, diameter, height, tessellation, rhcoords);
+    });
 }
 
 
@@ -568,16 +833,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(
     float diameter,
     float thickness,
     size_t tessellation,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Torus", true) << diameter << thickness << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -590,7 +860,24 @@ void GeometricPrimitive::CreateTorus(
     size_t tessellation,
     bool rhcoords)
 {
-    ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+    ComputeCached(GeometryCacheKey("Torus") << diameter << thickness << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateTorus(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float diameter,
+    float thickness,
+    size_t tessellation,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Torus") << diameter << thickness << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+    });
 }
 
 
@@ -602,16 +889,21 @@ _Use_decl_annotations_
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(
     ID3D11DeviceContext* deviceContext,
     float size,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeTetrahedron(vertices, indices, size, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Tetrahedron", true) << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTetrahedron(vertices, indices, size, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -622,7 +914,22 @@ void GeometricPrimitive::CreateTetrahedron(
     float size,
     bool rhcoords)
 {
-    ComputeTetrahedron(vertices, indices, size, rhcoords);
+    ComputeCached(GeometryCacheKey("Tetrahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTetrahedron(vertices, indices, size, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateTetrahedron(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float size,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Tetrahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTetrahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -634,16 +941,21 @@ _Use_decl_annotations_
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(
     ID3D11DeviceContext* deviceContext,
     float size,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeOctahedron(vertices, indices, size, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Octahedron", true) << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeOctahedron(vertices, indices, size, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -654,7 +966,22 @@ void GeometricPrimitive::CreateOctahedron(
     float size,
     bool rhcoords)
 {
-    ComputeOctahedron(vertices, indices, size, rhcoords);
+    ComputeCached(GeometryCacheKey("Octahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeOctahedron(vertices, indices, size, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateOctahedron(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float size,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Octahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeOctahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -666,16 +993,21 @@ _Use_decl_annotations_
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(
     ID3D11DeviceContext* deviceContext,
     float size,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeDodecahedron(vertices, indices, size, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Dodecahedron", true) << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeDodecahedron(vertices, indices, size, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -686,7 +1018,22 @@ void GeometricPrimitive::CreateDodecahedron(
     float size,
     bool rhcoords)
 {
-    ComputeDodecahedron(vertices, indices, size, rhcoords);
+    ComputeCached(GeometryCacheKey("Dodecahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeDodecahedron(vertices, indices, size, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateDodecahedron(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float size,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Dodecahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeDodecahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -698,16 +1045,21 @@ _Use_decl_annotations_
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(
     ID3D11DeviceContext* deviceContext,
     float size,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeIcosahedron(vertices, indices, size, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Icosahedron", true) << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeIcosahedron(vertices, indices, size, rhcoords);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -718,7 +1070,22 @@ void GeometricPrimitive::CreateIcosahedron(
     float size,
     bool rhcoords)
 {
-    ComputeIcosahedron(vertices, indices, size, rhcoords);
+    ComputeCached(GeometryCacheKey("Icosahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeIcosahedron(vertices, indices, size, rhcoords);
+    });
+}
+
+void GeometricPrimitive::CreateIcosahedron(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float size,
+    bool rhcoords)
+{
+    ComputeCached(GeometryCacheKey("Icosahedron") << size << rhcoords, vertices, indices, [&]()
+    {
+        ComputeIcosahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -731,16 +1098,21 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(
     ID3D11DeviceContext* deviceContext,
     float size,
     size_t tessellation,
-    bool rhcoords)
+    bool rhcoords,
+    VertexFormat vertexFormat)
 {
     VertexCollection vertices;
-    IndexCollection indices;
-    ComputeTeapot(vertices, indices, size, tessellation, rhcoords);
+    IndexCollection32 indices;
+    ComputeCached(GeometryCacheKey("Teapot", true) << size << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTeapot(vertices, indices, size, tessellation, rhcoords, nullptr);
+        OptimizeGeometry(vertices, indices, false, nullptr);
+    });
 
     // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
 
-    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, vertexFormat);
 
     return primitive;
 }
@@ -750,9 +1122,82 @@ void GeometricPrimitive::CreateTeapot(
     std::vector<uint16_t>& indices,
     float size,
     size_t tessellation,
-    bool rhcoords)
+    bool rhcoords,
+    const ParallelFor& parallelFor)
+{
+    ComputeCached(GeometryCacheKey("Teapot") << size << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTeapot(vertices, indices, size, tessellation, rhcoords, parallelFor);
+    });
+}
+
+void GeometricPrimitive::CreateTeapot(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    float size,
+    size_t tessellation,
+    bool rhcoords,
+    const ParallelFor& parallelFor)
+{
+    ComputeCached(GeometryCacheKey("Teapot") << size << tessellation << rhcoords, vertices, indices, [&]()
+    {
+        ComputeTeapot(vertices, indices, size, tessellation, rhcoords, parallelFor);
+    });
+}
+
+
+//--------------------------------------------------------------------------------------
+// Packed vertices
+//--------------------------------------------------------------------------------------
+
+void GeometricPrimitive::Pack(
+    const std::vector<VertexType>& vertices,
+    std::vector<PackedVertexType>& packed)
+{
+    packed.resize(vertices.size());
+
+    PackedVertexType::Encode(vertices.data(), vertices.size(), packed.data());
+}
+
+
+//--------------------------------------------------------------------------------------
+// Geometry cache
+//--------------------------------------------------------------------------------------
+
+_Use_decl_annotations_
+void GeometricPrimitive::SetCacheDirectory(const wchar_t* directory)
+{
+    SetGeometryCacheDirectory(directory);
+}
+
+GeometricPrimitive::CacheStats GeometricPrimitive::GetCacheStats()
+{
+    return GetGeometryCacheStats();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Optimization
+//--------------------------------------------------------------------------------------
+
+_Use_decl_annotations_
+void GeometricPrimitive::Optimize(
+    std::vector<VertexType>& vertices,
+    std::vector<uint16_t>& indices,
+    bool weldTextureSeams,
+    OptimizeStats* stats)
+{
+    OptimizeGeometry(vertices, indices, weldTextureSeams, stats);
+}
+
+_Use_decl_annotations_
+void GeometricPrimitive::Optimize(
+    std::vector<VertexType>& vertices,
+    std::vector<uint32_t>& indices,
+    bool weldTextureSeams,
+    OptimizeStats* stats)
 {
-    ComputeTeapot(vertices, indices, size, tessellation, rhcoords);
+    OptimizeGeometry(vertices, indices, weldTextureSeams, stats);
 }
 
 
@@ -792,3 +1237,36 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCustom(
 
     return primitive;
 }
+
+_Use_decl_annotations_
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCustom(
+    ID3D11DeviceContext* deviceContext,
+    const std::vector<VertexType>& vertices,
+    const std::vector<uint32_t>& indices)
+{
+    // Extra validation
+    if (vertices.empty() || indices.empty())
+        throw std::exception("Requires both vertices and indices");
+
+    if (indices.size() % 3)
+        throw std::exception("Expected triangular faces");
+
+    size_t nVerts = vertices.size();
+    if (nVerts >= UINT32_MAX)
+        throw std::exception("Too many vertices for 32-bit index buffer");
+
+    for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+    {
+        if (*it >= nVerts)
+        {
+            throw std::exception("Index not in vertices list");
+        }
+    }
+
+    // Create the primitive object.
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    primitive->pImpl->Initialize(deviceContext, vertices, indices);
+
+    return primitive;
+}
@@ -15,6 +15,9 @@
 #include "Geometry.h"
 #include "Bezier.h"
 
+#include <limits>
+#include <utility>
+
 using namespace DirectX;
 
 namespace
@@ -23,24 +26,28 @@ namespace
     const float SQRT3 = 1.73205080756887729352f;
     const float SQRT6 = 2.44948974278317809820f;
 
+    template<typename index_t>
     inline void CheckIndexOverflow(size_t value)
     {
-        // Use >=, not > comparison, because some D3D level 9_x hardware does not support 0xFFFF index values.
-        if (value >= USHRT_MAX)
+        // Use >=, not > comparison, because some D3D level 9_x hardware does not support 0xFFFF index values, and
+        // 0xFFFFFFFF is the strip cut value for 32-bit indices.
+        if (value >= (std::numeric_limits<index_t>::max)())
             throw std::exception("Index value out of range: cannot tesselate primitive so finely");
     }
 
 
     // Collection types used when generating the geometry.
-    inline void index_push_back(IndexCollection& indices, size_t value)
+    template<typename index_t>
+    inline void index_push_back(IndexCollectionT<index_t>& indices, size_t value)
     {
-        CheckIndexOverflow(value);
-        indices.push_back((uint16_t)value);
+        CheckIndexOverflow<index_t>(value);
+        indices.push_back(static_cast<index_t>(value));
     }
 
 
     // Helper for flipping winding of geometric primitives for LH vs. RH coords
-    inline void ReverseWinding(IndexCollection& indices, VertexCollection& vertices)
+    template<typename index_t>
+    inline void ReverseWinding(IndexCollectionT<index_t>& indices, VertexCollection& vertices)
     {
         assert((indices.size() % 3) == 0);
         for (auto it = indices.begin(); it != indices.end(); it += 3)
@@ -71,7 +78,8 @@ namespace
 //--------------------------------------------------------------------------------------
 // Cube (aka a Hexahedron) or Box
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeBox(VertexCollection& vertices, IndexCollection& indices, const XMFLOAT3& size, bool rhcoords, bool invertn)
+template<typename index_t>
+void DirectX::ComputeBox(VertexCollection& vertices, IndexCollectionT<index_t>& indices, const XMFLOAT3& size, bool rhcoords, bool invertn)
 {
     vertices.clear();
     indices.clear();
@@ -140,7 +148,8 @@ void DirectX::ComputeBox(VertexCollection& vertices, IndexCollection& indices, c
 //--------------------------------------------------------------------------------------
 // Sphere
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeSphere(VertexCollection& vertices, IndexCollection& indices, float diameter, size_t tessellation, bool rhcoords, bool invertn)
+template<typename index_t>
+void DirectX::ComputeSphere(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, size_t tessellation, bool rhcoords, bool invertn)
 {
     vertices.clear();
     indices.clear();
@@ -215,18 +224,19 @@ void DirectX::ComputeSphere(VertexCollection& vertices, IndexCollection& indices
 //--------------------------------------------------------------------------------------
 // Geodesic sphere
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indices, float diameter, size_t tessellation, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, size_t tessellation, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
 
     // An undirected edge between two vertices, represented by a pair of indexes into a vertex array.
     // Becuse this edge is undirected, (a,b) is the same as (b,a).
-    typedef std::pair<uint16_t, uint16_t> UndirectedEdge;
+    typedef std::pair<index_t, index_t> UndirectedEdge;
 
     // Makes an undirected edge. Rather than overloading comparison operators to give us the (a,b)==(b,a) property,
     // we'll just ensure that the larger of the two goes first. This'll simplify things greatly.
-    auto makeUndirectedEdge = [](uint16_t a, uint16_t b)
+    auto makeUndirectedEdge = [](index_t a, index_t b)
     {
         return std::make_pair(std::max(a, b), std::min(a, b));
     };
@@ -234,7 +244,7 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
     // Key: an edge
     // Value: the index of the vertex which lies midway between the two vertices pointed to by the key value
     // This map is used to avoid duplicating vertices when subdividing triangles along edges.
-    typedef std::map<UndirectedEdge, uint16_t> EdgeSubdivisionMap;
+    typedef std::map<UndirectedEdge, index_t> EdgeSubdivisionMap;
 
 
     static const XMFLOAT3 OctahedronVertices[] =
@@ -247,7 +257,7 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
         XMFLOAT3(-1,  0,  0), // 4 left
         XMFLOAT3(0, -1,  0), // 5 bottom
     };
-    static const uint16_t OctahedronIndices[] =
+    static const index_t OctahedronIndices[] =
     {
         0, 1, 2, // top front-right face
         0, 2, 3, // top back-right face
@@ -270,8 +280,8 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
     // We know these values by looking at the above index list for the octahedron. Despite the subdivisions that are
     // about to go on, these values aren't ever going to change because the vertices don't move around in the array.
     // We'll need these values later on to fix the singularities that show up at the poles.
-    const uint16_t northPoleIndex = 0;
-    const uint16_t southPoleIndex = 5;
+    const index_t northPoleIndex = 0;
+    const index_t southPoleIndex = 5;
 
     for (size_t iSubdivision = 0; iSubdivision < tessellation; ++iSubdivision)
     {
@@ -281,7 +291,7 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
         EdgeSubdivisionMap subdividedEdges;
 
         // The new index collection after subdivision.
-        IndexCollection newIndices;
+        IndexCollectionT<index_t> newIndices;
 
         const size_t triangleCount = indices.size() / 3;
         for (size_t iTriangle = 0; iTriangle < triangleCount; ++iTriangle)
@@ -290,20 +300,20 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
             // The winding order of the triangles we output are the same as the winding order of the inputs.
 
             // Indices of the vertices making up this triangle
-            uint16_t iv0 = indices[iTriangle * 3 + 0];
-            uint16_t iv1 = indices[iTriangle * 3 + 1];
-            uint16_t iv2 = indices[iTriangle * 3 + 2];
+            index_t iv0 = indices[iTriangle * 3 + 0];
+            index_t iv1 = indices[iTriangle * 3 + 1];
+            index_t iv2 = indices[iTriangle * 3 + 2];
 
             // Get the new vertices
             XMFLOAT3 v01; // vertex on the midpoint of v0 and v1
             XMFLOAT3 v12; // ditto v1 and v2
             XMFLOAT3 v20; // ditto v2 and v0
-            uint16_t iv01; // index of v01
-            uint16_t iv12; // index of v12
-            uint16_t iv20; // index of v20
+            index_t iv01; // index of v01
+            index_t iv12; // index of v12
+            index_t iv20; // index of v20
 
             // Function that, when given the index of two vertices, creates a new vertex at the midpoint of those vertices.
-            auto divideEdge = [&](uint16_t i0, uint16_t i1, XMFLOAT3& outVertex, uint16_t& outIndex)
+            auto divideEdge = [&](index_t i0, index_t i1, XMFLOAT3& outVertex, index_t& outIndex)
             {
                 const UndirectedEdge edge = makeUndirectedEdge(i0, i1);
 
@@ -328,8 +338,8 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
                         )
                     );
 
-                    outIndex = static_cast<uint16_t>(vertexPositions.size());
-                    CheckIndexOverflow(outIndex);
+                    CheckIndexOverflow<index_t>(vertexPositions.size());
+                    outIndex = static_cast<index_t>(vertexPositions.size());
                     vertexPositions.push_back(outVertex);
 
                     // Now add it to the map.
@@ -350,7 +360,7 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
             //     /b\c/d\
             // v2 o---o---o v1
             //       v12
-            const uint16_t indicesToAdd[] =
+            const index_t indicesToAdd[] =
             {
                  iv0, iv01, iv20, // a
                 iv20, iv12,  iv2, // b
@@ -408,7 +418,7 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
         if (isOnPrimeMeridian)
         {
             size_t newIndex = vertices.size(); // the index of this vertex that we're about to add
-            CheckIndexOverflow(newIndex);
+            CheckIndexOverflow<index_t>(newIndex);
 
             // copy this vertex, correct the texture coordinate, and add the vertex
             VertexPositionNormalTexture v = vertices[i];
@@ -418,9 +428,9 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
             // Now find all the triangles which contain this vertex and update them if necessary
             for (size_t j = 0; j < indices.size(); j += 3)
             {
-                uint16_t* triIndex0 = &indices[j + 0];
-                uint16_t* triIndex1 = &indices[j + 1];
-                uint16_t* triIndex2 = &indices[j + 2];
+                index_t* triIndex0 = &indices[j + 0];
+                index_t* triIndex1 = &indices[j + 1];
+                index_t* triIndex2 = &indices[j + 2];
 
                 if (*triIndex0 == i)
                 {
@@ -454,7 +464,7 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
                     abs(v0.textureCoordinate.x - v2.textureCoordinate.x) > 0.5f)
                 {
                     // yep; replace the specified index to point to the new, corrected vertex
-                    *triIndex0 = static_cast<uint16_t>(newIndex);
+                    *triIndex0 = static_cast<index_t>(newIndex);
                 }
             }
         }
@@ -475,9 +485,9 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
             // These pointers point to the three indices which make up this triangle. pPoleIndex is the pointer to the
             // entry in the index array which represents the pole index, and the other two pointers point to the other
             // two indices making up this triangle.
-            uint16_t* pPoleIndex;
-            uint16_t* pOtherIndex0;
-            uint16_t* pOtherIndex1;
+            index_t* pPoleIndex;
+            index_t* pOtherIndex0;
+            index_t* pOtherIndex1;
             if (indices[i + 0] == poleIndex)
             {
                 pPoleIndex = &indices[i + 0];
@@ -516,9 +526,9 @@ void DirectX::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indi
             }
             else
             {
-                CheckIndexOverflow(vertices.size());
+                CheckIndexOverflow<index_t>(vertices.size());
 
-                *pPoleIndex = static_cast<uint16_t>(vertices.size());
+                *pPoleIndex = static_cast<index_t>(vertices.size());
                 vertices.push_back(newPoleVertex);
             }
         }
@@ -563,7 +573,8 @@ namespace
 
 
     // Helper creates a triangle fan to close the end of a cylinder / cone
-    void CreateCylinderCap(VertexCollection& vertices, IndexCollection& indices, size_t tessellation, float height, float radius, bool isTop)
+    template<typename index_t>
+    void CreateCylinderCap(VertexCollection& vertices, IndexCollectionT<index_t>& indices, size_t tessellation, float height, float radius, bool isTop)
     {
         // Create cap indices.
         for (size_t i = 0; i < tessellation - 2; i++)
@@ -606,7 +617,8 @@ namespace
     }
 }
 
-void DirectX::ComputeCylinder(VertexCollection& vertices, IndexCollection& indices, float height, float diameter, size_t tessellation, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeCylinder(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float height, float diameter, size_t tessellation, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -655,7 +667,8 @@ void DirectX::ComputeCylinder(VertexCollection& vertices, IndexCollection& indic
 
 
 // Creates a cone primitive.
-void DirectX::ComputeCone(VertexCollection& vertices, IndexCollection& indices, float diameter, float height, size_t tessellation, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeCone(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, float height, size_t tessellation, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -707,7 +720,8 @@ void DirectX::ComputeCone(VertexCollection& vertices, IndexCollection& indices,
 //--------------------------------------------------------------------------------------
 // Torus
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeTorus(VertexCollection& vertices, IndexCollection& indices, float diameter, float thickness, size_t tessellation, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeTorus(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, float thickness, size_t tessellation, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -771,7 +785,8 @@ void DirectX::ComputeTorus(VertexCollection& vertices, IndexCollection& indices,
 //--------------------------------------------------------------------------------------
 // Tetrahedron
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeTetrahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeTetrahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -830,7 +845,8 @@ void DirectX::ComputeTetrahedron(VertexCollection& vertices, IndexCollection& in
 //--------------------------------------------------------------------------------------
 // Octahedron
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeOctahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeOctahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -895,7 +911,8 @@ void DirectX::ComputeOctahedron(VertexCollection& vertices, IndexCollection& ind
 //--------------------------------------------------------------------------------------
 // Dodecahedron
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeDodecahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeDodecahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -1025,7 +1042,8 @@ void DirectX::ComputeDodecahedron(VertexCollection& vertices, IndexCollection& i
 //--------------------------------------------------------------------------------------
 // Icosahedron
 //--------------------------------------------------------------------------------------
-void DirectX::ComputeIcosahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeIcosahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords)
 {
     vertices.clear();
     indices.clear();
@@ -1112,40 +1130,87 @@ void DirectX::ComputeIcosahedron(VertexCollection& vertices, IndexCollection& in
 // Teapot
 //--------------------------------------------------------------------------------------
 
-// Include the teapot control point data.
+// Include the teapot control point data, and the tables baked from it.
 namespace
 {
 #include "TeapotData.inc"
+#include "TeapotTables.inc"
+
+    // One tessellation of a patch: as stored, or mirrored in X, in Z, or in both.
+    struct TeapotPatchCopy
+    {
+        size_t patch;
+        size_t mirror;
+    };
+
 
-    // Tessellates the specified bezier patch.
-    void XM_CALLCONV TessellatePatch(VertexCollection& vertices, IndexCollection& indices, TeapotPatch const& patch, size_t tessellation, FXMVECTOR scale, bool isMirrored)
+    // Tessellates the specified bezier patch into the vertices and indices at the given pointers, which must have
+    // room for all of them. vbase is the index of the first vertex.
+    template<typename index_t>
+    void XM_CALLCONV TessellatePatch(VertexPositionNormalTexture* vertices, index_t* indices, size_t vbase, TeapotPatch const& patch, Bezier::PatchBasis const& basis, FXMVECTOR scale, bool isMirrored)
     {
         // Look up the 16 control points for this patch.
         XMVECTOR controlPoints[16];
 
         for (int i = 0; i < 16; i++)
         {
-            controlPoints[i] = TeapotControlPoints[patch.indices[i]] * scale;
+            TeapotControlPoint const& point = TeapotControlPoints[patch.indices[i]];
+
+            controlPoints[i] = XMVectorSet(point.x, point.y, point.z, 0) * scale;
         }
 
         // Create the index data.
-        size_t vbase = vertices.size();
-        Bezier::CreatePatchIndices(tessellation, isMirrored, [&](size_t index)
+        Bezier::CreatePatchIndices(basis.GetTessellation(), isMirrored, [&](size_t index)
         {
-            index_push_back(indices, vbase + index);
+            *indices++ = static_cast<index_t>(vbase + index);
         });
 
         // Create the vertex data.
-        Bezier::CreatePatchVertices(controlPoints, tessellation, isMirrored, [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
+        Bezier::CreatePatchVertices(controlPoints, basis, isMirrored, [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
         {
-            vertices.push_back(VertexPositionNormalTexture(position, normal, textureCoordinate));
+            *vertices++ = VertexPositionNormalTexture(position, normal, textureCoordinate);
         });
     }
+
+
+    template<size_t Tessellation, typename index_t>
+    void CopyBakedTeapot(BakedTeapot<Tessellation> const& baked, VertexCollection& vertices, IndexCollectionT<index_t>& indices)
+    {
+        vertices.reserve(_countof(baked.copies) * _countof(baked.copies[0].vertices));
+        indices.reserve(_countof(baked.copies) * _countof(baked.copies[0].indices));
+
+        for (auto const& copy : baked.copies)
+        {
+            for (auto const& vertex : copy.vertices)
+            {
+                vertices.push_back(VertexPositionNormalTexture(XMFLOAT3(vertex.position), XMFLOAT3(vertex.normal), XMFLOAT2(vertex.textureCoordinate)));
+            }
+
+            indices.insert(indices.end(), std::begin(copy.indices), std::end(copy.indices));
+        }
+    }
+
+
+    // Copies the teapot from the tables in TeapotTables.inc, if it was baked at this tessellation: the default, and
+    // the levels below it.
+    template<typename index_t>
+    bool CopyBakedTeapot(size_t tessellation, VertexCollection& vertices, IndexCollectionT<index_t>& indices)
+    {
+        switch (tessellation)
+        {
+        case 1: CopyBakedTeapot(BakedTeapotData<1>, vertices, indices); return true;
+        case 2: CopyBakedTeapot(BakedTeapotData<2>, vertices, indices); return true;
+        case 4: CopyBakedTeapot(BakedTeapotData<4>, vertices, indices); return true;
+        case 8: CopyBakedTeapot(BakedTeapotData<8>, vertices, indices); return true;
+        default: return false;
+        }
+    }
 }
 
         
 // Creates a teapot primitive.
-void DirectX::ComputeTeapot(VertexCollection& vertices, IndexCollection& indices, float size, size_t tessellation, bool rhcoords)
+template<typename index_t>
+void DirectX::ComputeTeapot(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, size_t tessellation, bool rhcoords, const GeometricPrimitive::ParallelFor& parallelFor)
 {
     vertices.clear();
     indices.clear();
@@ -1153,32 +1218,452 @@ void DirectX::ComputeTeapot(VertexCollection& vertices, IndexCollection& indices
     if (tessellation < 1)
         throw std::out_of_range("tesselation parameter out of range");
 
-    XMVECTOR scaleVector = XMVectorReplicate(size);
+    // Common tessellations of the unit teapot were computed at compile time.
+    if (size == 1 && CopyBakedTeapot(tessellation, vertices, indices))
+    {
+        if (!rhcoords)
+            ReverseWinding(indices, vertices);
 
-    XMVECTOR scaleNegateX = scaleVector * g_XMNegateX;
-    XMVECTOR scaleNegateZ = scaleVector * g_XMNegateZ;
-    XMVECTOR scaleNegateXZ = scaleVector * g_XMNegateX * g_XMNegateZ;
+        return;
+    }
+
+    XMVECTOR scaleVector = XMVectorReplicate(size);
 
-    for (int i = 0; i < sizeof(TeapotPatches) / sizeof(TeapotPatches[0]); i++)
+    // Indexed by TeapotPatchCopy::mirror.
+    const XMVECTOR scales[4] =
     {
-        TeapotPatch const& patch = TeapotPatches[i];
+        scaleVector,
+        scaleVector * g_XMNegateX,
+        scaleVector * g_XMNegateZ,
+        scaleVector * g_XMNegateX * g_XMNegateZ,
+    };
+
+    std::vector<TeapotPatchCopy> copies;
 
+    for (size_t i = 0; i < _countof(TeapotPatches); i++)
+    {
         // Because the teapot is symmetrical from left to right, we only store
         // data for one side, then tessellate each patch twice, mirroring in X.
-        TessellatePatch(vertices, indices, patch, tessellation, scaleVector, false);
-        TessellatePatch(vertices, indices, patch, tessellation, scaleNegateX, true);
+        copies.push_back({ i, 0 });
+        copies.push_back({ i, 1 });
 
-        if (patch.mirrorZ)
+        if (TeapotPatches[i].mirrorZ)
         {
             // Some parts of the teapot (the body, lid, and rim, but not the
             // handle or spout) are also symmetrical from front to back, so
             // we tessellate them four times, mirroring in Z as well as X.
-            TessellatePatch(vertices, indices, patch, tessellation, scaleNegateZ, true);
-            TessellatePatch(vertices, indices, patch, tessellation, scaleNegateXZ, false);
+            copies.push_back({ i, 2 });
+            copies.push_back({ i, 3 });
+        }
+    }
+
+    // Every copy has the same number of vertices and indices, so where each one goes is known up front. The output
+    // is allocated once and the copies written straight into place, in any order.
+    const size_t patchVertices = (tessellation + 1) * (tessellation + 1);
+    const size_t patchIndices = tessellation * tessellation * 6;
+
+    CheckIndexOverflow<index_t>(copies.size() * patchVertices - 1);
+
+    vertices.resize(copies.size() * patchVertices);
+    indices.resize(copies.size() * patchIndices);
+
+    // The Bezier weights at each sample are the same for every patch.
+    const Bezier::PatchBasis basis(tessellation);
+
+    auto tessellateCopy = [&](size_t i)
+    {
+        TeapotPatchCopy const& copy = copies[i];
+        bool isMirrored = (copy.mirror == 1 || copy.mirror == 2);
+
+        TessellatePatch(&vertices[i * patchVertices], &indices[i * patchIndices], i * patchVertices, TeapotPatches[copy.patch], basis, scales[copy.mirror], isMirrored);
+    };
+
+    if (parallelFor)
+    {
+        parallelFor(copies.size(), tessellateCopy);
+    }
+    else
+    {
+        for (size_t i = 0; i < copies.size(); i++)
+        {
+            tessellateCopy(i);
         }
     }
 
     // Built RH above
     if (!rhcoords)
         ReverseWinding(indices, vertices);
-}
\ No newline at end of file
+}
+
+
+//--------------------------------------------------------------------------------------
+// Mesh optimization
+//--------------------------------------------------------------------------------------
+
+namespace
+{
+    const uint32_t UNASSIGNED = UINT32_MAX;
+
+    // Vertices are welded within this fraction of the mesh's extent, and with normals within about a degree.
+    const float WELD_POSITION_TOLERANCE = 1e-5f;
+    const float WELD_NORMAL_COS = 0.99985f;
+    const float WELD_TEXCOORD_TOLERANCE = 1e-5f;
+
+    // Modelled cache size and scoring constants for the triangle order (Forsyth, "Linear-Speed Vertex Cache
+    // Optimisation"). The cache is larger than the one ACMR is reported for, as the order is good for any smaller one.
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+    const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+    const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+
+    const size_t REPORT_CACHE_SIZE = 16;
+
+
+    // Position cell of a vertex on a grid of the given spacing, packed 21 bits per axis.
+    uint64_t CellKey(int x, int y, int z)
+    {
+        const int bias = 1 << 20;
+        return (uint64_t(uint32_t(x + bias) & 0x1FFFFF) << 42)
+            | (uint64_t(uint32_t(y + bias) & 0x1FFFFF) << 21)
+            | uint64_t(uint32_t(z + bias) & 0x1FFFFF);
+    }
+
+
+    bool CanWeld(const VertexPositionNormalTexture& a, const VertexPositionNormalTexture& b, float tolerance, bool weldTextureSeams)
+    {
+        if (fabsf(a.position.x - b.position.x) > tolerance
+            || fabsf(a.position.y - b.position.y) > tolerance
+            || fabsf(a.position.z - b.position.z) > tolerance)
+            return false;
+
+        float cosAngle = a.normal.x * b.normal.x + a.normal.y * b.normal.y + a.normal.z * b.normal.z;
+        if (cosAngle < WELD_NORMAL_COS)
+            return false;
+
+        return weldTextureSeams
+            || (fabsf(a.textureCoordinate.x - b.textureCoordinate.x) <= WELD_TEXCOORD_TOLERANCE
+                && fabsf(a.textureCoordinate.y - b.textureCoordinate.y) <= WELD_TEXCOORD_TOLERANCE);
+    }
+
+
+    // Points the indices of each duplicate vertex at the first vertex it can be welded to, and removes the triangles
+    // left with a repeated corner. Duplicates are found among the vertices in the 27 grid cells around each one.
+    template<typename index_t>
+    void WeldVertices(const VertexCollection& vertices, IndexCollectionT<index_t>& indices, bool weldTextureSeams)
+    {
+        if (vertices.empty())
+            return;
+
+        XMVECTOR vmin = XMLoadFloat3(&vertices[0].position);
+        XMVECTOR vmax = vmin;
+        for (auto it = vertices.cbegin(); it != vertices.cend(); ++it)
+        {
+            XMVECTOR p = XMLoadFloat3(&it->position);
+            vmin = XMVectorMin(vmin, p);
+            vmax = XMVectorMax(vmax, p);
+        }
+
+        XMFLOAT3 extent;
+        XMStoreFloat3(&extent, XMVectorSubtract(vmax, vmin));
+        float tolerance = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * WELD_POSITION_TOLERANCE;
+
+        auto cellOf = [tolerance](float value) { return int(floorf(value / tolerance)); };
+
+        std::vector<std::pair<uint64_t, uint32_t>> cells(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const XMFLOAT3& p = vertices[i].position;
+            cells[i] = std::make_pair(CellKey(cellOf(p.x), cellOf(p.y), cellOf(p.z)), uint32_t(i));
+        }
+        std::sort(cells.begin(), cells.end());
+
+        std::vector<uint32_t> remap(vertices.size(), UNASSIGNED);
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const XMFLOAT3& p = vertices[i].position;
+            int cx = cellOf(p.x);
+            int cy = cellOf(p.y);
+            int cz = cellOf(p.z);
+
+            uint32_t target = uint32_t(i);
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                for (int dy = -1; dy <= 1; ++dy)
+                {
+                    for (int dz = -1; dz <= 1; ++dz)
+                    {
+                        auto range = std::equal_range(
+                            cells.cbegin(),
+                            cells.cend(),
+                            std::make_pair(CellKey(cx + dx, cy + dy, cz + dz), uint32_t(0)),
+                            [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+
+                        // Earlier vertices have already been assigned; weld to the first that is its own target.
+                        for (auto it = range.first; it != range.second && it->second < target; ++it)
+                        {
+                            if (remap[it->second] == it->second
+                                && CanWeld(vertices[it->second], vertices[i], tolerance, weldTextureSeams))
+                            {
+                                target = it->second;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            remap[i] = target;
+        }
+
+        size_t count = 0;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            index_t i0 = static_cast<index_t>(remap[indices[i]]);
+            index_t i1 = static_cast<index_t>(remap[indices[i + 1]]);
+            index_t i2 = static_cast<index_t>(remap[indices[i + 2]]);
+            if (i0 == i1 || i1 == i2 || i2 == i0)
+                continue;
+
+            indices[count++] = i0;
+            indices[count++] = i1;
+            indices[count++] = i2;
+        }
+        indices.resize(count);
+    }
+
+
+    float VertexScore(int cachePosition, uint32_t remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                // The vertices of the last triangle drawn get a fixed score, so that its neighbours aren't favoured
+                // just for being in its winding order.
+                score = FORSYTH_LAST_TRIANGLE_SCORE;
+            }
+            else
+            {
+                float scaler = 1.0f - float(cachePosition - 3) / float(FORSYTH_CACHE_SIZE - 3);
+                score = powf(scaler, FORSYTH_CACHE_DECAY_POWER);
+            }
+        }
+
+        // Favour vertices with few triangles left, so that none are stranded to be drawn much later.
+        return score + FORSYTH_VALENCE_BOOST_SCALE / sqrtf(float(remainingTriangles));
+    }
+
+
+    // Greedily draws next the triangle whose vertices score highest, scoring vertices by their position in a
+    // modelled LRU cache and by how many of their triangles are left to draw.
+    template<typename index_t>
+    void ReorderForVertexCache(IndexCollectionT<index_t>& indices, size_t vertexCount)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // The triangles left to draw of each vertex, the first remaining[v] of its range.
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+            ++remaining[*it];
+
+        std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v)
+            firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        {
+            std::vector<uint32_t> cursor(firstTriangle.cbegin(), firstTriangle.cend() - 1);
+            for (size_t i = 0; i < indices.size(); ++i)
+                vertexTriangles[cursor[indices[i]]++] = uint32_t(i / 3);
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> score(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            score[v] = VertexScore(-1, remaining[v]);
+
+        std::vector<bool> drawn(triangleCount, false);
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> nextCache;
+        cache.reserve(FORSYTH_CACHE_SIZE + 3);
+        nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+        IndexCollectionT<index_t> result;
+        result.reserve(indices.size());
+
+        size_t nextUndrawn = 0;
+        size_t best = 0;
+        while (result.size() < indices.size())
+        {
+            const index_t* corners = &indices[best * 3];
+            drawn[best] = true;
+            result.insert(result.end(), corners, corners + 3);
+
+            // Remove the triangle from its vertices' lists.
+            for (size_t k = 0; k < 3; ++k)
+            {
+                uint32_t v = corners[k];
+                uint32_t* list = &vertexTriangles[firstTriangle[v]];
+                uint32_t* last = list + remaining[v] - 1;
+                *std::find(list, last + 1, uint32_t(best)) = *last;
+                --remaining[v];
+            }
+
+            // Move its vertices to the front of the cache.
+            nextCache.assign(corners, corners + 3);
+            for (auto it = cache.cbegin(); it != cache.cend(); ++it)
+            {
+                if (*it != corners[0] && *it != corners[1] && *it != corners[2])
+                    nextCache.push_back(*it);
+            }
+
+            for (size_t i = 0; i < nextCache.size(); ++i)
+            {
+                uint32_t v = nextCache[i];
+                cachePosition[v] = (i < size_t(FORSYTH_CACHE_SIZE)) ? int(i) : -1;
+                score[v] = VertexScore(cachePosition[v], remaining[v]);
+            }
+            if (nextCache.size() > size_t(FORSYTH_CACHE_SIZE))
+                nextCache.resize(FORSYTH_CACHE_SIZE);
+            cache.swap(nextCache);
+
+            // The next triangle is the best one touching the cache, or failing that the first not yet drawn.
+            float bestScore = -1.0f;
+            for (auto it = cache.cbegin(); it != cache.cend(); ++it)
+            {
+                const uint32_t* list = &vertexTriangles[firstTriangle[*it]];
+                for (uint32_t t = 0; t < remaining[*it]; ++t)
+                {
+                    const index_t* tri = &indices[list[t] * 3];
+                    float triangleScore = score[tri[0]] + score[tri[1]] + score[tri[2]];
+                    if (triangleScore > bestScore)
+                    {
+                        bestScore = triangleScore;
+                        best = list[t];
+                    }
+                }
+            }
+
+            if (bestScore < 0.0f)
+            {
+                while (nextUndrawn < triangleCount && drawn[nextUndrawn])
+                    ++nextUndrawn;
+                best = nextUndrawn;
+            }
+        }
+
+        indices.swap(result);
+    }
+
+
+    // Renumbers the vertices in the order the indices first use them, dropping any left unused.
+    template<typename index_t>
+    void ReorderForVertexFetch(VertexCollection& vertices, IndexCollectionT<index_t>& indices)
+    {
+        std::vector<uint32_t> remap(vertices.size(), UNASSIGNED);
+        VertexCollection reordered;
+        reordered.reserve(vertices.size());
+
+        for (auto it = indices.begin(); it != indices.end(); ++it)
+        {
+            if (remap[*it] == UNASSIGNED)
+            {
+                remap[*it] = uint32_t(reordered.size());
+                reordered.push_back(vertices[*it]);
+            }
+            *it = static_cast<index_t>(remap[*it]);
+        }
+
+        vertices.swap(reordered);
+    }
+}
+
+
+template<typename index_t>
+float DirectX::ComputeACMR(const IndexCollectionT<index_t>& indices, size_t cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return 0.0f;
+
+    // A vertex is in the cache if fewer than cacheSize misses have happened since it was loaded.
+    std::vector<size_t> loadedAt(size_t(*std::max_element(indices.cbegin(), indices.cend())) + 1, 0);
+    size_t misses = 0;
+    for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+    {
+        if (loadedAt[*it] == 0 || misses - loadedAt[*it] >= cacheSize)
+        {
+            ++misses;
+            loadedAt[*it] = misses;
+        }
+    }
+
+    return float(misses) / float(triangleCount);
+}
+
+
+template<typename index_t>
+void DirectX::OptimizeGeometry(VertexCollection& vertices, IndexCollectionT<index_t>& indices, bool weldTextureSeams, GeometricPrimitive::OptimizeStats* stats)
+{
+    if (indices.size() % 3)
+        throw std::exception("Expected triangular faces");
+
+    for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+    {
+        if (*it >= vertices.size())
+            throw std::exception("Index not in vertices list");
+    }
+
+    if (stats)
+    {
+        stats->verticesBefore = vertices.size();
+        stats->trianglesBefore = indices.size() / 3;
+        stats->acmrBefore = ComputeACMR(indices, REPORT_CACHE_SIZE);
+    }
+
+    WeldVertices(vertices, indices, weldTextureSeams);
+
+    // The triangle order is tuned for a larger LRU cache, so on small meshes can do worse than the generator's own.
+    IndexCollectionT<index_t> reordered(indices);
+    ReorderForVertexCache(reordered, vertices.size());
+    if (ComputeACMR(reordered, REPORT_CACHE_SIZE) < ComputeACMR(indices, REPORT_CACHE_SIZE))
+        indices.swap(reordered);
+
+    ReorderForVertexFetch(vertices, indices);
+
+    if (stats)
+    {
+        stats->verticesAfter = vertices.size();
+        stats->trianglesAfter = indices.size() / 3;
+        stats->acmrAfter = ComputeACMR(indices, REPORT_CACHE_SIZE);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Instantiations for 16 and 32-bit indices
+//--------------------------------------------------------------------------------------
+#define INSTANTIATE_GEOMETRY(index_t) \
+    template void DirectX::ComputeBox<index_t>(VertexCollection&, IndexCollectionT<index_t>&, const XMFLOAT3&, bool, bool); \
+    template void DirectX::ComputeSphere<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, size_t, bool, bool); \
+    template void DirectX::ComputeGeoSphere<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, size_t, bool); \
+    template void DirectX::ComputeCylinder<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, float, size_t, bool); \
+    template void DirectX::ComputeCone<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, float, size_t, bool); \
+    template void DirectX::ComputeTorus<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, float, size_t, bool); \
+    template void DirectX::ComputeTetrahedron<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, bool); \
+    template void DirectX::ComputeOctahedron<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, bool); \
+    template void DirectX::ComputeDodecahedron<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, bool); \
+    template void DirectX::ComputeIcosahedron<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, bool); \
+    template void DirectX::ComputeTeapot<index_t>(VertexCollection&, IndexCollectionT<index_t>&, float, size_t, bool, const GeometricPrimitive::ParallelFor&); \
+    template void DirectX::OptimizeGeometry<index_t>(VertexCollection&, IndexCollectionT<index_t>&, bool, GeometricPrimitive::OptimizeStats*); \
+    template float DirectX::ComputeACMR<index_t>(const IndexCollectionT<index_t>&, size_t);
+
+INSTANTIATE_GEOMETRY(uint16_t)
+INSTANTIATE_GEOMETRY(uint32_t)
+
+#undef INSTANTIATE_GEOMETRY
@@ -11,22 +11,36 @@
 // http://go.microsoft.com/fwlink/?LinkId=248929
 //--------------------------------------------------------------------------------------
 
+#pragma once
+
+#include "GeometricPrimitive.h"
 #include "VertexTypes.h"
 
 namespace DirectX
 {
     typedef std::vector<DirectX::VertexPositionNormalTexture> VertexCollection;
-    typedef std::vector<uint16_t> IndexCollection;
 
-    void ComputeBox(VertexCollection& vertices, IndexCollection& indices, const XMFLOAT3& size, bool rhcoords, bool invertn);
-    void ComputeSphere(VertexCollection& vertices, IndexCollection& indices, float diameter, size_t tessellation, bool rhcoords, bool invertn);
-    void ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indices, float diameter, size_t tessellation, bool rhcoords);
-    void ComputeCylinder(VertexCollection& vertices, IndexCollection& indices, float height, float diameter, size_t tessellation, bool rhcoords);
-    void ComputeCone(VertexCollection& vertices, IndexCollection& indices, float diameter, float height, size_t tessellation, bool rhcoords);
-    void ComputeTorus(VertexCollection& vertices, IndexCollection& indices, float diameter, float thickness, size_t tessellation, bool rhcoords);
-    void ComputeTetrahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords);
-    void ComputeOctahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords);
-    void ComputeDodecahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords);
-    void ComputeIcosahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords);
-    void ComputeTeapot(VertexCollection& vertices, IndexCollection& indices, float size, size_t tessellation, bool rhcoords);
+    // Indices are 16 or 32-bit; the functions below are instantiated for uint16_t and uint32_t. A generator throws if
+    // the mesh needs more vertices than its index type can address.
+    template<typename index_t> using IndexCollectionT = std::vector<index_t>;
+    typedef IndexCollectionT<uint16_t> IndexCollection;
+    typedef IndexCollectionT<uint32_t> IndexCollection32;
+
+    template<typename index_t> void ComputeBox(VertexCollection& vertices, IndexCollectionT<index_t>& indices, const XMFLOAT3& size, bool rhcoords, bool invertn);
+    template<typename index_t> void ComputeSphere(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, size_t tessellation, bool rhcoords, bool invertn);
+    template<typename index_t> void ComputeGeoSphere(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, size_t tessellation, bool rhcoords);
+    template<typename index_t> void ComputeCylinder(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float height, float diameter, size_t tessellation, bool rhcoords);
+    template<typename index_t> void ComputeCone(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, float height, size_t tessellation, bool rhcoords);
+    template<typename index_t> void ComputeTorus(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float diameter, float thickness, size_t tessellation, bool rhcoords);
+    template<typename index_t> void ComputeTetrahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords);
+    template<typename index_t> void ComputeOctahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords);
+    template<typename index_t> void ComputeDodecahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords);
+    template<typename index_t> void ComputeIcosahedron(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, bool rhcoords);
+    template<typename index_t> void ComputeTeapot(VertexCollection& vertices, IndexCollectionT<index_t>& indices, float size, size_t tessellation, bool rhcoords, const GeometricPrimitive::ParallelFor& parallelFor);
+
+    // Post-tessellation optimization of any of the above; see GeometricPrimitive::Optimize.
+    template<typename index_t> void OptimizeGeometry(VertexCollection& vertices, IndexCollectionT<index_t>& indices, bool weldTextureSeams, _Out_opt_ GeometricPrimitive::OptimizeStats* stats);
+
+    // Average cache miss ratio: post-transform vertex cache misses per triangle, for a FIFO cache of cacheSize entries.
+    template<typename index_t> float ComputeACMR(const IndexCollectionT<index_t>& indices, size_t cacheSize);
 }
\ No newline at end of file
@@ -0,0 +1,359 @@
+//--------------------------------------------------------------------------------------
+// File: GeometryCache.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "GeometryCache.h"
+#include "PlatformHelpers.h"
+
+#include "vbo.h"
+
+#include <atomic>
+
+using namespace DirectX;
+
+static_assert(sizeof(VertexPositionNormalTexture) == 32, "VBO vertex size mismatch");
+
+namespace
+{
+    // Bump whenever the output of a generator or of OptimizeGeometry changes, so that entries written by older code
+    // are no longer found. They are left on disk; the cache directory can be emptied at any time.
+    const uint32_t c_CacheVersion = 1;
+
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    std::mutex g_Mutex;
+    std::wstring g_Directory;
+
+    std::atomic<size_t> g_Hits(0);
+    std::atomic<size_t> g_Misses(0);
+    std::atomic<size_t> g_Writes(0);
+    std::atomic<size_t> g_WriteFailures(0);
+
+
+    // Full path of the entry for key, or false if caching is off.
+    bool GetCachePath(const GeometryCacheKey& key, size_t indexSize, std::wstring& path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_Mutex);
+
+            if (g_Directory.empty())
+                return false;
+
+            path = g_Directory;
+        }
+
+        if (path.back() != L'\\' && path.back() != L'/')
+            path += L'\\';
+
+        path += key.GetFileName(indexSize);
+
+        return true;
+    }
+
+
+    // Read-only view of a whole file.
+    class MappedFile
+    {
+    public:
+        MappedFile() : mData(nullptr), mSize(0) {}
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator= (MappedFile const&) = delete;
+
+        ~MappedFile()
+        {
+            if (mData)
+                UnmapViewOfFile(mData);
+        }
+
+        HRESULT Open(_In_z_ const wchar_t* fileName)
+        {
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+            ScopedHandle hFile(safe_handle(CreateFile2(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_EXISTING, nullptr)));
+#else
+            ScopedHandle hFile(safe_handle(CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)));
+#endif
+
+            if (!hFile)
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            FILE_STANDARD_INFO fileInfo;
+            if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            // Empty files can't be mapped, and no entry is this small anyway.
+            if (fileInfo.EndOfFile.QuadPart <= static_cast<LONGLONG>(sizeof(VBO::header_t))
+                || static_cast<ULONGLONG>(fileInfo.EndOfFile.QuadPart) > SIZE_MAX)
+                return E_FAIL;
+
+            // The view keeps the mapping, and the mapping the file, open once their handles are closed.
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+            ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+            if (!hMapping)
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            void* view = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+#else
+            ScopedHandle hMapping(CreateFileMappingFromApp(hFile.get(), nullptr, PAGE_READONLY, 0, nullptr));
+            if (!hMapping)
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            void* view = MapViewOfFileFromApp(hMapping.get(), FILE_MAP_READ, 0, 0);
+#endif
+            if (!view)
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            mData = static_cast<const uint8_t*>(view);
+            mSize = static_cast<size_t>(fileInfo.EndOfFile.QuadPart);
+
+            return S_OK;
+        }
+
+        const uint8_t* GetData() const { return mData; }
+        size_t GetSize() const { return mSize; }
+
+    private:
+        const uint8_t* mData;
+        size_t mSize;
+    };
+
+
+    // Copies a VBO file's contents, if they are complete and every index is in range.
+    template<typename index_t>
+    bool ReadGeometry(_In_reads_bytes_(dataSize) const uint8_t* data, size_t dataSize, VertexCollection& vertices, IndexCollectionT<index_t>& indices)
+    {
+        auto header = reinterpret_cast<const VBO::header_t*>(data);
+
+        if (!header->numVertices || !header->numIndices || (header->numIndices % 3))
+            return false;
+
+        uint64_t vertSize = uint64_t(sizeof(VertexPositionNormalTexture)) * header->numVertices;
+        uint64_t indexSize = uint64_t(sizeof(index_t)) * header->numIndices;
+
+        if (dataSize != sizeof(VBO::header_t) + vertSize + indexSize)
+            return false;
+
+        auto verts = reinterpret_cast<const VertexPositionNormalTexture*>(data + sizeof(VBO::header_t));
+        auto inds = reinterpret_cast<const index_t*>(data + sizeof(VBO::header_t) + vertSize);
+
+        for (size_t j = 0; j < header->numIndices; ++j)
+        {
+            if (inds[j] >= header->numVertices)
+                return false;
+        }
+
+        vertices.assign(verts, verts + header->numVertices);
+        indices.assign(inds, inds + header->numIndices);
+
+        return true;
+    }
+
+
+    HRESULT WriteBytes(HANDLE hFile, _In_reads_bytes_(size) const void* data, size_t size)
+    {
+        DWORD bytesWritten = 0;
+        if (!WriteFile(hFile, data, static_cast<DWORD>(size), &bytesWritten, nullptr))
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        if (bytesWritten != size)
+            return E_FAIL;
+
+        return S_OK;
+    }
+
+
+    // Writes the entry to a file of its own and then renames it into place, so readers in this or another process
+    // see either no entry or a whole one, and concurrent writers of the same entry don't interleave.
+    template<typename index_t>
+    HRESULT WriteGeometry(const std::wstring& path, const VertexCollection& vertices, const IndexCollectionT<index_t>& indices)
+    {
+        uint64_t vertSize = uint64_t(sizeof(VertexPositionNormalTexture)) * vertices.size();
+        uint64_t indexSize = uint64_t(sizeof(index_t)) * indices.size();
+
+        if (vertices.empty() || indices.empty() || vertSize > UINT32_MAX || indexSize > UINT32_MAX)
+            return E_INVALIDARG;
+
+        VBO::header_t header;
+        header.numVertices = static_cast<uint32_t>(vertices.size());
+        header.numIndices = static_cast<uint32_t>(indices.size());
+
+        wchar_t suffix[32] = {};
+        swprintf_s(suffix, L".%lu.%lu.tmp", GetCurrentProcessId(), GetCurrentThreadId());
+        std::wstring tempPath = path + suffix;
+
+        {
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+            ScopedHandle hFile(safe_handle(CreateFile2(tempPath.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr)));
+#else
+            ScopedHandle hFile(safe_handle(CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)));
+#endif
+            if (!hFile)
+                return HRESULT_FROM_WIN32(GetLastError());
+
+            HRESULT hr = WriteBytes(hFile.get(), &header, sizeof(header));
+            if (SUCCEEDED(hr))
+                hr = WriteBytes(hFile.get(), vertices.data(), static_cast<size_t>(vertSize));
+            if (SUCCEEDED(hr))
+                hr = WriteBytes(hFile.get(), indices.data(), static_cast<size_t>(indexSize));
+
+            if (FAILED(hr))
+            {
+                hFile.reset();
+                DeleteFileW(tempPath.c_str());
+                return hr;
+            }
+        }
+
+        if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            DeleteFileW(tempPath.c_str());
+            return hr;
+        }
+
+        return S_OK;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Keys
+//--------------------------------------------------------------------------------------
+
+_Use_decl_annotations_
+GeometryCacheKey::GeometryCacheKey(const char* generator, bool optimized) :
+    mHash(FNV_OFFSET_BASIS)
+{
+    uint32_t vertexSize = sizeof(VertexPositionNormalTexture);
+
+    Add(&c_CacheVersion, sizeof(c_CacheVersion));
+    Add(&vertexSize, sizeof(vertexSize));
+    Add(generator, strlen(generator) + 1);
+    *this << optimized;
+}
+
+GeometryCacheKey& GeometryCacheKey::operator<< (float value)
+{
+    Add(&value, sizeof(value));
+    return *this;
+}
+
+GeometryCacheKey& GeometryCacheKey::operator<< (size_t value)
+{
+    // The same key on 32 and 64-bit builds.
+    uint64_t wide = value;
+    Add(&wide, sizeof(wide));
+    return *this;
+}
+
+GeometryCacheKey& GeometryCacheKey::operator<< (bool value)
+{
+    uint8_t byte = value ? 1 : 0;
+    Add(&byte, sizeof(byte));
+    return *this;
+}
+
+GeometryCacheKey& GeometryCacheKey::operator<< (const XMFLOAT3& value)
+{
+    return *this << value.x << value.y << value.z;
+}
+
+std::wstring GeometryCacheKey::GetFileName(size_t indexSize) const
+{
+    // VBO files hold 16-bit indices; entries with 32-bit ones share the layout under another extension.
+    wchar_t name[32] = {};
+    swprintf_s(name, L"%016llx%ls", static_cast<unsigned long long>(mHash), (indexSize == sizeof(uint16_t)) ? L".vbo" : L".vbo32");
+    return name;
+}
+
+_Use_decl_annotations_
+void GeometryCacheKey::Add(const void* data, size_t size)
+{
+    // FNV-1a
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t j = 0; j < size; ++j)
+    {
+        mHash ^= bytes[j];
+        mHash *= FNV_PRIME;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Loading and storing
+//--------------------------------------------------------------------------------------
+
+template<typename index_t>
+bool DirectX::LoadCachedGeometry(const GeometryCacheKey& key, VertexCollection& vertices, IndexCollectionT<index_t>& indices)
+{
+    std::wstring path;
+    if (!GetCachePath(key, sizeof(index_t), path))
+        return false;
+
+    MappedFile file;
+    if (FAILED(file.Open(path.c_str())) || !ReadGeometry(file.GetData(), file.GetSize(), vertices, indices))
+    {
+        ++g_Misses;
+        return false;
+    }
+
+    ++g_Hits;
+    return true;
+}
+
+template<typename index_t>
+void DirectX::StoreCachedGeometry(const GeometryCacheKey& key, const VertexCollection& vertices, const IndexCollectionT<index_t>& indices)
+{
+    std::wstring path;
+    if (!GetCachePath(key, sizeof(index_t), path))
+        return;
+
+    HRESULT hr = WriteGeometry(path, vertices, indices);
+    if (FAILED(hr))
+    {
+        DebugTrace("GeometricPrimitive cache failed (%08X) writing '%ls'\n", static_cast<unsigned int>(hr), path.c_str());
+        ++g_WriteFailures;
+        return;
+    }
+
+    ++g_Writes;
+}
+
+template bool DirectX::LoadCachedGeometry<uint16_t>(const GeometryCacheKey&, VertexCollection&, IndexCollectionT<uint16_t>&);
+template bool DirectX::LoadCachedGeometry<uint32_t>(const GeometryCacheKey&, VertexCollection&, IndexCollectionT<uint32_t>&);
+template void DirectX::StoreCachedGeometry<uint16_t>(const GeometryCacheKey&, const VertexCollection&, const IndexCollectionT<uint16_t>&);
+template void DirectX::StoreCachedGeometry<uint32_t>(const GeometryCacheKey&, const VertexCollection&, const IndexCollectionT<uint32_t>&);
+
+
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+_Use_decl_annotations_
+void DirectX::SetGeometryCacheDirectory(const wchar_t* directory)
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+
+    g_Directory = directory ? directory : L"";
+}
+
+GeometricPrimitive::CacheStats DirectX::GetGeometryCacheStats()
+{
+    GeometricPrimitive::CacheStats stats;
+    stats.hits = g_Hits;
+    stats.misses = g_Misses;
+    stats.writes = g_Writes;
+    stats.writeFailures = g_WriteFailures;
+    return stats;
+}
@@ -0,0 +1,67 @@
+//--------------------------------------------------------------------------------------
+// File: GeometryCache.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Geometry.h"
+
+#include <string>
+
+
+namespace DirectX
+{
+    // On-disk cache of generator output; see GeometricPrimitive::SetCacheDirectory.
+    void SetGeometryCacheDirectory(_In_opt_z_ const wchar_t* directory);
+    GeometricPrimitive::CacheStats GetGeometryCacheStats();
+
+    // Identifies the output of one generator call: the generator, every parameter that shapes its output, whether
+    // OptimizeGeometry ran after it, and the cache version. Parameters are hashed by value, so calls that differ only
+    // in how they were spelled, like CreateCube(size) and CreateBox(XMFLOAT3(size, size, size)), share an entry.
+    class GeometryCacheKey
+    {
+    public:
+        explicit GeometryCacheKey(_In_z_ const char* generator, bool optimized = false);
+
+        GeometryCacheKey& operator<< (float value);
+        GeometryCacheKey& operator<< (size_t value);
+        GeometryCacheKey& operator<< (bool value);
+        GeometryCacheKey& operator<< (const XMFLOAT3& value);
+
+        // File name, without a directory, for the geometry with indices of indexSize bytes.
+        std::wstring GetFileName(size_t indexSize) const;
+
+    private:
+        void Add(_In_reads_bytes_(size) const void* data, size_t size);
+
+        uint64_t mHash;
+    };
+
+    // Fills vertices and indices from the cache entry for key and returns true, or returns false if caching is off or
+    // there is no valid entry.
+    template<typename index_t> bool LoadCachedGeometry(const GeometryCacheKey& key, VertexCollection& vertices, IndexCollectionT<index_t>& indices);
+
+    // Writes the cache entry for key, if caching is on. Failures are counted, not thrown: the geometry is still good.
+    template<typename index_t> void StoreCachedGeometry(const GeometryCacheKey& key, const VertexCollection& vertices, const IndexCollectionT<index_t>& indices);
+
+    // Loads the geometry for key from the cache, or calls generate to fill vertices and indices and stores the result.
+    template<typename index_t, typename Generate>
+    void ComputeCached(const GeometryCacheKey& key, VertexCollection& vertices, IndexCollectionT<index_t>& indices, Generate generate)
+    {
+        if (LoadCachedGeometry(key, vertices, indices))
+            return;
+
+        generate();
+
+        StoreCachedGeometry(key, vertices, indices);
+    }
+}
@@ -111,6 +111,146 @@ const D3D11_INPUT_ELEMENT_DESC VertexPositionNormalTexture::InputElements[] =
 static_assert( sizeof(VertexPositionNormalTexture) == 32, "Vertex struct/layout mismatch" );
 
 
+//--------------------------------------------------------------------------------------
+// Vertex struct holding position, normal vector, and texture mapping information, packed.
+const D3D11_INPUT_ELEMENT_DESC VertexPositionNormalTexturePacked::InputElements[] =
+{
+    { "SV_Position", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "NORMAL",      0, DXGI_FORMAT_R16G16_SNORM,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD",    0, DXGI_FORMAT_R16G16_UNORM,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+static_assert( sizeof(VertexPositionNormalTexturePacked) == 16, "Vertex struct/layout mismatch" );
+
+namespace
+{
+    // Octahedral encoding of four normals, one component per vector. Each is projected onto the octahedron
+    // |x| + |y| + |z| = 1 and the lower half folded over the upper, so that x and y alone locate it.
+    inline void XM_CALLCONV EncodeOctahedral(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, _Out_ XMVECTOR* u, _Out_ XMVECTOR* v)
+    {
+        XMVECTOR sum = XMVectorAdd(XMVectorAdd(XMVectorAbs(x), XMVectorAbs(y)), XMVectorAbs(z));
+        XMVECTOR scale = XMVectorSelect(XMVectorReciprocal(sum), g_XMZero, XMVectorEqual(sum, g_XMZero));
+
+        XMVECTOR px = XMVectorMultiply(x, scale);
+        XMVECTOR py = XMVectorMultiply(y, scale);
+        XMVECTOR pz = XMVectorMultiply(z, scale);
+
+        // Zero folds towards +1, as DecodeOctahedral expects.
+        XMVECTOR signX = XMVectorSelect(g_XMNegativeOne, g_XMOne, XMVectorGreaterOrEqual(px, g_XMZero));
+        XMVECTOR signY = XMVectorSelect(g_XMNegativeOne, g_XMOne, XMVectorGreaterOrEqual(py, g_XMZero));
+
+        XMVECTOR foldX = XMVectorMultiply(XMVectorSubtract(g_XMOne, XMVectorAbs(py)), signX);
+        XMVECTOR foldY = XMVectorMultiply(XMVectorSubtract(g_XMOne, XMVectorAbs(px)), signY);
+
+        XMVECTOR lower = XMVectorLess(pz, g_XMZero);
+        *u = XMVectorSelect(px, foldX, lower);
+        *v = XMVectorSelect(py, foldY, lower);
+    }
+
+    // Inverse of EncodeOctahedral, renormalizing the result.
+    inline void XM_CALLCONV DecodeOctahedral(FXMVECTOR u, FXMVECTOR v, _Out_ XMVECTOR* x, _Out_ XMVECTOR* y, _Out_ XMVECTOR* z)
+    {
+        XMVECTOR pz = XMVectorSubtract(XMVectorSubtract(g_XMOne, XMVectorAbs(u)), XMVectorAbs(v));
+        XMVECTOR fold = XMVectorMax(XMVectorNegate(pz), g_XMZero);
+
+        XMVECTOR px = XMVectorAdd(u, XMVectorSelect(fold, XMVectorNegate(fold), XMVectorGreaterOrEqual(u, g_XMZero)));
+        XMVECTOR py = XMVectorAdd(v, XMVectorSelect(fold, XMVectorNegate(fold), XMVectorGreaterOrEqual(v, g_XMZero)));
+
+        XMVECTOR lengthSq = XMVectorMultiplyAdd(px, px, XMVectorMultiplyAdd(py, py, XMVectorMultiply(pz, pz)));
+        XMVECTOR scale = XMVectorReciprocalSqrt(lengthSq);
+
+        *x = XMVectorMultiply(px, scale);
+        *y = XMVectorMultiply(py, scale);
+        *z = XMVectorMultiply(pz, scale);
+    }
+
+    inline void XM_CALLCONV Pack(const VertexPositionNormalTexture& vertex, FXMVECTOR octahedral, VertexPositionNormalTexturePacked& packed)
+    {
+        XMStoreHalf4(&packed.position, XMVectorSetW(XMLoadFloat3(&vertex.position), 1.f));
+        XMStoreShortN2(&packed.normal, octahedral);
+        XMStoreUShortN2(&packed.textureCoordinate, XMLoadFloat2(&vertex.textureCoordinate));
+    }
+
+    inline void XM_CALLCONV Unpack(const VertexPositionNormalTexturePacked& packed, FXMVECTOR normal, VertexPositionNormalTexture& vertex)
+    {
+        XMStoreFloat3(&vertex.position, XMLoadHalf4(&packed.position));
+        XMStoreFloat3(&vertex.normal, normal);
+        XMStoreFloat2(&vertex.textureCoordinate, XMLoadUShortN2(&packed.textureCoordinate));
+    }
+}
+
+_Use_decl_annotations_
+void VertexPositionNormalTexturePacked::Encode(const VertexPositionNormalTexture* vertices, size_t count, VertexPositionNormalTexturePacked* packed)
+{
+    size_t i = 0;
+
+    // Four normals at a time, transposed so that each vector holds one component of all four.
+    for (; i + 4 <= count; i += 4)
+    {
+        XMMATRIX normals = XMMatrixTranspose(XMMATRIX(
+            XMLoadFloat3(&vertices[i].normal),
+            XMLoadFloat3(&vertices[i + 1].normal),
+            XMLoadFloat3(&vertices[i + 2].normal),
+            XMLoadFloat3(&vertices[i + 3].normal)));
+
+        XMVECTOR u, v;
+        EncodeOctahedral(normals.r[0], normals.r[1], normals.r[2], &u, &v);
+
+        XMMATRIX encoded = XMMatrixTranspose(XMMATRIX(u, v, g_XMZero, g_XMZero));
+
+        for (size_t j = 0; j < 4; ++j)
+        {
+            Pack(vertices[i + j], encoded.r[j], packed[i + j]);
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        XMVECTOR normal = XMLoadFloat3(&vertices[i].normal);
+
+        XMVECTOR u, v;
+        EncodeOctahedral(XMVectorSplatX(normal), XMVectorSplatY(normal), XMVectorSplatZ(normal), &u, &v);
+
+        Pack(vertices[i], XMVectorMergeXY(u, v), packed[i]);
+    }
+}
+
+_Use_decl_annotations_
+void VertexPositionNormalTexturePacked::Decode(const VertexPositionNormalTexturePacked* packed, size_t count, VertexPositionNormalTexture* vertices)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        XMMATRIX encoded = XMMatrixTranspose(XMMATRIX(
+            XMLoadShortN2(&packed[i].normal),
+            XMLoadShortN2(&packed[i + 1].normal),
+            XMLoadShortN2(&packed[i + 2].normal),
+            XMLoadShortN2(&packed[i + 3].normal)));
+
+        XMVECTOR x, y, z;
+        DecodeOctahedral(encoded.r[0], encoded.r[1], &x, &y, &z);
+
+        XMMATRIX normals = XMMatrixTranspose(XMMATRIX(x, y, z, g_XMZero));
+
+        for (size_t j = 0; j < 4; ++j)
+        {
+            Unpack(packed[i + j], normals.r[j], vertices[i + j]);
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        XMVECTOR encoded = XMLoadShortN2(&packed[i].normal);
+
+        XMVECTOR x, y, z;
+        DecodeOctahedral(XMVectorSplatX(encoded), XMVectorSplatY(encoded), &x, &y, &z);
+
+        Unpack(packed[i], XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1W>(XMVectorMergeXY(x, y), z), vertices[i]);
+    }
+}
+
+
 //--------------------------------------------------------------------------------------
 // Vertex struct holding position, normal vector, color, and texture mapping information.
 const D3D11_INPUT_ELEMENT_DESC VertexPositionNormalColorTexture::InputElements[] =
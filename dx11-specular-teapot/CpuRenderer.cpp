@@ -0,0 +1,790 @@
+#include "pch.h"
+#include "CpuRenderer.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <fstream>
+
+using namespace DirectX;
+
+//------------------------------------------------------------------------------
+namespace
+{
+constexpr size_t VERTEX_CHUNK_SIZE   = 1024;
+constexpr size_t TRIANGLE_CHUNK_SIZE = 2048;
+constexpr size_t SHADE_BATCH_SIZE    = 256;
+
+//------------------------------------------------------------------------------
+StaticConstantBuffer
+DefaultMaterial()
+{
+  StaticConstantBuffer material;
+  InitStaticConstants(material);
+  return material;
+}
+
+//------------------------------------------------------------------------------
+// Converts a float4 colour into the B8G8R8A8_UNORM back buffer layout.
+inline uint32_t XM_CALLCONV
+PackColor(FXMVECTOR color)
+{
+  XMFLOAT4 c;
+  XMStoreFloat4(&c, XMVectorSaturate(color));
+
+  auto toByte = [](float v) {
+    return static_cast<uint32_t>(v * 255.0f + 0.5f);
+  };
+  return (toByte(c.w) << 24) | (toByte(c.x) << 16) | (toByte(c.y) << 8)
+         | toByte(c.z);
+}
+
+//------------------------------------------------------------------------------
+// Signed area of the parallelogram (a, b, p). Positive when p lies on the
+// inside of a clockwise (in screen space) edge a->b.
+inline float
+EdgeFunction(float ax, float ay, float bx, float by, float px, float py)
+{
+  return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+//------------------------------------------------------------------------------
+inline int
+ClampToInt(float value, int lo, int hi)
+{
+  if (!(value > static_cast<float>(lo)))
+  {
+    return lo;
+  }
+  if (value > static_cast<float>(hi))
+  {
+    return hi;
+  }
+  return static_cast<int>(value);
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+CpuRenderer::CpuRenderer(int width, int height, int threadCount)
+    : m_width(width)
+    , m_height(height)
+    , m_tilesX((width + TileSize - 1) / TileSize)
+    , m_tilesY((height + TileSize - 1) / TileSize)
+    , m_pool(threadCount)
+    , m_staticData(DefaultMaterial())
+    , m_kernel(m_staticData)
+{
+  if (width <= 0 || height <= 0)
+  {
+    throw std::invalid_argument("CpuRenderer: invalid render target size");
+  }
+
+  m_clearColor = PackColor(Colors::CornflowerBlue);
+
+  size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+  m_color.resize(pixelCount, m_clearColor);
+  m_depth.resize(pixelCount, 1.0f);
+  m_visible.resize(pixelCount);
+  m_barycentrics.resize(pixelCount);
+  m_tilePixelsShaded.resize(static_cast<size_t>(m_tilesX * m_tilesY));
+
+  XMStoreFloat4x4(&m_view, XMMatrixIdentity());
+  XMStoreFloat4x4(&m_projection, XMMatrixIdentity());
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::SetShadingIsa(ShadingKernel::Isa isa)
+{
+  m_kernel = ShadingKernel(m_staticData, isa);
+}
+
+//------------------------------------------------------------------------------
+size_t
+CpuRenderer::AddMesh(
+  const std::vector<ModelVertex>& vertices,
+  const std::vector<uint32_t>& indices)
+{
+  if (indices.size() % 3)
+  {
+    throw std::invalid_argument("CpuRenderer: expected triangular faces");
+  }
+
+  Mesh mesh;
+  mesh.vertices = vertices;
+  mesh.indices  = indices;
+  m_meshes.push_back(std::move(mesh));
+
+  return m_meshes.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::SetGridLines(const std::vector<LineVertex>& lines)
+{
+  m_gridLines = lines;
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+CpuRenderer::BeginFrame(FXMMATRIX view, CXMMATRIX projection)
+{
+  XMStoreFloat4x4(&m_view, view);
+  XMStoreFloat4x4(&m_projection, projection);
+
+  // Only the world matrix changes between draws.
+  ComputeViewConstants(m_frameConstants, view);
+  ComputeProjectionConstants(m_frameConstants, projection);
+
+  m_modelDraws.clear();
+  m_lines.clear();
+  m_vertexCount   = 0;
+  m_triangleCount = 0;
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+CpuRenderer::DrawGrid(FXMMATRIX world, size_t vertexCount)
+{
+  XMMATRIX worldViewProj = world * XMLoadFloat4x4(&m_view)
+                           * XMLoadFloat4x4(&m_projection);
+
+  const float halfWidth  = 0.5f * static_cast<float>(m_width);
+  const float halfHeight = 0.5f * static_cast<float>(m_height);
+
+  vertexCount = std::min(vertexCount, m_gridLines.size());
+  for (size_t i = 0; i + 1 < vertexCount; i += 2)
+  {
+    const auto& a = m_gridLines[i];
+    const auto& b = m_gridLines[i + 1];
+
+    XMVECTOR p0 = XMVector3Transform(XMLoadFloat3(&a.position), worldViewProj);
+    XMVECTOR p1 = XMVector3Transform(XMLoadFloat3(&b.position), worldViewProj);
+    XMVECTOR c0 = XMLoadFloat4(&a.color);
+    XMVECTOR c1 = XMLoadFloat4(&b.color);
+
+    // Clip against the near plane (z >= 0 in D3D clip space).
+    float z0 = XMVectorGetZ(p0);
+    float z1 = XMVectorGetZ(p1);
+    if (z0 < 0.0f && z1 < 0.0f)
+    {
+      continue;
+    }
+    if (z0 < 0.0f || z1 < 0.0f)
+    {
+      float t = z0 / (z0 - z1);
+      XMVECTOR p = XMVectorLerp(p0, p1, t);
+      XMVECTOR c = XMVectorLerp(c0, c1, t);
+      if (z0 < 0.0f)
+      {
+        p0 = p;
+        c0 = c;
+      }
+      else
+      {
+        p1 = p;
+        c1 = c;
+      }
+    }
+
+    XMFLOAT4 s0;
+    XMFLOAT4 s1;
+    XMStoreFloat4(&s0, p0);
+    XMStoreFloat4(&s1, p1);
+
+    ScreenLine line;
+    line.x0 = (s0.x / s0.w + 1.0f) * halfWidth;
+    line.y0 = (1.0f - s0.y / s0.w) * halfHeight;
+    line.x1 = (s1.x / s1.w + 1.0f) * halfWidth;
+    line.y1 = (1.0f - s1.y / s1.w) * halfHeight;
+    XMStoreFloat4(&line.color0, c0);
+    XMStoreFloat4(&line.color1, c1);
+    m_lines.push_back(line);
+  }
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+CpuRenderer::DrawModel(size_t meshId, FXMMATRIX world)
+{
+  const Mesh& mesh = m_meshes.at(meshId);
+
+  ModelDraw draw;
+  draw.meshId        = meshId;
+  draw.firstVertex   = m_vertexCount;
+  draw.firstTriangle = m_triangleCount;
+  draw.constants     = m_frameConstants;
+  ComputeWorldConstants(draw.constants, world);
+  m_modelDraws.push_back(draw);
+
+  m_vertexCount += mesh.vertices.size();
+  m_triangleCount += mesh.indices.size() / 3;
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::EndFrame()
+{
+  DX::ScopedZone zone(L"CpuRenderer::EndFrame");
+
+  // Vertex stage.
+  DX::Profiler::BeginZone(L"Transform");
+  m_clipVertices.resize(m_vertexCount);
+
+  size_t vertexJobs =
+    (m_vertexCount + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE;
+  m_pool.ParallelFor(vertexJobs, [this](size_t job) {
+    size_t first = job * VERTEX_CHUNK_SIZE;
+    TransformVertices(
+      first, std::min(VERTEX_CHUNK_SIZE, m_vertexCount - first));
+  });
+  DX::Profiler::EndZone();
+
+  // Triangle setup and binning.
+  DX::Profiler::BeginZone(L"Setup");
+  const size_t tileCount = static_cast<size_t>(m_tilesX * m_tilesY);
+
+  m_chunkCount =
+    (m_triangleCount + TRIANGLE_CHUNK_SIZE - 1) / TRIANGLE_CHUNK_SIZE;
+  if (m_chunks.size() < m_chunkCount)
+  {
+    m_chunks.resize(m_chunkCount);
+  }
+  for (size_t i = 0; i < m_chunkCount; ++i)
+  {
+    m_chunks[i].bins.resize(tileCount);
+  }
+
+  m_pool.ParallelFor(
+    m_chunkCount, [this](size_t chunkIndex) { SetupTriangles(chunkIndex); });
+  DX::Profiler::EndZone();
+
+  // All draws share the frame's view, and so its eye position.
+  if (!m_modelDraws.empty())
+  {
+    m_kernel.SetDrawConstants(m_modelDraws.front().constants);
+  }
+
+  // Rasterization.
+  DX::Profiler::BeginZone(L"Rasterize");
+  m_pool.ParallelFor(tileCount, [this](size_t tileIndex) {
+    DX::ScopedZone tileZone(L"RasterizeTile");
+    RasterizeTile(tileIndex);
+  });
+  DX::Profiler::EndZone();
+
+  // Gather statistics.
+  m_stats                    = FrameStats();
+  m_stats.trianglesSubmitted = m_triangleCount;
+  m_stats.tileCount          = tileCount;
+  for (size_t i = 0; i < m_chunkCount; ++i)
+  {
+    m_stats.trianglesBinned += m_chunks[i].triangles.size();
+  }
+  for (auto pixels : m_tilePixelsShaded)
+  {
+    m_stats.pixelsShaded += pixels;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Port of VertexShader.hlsl.
+//------------------------------------------------------------------------------
+void
+CpuRenderer::TransformVertices(size_t first, size_t count)
+{
+  // Find the draw that owns the first vertex.
+  auto draw = std::upper_bound(
+    m_modelDraws.begin(),
+    m_modelDraws.end(),
+    first,
+    [](size_t value, const ModelDraw& d) { return value < d.firstVertex; });
+  --draw;
+
+  size_t end = first + count;
+  while (first < end)
+  {
+    const Mesh& mesh = m_meshes[draw->meshId];
+    size_t drawEnd   = draw->firstVertex + mesh.vertices.size();
+    size_t stop      = std::min(end, drawEnd);
+    const auto& cb   = draw->constants;
+
+    // The constant buffer holds transposed matrices for HLSL.
+    XMMATRIX model      = XMMatrixTranspose(XMLoadFloat4x4(&cb.model));
+    XMMATRIX view       = XMMatrixTranspose(XMLoadFloat4x4(&cb.view));
+    XMMATRIX projection = XMMatrixTranspose(XMLoadFloat4x4(&cb.projection));
+
+    for (; first < stop; ++first)
+    {
+      const ModelVertex& in = mesh.vertices[first - draw->firstVertex];
+      ClipVertex& out       = m_clipVertices[first];
+
+      XMVECTOR pos    = XMVectorSetW(XMLoadFloat3(&in.position), 1.0f);
+      XMVECTOR normal = XMLoadFloat3(&in.normal);
+
+      XMVECTOR worldPos = XMVector4Transform(pos, model);
+      pos               = XMVector4Transform(worldPos, view);
+      pos               = XMVector4Transform(pos, projection);
+
+      XMStoreFloat4(&out.pos, pos);
+      XMStoreFloat3(&out.normal, XMVector3TransformNormal(normal, model));
+      XMStoreFloat3(&out.worldPos, worldPos);
+    }
+
+    ++draw;
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::SetupTriangles(size_t chunkIndex)
+{
+  TriangleChunk& chunk = m_chunks[chunkIndex];
+  chunk.triangles.clear();
+  for (auto& bin : chunk.bins)
+  {
+    bin.clear();
+  }
+
+  size_t first = chunkIndex * TRIANGLE_CHUNK_SIZE;
+  size_t end   = std::min(first + TRIANGLE_CHUNK_SIZE, m_triangleCount);
+
+  auto draw = std::upper_bound(
+    m_modelDraws.begin(),
+    m_modelDraws.end(),
+    first,
+    [](size_t value, const ModelDraw& d) { return value < d.firstTriangle; });
+  --draw;
+
+  auto lerp = [](const ClipVertex& a, const ClipVertex& b, float t) {
+    ClipVertex r;
+    XMStoreFloat4(
+      &r.pos, XMVectorLerp(XMLoadFloat4(&a.pos), XMLoadFloat4(&b.pos), t));
+    XMStoreFloat3(
+      &r.normal,
+      XMVectorLerp(XMLoadFloat3(&a.normal), XMLoadFloat3(&b.normal), t));
+    XMStoreFloat3(
+      &r.worldPos,
+      XMVectorLerp(XMLoadFloat3(&a.worldPos), XMLoadFloat3(&b.worldPos), t));
+    return r;
+  };
+
+  while (first < end)
+  {
+    const Mesh& mesh           = m_meshes[draw->meshId];
+    size_t drawEnd             = draw->firstTriangle + mesh.indices.size() / 3;
+    size_t stop                = std::min(end, drawEnd);
+    const ClipVertex* vertices = m_clipVertices.data() + draw->firstVertex;
+
+    for (; first < stop; ++first)
+    {
+      const uint32_t* tri = &mesh.indices[(first - draw->firstTriangle) * 3];
+      const ClipVertex* v[3] = {
+        &vertices[tri[0]], &vertices[tri[1]], &vertices[tri[2]]};
+
+      // Trivially reject triangles wholly outside one frustum plane.
+      int outside[5] = {};
+      for (int i = 0; i < 3; ++i)
+      {
+        const XMFLOAT4& p = v[i]->pos;
+        outside[0] += (p.x < -p.w);
+        outside[1] += (p.x > p.w);
+        outside[2] += (p.y < -p.w);
+        outside[3] += (p.y > p.w);
+        outside[4] += (p.z < 0.0f);
+      }
+      if (
+        outside[0] == 3 || outside[1] == 3 || outside[2] == 3
+        || outside[3] == 3 || outside[4] == 3)
+      {
+        continue;
+      }
+
+      if (outside[4] == 0)
+      {
+        EmitTriangle(chunk, *v[0], *v[1], *v[2]);
+        continue;
+      }
+
+      // Clip against the near plane, producing a triangle or a quad.
+      ClipVertex polygon[4];
+      int polygonSize = 0;
+      for (int i = 0; i < 3; ++i)
+      {
+        const ClipVertex& a = *v[i];
+        const ClipVertex& b = *v[(i + 1) % 3];
+        bool aInside        = a.pos.z >= 0.0f;
+        bool bInside        = b.pos.z >= 0.0f;
+
+        if (aInside)
+        {
+          polygon[polygonSize++] = a;
+        }
+        if (aInside != bInside)
+        {
+          polygon[polygonSize++] = lerp(a, b, a.pos.z / (a.pos.z - b.pos.z));
+        }
+      }
+
+      for (int i = 2; i < polygonSize; ++i)
+      {
+        EmitTriangle(chunk, polygon[0], polygon[i - 1], polygon[i]);
+      }
+    }
+
+    ++draw;
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::EmitTriangle(
+  TriangleChunk& chunk,
+  const ClipVertex& v0,
+  const ClipVertex& v1,
+  const ClipVertex& v2)
+{
+  const float halfWidth  = 0.5f * static_cast<float>(m_width);
+  const float halfHeight = 0.5f * static_cast<float>(m_height);
+
+  SetupTriangle tri;
+  const ClipVertex* v[3] = {&v0, &v1, &v2};
+  for (int i = 0; i < 3; ++i)
+  {
+    const XMFLOAT4& p = v[i]->pos;
+    float invW        = 1.0f / p.w;
+
+    tri.x[i]    = (p.x * invW + 1.0f) * halfWidth;
+    tri.y[i]    = (1.0f - p.y * invW) * halfHeight;
+    tri.z[i]    = p.z * invW;
+    tri.invW[i] = invW;
+    XMStoreFloat3(&tri.normal[i], XMLoadFloat3(&v[i]->normal) * invW);
+    XMStoreFloat3(&tri.worldPos[i], XMLoadFloat3(&v[i]->worldPos) * invW);
+  }
+
+  float area =
+    EdgeFunction(tri.x[0], tri.y[0], tri.x[1], tri.y[1], tri.x[2], tri.y[2]);
+
+  // Models are drawn with D3D11_CULL_BACK and clockwise front faces
+  // (CullCounterClockwise). With y pointing down the screen, clockwise
+  // triangles have a positive area; drop the rest, and degenerate ones.
+  if (area <= 0.0f)
+  {
+    return;
+  }
+  tri.invArea = 1.0f / area;
+
+  // Top-left fill rule; edge i is the one opposite vertex i.
+  for (int i = 0; i < 3; ++i)
+  {
+    int a    = (i + 1) % 3;
+    int b    = (i + 2) % 3;
+    float dx = tri.x[b] - tri.x[a];
+    float dy = tri.y[b] - tri.y[a];
+
+    tri.topLeft[i] = (dy < 0.0f) || (dy == 0.0f && dx > 0.0f);
+  }
+
+  // Pixel centres are at half-integer coordinates.
+  float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2])) - 0.5f;
+  float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2])) - 0.5f;
+  float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2])) - 0.5f;
+  float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2])) - 0.5f;
+
+  tri.minX = ClampToInt(std::ceil(minX), 0, m_width);
+  tri.maxX = ClampToInt(std::floor(maxX), -1, m_width - 1);
+  tri.minY = ClampToInt(std::ceil(minY), 0, m_height);
+  tri.maxY = ClampToInt(std::floor(maxY), -1, m_height - 1);
+  if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+  {
+    return;
+  }
+
+  uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+  chunk.triangles.push_back(tri);
+
+  for (int ty = tri.minY / TileSize; ty <= tri.maxY / TileSize; ++ty)
+  {
+    for (int tx = tri.minX / TileSize; tx <= tri.maxX / TileSize; ++tx)
+    {
+      chunk.bins[static_cast<size_t>(ty * m_tilesX + tx)].push_back(index);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::RasterizeTile(size_t tileIndex)
+{
+  const int tileX0 = static_cast<int>(tileIndex % m_tilesX) * TileSize;
+  const int tileY0 = static_cast<int>(tileIndex / m_tilesX) * TileSize;
+  const int tileX1 = std::min(tileX0 + TileSize, m_width);
+  const int tileY1 = std::min(tileY0 + TileSize, m_height);
+
+  // Clear.
+  for (int y = tileY0; y < tileY1; ++y)
+  {
+    size_t row      = static_cast<size_t>(y) * m_width;
+    uint32_t* color = m_color.data() + row;
+    float* depth    = m_depth.data() + row;
+    auto visible    = m_visible.data() + row;
+    std::fill(color + tileX0, color + tileX1, m_clearColor);
+    std::fill(depth + tileX0, depth + tileX1, 1.0f);
+    std::fill(visible + tileX0, visible + tileX1, nullptr);
+  }
+
+  // Grid pass: opaque, no depth test or write.
+  for (const auto& line : m_lines)
+  {
+    DrawLine(line, tileX0, tileY0, tileX1, tileY1);
+  }
+
+  // Model pass, in submission order.
+  for (size_t i = 0; i < m_chunkCount; ++i)
+  {
+    const TriangleChunk& chunk = m_chunks[i];
+    for (uint32_t index : chunk.bins[tileIndex])
+    {
+      DrawTriangle(chunk.triangles[index], tileX0, tileY0, tileX1, tileY1);
+    }
+  }
+
+  m_tilePixelsShaded[tileIndex] = ShadeTile(tileX0, tileY0, tileX1, tileY1);
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::DrawTriangle(
+  const SetupTriangle& tri,
+  int tileX0,
+  int tileY0,
+  int tileX1,
+  int tileY1)
+{
+  const int x0 = std::max(tri.minX, tileX0);
+  const int x1 = std::min(tri.maxX, tileX1 - 1);
+  const int y0 = std::max(tri.minY, tileY0);
+  const int y1 = std::min(tri.maxY, tileY1 - 1);
+
+  for (int y = y0; y <= y1; ++y)
+  {
+    const float py   = static_cast<float>(y) + 0.5f;
+    const size_t row = static_cast<size_t>(y) * m_width;
+
+    for (int x = x0; x <= x1; ++x)
+    {
+      const float px = static_cast<float>(x) + 0.5f;
+
+      float e[3]  = {};
+      bool inside = true;
+      for (int i = 0; i < 3 && inside; ++i)
+      {
+        int a  = (i + 1) % 3;
+        int b  = (i + 2) % 3;
+        e[i]   = EdgeFunction(tri.x[a], tri.y[a], tri.x[b], tri.y[b], px, py);
+        inside = e[i] > 0.0f || (e[i] == 0.0f && tri.topLeft[i]);
+      }
+      if (!inside)
+      {
+        continue;
+      }
+
+      float l0 = e[0] * tri.invArea;
+      float l1 = e[1] * tri.invArea;
+      float l2 = e[2] * tri.invArea;
+
+      // Depth clip (far plane) and LESS depth test.
+      float z = l0 * tri.z[0] + l1 * tri.z[1] + l2 * tri.z[2];
+      if (z > 1.0f || !(z < m_depth[row + x]))
+      {
+        continue;
+      }
+
+      m_depth[row + x]        = z;
+      m_visible[row + x]      = &tri;
+      m_barycentrics[row + x] = XMFLOAT3(l0, l1, l2);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Draws the part of a line that falls within a tile. Pixels are chosen from
+// the line equation alone, so the result does not depend on the tiling.
+//------------------------------------------------------------------------------
+void
+CpuRenderer::DrawLine(
+  const ScreenLine& line, int tileX0, int tileY0, int tileX1, int tileY1)
+{
+  float dx = line.x1 - line.x0;
+  float dy = line.y1 - line.y0;
+  if (dx == 0.0f && dy == 0.0f)
+  {
+    return;
+  }
+
+  XMVECTOR c0 = XMLoadFloat4(&line.color0);
+  XMVECTOR c1 = XMLoadFloat4(&line.color1);
+
+  bool xMajor = std::abs(dx) >= std::abs(dy);
+
+  // Step along the major axis from the smaller coordinate.
+  float major0 = xMajor ? line.x0 : line.y0;
+  float major1 = xMajor ? line.x1 : line.y1;
+  float minor0 = xMajor ? line.y0 : line.x0;
+  float dMajor = xMajor ? dx : dy;
+  float dMinor = xMajor ? dy : dx;
+  if (dMajor < 0.0f)
+  {
+    std::swap(major0, major1);
+    minor0 += dMinor;
+    dMajor = -dMajor;
+    dMinor = -dMinor;
+    std::swap(c0, c1);
+  }
+
+  int majorLo = xMajor ? tileX0 : tileY0;
+  int majorHi = xMajor ? tileX1 - 1 : tileY1 - 1;
+  int minorLo = xMajor ? tileY0 : tileX0;
+  int minorHi = xMajor ? tileY1 - 1 : tileX1 - 1;
+
+  // Pixel centres in [major0, major1).
+  int first = ClampToInt(std::ceil(major0 - 0.5f), majorLo, majorHi + 1);
+  int last  = ClampToInt(std::ceil(major1 - 0.5f) - 1.0f, majorLo - 1, majorHi);
+
+  for (int m = first; m <= last; ++m)
+  {
+    float t     = (static_cast<float>(m) + 0.5f - major0) / dMajor;
+    float minor = std::floor(minor0 + t * dMinor);
+    if (
+      minor < static_cast<float>(minorLo)
+      || minor > static_cast<float>(minorHi))
+    {
+      continue;
+    }
+
+    int n = static_cast<int>(minor);
+    int x = xMajor ? m : n;
+    int y = xMajor ? n : m;
+    m_color[static_cast<size_t>(y) * m_width + x] =
+      PackColor(XMVectorLerp(c0, c1, t));
+  }
+}
+
+//------------------------------------------------------------------------------
+// Shades the visible pixels of a tile in batches: attributes are interpolated
+// into structure-of-arrays form, shaded by the kernel and scattered back.
+// Returns the number of pixels shaded.
+//------------------------------------------------------------------------------
+uint64_t
+CpuRenderer::ShadeTile(int tileX0, int tileY0, int tileX1, int tileY1)
+{
+  float normal[3][SHADE_BATCH_SIZE];
+  float worldPos[3][SHADE_BATCH_SIZE];
+  uint32_t colors[SHADE_BATCH_SIZE];
+  size_t pixels[SHADE_BATCH_SIZE];
+
+  const ShadingKernel::Fragments fragments = {
+    {normal[0], normal[1], normal[2]}, {worldPos[0], worldPos[1], worldPos[2]}};
+
+  uint64_t pixelsShaded = 0;
+  size_t batchSize      = 0;
+
+  auto flush = [&]() {
+    m_kernel.Shade(fragments, batchSize, colors);
+    for (size_t i = 0; i < batchSize; ++i)
+    {
+      m_color[pixels[i]] = colors[i];
+    }
+    pixelsShaded += batchSize;
+    batchSize = 0;
+  };
+
+  for (int y = tileY0; y < tileY1; ++y)
+  {
+    const size_t row = static_cast<size_t>(y) * m_width;
+
+    for (int x = tileX0; x < tileX1; ++x)
+    {
+      const SetupTriangle* tri = m_visible[row + x];
+      if (!tri)
+      {
+        continue;
+      }
+
+      // Perspective-correct attribute interpolation.
+      const XMFLOAT3& l = m_barycentrics[row + x];
+      const float w     = 1.0f
+                      / (l.x * tri->invW[0] + l.y * tri->invW[1]
+                         + l.z * tri->invW[2]);
+
+      XMFLOAT3 n;
+      XMFLOAT3 p;
+      XMStoreFloat3(
+        &n,
+        (XMLoadFloat3(&tri->normal[0]) * l.x
+         + XMLoadFloat3(&tri->normal[1]) * l.y
+         + XMLoadFloat3(&tri->normal[2]) * l.z)
+          * w);
+      XMStoreFloat3(
+        &p,
+        (XMLoadFloat3(&tri->worldPos[0]) * l.x
+         + XMLoadFloat3(&tri->worldPos[1]) * l.y
+         + XMLoadFloat3(&tri->worldPos[2]) * l.z)
+          * w);
+
+      normal[0][batchSize]   = n.x;
+      normal[1][batchSize]   = n.y;
+      normal[2][batchSize]   = n.z;
+      worldPos[0][batchSize] = p.x;
+      worldPos[1][batchSize] = p.y;
+      worldPos[2][batchSize] = p.z;
+      pixels[batchSize]      = row + x;
+
+      if (++batchSize == SHADE_BATCH_SIZE)
+      {
+        flush();
+      }
+    }
+  }
+
+  if (batchSize)
+  {
+    flush();
+  }
+
+  return pixelsShaded;
+}
+
+//------------------------------------------------------------------------------
+void
+CpuRenderer::SaveImage(_In_z_ const wchar_t* fileName) const
+{
+  std::ofstream outFile(fileName, std::ios::out | std::ios::binary);
+  if (!outFile)
+  {
+    throw std::runtime_error("SaveImage");
+  }
+
+  outFile << "P6\n" << m_width << " " << m_height << "\n255\n";
+
+  std::vector<uint8_t> row(static_cast<size_t>(m_width) * 3);
+  for (int y = 0; y < m_height; ++y)
+  {
+    const uint32_t* src = &m_color[static_cast<size_t>(y) * m_width];
+    for (int x = 0; x < m_width; ++x)
+    {
+      row[x * 3 + 0] = static_cast<uint8_t>(src[x] >> 16);
+      row[x * 3 + 1] = static_cast<uint8_t>(src[x] >> 8);
+      row[x * 3 + 2] = static_cast<uint8_t>(src[x]);
+    }
+    outFile.write(
+      reinterpret_cast<const char*>(row.data()),
+      static_cast<std::streamsize>(row.size()));
+  }
+
+  if (!outFile)
+  {
+    throw std::runtime_error("SaveImage");
+  }
+}
+
+//------------------------------------------------------------------------------
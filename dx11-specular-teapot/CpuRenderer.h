@@ -0,0 +1,185 @@
+#pragma once
+
+#include "pch.h"
+#include "ThreadPool.h"
+#include "ShadingKernel.h"
+#include "Shader/MyEffectConstants.h"
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Software implementation of the scene drawn by Game::Render, for machines
+// without a graphics device.
+//
+// Draws are recorded between BeginFrame and EndFrame. EndFrame transforms the
+// vertices, bins the triangles into screen tiles and then rasterizes the tiles
+// in parallel on a thread pool. Models are shaded by a C++ port of
+// VertexShader.hlsl / PixelShader.hlsl using the same constant buffers as
+// MyEffect, with the GPU pass's counter-clockwise culling; grid lines match
+// the vertex-coloured, depth-less Grid pass, which culls nothing.
+//
+// Each tile first resolves visibility, then shades every covered pixel once
+// with ShadingKernel, in SIMD packets.
+//------------------------------------------------------------------------------
+class CpuRenderer
+{
+public:
+  using ModelVertex = DirectX::VertexPositionNormalTexture;
+  using LineVertex  = DirectX::VertexPositionColor;
+
+  static const int TileSize = 64;
+
+  struct FrameStats
+  {
+    size_t trianglesSubmitted = 0;
+    size_t trianglesBinned    = 0;
+    size_t tileCount          = 0;
+    uint64_t pixelsShaded     = 0;
+  };
+
+  // threadCount as per DX::ThreadPool (-1 uses every hardware thread).
+  CpuRenderer(int width, int height, int threadCount = -1);
+
+  CpuRenderer(CpuRenderer const&) = delete;
+  CpuRenderer& operator=(CpuRenderer const&) = delete;
+
+  // Meshes are copied; the returned id is passed to DrawModel.
+  size_t AddMesh(
+    const std::vector<ModelVertex>& vertices,
+    const std::vector<uint32_t>& indices);
+
+  // Line list, two vertices per line.
+  void SetGridLines(const std::vector<LineVertex>& lines);
+
+  void XM_CALLCONV
+  BeginFrame(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection);
+
+  // Draws the first vertexCount vertices of the grid lines.
+  void XM_CALLCONV
+  DrawGrid(DirectX::FXMMATRIX world, size_t vertexCount = SIZE_MAX);
+  void XM_CALLCONV DrawModel(size_t meshId, DirectX::FXMMATRIX world);
+  void EndFrame();
+
+  // Render target access. Pixels use the back buffer's B8G8R8A8 layout.
+  int GetWidth() const { return m_width; }
+  int GetHeight() const { return m_height; }
+  const uint32_t* GetPixels() const { return m_color.data(); }
+  const FrameStats& GetFrameStats() const { return m_stats; }
+  size_t GetConcurrency() const { return m_pool.GetConcurrency(); }
+
+  // Defaults to the best instruction set the machine supports.
+  void SetShadingIsa(ShadingKernel::Isa isa);
+  ShadingKernel::Isa GetShadingIsa() const { return m_kernel.GetIsa(); }
+
+  // Writes the last frame as a binary PPM image.
+  void SaveImage(_In_z_ const wchar_t* fileName) const;
+
+private:
+  // Vertex shader output (see PixelShaderInput in the shaders).
+  struct ClipVertex
+  {
+    DirectX::XMFLOAT4 pos;
+    DirectX::XMFLOAT3 normal;
+    DirectX::XMFLOAT3 worldPos;
+  };
+
+  // Screen-space triangle with perspective-divided attributes.
+  struct SetupTriangle
+  {
+    float x[3];
+    float y[3];
+    float z[3];
+    float invW[3];
+    DirectX::XMFLOAT3 normal[3];
+    DirectX::XMFLOAT3 worldPos[3];
+    float invArea;
+    bool topLeft[3];
+    int minX, minY, maxX, maxY;
+  };
+
+  struct ScreenLine
+  {
+    float x0, y0, x1, y1;
+    DirectX::XMFLOAT4 color0;
+    DirectX::XMFLOAT4 color1;
+  };
+
+  // Triangles are set up in fixed-size chunks, each with its own tile bins so
+  // chunks can be processed without locks. Replaying chunks in order keeps
+  // the submission order, and therefore the output, deterministic.
+  struct TriangleChunk
+  {
+    std::vector<SetupTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;
+  };
+
+  struct Mesh
+  {
+    std::vector<ModelVertex> vertices;
+    std::vector<uint32_t> indices;
+  };
+
+  struct ModelDraw
+  {
+    size_t meshId;
+    size_t firstVertex;    // Offset into m_clipVertices.
+    size_t firstTriangle;  // Offset into the frame's triangle sequence.
+    DynamicConstantBuffer constants;
+  };
+
+  void TransformVertices(size_t first, size_t count);
+  void SetupTriangles(size_t chunkIndex);
+  void EmitTriangle(
+    TriangleChunk& chunk,
+    const ClipVertex& v0,
+    const ClipVertex& v1,
+    const ClipVertex& v2);
+  void RasterizeTile(size_t tileIndex);
+  void DrawTriangle(
+    const SetupTriangle& tri,
+    int tileX0,
+    int tileY0,
+    int tileX1,
+    int tileY1);
+  void DrawLine(
+    const ScreenLine& line, int tileX0, int tileY0, int tileX1, int tileY1);
+  uint64_t ShadeTile(int tileX0, int tileY0, int tileX1, int tileY1);
+
+  int m_width;
+  int m_height;
+  int m_tilesX;
+  int m_tilesY;
+
+  DX::ThreadPool m_pool;
+
+  std::vector<Mesh> m_meshes;
+  std::vector<LineVertex> m_gridLines;
+
+  StaticConstantBuffer m_staticData;
+  ShadingKernel m_kernel;
+  uint32_t m_clearColor;
+  DirectX::XMFLOAT4X4 m_view;
+  DirectX::XMFLOAT4X4 m_projection;
+  DynamicConstantBuffer m_frameConstants;
+
+  // Per-frame state, reused between frames to avoid reallocation.
+  std::vector<ModelDraw> m_modelDraws;
+  std::vector<ScreenLine> m_lines;
+  std::vector<ClipVertex> m_clipVertices;
+  std::vector<TriangleChunk> m_chunks;
+  std::vector<uint64_t> m_tilePixelsShaded;
+  size_t m_chunkCount    = 0;
+  size_t m_vertexCount   = 0;
+  size_t m_triangleCount = 0;
+
+  std::vector<uint32_t> m_color;
+  std::vector<float> m_depth;
+
+  // Visibility: the front-most triangle at each pixel and its barycentrics.
+  std::vector<const SetupTriangle*> m_visible;
+  std::vector<DirectX::XMFLOAT3> m_barycentrics;
+
+  FrameStats m_stats;
+};
+
+//------------------------------------------------------------------------------
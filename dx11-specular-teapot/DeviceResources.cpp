@@ -50,6 +50,8 @@ DX::DeviceResources::DeviceResources(
     , m_window(0)
     , m_d3dFeatureLevel(D3D_FEATURE_LEVEL_9_1)
     , m_outputSize{0, 0, 1, 1}
+    , m_occluded(false)
+    , m_vsync(true)
     , m_deviceNotify(nullptr)
 {
 }
@@ -220,11 +222,42 @@ DX::DeviceResources::CreateDeviceResources()
   }
 }
 
+// Takes the device and context in place of CreateDeviceResources, then creates
+// the render target without a swap chain.
+void
+DX::DeviceResources::CreateOffscreenResources(
+  ID3D11Device* device, ID3D11DeviceContext* context, int width, int height)
+{
+  m_window          = 0;
+  m_d3dDevice       = device;
+  m_d3dContext      = context;
+  m_d3dFeatureLevel = device->GetFeatureLevel();
+
+  m_d3dDevice1.Reset();
+  m_d3dContext1.Reset();
+  m_d3dAnnotation.Reset();
+  m_swapChain.Reset();
+  m_swapChain1.Reset();
+
+  // Obtain Direct3D 11.1 interfaces (if available)
+  if (SUCCEEDED(m_d3dDevice.As(&m_d3dDevice1)))
+  {
+    (void)m_d3dContext.As(&m_d3dContext1);
+    (void)m_d3dContext.As(&m_d3dAnnotation);
+  }
+
+  m_outputSize.left = m_outputSize.top = 0;
+  m_outputSize.right                   = width;
+  m_outputSize.bottom                  = height;
+
+  CreateWindowSizeDependentResources();
+}
+
 // These resources need to be recreated every time the window size is changed.
 void
 DX::DeviceResources::CreateWindowSizeDependentResources()
 {
-  if (!m_window)
+  if (!m_window && !m_d3dDevice)
   {
     throw std::exception("Call SetWindow with a valid Win32 window handle");
   }
@@ -280,7 +313,7 @@ DX::DeviceResources::CreateWindowSizeDependentResources()
       DX::ThrowIfFailed(hr);
     }
   }
-  else
+  else if (m_window)
   {
     // Otherwise, create a new one using the same adapter as the existing
     // Direct3D device.
@@ -354,9 +387,30 @@ DX::DeviceResources::CreateWindowSizeDependentResources()
       dxgiFactory->MakeWindowAssociation(m_window, DXGI_MWA_NO_ALT_ENTER));
   }
 
-  // Create a render target view of the swap chain back buffer.
-  DX::ThrowIfFailed(m_swapChain->GetBuffer(
-    0, IID_PPV_ARGS(m_renderTarget.ReleaseAndGetAddressOf())));
+  if (m_swapChain)
+  {
+    // Create a render target view of the swap chain back buffer.
+    DX::ThrowIfFailed(m_swapChain->GetBuffer(
+      0, IID_PPV_ARGS(m_renderTarget.ReleaseAndGetAddressOf())));
+  }
+  else
+  {
+    // Offscreen, render to a texture made like the back buffer.
+    CD3D11_TEXTURE2D_DESC renderTargetDesc(
+      m_backBufferFormat,
+      backBufferWidth,
+      backBufferHeight,
+      1,
+      1,
+      D3D11_BIND_RENDER_TARGET,
+      D3D11_USAGE_DEFAULT,
+      0,
+      4,
+      0);
+
+    DX::ThrowIfFailed(m_d3dDevice->CreateTexture2D(
+      &renderTargetDesc, nullptr, m_renderTarget.ReleaseAndGetAddressOf()));
+  }
 
   DX::ThrowIfFailed(m_d3dDevice->CreateRenderTargetView(
     m_renderTarget.Get(),
@@ -471,10 +525,18 @@ DX::DeviceResources::HandleDeviceLost()
 void
 DX::DeviceResources::Present()
 {
-  // The first argument instructs DXGI to block until VSync, putting the
-  // application to sleep until the next VSync. This ensures we don't waste any
-  // cycles rendering frames that will never be displayed to the screen.
-  HRESULT hr = m_swapChain->Present(1, 0);
+  // Offscreen frames are left in the render target.
+  if (!m_swapChain)
+  {
+    return;
+  }
+
+  // With vsync, the first argument instructs DXGI to block until VSync,
+  // putting the application to sleep until the next VSync. This ensures we
+  // don't waste any cycles rendering frames that will never be displayed to
+  // the screen.
+  HRESULT hr = m_swapChain->Present(m_vsync ? 1 : 0, 0);
+  m_occluded = (hr == DXGI_STATUS_OCCLUDED);
 
   if (m_d3dContext1)
   {
@@ -512,6 +574,16 @@ DX::DeviceResources::Present()
   }
 }
 
+// Checks whether presenting would show anything, without presenting.
+bool
+DX::DeviceResources::TestOcclusion()
+{
+  m_occluded = m_swapChain
+               && m_swapChain->Present(0, DXGI_PRESENT_TEST)
+                    == DXGI_STATUS_OCCLUDED;
+  return m_occluded;
+}
+
 // This method acquires the first available hardware adapter.
 // If no such adapter can be found, *ppAdapter will be set to nullptr.
 void
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "Profiler.h"
+
 namespace DX
 {
 // Provides an interface for an application that owns DeviceResources to be
@@ -26,6 +28,14 @@ public:
 
   void CreateDeviceResources();
   void CreateWindowSizeDependentResources();
+
+  // Adopts a device created elsewhere, such as a RecordingDevice, and renders
+  // to a texture of the given size instead of a window's swap chain.
+  void CreateOffscreenResources(
+    ID3D11Device* device,
+    ID3D11DeviceContext* context,
+    int width,
+    int height);
   void SetWindow(HWND window, int width, int height);
   bool WindowSizeChanged(int width, int height);
   void HandleDeviceLost();
@@ -35,6 +45,16 @@ public:
   }
   void Present();
 
+  // Whether Present waits for the vertical blank, which paces the frame loop
+  // to the display. On by default.
+  void SetVSync(bool vsync) { m_vsync = vsync; }
+  bool IsVSyncEnabled() const { return m_vsync; }
+
+  // Whether the last Present found the window entirely hidden, so that
+  // drawing can stop until TestOcclusion finds part of it visible again.
+  bool IsOccluded() const { return m_occluded; }
+  bool TestOcclusion();
+
   // Device Accessors.
   RECT GetOutputSize() const { return m_outputSize; }
 
@@ -67,9 +87,12 @@ public:
   D3D11_VIEWPORT GetScreenViewport() const { return m_screenViewport; }
   UINT GetBackBufferCount() const { return m_backBufferCount; }
 
-  // Performance events
+  // Performance events, recorded by the Profiler as well as sent to any
+  // attached graphics debugger.
   void PIXBeginEvent(_In_z_ const wchar_t* name)
   {
+    Profiler::BeginZone(name);
+
     if (m_d3dAnnotation)
     {
       m_d3dAnnotation->BeginEvent(name);
@@ -82,6 +105,8 @@ public:
     {
       m_d3dAnnotation->EndEvent();
     }
+
+    Profiler::EndZone();
   }
 
   void PIXSetMarker(_In_z_ const wchar_t* name)
@@ -121,6 +146,8 @@ private:
   HWND m_window;
   D3D_FEATURE_LEVEL m_d3dFeatureLevel;
   RECT m_outputSize;
+  bool m_occluded;
+  bool m_vsync;
 
   // The IDeviceNotify can be held directly as it owns the DeviceResources.
   IDeviceNotify* m_deviceNotify;
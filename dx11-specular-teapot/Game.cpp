@@ -13,6 +13,24 @@ constexpr float ROTATION_DEGREES_PER_SECOND = 45.f;
 constexpr float CAMERA_SPEED_X              = 1.0f;
 constexpr float CAMERA_SPEED_Y              = 1.0f;
 constexpr wchar_t HUD_TEXT[]                = L"Arrow Keys: rotate camera";
+constexpr float TEAPOT_SPACING              = 1.5f;
+constexpr double FRAME_RATE_LIMIT           = 60.0;
+
+namespace
+{
+//------------------------------------------------------------------------------
+BoundingSphere
+ComputeBounds(const std::vector<VertexPositionNormalTexture>& vertices)
+{
+  BoundingSphere bounds;
+  BoundingSphere::CreateFromPoints(
+    bounds,
+    vertices.size(),
+    &vertices[0].position,
+    sizeof(VertexPositionNormalTexture));
+  return bounds;
+}
+}    // namespace
 
 //------------------------------------------------------------------------------
 Game::Game()
@@ -21,6 +39,48 @@ Game::Game()
 {
   m_deviceResources = std::make_unique<DX::DeviceResources>();
   m_deviceResources->RegisterDeviceNotify(this);
+
+  m_teapotField.SetPlacements(
+    TeapotField::CreateRings(m_sceneOptions.teapotCount, TEAPOT_SPACING));
+}
+
+//------------------------------------------------------------------------------
+void
+Game::SetSceneOptions(const SceneOptions& options)
+{
+  if (options.teapotCount < 1 || options.tessellation < 1)
+  {
+    throw std::invalid_argument("SetSceneOptions");
+  }
+
+  m_sceneOptions = options;
+  m_teapotField.SetPlacements(
+    TeapotField::CreateRings(m_sceneOptions.teapotCount, TEAPOT_SPACING));
+}
+
+//------------------------------------------------------------------------------
+void
+Game::SetSceneScript(SceneScript script)
+{
+  m_sceneScript = std::move(script);
+}
+
+//------------------------------------------------------------------------------
+void
+Game::SetClock(std::shared_ptr<DX::IClock> clock)
+{
+  m_timer.SetClock(std::move(clock));
+}
+
+//------------------------------------------------------------------------------
+void
+Game::SetFrameRateLimit(double framesPerSecond)
+{
+  m_frameRateLimit = framesPerSecond;
+  if (m_powerState == PowerState::Active)
+  {
+    m_timer.SetFrameRateLimit(framesPerSecond);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -29,7 +89,12 @@ Game::Game()
 void
 Game::Initialize(HWND window, int width, int height)
 {
+  m_recordPool =
+    std::make_unique<DX::ThreadPool>(int(m_sceneCommands.size()) - 1);
+  m_loadPool = std::make_unique<DX::ThreadPool>(m_sceneOptions.loadThreads);
+
   m_deviceResources->SetWindow(window, width, height);
+  m_deviceResources->SetVSync(m_sceneOptions.vsync);
 
   m_deviceResources->CreateDeviceResources();
   if (FAILED(CreateDeviceDependentResources()))
@@ -53,6 +118,59 @@ Game::Initialize(HWND window, int width, int height)
   m_timer.SetFixedTimeStep(true);
   m_timer.SetTargetElapsedSeconds(1.0 / 60);
   */
+
+  // Without vsync, sleep out the rest of each frame rather than spin the main
+  // loop. With it, Present already blocks until the next frame.
+  if (!m_sceneOptions.vsync)
+  {
+    SetFrameRateLimit(FRAME_RATE_LIMIT);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Initialize the software renderer in place of the Direct3D resources.
+//------------------------------------------------------------------------------
+void
+Game::InitializeHeadless(int width, int height, int threadCount)
+{
+  m_cpuRenderer = std::make_unique<CpuRenderer>(width, height, threadCount);
+
+  std::vector<VertexPositionNormalTexture> vertices;
+  std::vector<uint32_t> indices;
+  GeometricPrimitive::CreateTeapot(
+    vertices, indices, 1.0f, m_sceneOptions.tessellation);
+  GeometricPrimitive::Optimize(vertices, indices, true);
+  m_cpuTeapotMesh = m_cpuRenderer->AddMesh(vertices, indices);
+  m_teapotField.SetModelBounds(ComputeBounds(vertices));
+
+  Grid::CreateLines(m_sceneOptions.grid, m_cpuGridLines);
+  m_cpuRenderer->SetGridLines(m_cpuGridLines.vertices);
+
+  CreateSceneMatrices(float(width) / float(height));
+}
+
+//------------------------------------------------------------------------------
+// Initialize the Direct3D resources on a recording device, without a window.
+//------------------------------------------------------------------------------
+void
+Game::InitializeRecording(int width, int height)
+{
+  m_recordPool =
+    std::make_unique<DX::ThreadPool>(int(m_sceneCommands.size()) - 1);
+  m_loadPool = std::make_unique<DX::ThreadPool>(m_sceneOptions.loadThreads);
+
+  m_recordingDevice = std::make_unique<DX::RecordingDevice>();
+  m_deviceResources->CreateOffscreenResources(
+    m_recordingDevice->GetDevice(),
+    m_recordingDevice->GetContext(),
+    width,
+    height);
+
+  if (FAILED(CreateDeviceDependentResources())
+      || FAILED(CreateWindowSizeDependentResources()))
+  {
+    throw std::runtime_error("InitializeRecording");
+  }
 }
 
 #pragma region Frame Update
@@ -62,9 +180,61 @@ Game::Initialize(HWND window, int width, int height)
 void
 Game::Tick()
 {
+  if (m_powerState == PowerState::Suspended)
+  {
+    // Nothing moves until OnResuming restarts the timer.
+    m_timer.WaitForNextFrame();
+    m_powerStats.skippedFrames++;
+    m_powerStats.skippedUpdates++;
+    return;
+  }
+
   m_timer.Tick([&]() { Update(m_timer); });
 
+  if (m_powerState == PowerState::Occluded
+      && m_deviceResources->TestOcclusion())
+  {
+    m_powerStats.skippedFrames++;
+    return;
+  }
+
   Render();
+  m_powerStats.renderedFrames++;
+
+  // Present may have found the window hidden, or TestOcclusion visible.
+  UpdatePowerState();
+}
+
+//------------------------------------------------------------------------------
+// Moves to the state the window flags and last Present call for, pacing Tick
+// to suit it.
+//------------------------------------------------------------------------------
+void
+Game::UpdatePowerState()
+{
+  PowerState state = PowerState::Active;
+  if (m_suspended)
+  {
+    state = PowerState::Suspended;
+  }
+  else if (m_deviceResources->IsOccluded())
+  {
+    state = PowerState::Occluded;
+  }
+  else if (!m_windowActive)
+  {
+    state = PowerState::Background;
+  }
+
+  if (state == m_powerState)
+  {
+    return;
+  }
+  m_powerState = state;
+  m_powerStats.stateChanges++;
+
+  m_timer.SetFrameRateLimit(
+    state == PowerState::Active ? m_frameRateLimit : BACKGROUND_FRAME_RATE);
 }
 
 //------------------------------------------------------------------------------
@@ -73,9 +243,36 @@ Game::Tick()
 void
 Game::Update(DX::StepTimer const& timer)
 {
-  HandleInput(timer);
+  if (!m_sceneScript)
+  {
+    HandleInput(timer);
+  }
+  PoseScene(timer.GetTotalSeconds());
+}
+
+//------------------------------------------------------------------------------
+void
+Game::PoseScene(double totalSeconds)
+{
+  if (!m_sceneScript)
+  {
+    AnimateModel(totalSeconds);
+    return;
+  }
+
+  ScenePose pose    = m_sceneScript(totalSeconds);
+  m_cameraRotationX = pose.cameraRotationX;
+  m_cameraRotationY = pose.cameraRotationY;
 
-  float totalTimeS = static_cast<float>(timer.GetTotalSeconds());
+  float radians = static_cast<float>(fmod(pose.modelRotationY, XM_2PI));
+  m_modelWorld  = XMMatrixRotationY(radians);
+}
+
+//------------------------------------------------------------------------------
+void
+Game::AnimateModel(double totalSeconds)
+{
+  float totalTimeS = static_cast<float>(totalSeconds);
 
   // Implicit Model Rotation
   double totalRotation = totalTimeS * m_rotationRadiansPS;
@@ -129,19 +326,27 @@ Game::Render()
     return;
   }
 
+  if (m_cpuRenderer)
+  {
+    RenderCpu();
+    return;
+  }
+
   Clear();
 
   m_deviceResources->PIXBeginEvent(L"Render");
-  auto context = m_deviceResources->GetD3DDeviceContext();
-  context->RSSetState(m_raster.Get());
 
   PositionCamera();
-  m_myEffect->SetView(m_view);
+  RecordScene();
 
-  m_myEffect->SetWorld(m_modelWorld);
-
-  m_grid->Render(m_gridWorld, m_view, m_proj, context);
-  m_teapotMesh->Draw(m_myEffect.get(), m_inputLayout.Get());
+  {
+    DX::ScopedZone zone(L"ExecuteCommands");
+    DX::D3D11CommandExecutor executor(m_deviceResources->GetD3DDeviceContext());
+    for (const auto& commandList : m_sceneCommands)
+    {
+      executor.Execute(commandList);
+    }
+  }
 
   DrawHUD();
 
@@ -151,9 +356,118 @@ Game::Render()
   m_deviceResources->Present();
 }
 
+//------------------------------------------------------------------------------
+// Records the scene into m_sceneCommands without touching the device.
+//------------------------------------------------------------------------------
+void
+Game::RecordScene()
+{
+  DX::ScopedZone zone(L"RecordScene");
+
+  m_recordPool->ParallelFor(m_sceneCommands.size(), [this](size_t index) {
+    DX::RenderCommandList& commandList = m_sceneCommands[index];
+    commandList.Clear();
+    if (index == 0)
+    {
+      commandList.SetRasterizerState(m_raster.Get());
+      m_grid->Render(m_gridWorld, m_view, m_proj, commandList);
+    }
+    else
+    {
+      RecordTeapots(commandList);
+    }
+  });
+}
+
+//------------------------------------------------------------------------------
+// Culls the teapot field and records one instanced draw of what is visible at
+// each level of detail, with the states GeometricPrimitive::Draw would set.
+//------------------------------------------------------------------------------
+void
+Game::RecordTeapots(DX::RenderCommandList& commandList)
+{
+  auto instanceCount = static_cast<uint32_t>(
+    m_teapotField.Cull(m_modelWorld, m_view, m_proj));
+  if (instanceCount == 0)
+  {
+    return;
+  }
+
+  m_teapotField.Upload(commandList);
+
+  commandList.SetBlendState(m_states->Opaque());
+  commandList.SetDepthStencilState(m_states->DepthDefault());
+  commandList.SetRasterizerState(m_states->CullCounterClockwise());
+  commandList.SetInputLayout(m_inputLayout.Get());
+
+  m_myEffect->SetView(m_view);
+  m_myEffect->Apply(commandList);
+
+  m_teapotLod->SetBuffers(commandList);
+  m_teapotField.SetVertexBuffer(commandList, 1);
+  commandList.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+  // The visible instances are packed by level, finest first.
+  const auto& levelCounts = m_teapotField.GetLevelInstanceCounts();
+  uint32_t startInstance  = 0;
+  for (size_t level = 0; level < levelCounts.size(); ++level)
+  {
+    if (levelCounts[level] > 0)
+    {
+      m_teapotLod->DrawInstanced(
+        commandList, level, levelCounts[level], startInstance);
+    }
+    startInstance += levelCounts[level];
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+Game::RenderHeadless(double totalSeconds)
+{
+  if (!m_cpuRenderer)
+  {
+    throw std::logic_error("RenderHeadless requires InitializeHeadless");
+  }
+
+  PoseScene(totalSeconds);
+  RenderCpu();
+}
+
+//------------------------------------------------------------------------------
+// Draws the scene, minus the HUD, with the software renderer.
+//------------------------------------------------------------------------------
+void
+Game::RenderCpu()
+{
+  DX::ScopedZone zone(L"RenderCpu");
+
+  PositionCamera();
+
+  m_cpuRenderer->BeginFrame(m_view, m_proj);
+  size_t gridLevel =
+    Grid::SelectLevel(m_sceneOptions.grid, m_gridWorld, m_view);
+  m_cpuRenderer->DrawGrid(
+    m_gridWorld, m_cpuGridLines.levelVertexCounts[gridLevel]);
+
+  m_teapotField.Cull(m_modelWorld, m_view, m_proj);
+  for (const auto& instance : m_teapotField.GetVisibleInstances())
+  {
+    m_cpuRenderer->DrawModel(m_cpuTeapotMesh, UnpackInstanceWorld(instance));
+  }
+  m_cpuRenderer->EndFrame();
+}
+
 //------------------------------------------------------------------------------
 void
 Game::PositionCamera()
+{
+  m_view = CreateCameraView(m_cameraRotationX, m_cameraRotationY);
+}
+
+//------------------------------------------------------------------------------
+Matrix
+Game::CreateCameraView(float cameraRotationX, float cameraRotationY)
 {
   static const Vector4 eye = {0.0f, 0.7f, 1.2f, 0.0f};
   static const Vector4 at  = {0.0f, -0.1f, 0.0f, 0.0f};
@@ -161,23 +475,25 @@ Game::PositionCamera()
 
   XMVECTOR eyePos = ::XMVectorSubtract(eye, at);
 
-  float radiansX = static_cast<float>(fmod(m_cameraRotationX, XM_2PI));
+  float radiansX = static_cast<float>(fmod(cameraRotationX, XM_2PI));
   eyePos         = ::XMVector3Rotate(
     eyePos, XMQuaternionRotationMatrix(XMMatrixRotationX(radiansX)));
 
-  float radiansY = static_cast<float>(fmod(m_cameraRotationY, XM_2PI));
+  float radiansY = static_cast<float>(fmod(cameraRotationY, XM_2PI));
   eyePos         = ::XMVector3Rotate(
     eyePos, XMQuaternionRotationMatrix(XMMatrixRotationY(radiansY)));
 
   eyePos = ::XMVectorAdd(eyePos, at);
 
-  m_view = XMMatrixLookAtRH(eyePos, at, up);
+  return XMMatrixLookAtRH(eyePos, at, up);
 }
 
 //------------------------------------------------------------------------------
 void
 Game::DrawHUD()
 {
+  m_deviceResources->PIXBeginEvent(L"DrawHUD");
+
   m_fontSpriteBatch->Begin();
 
   m_font->DrawString(
@@ -189,6 +505,8 @@ Game::DrawHUD()
     m_fontOrigin);
 
   m_fontSpriteBatch->End();
+
+  m_deviceResources->PIXEndEvent();
 }
 
 //------------------------------------------------------------------------------
@@ -224,30 +542,35 @@ Game::Clear()
 void
 Game::OnActivated()
 {
-  // TODO: Game is becoming active window.
+  m_windowActive = true;
+  UpdatePowerState();
 }
 
 //------------------------------------------------------------------------------
 void
 Game::OnDeactivated()
 {
-  // TODO: Game is becoming background window.
+  m_windowActive = false;
+  UpdatePowerState();
 }
 
 //------------------------------------------------------------------------------
 void
 Game::OnSuspending()
 {
-  // TODO: Game is being power-suspended (or minimized).
+  m_suspended = true;
+  UpdatePowerState();
 }
 
 //------------------------------------------------------------------------------
 void
 Game::OnResuming()
 {
+  // The time spent suspended is skipped rather than caught up.
   m_timer.ResetElapsedTime();
 
-  // TODO: Game is being power-resumed (or returning from minimize).
+  m_suspended = false;
+  UpdatePowerState();
 }
 
 //------------------------------------------------------------------------------
@@ -283,49 +606,110 @@ Game::CreateDeviceDependentResources()
   auto device  = m_deviceResources->GetD3DDevice();
   auto context = m_deviceResources->GetD3DDeviceContext();
 
-  CD3D11_RASTERIZER_DESC rastDesc(
-    D3D11_FILL_SOLID,
-    D3D11_CULL_NONE,
-    FALSE,
-    D3D11_DEFAULT_DEPTH_BIAS,
-    D3D11_DEFAULT_DEPTH_BIAS_CLAMP,
-    D3D11_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
-    TRUE,
-    FALSE,
-    TRUE,
-    TRUE);
-
+  // Files are read and meshes generated in parallel; one task then creates
+  // every device object from them.
+  DX::MappedData fontData;
+  MyEffect::ShaderBytecode shaderBytecode;
+  TeapotLod::Mesh teapotMesh;
+  Grid::Lines gridLines;
+
+  DX::TaskGraph graph;
+  auto readFont = graph.AddTask(L"Read font", [&]() {
+    fontData = DX::MapData(L"assets/verdana.spritefont");
+  });
+  auto readShaders = graph.AddTask(L"Read shaders", [&]() {
+    shaderBytecode = MyEffect::ReadShaderBytecode();
+  });
+  auto tessellateTeapot = graph.AddTask(L"Tessellate teapot", [&]() {
+    // The patches are shared with the load threads left idle by the other
+    // tasks, rather than a pool of their own.
+    TeapotLod::CreateMesh(
+      m_sceneOptions.tessellation,
+      m_sceneOptions.lodLevels,
+      teapotMesh,
+      [&graph](size_t count, const std::function<void(size_t)>& job) {
+        graph.ParallelFor(count, job);
+      });
+  });
+  auto createGridLines = graph.AddTask(L"Create grid lines", [&]() {
+    Grid::CreateLines(m_sceneOptions.grid, gridLines);
+  });
+
+  graph.AddTask(
+    L"Create device objects",
+    [&]() {
+      CD3D11_RASTERIZER_DESC rastDesc(
+        D3D11_FILL_SOLID,
+        D3D11_CULL_NONE,
+        FALSE,
+        D3D11_DEFAULT_DEPTH_BIAS,
+        D3D11_DEFAULT_DEPTH_BIAS_CLAMP,
+        D3D11_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
+        TRUE,
+        FALSE,
+        TRUE,
+        TRUE);
+      DX::ThrowIfFailed(device->CreateRasterizerState(
+        &rastDesc, m_raster.ReleaseAndGetAddressOf()));
+
+      m_font =
+        std::make_unique<SpriteFont>(device, fontData.data(), fontData.size());
+
+      m_myEffectFactory =
+        std::make_unique<MyEffectFactory>(device, std::move(shaderBytecode));
+
+      IEffectFactory::EffectInfo info;
+      m_myEffect = std::static_pointer_cast<MyEffect>(
+        m_myEffectFactory->CreateEffect(info, context));
+
+      if (!m_myEffect->isInit())
+      {
+        throw std::runtime_error("MyEffect");
+      }
+
+      // Every teapot is drawn by one instanced draw; see Render.
+      m_myEffect->SetInstancing(true);
+
+      m_teapotLod =
+        std::make_unique<TeapotLod>(device, std::move(teapotMesh));
+      m_teapotField.SetModelBounds(
+        ComputeBounds(m_teapotLod->GetMesh().vertices));
+      m_teapotField.SetLevelsOfDetail(
+        m_teapotLod->GetLevelErrors(), m_sceneOptions.lodPixelError);
+      m_teapotField.CreateDeviceResources(device);
+
+      void const* shaderByteCode;
+      size_t byteCodeLength;
+      m_myEffect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+
+      DX::ThrowIfFailed(device->CreateInputLayout(
+        MyEffect::InstancedInputElements,
+        MyEffect::InstancedInputElementCount,
+        shaderByteCode,
+        byteCodeLength,
+        m_inputLayout.ReleaseAndGetAddressOf()));
+
+      m_grid = std::make_unique<Grid>(
+        device, m_sceneOptions.grid, std::move(gridLines));
+      m_states = std::make_unique<CommonStates>(device);
+
+      m_fontSpriteBatch = std::make_unique<SpriteBatch>(context);
+    },
+    {readFont, readShaders, tessellateTeapot, createGridLines});
+
+  HRESULT hr = S_OK;
   try
   {
-    DX::ThrowIfFailed(device->CreateRasterizerState(
-      &rastDesc, m_raster.ReleaseAndGetAddressOf()));
-
-    m_font = std::make_unique<SpriteFont>(device, L"assets/verdana.spritefont");
-
-    m_myEffectFactory = std::make_unique<MyEffectFactory>(device);
-
-    IEffectFactory::EffectInfo info;
-    m_myEffect = std::static_pointer_cast<MyEffect>(
-      m_myEffectFactory->CreateEffect(info, context));
-
-    if (!m_myEffect->isInit())
-    {
-      return E_FAIL;
-    }
-
-    m_teapotMesh = GeometricPrimitive::CreateTeapot(context);
-    m_teapotMesh->CreateInputLayout(m_myEffect.get(), &m_inputLayout);
-
-    m_grid = std::make_unique<Grid>(device, context);
-
-    m_fontSpriteBatch = std::make_unique<SpriteBatch>(context);
+    graph.Run(*m_loadPool);
   }
   catch (...)
   {
-    return E_FAIL;
+    hr = E_FAIL;
   }
 
-  return S_OK;
+  m_loadTimings = graph.GetTimings();
+  m_loadMs      = graph.GetElapsedMs();
+  return hr;
 }
 
 //------------------------------------------------------------------------------
@@ -334,18 +718,15 @@ Game::CreateDeviceDependentResources()
 HRESULT
 Game::CreateWindowSizeDependentResources()
 {
-  const float fovAngleY = 70.0f * XM_PI / 180.0f;
-  RECT outputSize       = m_deviceResources->GetOutputSize();
-  float aspectRatio     = float(outputSize.right - outputSize.left)
+  RECT outputSize   = m_deviceResources->GetOutputSize();
+  float aspectRatio = float(outputSize.right - outputSize.left)
                       / (outputSize.bottom - outputSize.top);
 
-  m_gridWorld  = XMMatrixTranslation(0.0f, -0.3f, 0.0f);
-  m_modelWorld = Matrix::Identity;
-  m_view       = Matrix::Identity;
-  m_proj       = Matrix::CreatePerspectiveFieldOfView(
-    fovAngleY, aspectRatio, 0.01f, 100.f);
+  CreateSceneMatrices(aspectRatio);
 
   m_myEffect->SetProjection(m_proj);
+  m_teapotField.SetViewportHeight(
+    static_cast<float>(outputSize.bottom - outputSize.top));
 
   // Position HUD
   XMVECTOR dimensions = m_font->MeasureString(HUD_TEXT);
@@ -358,13 +739,39 @@ Game::CreateWindowSizeDependentResources()
   return S_OK;
 }
 
+//------------------------------------------------------------------------------
+void
+Game::CreateSceneMatrices(float aspectRatio)
+{
+  m_gridWorld  = XMMatrixTranslation(0.0f, -0.3f, 0.0f);
+  m_modelWorld = Matrix::Identity;
+  m_view       = Matrix::Identity;
+  m_proj       = CreateProjection(aspectRatio);
+}
+
+//------------------------------------------------------------------------------
+Matrix
+Game::CreateProjection(float aspectRatio)
+{
+  const float fovAngleY = 70.0f * XM_PI / 180.0f;
+
+  return Matrix::CreatePerspectiveFieldOfView(
+    fovAngleY, aspectRatio, 0.01f, 100.f);
+}
+
 //------------------------------------------------------------------------------
 void
 Game::OnDeviceLost()
 {
+  for (auto& commandList : m_sceneCommands)
+  {
+    commandList.Clear();
+  }
   m_fontSpriteBatch.reset();
+  m_states.reset();
   m_grid.reset();
-  m_teapotMesh.reset();
+  m_teapotLod.reset();
+  m_teapotField.ReleaseDeviceResources();
   m_inputLayout.Reset();
   m_myEffect.reset();
   m_myEffectFactory.reset();
@@ -5,6 +5,16 @@
 #include "Shader/MyEffect.h"
 #include "Shader/MyEffectFactory.h"
 #include "Grid.h"
+#include "CpuRenderer.h"
+#include "RecordingDevice.h"
+#include "RenderCommandList.h"
+#include "TaskGraph.h"
+#include "TeapotField.h"
+#include "TeapotLod.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <functional>
 
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop.
@@ -13,9 +23,99 @@ class Game : public DX::IDeviceNotify
 public:
   Game();
 
+  // Scene contents. Teapots after the first are placed around it on the grid,
+  // and drawn with one instanced draw per level of detail after frustum
+  // culling.
+  struct SceneOptions
+  {
+    int teapotCount     = 1;
+    size_t tessellation = 8;
+    Grid::Options grid;
+
+    // Levels of detail, the first at tessellation and each after it at half
+    // the last. Each teapot is drawn at the coarsest level that keeps within
+    // lodPixelError pixels of the finest. The software renderer only draws
+    // the finest.
+    size_t lodLevels    = 4;
+    float lodPixelError = 1.0f;
+
+    // Threads, besides the calling one, that load assets when the device
+    // resources are created; -1 for one per hardware thread.
+    int loadThreads = -1;
+
+    // Whether the window presents on the vertical blank. Without it, Tick is
+    // limited to 60 fps instead.
+    bool vsync = true;
+  };
+
+  // How much work Tick does, following the window. A background window
+  // updates and draws at BACKGROUND_FRAME_RATE; an occluded one updates at
+  // that rate but doesn't draw, only checking whether it has become visible;
+  // a minimized or power-suspended one does neither.
+  enum class PowerState
+  {
+    Active,
+    Background,
+    Occluded,
+    Suspended,
+  };
+
+  // Ticks per second, at most, in every state but Active.
+  static constexpr double BACKGROUND_FRAME_RATE = 10.0;
+
+  // Counts of Tick calls since start-up.
+  struct PowerStats
+  {
+    uint64_t renderedFrames = 0;
+    uint64_t skippedFrames  = 0;    // Neither rendered nor presented.
+    uint64_t skippedUpdates = 0;    // Suspended; the timer was not ticked.
+    uint64_t stateChanges   = 0;
+  };
+
+  // Camera and model rotations, in radians.
+  struct ScenePose
+  {
+    float cameraRotationX;
+    float cameraRotationY;
+    float modelRotationY;
+  };
+
+  // Poses the scene for a given time in seconds, in place of keyboard input
+  // and the model's constant spin.
+  using SceneScript = std::function<ScenePose(double totalSeconds)>;
+
+  // Must be called before Initialize, InitializeHeadless or
+  // InitializeRecording.
+  void SetSceneOptions(const SceneOptions& options);
+  void SetSceneScript(SceneScript script);
+
+  // Time source for Tick; defaults to the system clock.
+  void SetClock(std::shared_ptr<DX::IClock> clock);
+
+  // Tick waits until this long after the previous frame began, sleeping
+  // rather than spinning the main loop; zero ticks as fast as it is called.
+  // Initialize sets a 60 fps limit when vsync is off; with it, Present paces
+  // the loop. Applies while the window is active.
+  void SetFrameRateLimit(double framesPerSecond);
+
   // Initialization and management
   void Initialize(HWND window, int width, int height);
 
+  // Renders the scene with CpuRenderer instead of a D3D device. No window,
+  // device or HUD is created; frames are read back through GetCpuRenderer().
+  void InitializeHeadless(int width, int height, int threadCount = -1);
+
+  // Runs the Direct3D path on a RecordingDevice, rendering offscreen, so that
+  // Tick issues every call it would on a real device without needing one.
+  // Frames are counted through GetRecordingDevice(). Loads the shaders and
+  // font as Initialize does; throws if they can't be created.
+  void InitializeRecording(int width, int height);
+
+  // Poses the scene as it would be totalSeconds into the run and draws it with
+  // the software renderer. Unlike Tick this does not read the wall clock, so
+  // the output is reproducible.
+  void RenderHeadless(double totalSeconds);
+
   // Basic game loop
   void Tick();
 
@@ -30,15 +130,48 @@ public:
   void OnResuming();
   void OnWindowSizeChanged(int width, int height);
 
+  // The view and projection the scene is drawn with, for the given camera
+  // rotations in radians and the output's width over height.
+  static DirectX::SimpleMath::Matrix
+  CreateCameraView(float cameraRotationX, float cameraRotationY);
+  static DirectX::SimpleMath::Matrix CreateProjection(float aspectRatio);
+
   // Properties
   void GetDefaultSize(int& width, int& height) const;
+  CpuRenderer* GetCpuRenderer() const { return m_cpuRenderer.get(); }
+
+  // Each step of the last creation of the device resources, and the time it
+  // took as a whole.
+  const std::vector<DX::TaskGraph::Timing>& GetLoadTimings() const
+  {
+    return m_loadTimings;
+  }
+  double GetLoadMs() const { return m_loadMs; }
+  DX::StepTimer::PacingStats GetPacingStats() const
+  {
+    return m_timer.GetPacingStats();
+  }
+  PowerState GetPowerState() const { return m_powerState; }
+  const PowerStats& GetPowerStats() const { return m_powerStats; }
+  DX::RecordingDevice* GetRecordingDevice() const
+  {
+    return m_recordingDevice.get();
+  }
 
 private:
   void Update(DX::StepTimer const& timer);
   void HandleInput(DX::StepTimer const& timer);
+  void PoseScene(double totalSeconds);
+  void AnimateModel(double totalSeconds);
+
+  void UpdatePowerState();
 
   void Render();
+  void RecordScene();
+  void RecordTeapots(DX::RenderCommandList& commandList);
+  void RenderCpu();
   void PositionCamera();
+  void CreateSceneMatrices(float aspectRatio);
   void DrawHUD();
   void Clear();
 
@@ -47,19 +180,49 @@ private:
 
   // Device resources.
   std::unique_ptr<DX::DeviceResources> m_deviceResources;
+  std::unique_ptr<DX::RecordingDevice> m_recordingDevice;
   std::unique_ptr<DirectX::Keyboard> m_keyboard;
   Microsoft::WRL::ComPtr<ID3D11RasterizerState> m_raster;
   std::unique_ptr<DirectX::SpriteFont> m_font;
 
   // Rendering loop timer.
   DX::StepTimer m_timer;
+  double m_frameRateLimit = 0.0;
+
+  // Window state, as told by the message handlers and Present.
+  bool m_windowActive     = true;
+  bool m_suspended        = false;
+  PowerState m_powerState = PowerState::Active;
+  PowerStats m_powerStats;
+
+  // Scene setup.
+  SceneOptions m_sceneOptions;
+  SceneScript m_sceneScript;
+  TeapotField m_teapotField;
 
   // Visuals
   Microsoft::WRL::ComPtr<ID3D11InputLayout> m_inputLayout;
-  std::unique_ptr<DirectX::GeometricPrimitive> m_teapotMesh;
+  std::unique_ptr<TeapotLod> m_teapotLod;
   std::unique_ptr<MyEffectFactory> m_myEffectFactory;
   std::shared_ptr<MyEffect> m_myEffect;
   std::unique_ptr<Grid> m_grid;
+  std::unique_ptr<DirectX::CommonStates> m_states;
+
+  // The grid and the teapots are recorded in parallel, one list each, then
+  // executed in that order.
+  std::array<DX::RenderCommandList, 2> m_sceneCommands;
+  std::unique_ptr<DX::ThreadPool> m_recordPool;
+
+  // Runs the device resource loads, including each restore after a lost
+  // device, with SceneOptions::loadThreads workers.
+  std::unique_ptr<DX::ThreadPool> m_loadPool;
+  std::vector<DX::TaskGraph::Timing> m_loadTimings;
+  double m_loadMs = 0.0;
+
+  // Headless rendering.
+  std::unique_ptr<CpuRenderer> m_cpuRenderer;
+  Grid::Lines m_cpuGridLines;
+  size_t m_cpuTeapotMesh = 0;
 
   DirectX::SimpleMath::Vector2 m_fontPos;
   DirectX::SimpleMath::Vector2 m_fontOrigin;
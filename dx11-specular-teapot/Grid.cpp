@@ -1,15 +1,73 @@
 #include "pch.h"
 #include "Grid.h"
+#include "Profiler.h"
+
+#include <cmath>
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 using Microsoft::WRL::ComPtr;
+
+namespace
+{
+//------------------------------------------------------------------------------
+void
+ValidateOptions(const Grid::Options& _options)
+{
+  if (!(_options.extent > 0.0f) || _options.divisions < 1
+      || _options.lodLevels < 1 || _options.lodLevels > 32
+      || !(_options.lodDistance > 0.0f))
+  {
+    throw std::invalid_argument("Grid::Options");
+  }
+}
+
+//------------------------------------------------------------------------------
+bool
+SameOptions(const Grid::Options& _a, const Grid::Options& _b)
+{
+  return _a.extent == _b.extent && _a.divisions == _b.divisions
+         && _a.lodLevels == _b.lodLevels && _a.lodDistance == _b.lodDistance
+         && _a.color.x == _b.color.x && _a.color.y == _b.color.y
+         && _a.color.z == _b.color.z && _a.color.w == _b.color.w;
+}
+
 //------------------------------------------------------------------------------
-Grid::Grid(ID3D11Device* _device, ID3D11DeviceContext* _deviceContext)
+// The coarsest level line i still shows at: lines at multiples of 2^level
+// survive up to that level, and the outermost lines survive every level.
+uint32_t
+LineLevel(uint32_t _line, const Grid::Options& _options)
+{
+  const uint32_t maxLevel = _options.lodLevels - 1;
+  if (_line == 0 || _line == _options.divisions)
+  {
+    return maxLevel;
+  }
+
+  uint32_t level = 0;
+  while (level < maxLevel && (_line & (1u << level)) == 0)
+  {
+    ++level;
+  }
+  return level;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+Grid::Grid(ID3D11Device* _device, const Options& _options)
+    : Grid(_device, _options, Lines())
+{
+}
+
+//------------------------------------------------------------------------------
+Grid::Grid(ID3D11Device* _device, const Options& _options, Lines&& _lines)
     : m_states(_device)
     , m_effect(_device)
-    , m_batch(_deviceContext)
+    , m_options(_options)
+    , m_lines(std::move(_lines))
 {
+  ValidateOptions(m_options);
+
   m_effect.SetVertexColorEnabled(true);
 
   void const* shaderByteCode;
@@ -22,6 +80,27 @@ Grid::Grid(ID3D11Device* _device, ID3D11DeviceContext* _deviceContext)
     shaderByteCode,
     byteCodeLength,
     m_inputLayout.ReleaseAndGetAddressOf()));
+
+  if (m_lines.vertices.empty())
+  {
+    CreateLines(m_options, m_lines);
+  }
+  CreateVertexBuffer(_device);
+}
+
+//------------------------------------------------------------------------------
+void
+Grid::SetOptions(ID3D11Device* _device, const Options& _options)
+{
+  ValidateOptions(_options);
+  if (SameOptions(_options, m_options))
+  {
+    return;
+  }
+
+  m_options = _options;
+  CreateLines(m_options, m_lines);
+  CreateVertexBuffer(_device);
 }
 
 //------------------------------------------------------------------------------
@@ -30,69 +109,133 @@ Grid::Reset()
 {
 }
 
+//------------------------------------------------------------------------------
+void
+Grid::CreateVertexBuffer(ID3D11Device* _device)
+{
+  CD3D11_BUFFER_DESC desc(
+    static_cast<UINT>(m_lines.vertices.size() * sizeof(VertexPositionColor)),
+    D3D11_BIND_VERTEX_BUFFER,
+    D3D11_USAGE_IMMUTABLE);
+
+  D3D11_SUBRESOURCE_DATA initialData = {};
+  initialData.pSysMem                = m_lines.vertices.data();
+
+  DX::ThrowIfFailed(_device->CreateBuffer(
+    &desc, &initialData, m_vertexBuffer.ReleaseAndGetAddressOf()));
+}
+
 //------------------------------------------------------------------------------
 void XM_CALLCONV
 Grid::Render(
   DirectX::FXMMATRIX _world,
   DirectX::CXMMATRIX _view,
   DirectX::CXMMATRIX _projection,
-  ID3D11DeviceContext* _deviceContext)
+  DX::RenderCommandList& _commandList)
 {
-  ComPtr<ID3D11BlendState> pPrevBlendState;
-  FLOAT prevBlendFactor[4];
-  UINT pPrevSampleMask;
-  ComPtr<ID3D11DepthStencilState> pDepthStencilState;
-  UINT pStencilRef;
+  DX::ScopedZone zone(L"Grid::Render");
 
-  _deviceContext->OMGetBlendState(
-    pPrevBlendState.GetAddressOf(), prevBlendFactor, &pPrevSampleMask);
-  _deviceContext->OMGetDepthStencilState(
-    pDepthStencilState.GetAddressOf(), &pStencilRef);
-
-  _deviceContext->OMSetBlendState(m_states.Opaque(), nullptr, 0xFFFFFFFF);
-  _deviceContext->OMSetDepthStencilState(m_states.DepthNone(), 0);
+  _commandList.SetBlendState(m_states.Opaque());
+  _commandList.SetDepthStencilState(m_states.DepthNone());
 
   m_effect.SetMatrices(_world, _view, _projection);
-  m_effect.Apply(_deviceContext);
-  _deviceContext->IASetInputLayout(m_inputLayout.Get());
+  _commandList.ApplyEffect(&m_effect);
+  _commandList.SetInputLayout(m_inputLayout.Get());
 
-  m_batch.Begin();
+  _commandList.SetVertexBuffer(
+    0, m_vertexBuffer.Get(), sizeof(VertexPositionColor));
+  _commandList.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
 
-  Vector3 xaxis(2.f, 0.f, 0.f);
-  Vector3 yaxis(0.f, 0.f, 2.f);
-  Vector3 origin = Vector3::Zero;
+  size_t level = SelectLevel(m_options, _world, _view);
+  _commandList.Draw(m_lines.levelVertexCounts[level]);
+}
+
+//------------------------------------------------------------------------------
+void
+Grid::CreateLines(const Options& _options, Lines& _lines)
+{
+  ValidateOptions(_options);
+
+  _lines.vertices.clear();
+  _lines.vertices.reserve(4 * (size_t(_options.divisions) + 1));
+  _lines.levelVertexCounts.assign(_options.lodLevels, 0);
 
-  size_t divisions = 20;
+  Vector3 xaxis(_options.extent, 0.f, 0.f);
+  Vector3 yaxis(0.f, 0.f, _options.extent);
+  Vector3 origin = Vector3::Zero;
+  XMVECTOR color = XMLoadFloat4(&_options.color);
 
-  for (size_t i = 0; i <= divisions; ++i)
+  // Coarsest level first, so each level's lines follow those of the levels
+  // above it.
+  for (uint32_t level = _options.lodLevels; level-- > 0;)
   {
-    float fPercent = float(i) / float(divisions);
-    fPercent       = (fPercent * 2.0f) - 1.0f;
+    for (uint32_t i = 0; i <= _options.divisions; ++i)
+    {
+      if (LineLevel(i, _options) != level)
+      {
+        continue;
+      }
+
+      float fPercent = float(i) / float(_options.divisions);
+      fPercent       = (fPercent * 2.0f) - 1.0f;
+
+      Vector3 scale = xaxis * fPercent + origin;
+
+      _lines.vertices.emplace_back(scale - yaxis, color);
+      _lines.vertices.emplace_back(scale + yaxis, color);
+    }
+
+    for (uint32_t i = 0; i <= _options.divisions; ++i)
+    {
+      if (LineLevel(i, _options) != level)
+      {
+        continue;
+      }
+
+      float fPercent = float(i) / float(_options.divisions);
+      fPercent       = (fPercent * 2.0f) - 1.0f;
+
+      Vector3 scale = yaxis * fPercent + origin;
 
-    Vector3 scale = xaxis * fPercent + origin;
+      _lines.vertices.emplace_back(scale - xaxis, color);
+      _lines.vertices.emplace_back(scale + xaxis, color);
+    }
 
-    VertexPositionColor v1(scale - yaxis, Colors::White);
-    VertexPositionColor v2(scale + yaxis, Colors::White);
-    m_batch.DrawLine(v1, v2);
+    _lines.levelVertexCounts[level] =
+      static_cast<uint32_t>(_lines.vertices.size());
   }
+}
 
-  for (size_t i = 0; i <= divisions; i++)
+//------------------------------------------------------------------------------
+// The eye's distance from the grid's square, in grid space, decides the level.
+//------------------------------------------------------------------------------
+size_t XM_CALLCONV
+Grid::SelectLevel(const Options& _options, FXMMATRIX _world, CXMMATRIX _view)
+{
+  if (_options.lodLevels < 2)
   {
-    float fPercent = float(i) / float(divisions);
-    fPercent       = (fPercent * 2.0f) - 1.0f;
+    return 0;
+  }
 
-    Vector3 scale = yaxis * fPercent + origin;
+  XMMATRIX viewToGrid =
+    XMMatrixInverse(nullptr, XMMatrixMultiply(_world, _view));
+  XMFLOAT3 eye;
+  XMStoreFloat3(&eye, viewToGrid.r[3]);
 
-    VertexPositionColor v1(scale - xaxis, Colors::White);
-    VertexPositionColor v2(scale + xaxis, Colors::White);
-    m_batch.DrawLine(v1, v2);
-  }
+  float dx       = std::max(std::fabs(eye.x) - _options.extent, 0.0f);
+  float dz       = std::max(std::fabs(eye.z) - _options.extent, 0.0f);
+  float distance = std::sqrt(dx * dx + eye.y * eye.y + dz * dz);
 
-  m_batch.End();
+  float spacing = 2.0f * _options.extent / float(_options.divisions);
+  float ratio   = distance / (spacing * _options.lodDistance);
+  if (!(ratio > 1.0f))
+  {
+    return 0;
+  }
 
-  _deviceContext->OMSetBlendState(
-    pPrevBlendState.Get(), prevBlendFactor, pPrevSampleMask);
-  _deviceContext->OMSetDepthStencilState(pDepthStencilState.Get(), pStencilRef);
+  float level = std::ceil(std::log2(ratio));
+  return std::min<size_t>(
+    static_cast<size_t>(level), size_t(_options.lodLevels) - 1);
 }
 
 //------------------------------------------------------------------------------
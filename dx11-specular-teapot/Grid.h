@@ -1,25 +1,76 @@
 #pragma once
 #include "pch.h"
+#include "RenderCommandList.h"
 
+//------------------------------------------------------------------------------
+// A square grid of lines on the XZ plane, kept in an immutable vertex buffer
+// that is only rebuilt when the options change, and drawn with one Draw.
 //------------------------------------------------------------------------------
 class Grid
 {
 public:
-  Grid(ID3D11Device* _device, ID3D11DeviceContext* _deviceContext);
+  // The grid spans [-extent, extent] in X and Z with divisions + 1 lines each
+  // way. With lodLevels > 1, every other line is dropped each time the eye's
+  // distance from the grid doubles beyond lodDistance line spacings, down to
+  // every 2^(lodLevels - 1)th line; the outermost lines always remain.
+  struct Options
+  {
+    float extent            = 2.0f;
+    uint32_t divisions      = 20;
+    uint32_t lodLevels      = 1;
+    float lodDistance       = 16.0f;
+    DirectX::XMFLOAT4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+  };
+
+  // Line list (two vertices per line) in model space, ordered coarsest level
+  // first so that every level is a prefix of it.
+  struct Lines
+  {
+    std::vector<DirectX::VertexPositionColor> vertices;
+
+    // Vertices drawn at each level, the first being all of them.
+    std::vector<uint32_t> levelVertexCounts;
+  };
+
+  Grid(ID3D11Device* _device, const Options& _options);
+
+  // Takes lines already made by CreateLines from the same options, so that
+  // they can be generated on another thread first.
+  Grid(ID3D11Device* _device, const Options& _options, Lines&& _lines);
+
+  // Regenerates the lines and vertex buffer if the options have changed.
+  void SetOptions(ID3D11Device* _device, const Options& _options);
+  const Options& GetOptions() const { return m_options; }
+  const Lines& GetLines() const { return m_lines; }
 
   void Reset();
 
+  // Records the grid with opaque blending and no depth test, leaving those
+  // states set. The grid's effect is applied when the list is executed, so
+  // only one grid draw may be pending at a time.
   void XM_CALLCONV Render(
     DirectX::FXMMATRIX _world,
     DirectX::CXMMATRIX _view,
     DirectX::CXMMATRIX _projection,
-    ID3D11DeviceContext* _deviceContext);
+    DX::RenderCommandList& _commandList);
+
+  static void CreateLines(const Options& _options, Lines& _lines);
+
+  // Level of detail to draw the grid at, placed by _world, seen from _view.
+  static size_t XM_CALLCONV SelectLevel(
+    const Options& _options,
+    DirectX::FXMMATRIX _world,
+    DirectX::CXMMATRIX _view);
 
 private:
+  void CreateVertexBuffer(ID3D11Device* _device);
+
   DirectX::CommonStates m_states;
   DirectX::BasicEffect m_effect;
-  DirectX::PrimitiveBatch<DirectX::VertexPositionColor> m_batch;
   Microsoft::WRL::ComPtr<ID3D11InputLayout> m_inputLayout;
+  Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer;
+  Options m_options;
+  Lines m_lines;
 };
 
 //------------------------------------------------------------------------------
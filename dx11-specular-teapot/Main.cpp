@@ -6,6 +6,8 @@
 #include "resource.h"
 #include "Game.h"
 
+#include <timeapi.h>
+
 using namespace DirectX;
 
 namespace
@@ -103,6 +105,10 @@ wWinMain(
     g_game->Initialize(hwnd, rc.right - rc.left, rc.bottom - rc.top);
   }
 
+  // Frame pacing sleeps in 1 ms slices, which the default 15.6 ms timer
+  // resolution would round up.
+  timeBeginPeriod(1);
+
   // Main message loop
   MSG msg = {0};
   while (WM_QUIT != msg.message)
@@ -118,6 +124,8 @@ wWinMain(
     }
   }
 
+  timeEndPeriod(1);
+
   g_game.reset();
 
   CoUninitialize();
@@ -0,0 +1,257 @@
+//
+// MappedData.cpp - Read-only memory-mapped files, the zero-copy ReadData
+//
+
+#include "pch.h"
+#include "MappedData.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+
+namespace
+{
+#if defined(_WIN32)
+//------------------------------------------------------------------------------
+// Null if the file can't be opened. An empty file has a size but no view.
+const uint8_t*
+MapFile(const wchar_t* filename, size_t& size, bool& opened)
+{
+  opened = false;
+  size   = 0;
+
+  HANDLE file = CreateFileW(
+    filename,
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return nullptr;
+  }
+  opened = true;
+
+  LARGE_INTEGER fileSize = {};
+  if (!GetFileSizeEx(file, &fileSize)
+      || static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+  {
+    CloseHandle(file);
+    throw std::runtime_error("MapData size");
+  }
+  size = static_cast<size_t>(fileSize.QuadPart);
+  if (size == 0)
+  {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  // The view keeps the mapping, and the mapping the file, open.
+  HANDLE mapping =
+    CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping)
+  {
+    throw std::runtime_error("MapData CreateFileMapping");
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view)
+  {
+    throw std::runtime_error("MapData MapViewOfFile");
+  }
+  return static_cast<const uint8_t*>(view);
+}
+
+//------------------------------------------------------------------------------
+void
+UnmapFile(const uint8_t* data, size_t)
+{
+  UnmapViewOfFile(data);
+}
+
+//------------------------------------------------------------------------------
+// Empty where there is no executable directory to fall back to.
+std::wstring
+ModuleRelativePath(const wchar_t* name)
+{
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+  wchar_t moduleName[_MAX_PATH];
+  (void)GetModuleFileNameW(nullptr, moduleName, _MAX_PATH);
+
+  wchar_t drive[_MAX_DRIVE];
+  wchar_t path[_MAX_PATH];
+  if (_wsplitpath_s(
+        moduleName, drive, _MAX_DRIVE, path, _MAX_PATH, nullptr, 0, nullptr, 0))
+  {
+    throw std::runtime_error("_wsplitpath_s");
+  }
+
+  wchar_t filename[_MAX_PATH];
+  if (_wmakepath_s(filename, _MAX_PATH, drive, path, name, nullptr))
+  {
+    throw std::runtime_error("_wmakepath_s");
+  }
+  return filename;
+#else
+  (void)name;
+  return std::wstring();
+#endif
+}
+
+#else
+//------------------------------------------------------------------------------
+std::string
+NarrowPath(const wchar_t* name)
+{
+  const size_t length = wcstombs(nullptr, name, 0);
+  if (length == static_cast<size_t>(-1))
+  {
+    throw std::invalid_argument("MapData name");
+  }
+
+  std::string narrow(length, '\0');
+  wcstombs(&narrow[0], name, length + 1);
+  return narrow;
+}
+
+//------------------------------------------------------------------------------
+const uint8_t*
+MapFile(const wchar_t* filename, size_t& size, bool& opened)
+{
+  opened = false;
+  size   = 0;
+
+  const int file = open(NarrowPath(filename).c_str(), O_RDONLY | O_CLOEXEC);
+  if (file < 0)
+  {
+    return nullptr;
+  }
+  opened = true;
+
+  struct stat status = {};
+  if (fstat(file, &status) != 0)
+  {
+    close(file);
+    throw std::runtime_error("MapData fstat");
+  }
+  size = static_cast<size_t>(status.st_size);
+  if (size == 0)
+  {
+    close(file);
+    return nullptr;
+  }
+
+  // The mapping holds its own reference to the file.
+  void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (view == MAP_FAILED)
+  {
+    throw std::runtime_error("MapData mmap");
+  }
+  return static_cast<const uint8_t*>(view);
+}
+
+//------------------------------------------------------------------------------
+void
+UnmapFile(const uint8_t* data, size_t size)
+{
+  munmap(const_cast<uint8_t*>(data), size);
+}
+
+//------------------------------------------------------------------------------
+std::wstring
+ModuleRelativePath(const wchar_t* name)
+{
+  char modulePath[PATH_MAX];
+  const ssize_t length =
+    readlink("/proc/self/exe", modulePath, sizeof(modulePath) - 1);
+  if (length <= 0)
+  {
+    return std::wstring();
+  }
+
+  std::string directory(modulePath, static_cast<size_t>(length));
+  directory.erase(directory.find_last_of('/') + 1);
+
+  std::wstring path(directory.begin(), directory.end());
+  return path + name;
+}
+#endif
+}    // namespace
+
+//------------------------------------------------------------------------------
+DX::MappedData::MappedData(MappedData&& moveFrom) noexcept
+    : m_data(moveFrom.m_data)
+    , m_size(moveFrom.m_size)
+{
+  moveFrom.m_data = nullptr;
+  moveFrom.m_size = 0;
+}
+
+//------------------------------------------------------------------------------
+DX::MappedData&
+DX::MappedData::operator=(MappedData&& moveFrom) noexcept
+{
+  if (this != &moveFrom)
+  {
+    Reset();
+    m_data          = moveFrom.m_data;
+    m_size          = moveFrom.m_size;
+    moveFrom.m_data = nullptr;
+    moveFrom.m_size = 0;
+  }
+  return *this;
+}
+
+//------------------------------------------------------------------------------
+DX::MappedData::~MappedData()
+{
+  Reset();
+}
+
+//------------------------------------------------------------------------------
+void
+DX::MappedData::Reset()
+{
+  if (m_data)
+  {
+    UnmapFile(m_data, m_size);
+  }
+  m_data = nullptr;
+  m_size = 0;
+}
+
+//------------------------------------------------------------------------------
+DX::MappedData
+DX::MapData(const wchar_t* name)
+{
+  MappedData mapped;
+  bool opened   = false;
+  mapped.m_data = MapFile(name, mapped.m_size, opened);
+  if (!opened)
+  {
+    const std::wstring fallback = ModuleRelativePath(name);
+    if (!fallback.empty())
+    {
+      mapped.m_data = MapFile(fallback.c_str(), mapped.m_size, opened);
+    }
+  }
+
+  if (!opened)
+  {
+    throw std::runtime_error("MapData");
+  }
+  return mapped;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,51 @@
+//
+// MappedData.h - Read-only memory-mapped files, the zero-copy ReadData
+//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace DX
+{
+// A whole file mapped read-only into memory, unmapped on destruction. Pages
+// are read in from the file cache on first touch rather than copied up front,
+// and are shared with any other process mapping the same file.
+//
+// The bytes are only valid while this is alive, so anything that keeps
+// pointers into them (e.g. shader bytecode for input layouts) must keep it too.
+class MappedData
+{
+public:
+  MappedData() = default;
+
+  MappedData(MappedData&& moveFrom) noexcept;
+  MappedData& operator=(MappedData&& moveFrom) noexcept;
+
+  MappedData(MappedData const&) = delete;
+  MappedData& operator=(MappedData const&) = delete;
+
+  ~MappedData();
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  const uint8_t* begin() const { return m_data; }
+  const uint8_t* end() const { return m_data + m_size; }
+
+private:
+  friend MappedData MapData(const wchar_t* name);
+
+  void Reset();
+
+  // Null for an empty file, which can't be mapped.
+  const uint8_t* m_data = nullptr;
+  size_t m_size         = 0;
+};
+
+// Maps a file as ReadData reads it: from the working directory, or else from
+// the directory of the running executable. Throws if it can be opened from
+// neither.
+MappedData MapData(_In_z_ const wchar_t* name);
+}
@@ -0,0 +1,647 @@
+#include "pch.h"
+#include "MeshBvh.h"
+
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+using namespace DX;
+using namespace MeshBvhImpl;
+
+namespace
+{
+// Ranges of up to this many triangles may become leaves, if the SAH agrees.
+constexpr uint32_t MAX_LEAF_TRIANGLES = 8;
+
+// Centroid bins per split.
+constexpr int SAH_BINS = 16;
+
+// Cost of visiting a node, relative to testing a triangle.
+constexpr float SAH_TRAVERSAL_COST = 1.0f;
+
+// Past this depth ranges are split at the median, which halves them, so the
+// tree stays within MAX_DEPTH for any triangle count a uint32_t can hold.
+constexpr int SAH_MAX_DEPTH = 32;
+
+// Rays are converted to structure-of-arrays form this many at a time.
+constexpr size_t RAY_BATCH = 64;
+
+//------------------------------------------------------------------------------
+float
+Component(const XMFLOAT3& v, int axis)
+{
+  return (&v.x)[axis];
+}
+
+//------------------------------------------------------------------------------
+int
+WidestAxis(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+  float x  = boundsMax.x - boundsMin.x;
+  float y  = boundsMax.y - boundsMin.y;
+  float z  = boundsMax.z - boundsMin.z;
+  int axis = x >= y ? 0 : 1;
+  return (axis == 0 ? x : y) >= z ? axis : 2;
+}
+
+//------------------------------------------------------------------------------
+float
+HalfSurfaceArea(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+  float x = std::max(0.0f, boundsMax.x - boundsMin.x);
+  float y = std::max(0.0f, boundsMax.y - boundsMin.y);
+  float z = std::max(0.0f, boundsMax.z - boundsMin.z);
+  return x * y + y * z + z * x;
+}
+
+//------------------------------------------------------------------------------
+void
+Grow(
+  XMFLOAT3& boundsMin,
+  XMFLOAT3& boundsMax,
+  const XMFLOAT3& pointMin,
+  const XMFLOAT3& pointMax)
+{
+  XMStoreFloat3(
+    &boundsMin,
+    XMVectorMin(XMLoadFloat3(&boundsMin), XMLoadFloat3(&pointMin)));
+  XMStoreFloat3(
+    &boundsMax,
+    XMVectorMax(XMLoadFloat3(&boundsMax), XMLoadFloat3(&pointMax)));
+}
+
+//------------------------------------------------------------------------------
+void
+Store(float out[3], const XMFLOAT3& v)
+{
+  out[0] = v.x;
+  out[1] = v.y;
+  out[2] = v.z;
+}
+
+//------------------------------------------------------------------------------
+inline float
+Dot(const float a[3], const float b[3])
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+//------------------------------------------------------------------------------
+inline void
+Cross(const float a[3], const float b[3], float out[3])
+{
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Reference implementation; the packet paths follow the same steps.
+//------------------------------------------------------------------------------
+void
+MeshBvhImpl::IntersectScalar(
+  const Tree& tree,
+  const Rays& rays,
+  size_t count,
+  float maxDistance,
+  const Hits& hits)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    const float origin[3]    = {rays.origin[0][i],
+                             rays.origin[1][i],
+                             rays.origin[2][i]};
+    const float direction[3] = {rays.direction[0][i],
+                                rays.direction[1][i],
+                                rays.direction[2][i]};
+    const float invDirection[3] = {
+      1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2]};
+
+    float closest     = maxDistance;
+    uint32_t triangle = NO_TRIANGLE;
+    float hitU        = 0.0f;
+    float hitV        = 0.0f;
+
+    uint32_t stack[MAX_DEPTH];
+    size_t depth   = 0;
+    uint32_t index = 0;
+    for (;;)
+    {
+      const Node& node = tree.nodes[index];
+
+      float tMin = 0.0f;
+      float tMax = closest;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        float t0 = (node.boundsMin[axis] - origin[axis]) * invDirection[axis];
+        float t1 = (node.boundsMax[axis] - origin[axis]) * invDirection[axis];
+        // Operand order as MINPS/MAXPS, so that a NaN from a ray lying in a
+        // slab's plane leaves tMin and tMax as they were on every path.
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+      }
+
+      if (tMin <= tMax)
+      {
+        if (node.count == 0)
+        {
+          // Visit the nearer child first, and the other later.
+          uint32_t nearer = node.first + (direction[node.axis] < 0.0f ? 1 : 0);
+          stack[depth++]  = node.first + node.first + 1 - nearer;
+          index           = nearer;
+          continue;
+        }
+
+        for (uint32_t t = node.first; t < node.first + node.count; ++t)
+        {
+          const Triangle& tri = tree.triangles[t];
+
+          float p[3];
+          Cross(direction, tri.edge2, p);
+          float det    = Dot(tri.edge1, p);
+          float invDet = 1.0f / det;
+
+          float s[3] = {origin[0] - tri.v0[0],
+                        origin[1] - tri.v0[1],
+                        origin[2] - tri.v0[2]};
+          float u    = Dot(s, p) * invDet;
+
+          float q[3];
+          Cross(s, tri.edge1, q);
+          float v        = Dot(direction, q) * invDet;
+          float distance = Dot(tri.edge2, q) * invDet;
+
+          if (
+            det != 0.0f && u >= 0.0f && v >= 0.0f && u + v <= 1.0f
+            && distance >= 0.0f && distance < closest)
+          {
+            closest  = distance;
+            triangle = tri.index;
+            hitU     = u;
+            hitV     = v;
+          }
+        }
+      }
+
+      if (depth == 0)
+      {
+        break;
+      }
+      index = stack[--depth];
+    }
+
+    hits.triangle[i] = triangle;
+    hits.distance[i] = closest;
+    hits.u[i]        = hitU;
+    hits.v[i]        = hitV;
+  }
+}
+
+//------------------------------------------------------------------------------
+MeshBvh::MeshBvh(Isa isa)
+    : m_isa(isa)
+{
+}
+
+//------------------------------------------------------------------------------
+void
+MeshBvh::Build(
+  const std::vector<VertexPositionNormalTexture>& vertices,
+  const std::vector<uint16_t>& indices)
+{
+  BuildTree(vertices, indices);
+}
+
+//------------------------------------------------------------------------------
+void
+MeshBvh::Build(
+  const std::vector<VertexPositionNormalTexture>& vertices,
+  const std::vector<uint32_t>& indices)
+{
+  BuildTree(vertices, indices);
+}
+
+//------------------------------------------------------------------------------
+template<typename index_t>
+void
+MeshBvh::BuildTree(
+  const std::vector<VertexPositionNormalTexture>& vertices,
+  const std::vector<index_t>& indices)
+{
+  Clear();
+  if (indices.size() % 3 != 0)
+  {
+    throw std::invalid_argument("MeshBvh: expected triangular faces");
+  }
+  if (indices.size() / 3 >= NO_TRIANGLE)
+  {
+    throw std::invalid_argument("MeshBvh: too many triangles");
+  }
+  for (index_t index : indices)
+  {
+    if (index >= vertices.size())
+    {
+      throw std::invalid_argument("MeshBvh: index not in vertices list");
+    }
+  }
+
+  const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (triangleCount == 0)
+  {
+    return;
+  }
+
+  m_triangleMin.resize(triangleCount);
+  m_triangleMax.resize(triangleCount);
+  m_centroids.resize(triangleCount);
+  m_textureCoordinates.resize(indices.size());
+  for (uint32_t t = 0; t < triangleCount; ++t)
+  {
+    XMVECTOR p0 = XMLoadFloat3(&vertices[indices[3 * t]].position);
+    XMVECTOR p1 = XMLoadFloat3(&vertices[indices[3 * t + 1]].position);
+    XMVECTOR p2 = XMLoadFloat3(&vertices[indices[3 * t + 2]].position);
+    XMStoreFloat3(&m_triangleMin[t], XMVectorMin(XMVectorMin(p0, p1), p2));
+    XMStoreFloat3(&m_triangleMax[t], XMVectorMax(XMVectorMax(p0, p1), p2));
+    XMStoreFloat3(
+      &m_centroids[t],
+      XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), 1.0f / 3.0f));
+
+    for (int corner = 0; corner < 3; ++corner)
+    {
+      m_textureCoordinates[3 * t + corner] =
+        vertices[indices[3 * t + corner]].textureCoordinate;
+    }
+  }
+
+  m_order.resize(triangleCount);
+  std::iota(m_order.begin(), m_order.end(), 0u);
+
+  Range all = {0, triangleCount, {}, {}, {}, {}};
+  ComputeRangeBounds(all);
+
+  m_nodes.reserve(2 * static_cast<size_t>(triangleCount));
+  m_nodes.emplace_back();
+  BuildNode(0, all, 0);
+
+  // Triangles in leaf order, ready for Moller-Trumbore.
+  m_triangles.resize(triangleCount);
+  for (uint32_t i = 0; i < triangleCount; ++i)
+  {
+    const uint32_t t = m_order[i];
+    XMVECTOR p0      = XMLoadFloat3(&vertices[indices[3 * t]].position);
+    XMVECTOR p1      = XMLoadFloat3(&vertices[indices[3 * t + 1]].position);
+    XMVECTOR p2      = XMLoadFloat3(&vertices[indices[3 * t + 2]].position);
+
+    XMFLOAT3 v0, edge1, edge2;
+    XMStoreFloat3(&v0, p0);
+    XMStoreFloat3(&edge1, XMVectorSubtract(p1, p0));
+    XMStoreFloat3(&edge2, XMVectorSubtract(p2, p0));
+
+    Triangle& triangle = m_triangles[i];
+    Store(triangle.v0, v0);
+    Store(triangle.edge1, edge1);
+    Store(triangle.edge2, edge2);
+    triangle.index = t;
+  }
+
+  m_order.clear();
+  m_triangleMin.clear();
+  m_triangleMax.clear();
+  m_centroids.clear();
+}
+
+//------------------------------------------------------------------------------
+void
+MeshBvh::Clear()
+{
+  m_nodes.clear();
+  m_triangles.clear();
+  m_textureCoordinates.clear();
+  m_order.clear();
+  m_triangleMin.clear();
+  m_triangleMax.clear();
+  m_centroids.clear();
+}
+
+//------------------------------------------------------------------------------
+// Fills in node index for the range, appending its children, if it is split,
+// as a pair of new nodes.
+//------------------------------------------------------------------------------
+void
+MeshBvh::BuildNode(uint32_t index, const Range& range, int depth)
+{
+  Range left, right;
+  const bool split = SplitRange(range, depth, left, right);
+
+  Node& node = m_nodes[index];
+  Store(node.boundsMin, range.boundsMin);
+  Store(node.boundsMax, range.boundsMax);
+  node.axis = 0;
+
+  if (!split)
+  {
+    node.first = range.first;
+    node.count = static_cast<uint16_t>(range.count);
+    return;
+  }
+
+  const int axis = WidestAxis(range.centroidMin, range.centroidMax);
+
+  const auto children = static_cast<uint32_t>(m_nodes.size());
+  node.first          = children;
+  node.count          = 0;
+  node.axis           = static_cast<uint16_t>(axis);
+
+  // Invalidates node.
+  m_nodes.emplace_back();
+  m_nodes.emplace_back();
+
+  BuildNode(children, left, depth + 1);
+  BuildNode(children + 1, right, depth + 1);
+}
+
+//------------------------------------------------------------------------------
+// Picks where to split the range in two, by binned SAH along the widest axis
+// of the centroids, and partitions m_order there. Returns false when the range
+// is better left as a leaf.
+//------------------------------------------------------------------------------
+bool
+MeshBvh::SplitRange(const Range& range, int depth, Range& left, Range& right)
+{
+  if (range.count < 2)
+  {
+    return false;
+  }
+
+  const int axis         = WidestAxis(range.centroidMin, range.centroidMax);
+  const float axisMin    = Component(range.centroidMin, axis);
+  const float axisExtent = Component(range.centroidMax, axis) - axisMin;
+
+  auto begin = m_order.begin() + range.first;
+  auto end   = begin + range.count;
+
+  auto finish = [&](uint32_t middle) {
+    left.first  = range.first;
+    left.count  = middle - range.first;
+    right.first = middle;
+    right.count = range.first + range.count - middle;
+    ComputeRangeBounds(left);
+    ComputeRangeBounds(right);
+    return true;
+  };
+
+  // Splits at the median centroid, for when binning can't separate them.
+  auto splitMedian = [&]() {
+    uint32_t middle = range.first + range.count / 2;
+    std::nth_element(
+      begin, m_order.begin() + middle, end, [&](uint32_t a, uint32_t b) {
+        return Component(m_centroids[a], axis)
+               < Component(m_centroids[b], axis);
+      });
+    return finish(middle);
+  };
+
+  if (axisExtent <= 0.0f)
+  {
+    return range.count > MAX_LEAF_TRIANGLES ? splitMedian() : false;
+  }
+  if (depth >= SAH_MAX_DEPTH)
+  {
+    return splitMedian();
+  }
+
+  // Bin the triangles by centroid.
+  const float binScale = SAH_BINS * (1.0f - 1.0e-5f) / axisExtent;
+  auto binOf           = [&](uint32_t triangle) {
+    float offset = Component(m_centroids[triangle], axis) - axisMin;
+    return std::min(static_cast<int>(offset * binScale), SAH_BINS - 1);
+  };
+
+  uint32_t binCounts[SAH_BINS] = {};
+  XMFLOAT3 binMin[SAH_BINS];
+  XMFLOAT3 binMax[SAH_BINS];
+  for (int bin = 0; bin < SAH_BINS; ++bin)
+  {
+    binMin[bin] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+    binMax[bin] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  }
+  for (auto it = begin; it != end; ++it)
+  {
+    int bin = binOf(*it);
+    ++binCounts[bin];
+    Grow(binMin[bin], binMax[bin], m_triangleMin[*it], m_triangleMax[*it]);
+  }
+
+  // Sweep from the right, keeping the area of bins [i, SAH_BINS), then
+  // evaluate each plane sweeping from the left.
+  float rightAreas[SAH_BINS];
+  uint32_t rightCounts[SAH_BINS];
+  {
+    XMFLOAT3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    XMFLOAT3 sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    uint32_t sweepCount = 0;
+    for (int bin = SAH_BINS - 1; bin > 0; --bin)
+    {
+      Grow(sweepMin, sweepMax, binMin[bin], binMax[bin]);
+      sweepCount += binCounts[bin];
+      rightAreas[bin]  = HalfSurfaceArea(sweepMin, sweepMax);
+      rightCounts[bin] = sweepCount;
+    }
+  }
+
+  int bestPlane  = -1;
+  float bestCost = FLT_MAX;
+  {
+    XMFLOAT3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    XMFLOAT3 sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    uint32_t sweepCount = 0;
+    for (int plane = 1; plane < SAH_BINS; ++plane)
+    {
+      Grow(sweepMin, sweepMax, binMin[plane - 1], binMax[plane - 1]);
+      sweepCount += binCounts[plane - 1];
+      if (sweepCount == 0 || rightCounts[plane] == 0)
+      {
+        continue;
+      }
+
+      float cost = HalfSurfaceArea(sweepMin, sweepMax) * sweepCount
+                   + rightAreas[plane] * rightCounts[plane];
+      if (cost < bestCost)
+      {
+        bestCost  = cost;
+        bestPlane = plane;
+      }
+    }
+  }
+
+  if (bestPlane < 0)
+  {
+    return range.count > MAX_LEAF_TRIANGLES ? splitMedian() : false;
+  }
+
+  const float area = HalfSurfaceArea(range.boundsMin, range.boundsMax);
+  const float splitCost =
+    SAH_TRAVERSAL_COST + (area > 0.0f ? bestCost / area : 0.0f);
+  if (range.count <= MAX_LEAF_TRIANGLES && splitCost >= range.count)
+  {
+    return false;
+  }
+
+  auto middle = std::partition(
+    begin, end, [&](uint32_t triangle) { return binOf(triangle) < bestPlane; });
+  return finish(static_cast<uint32_t>(middle - m_order.begin()));
+}
+
+//------------------------------------------------------------------------------
+void
+MeshBvh::ComputeRangeBounds(Range& range) const
+{
+  XMVECTOR boundsMin   = g_XMFltMax;
+  XMVECTOR boundsMax   = XMVectorNegate(g_XMFltMax);
+  XMVECTOR centroidMin = g_XMFltMax;
+  XMVECTOR centroidMax = XMVectorNegate(g_XMFltMax);
+  for (uint32_t i = range.first; i < range.first + range.count; ++i)
+  {
+    const uint32_t t  = m_order[i];
+    boundsMin         = XMVectorMin(boundsMin, XMLoadFloat3(&m_triangleMin[t]));
+    boundsMax         = XMVectorMax(boundsMax, XMLoadFloat3(&m_triangleMax[t]));
+    XMVECTOR centroid = XMLoadFloat3(&m_centroids[t]);
+    centroidMin       = XMVectorMin(centroidMin, centroid);
+    centroidMax       = XMVectorMax(centroidMax, centroid);
+  }
+  XMStoreFloat3(&range.boundsMin, boundsMin);
+  XMStoreFloat3(&range.boundsMax, boundsMax);
+  XMStoreFloat3(&range.centroidMin, centroidMin);
+  XMStoreFloat3(&range.centroidMax, centroidMax);
+}
+
+//------------------------------------------------------------------------------
+size_t
+MeshBvh::GetPacketSize() const
+{
+  switch (m_isa)
+  {
+    case Isa::SSE4: return 4;
+    case Isa::AVX2: return 8;
+    default: return 1;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool
+MeshBvh::Intersect(
+  const SimpleMath::Ray& ray, float maxDistance, Hit& hit) const
+{
+  const Tree tree = {m_nodes.data(), m_triangles.data()};
+  const Rays in   = {{&ray.position.x, &ray.position.y, &ray.position.z},
+                   {&ray.direction.x, &ray.direction.y, &ray.direction.z}};
+
+  hit.triangle = NO_TRIANGLE;
+  if (m_nodes.empty())
+  {
+    return false;
+  }
+
+  float u, v;
+  const Hits out = {&hit.triangle, &hit.distance, &u, &v};
+  IntersectScalar(tree, in, 1, maxDistance, out);
+  if (hit.triangle == NO_TRIANGLE)
+  {
+    return false;
+  }
+
+  const XMFLOAT2* uv      = &m_textureCoordinates[3 * hit.triangle];
+  hit.barycentrics        = XMFLOAT2(u, v);
+  hit.textureCoordinate.x =
+    uv[0].x + u * (uv[1].x - uv[0].x) + v * (uv[2].x - uv[0].x);
+  hit.textureCoordinate.y =
+    uv[0].y + u * (uv[1].y - uv[0].y) + v * (uv[2].y - uv[0].y);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void
+MeshBvh::Intersect(
+  const SimpleMath::Ray* rays,
+  size_t count,
+  float maxDistance,
+  Hit* hits) const
+{
+  float origin[3][RAY_BATCH];
+  float direction[3][RAY_BATCH];
+  uint32_t triangle[RAY_BATCH];
+  float distance[RAY_BATCH];
+  float u[RAY_BATCH];
+  float v[RAY_BATCH];
+
+  const Rays in  = {{origin[0], origin[1], origin[2]},
+                   {direction[0], direction[1], direction[2]}};
+  const Hits out = {triangle, distance, u, v};
+
+  for (size_t first = 0; first < count; first += RAY_BATCH)
+  {
+    const size_t n = std::min(RAY_BATCH, count - first);
+    for (size_t i = 0; i < n; ++i)
+    {
+      const SimpleMath::Ray& ray = rays[first + i];
+      origin[0][i]               = ray.position.x;
+      origin[1][i]               = ray.position.y;
+      origin[2][i]               = ray.position.z;
+      direction[0][i]            = ray.direction.x;
+      direction[1][i]            = ray.direction.y;
+      direction[2][i]            = ray.direction.z;
+    }
+
+    Trace(in, n, maxDistance, out);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      Hit& hit     = hits[first + i];
+      hit.triangle = triangle[i];
+      if (hit.triangle == NO_TRIANGLE)
+      {
+        continue;
+      }
+
+      const XMFLOAT2* uv      = &m_textureCoordinates[3 * hit.triangle];
+      hit.distance            = distance[i];
+      hit.barycentrics        = XMFLOAT2(u[i], v[i]);
+      hit.textureCoordinate.x = uv[0].x + u[i] * (uv[1].x - uv[0].x)
+                                + v[i] * (uv[2].x - uv[0].x);
+      hit.textureCoordinate.y = uv[0].y + u[i] * (uv[1].y - uv[0].y)
+                                + v[i] * (uv[2].y - uv[0].y);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+MeshBvh::Trace(
+  const Rays& rays, size_t count, float maxDistance, const Hits& hits) const
+{
+  if (m_nodes.empty())
+  {
+    std::fill(hits.triangle, hits.triangle + count, NO_TRIANGLE);
+    return;
+  }
+
+  const Tree tree = {m_nodes.data(), m_triangles.data()};
+  switch (m_isa)
+  {
+    case Isa::AVX2:
+      IntersectAVX2(tree, rays, count, maxDistance, hits);
+      break;
+
+    case Isa::SSE4:
+      IntersectSSE4(tree, rays, count, maxDistance, hits);
+      break;
+
+    default:
+      IntersectScalar(tree, rays, count, maxDistance, hits);
+      break;
+  }
+}
+
+//------------------------------------------------------------------------------
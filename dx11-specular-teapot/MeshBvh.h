@@ -0,0 +1,121 @@
+//
+// MeshBvh.h - Bounding volume hierarchy over a mesh's triangles for picking
+//
+
+#pragma once
+
+#include "MeshBvhImpl.h"
+#include "ShadingKernel.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+// A binary bounding volume hierarchy over the triangles of one indexed mesh,
+// for finding the triangle a ray hits first, such as the one under the mouse.
+//
+// Build uses the surface area heuristic over binned triangle centroids. Rays
+// are tested against triangles with the Moller-Trumbore algorithm, from both
+// sides, and traced either one at a time or in packets of 4 (SSE4) or 8
+// (AVX2) that traverse the tree together, as ShadingKernel picks its width.
+// Packets pay off for coherent rays, like those through neighbouring pixels.
+//
+// Rays are in the mesh's own space: transform them by the inverse of its
+// world matrix. Queries are const and may run concurrently.
+class MeshBvh
+{
+public:
+  using Isa = ShadingKernel::Isa;
+
+  static constexpr uint32_t NO_TRIANGLE = MeshBvhImpl::NO_TRIANGLE;
+
+  struct Hit
+  {
+    // Index of the triangle in the mesh, i.e. its first index over 3, or
+    // NO_TRIANGLE if the ray missed. The other members are only set on a hit.
+    uint32_t triangle;
+
+    // Along the ray, in multiples of its direction's length.
+    float distance;
+
+    // Weights of the triangle's second and third corners; the first's is
+    // 1 - x - y.
+    DirectX::XMFLOAT2 barycentrics;
+
+    // Interpolated from the corners' texture coordinates.
+    DirectX::XMFLOAT2 textureCoordinate;
+  };
+
+  explicit MeshBvh(Isa isa = ShadingKernel::DetectIsa());
+
+  MeshBvh(MeshBvh const&) = delete;
+  MeshBvh& operator=(MeshBvh const&) = delete;
+
+  void Build(
+    const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+    const std::vector<uint16_t>& indices);
+  void Build(
+    const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+    const std::vector<uint32_t>& indices);
+  void Clear();
+
+  size_t GetTriangleCount() const { return m_triangles.size(); }
+  size_t GetNodeCount() const { return m_nodes.size(); }
+  Isa GetIsa() const { return m_isa; }
+  size_t GetPacketSize() const;
+
+  // The nearest triangle the ray hits within maxDistance. Returns whether
+  // there was one.
+  bool Intersect(
+    const DirectX::SimpleMath::Ray& ray, float maxDistance, Hit& hit) const;
+
+  // The same for each of count rays, traced in packets of GetPacketSize().
+  void Intersect(
+    const DirectX::SimpleMath::Ray* rays,
+    size_t count,
+    float maxDistance,
+    Hit* hits) const;
+
+private:
+  // Triangles m_order[first, first + count) and the bounds of their corners
+  // and of their centroids, while building a node.
+  struct Range
+  {
+    uint32_t first;
+    uint32_t count;
+    DirectX::XMFLOAT3 boundsMin;
+    DirectX::XMFLOAT3 boundsMax;
+    DirectX::XMFLOAT3 centroidMin;
+    DirectX::XMFLOAT3 centroidMax;
+  };
+
+  template<typename index_t>
+  void BuildTree(
+    const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+    const std::vector<index_t>& indices);
+  void BuildNode(uint32_t index, const Range& range, int depth);
+  bool SplitRange(const Range& range, int depth, Range& left, Range& right);
+  void ComputeRangeBounds(Range& range) const;
+  void Trace(
+    const MeshBvhImpl::Rays& rays,
+    size_t count,
+    float maxDistance,
+    const MeshBvhImpl::Hits& hits) const;
+
+  std::vector<MeshBvhImpl::Node> m_nodes;
+  std::vector<MeshBvhImpl::Triangle> m_triangles;
+
+  // Texture coordinates of each triangle's corners, in mesh order.
+  std::vector<DirectX::XMFLOAT2> m_textureCoordinates;
+
+  // Mesh triangle indices grouped by leaf, and each triangle's bounds and
+  // centroid, used during Build only.
+  std::vector<uint32_t> m_order;
+  std::vector<DirectX::XMFLOAT3> m_triangleMin;
+  std::vector<DirectX::XMFLOAT3> m_triangleMax;
+  std::vector<DirectX::XMFLOAT3> m_centroids;
+
+  Isa m_isa;
+};
+}
@@ -0,0 +1,244 @@
+//
+// MeshBvhAVX2.cpp - 8-ray AVX2/FMA packet traversal of MeshBvh
+//
+// Built without the precompiled header; see ShadingKernelImpl.h.
+//
+
+#include "MeshBvhImpl.h"
+
+#include <immintrin.h>
+
+using namespace MeshBvhImpl;
+
+namespace
+{
+constexpr size_t WIDTH = 8;
+
+//------------------------------------------------------------------------------
+struct Packet
+{
+  __m256 origin[3];
+  __m256 direction[3];
+  __m256 invDirection[3];
+
+  // 1 along each axis where most of the rays point towards -axis, so that
+  // the traversal visits the second child of a node split there first.
+  uint32_t nearer[3];
+};
+
+//------------------------------------------------------------------------------
+struct PacketHits
+{
+  __m256i triangle;
+  __m256 distance;
+  __m256 u;
+  __m256 v;
+};
+
+//------------------------------------------------------------------------------
+inline __m256
+Dot3(const __m256 a[3], const __m256 b[3])
+{
+  __m256 r = _mm256_mul_ps(a[0], b[0]);
+  r        = _mm256_fmadd_ps(a[1], b[1], r);
+  return _mm256_fmadd_ps(a[2], b[2], r);
+}
+
+//------------------------------------------------------------------------------
+inline void
+Cross(const __m256 a[3], const __m256 b[3], __m256 out[3])
+{
+  out[0] = _mm256_fmsub_ps(a[1], b[2], _mm256_mul_ps(a[2], b[1]));
+  out[1] = _mm256_fmsub_ps(a[2], b[0], _mm256_mul_ps(a[0], b[2]));
+  out[2] = _mm256_fmsub_ps(a[0], b[1], _mm256_mul_ps(a[1], b[0]));
+}
+
+//------------------------------------------------------------------------------
+inline __m256
+Select(__m256 a, __m256 b, __m256 mask)
+{
+  return _mm256_blendv_ps(a, b, mask);
+}
+
+//------------------------------------------------------------------------------
+// Mirrors IntersectScalar's test of one leaf triangle, for every ray, with
+// fused multiply-adds.
+inline void
+IntersectTriangle(const Triangle& tri, const Packet& p, PacketHits& hits)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one  = _mm256_set1_ps(1.0f);
+
+  __m256 edge1[3], edge2[3], s[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    edge1[axis] = _mm256_set1_ps(tri.edge1[axis]);
+    edge2[axis] = _mm256_set1_ps(tri.edge2[axis]);
+    s[axis]     = _mm256_sub_ps(p.origin[axis], _mm256_set1_ps(tri.v0[axis]));
+  }
+
+  __m256 pv[3];
+  Cross(p.direction, edge2, pv);
+  __m256 det    = Dot3(edge1, pv);
+  __m256 invDet = _mm256_div_ps(one, det);
+  __m256 u      = _mm256_mul_ps(Dot3(s, pv), invDet);
+
+  __m256 q[3];
+  Cross(s, edge1, q);
+  __m256 v        = _mm256_mul_ps(Dot3(p.direction, q), invDet);
+  __m256 distance = _mm256_mul_ps(Dot3(edge2, q), invDet);
+
+  // NEQ_UQ, like != in IntersectScalar; the rest are ordered.
+  __m256 hit = _mm256_and_ps(
+    _mm256_cmp_ps(det, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(
+    hit, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(
+    hit, _mm256_cmp_ps(distance, hits.distance, _CMP_LT_OQ));
+  if (_mm256_movemask_ps(hit) == 0)
+  {
+    return;
+  }
+
+  __m256 index =
+    _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(tri.index)));
+  hits.triangle = _mm256_castps_si256(
+    Select(_mm256_castsi256_ps(hits.triangle), index, hit));
+  hits.distance = Select(hits.distance, distance, hit);
+  hits.u        = Select(hits.u, u, hit);
+  hits.v        = Select(hits.v, v, hit);
+}
+
+//------------------------------------------------------------------------------
+// Walks the tree once for the whole packet, descending into every node any of
+// its rays still hits closer than what it found so far.
+inline void
+TracePacket(const Tree& tree, const Packet& p, PacketHits& hits)
+{
+  uint32_t stack[MAX_DEPTH];
+  size_t depth   = 0;
+  uint32_t index = 0;
+  for (;;)
+  {
+    const Node& node = tree.nodes[index];
+
+    __m256 tMin = _mm256_setzero_ps();
+    __m256 tMax = hits.distance;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      // Not bounds * inv - origin * inv as an FMA: for a ray parallel to the
+      // axis that is inf - inf, where this gives the infinity that culls it.
+      __m256 t0 = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_set1_ps(node.boundsMin[axis]), p.origin[axis]),
+        p.invDirection[axis]);
+      __m256 t1 = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_set1_ps(node.boundsMax[axis]), p.origin[axis]),
+        p.invDirection[axis]);
+      tMin = _mm256_max_ps(_mm256_min_ps(t1, t0), tMin);
+      tMax = _mm256_min_ps(_mm256_max_ps(t1, t0), tMax);
+    }
+
+    if (_mm256_movemask_ps(_mm256_cmp_ps(tMin, tMax, _CMP_LE_OQ)) != 0)
+    {
+      if (node.count == 0)
+      {
+        uint32_t nearer = node.first + p.nearer[node.axis];
+        stack[depth++]  = node.first + node.first + 1 - nearer;
+        index           = nearer;
+        continue;
+      }
+
+      for (uint32_t t = node.first; t < node.first + node.count; ++t)
+      {
+        IntersectTriangle(tree.triangles[t], p, hits);
+      }
+    }
+
+    if (depth == 0)
+    {
+      break;
+    }
+    index = stack[--depth];
+  }
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+MeshBvhImpl::IntersectAVX2(
+  const Tree& tree,
+  const Rays& rays,
+  size_t count,
+  float maxDistance,
+  const Hits& hits)
+{
+  for (size_t i = 0; i < count; i += WIDTH)
+  {
+    const size_t n = count - i < WIDTH ? count - i : WIDTH;
+
+    Packet p;
+    if (n == WIDTH)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        p.origin[axis]    = _mm256_loadu_ps(rays.origin[axis] + i);
+        p.direction[axis] = _mm256_loadu_ps(rays.direction[axis] + i);
+      }
+    }
+    else
+    {
+      // Pad the last packet by repeating its final ray.
+      alignas(32) float origin[3][WIDTH];
+      alignas(32) float direction[3][WIDTH];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        for (size_t k = 0; k < WIDTH; ++k)
+        {
+          size_t src         = i + (k < n ? k : n - 1);
+          origin[axis][k]    = rays.origin[axis][src];
+          direction[axis][k] = rays.direction[axis][src];
+        }
+        p.origin[axis]    = _mm256_load_ps(origin[axis]);
+        p.direction[axis] = _mm256_load_ps(direction[axis]);
+      }
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      p.invDirection[axis] =
+        _mm256_div_ps(_mm256_set1_ps(1.0f), p.direction[axis]);
+
+      int negatives = _mm_popcnt_u32(static_cast<unsigned>(_mm256_movemask_ps(
+        _mm256_cmp_ps(p.direction[axis], _mm256_setzero_ps(), _CMP_LT_OQ))));
+      p.nearer[axis] = negatives > static_cast<int>(WIDTH / 2) ? 1 : 0;
+    }
+
+    PacketHits packetHits;
+    packetHits.triangle = _mm256_set1_epi32(static_cast<int>(NO_TRIANGLE));
+    packetHits.distance = _mm256_set1_ps(maxDistance);
+    packetHits.u        = _mm256_setzero_ps();
+    packetHits.v        = _mm256_setzero_ps();
+    TracePacket(tree, p, packetHits);
+
+    alignas(32) uint32_t triangle[WIDTH];
+    alignas(32) float distance[WIDTH];
+    alignas(32) float u[WIDTH];
+    alignas(32) float v[WIDTH];
+    _mm256_store_si256(
+      reinterpret_cast<__m256i*>(triangle), packetHits.triangle);
+    _mm256_store_ps(distance, packetHits.distance);
+    _mm256_store_ps(u, packetHits.u);
+    _mm256_store_ps(v, packetHits.v);
+    for (size_t k = 0; k < n; ++k)
+    {
+      hits.triangle[i + k] = triangle[k];
+      hits.distance[i + k] = distance[k];
+      hits.u[i + k]        = u[k];
+      hits.v[i + k]        = v[k];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
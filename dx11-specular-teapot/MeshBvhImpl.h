@@ -0,0 +1,93 @@
+//
+// MeshBvhImpl.h - Instruction set specific halves of MeshBvh
+//
+// Included by the SSE4 and AVX2 translation units, which are compiled without
+// the precompiled header for the reasons given in ShadingKernelImpl.h. Keep
+// this header free of DirectXMath and Windows types.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MeshBvhImpl
+{
+constexpr uint32_t NO_TRIANGLE = UINT32_MAX;
+
+// Deepest tree the traversal stacks can hold.
+constexpr size_t MAX_DEPTH = 64;
+
+// Binary tree node. The children of an inner node are nodes first and
+// first + 1; a leaf holds triangles [first, first + count). axis is the one
+// an inner node was split along, which the traversal uses to visit the child
+// nearer the rays first.
+struct Node
+{
+  float boundsMin[3];
+  uint32_t first;
+  float boundsMax[3];
+  uint16_t count;
+  uint16_t axis;
+};
+
+static_assert(sizeof(Node) == 32, "MeshBvhImpl::Node size");
+
+// A triangle in leaf order, as Moller-Trumbore takes it: the first corner and
+// the edges from it to the other two. index is its place in the mesh.
+struct Triangle
+{
+  float v0[3];
+  float edge1[3];
+  float edge2[3];
+  uint32_t index;
+};
+
+struct Tree
+{
+  const Node* nodes;
+  const Triangle* triangles;
+};
+
+// Structure-of-arrays rays; every pointer addresses count floats.
+struct Rays
+{
+  const float* origin[3];
+  const float* direction[3];
+};
+
+// Nearest hit of each ray: its triangle index, or NO_TRIANGLE, the distance
+// in multiples of the ray's direction, and the barycentric weights u and v of
+// the triangle's second and third corners.
+struct Hits
+{
+  uint32_t* triangle;
+  float* distance;
+  float* u;
+  float* v;
+};
+
+void
+IntersectScalar(
+  const Tree& tree,
+  const Rays& rays,
+  size_t count,
+  float maxDistance,
+  const Hits& hits);
+
+void
+IntersectSSE4(
+  const Tree& tree,
+  const Rays& rays,
+  size_t count,
+  float maxDistance,
+  const Hits& hits);
+
+void
+IntersectAVX2(
+  const Tree& tree,
+  const Rays& rays,
+  size_t count,
+  float maxDistance,
+  const Hits& hits);
+}
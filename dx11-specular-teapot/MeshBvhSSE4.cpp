@@ -0,0 +1,239 @@
+//
+// MeshBvhSSE4.cpp - 4-ray SSE4.1 packet traversal of MeshBvh
+//
+// Built without the precompiled header; see ShadingKernelImpl.h.
+//
+
+#include "MeshBvhImpl.h"
+
+#include <smmintrin.h>
+
+using namespace MeshBvhImpl;
+
+namespace
+{
+constexpr size_t WIDTH = 4;
+
+//------------------------------------------------------------------------------
+struct Packet
+{
+  __m128 origin[3];
+  __m128 direction[3];
+  __m128 invDirection[3];
+
+  // 1 along each axis where most of the rays point towards -axis, so that
+  // the traversal visits the second child of a node split there first.
+  uint32_t nearer[3];
+};
+
+//------------------------------------------------------------------------------
+struct PacketHits
+{
+  __m128i triangle;
+  __m128 distance;
+  __m128 u;
+  __m128 v;
+};
+
+//------------------------------------------------------------------------------
+inline __m128
+Dot3(const __m128 a[3], const __m128 b[3])
+{
+  __m128 r = _mm_mul_ps(a[0], b[0]);
+  r        = _mm_add_ps(r, _mm_mul_ps(a[1], b[1]));
+  return _mm_add_ps(r, _mm_mul_ps(a[2], b[2]));
+}
+
+//------------------------------------------------------------------------------
+inline void
+Cross(const __m128 a[3], const __m128 b[3], __m128 out[3])
+{
+  out[0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+  out[1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+  out[2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+}
+
+//------------------------------------------------------------------------------
+inline __m128
+Select(__m128 a, __m128 b, __m128 mask)
+{
+  return _mm_blendv_ps(a, b, mask);
+}
+
+//------------------------------------------------------------------------------
+// Mirrors IntersectScalar's test of one leaf triangle, for every ray.
+inline void
+IntersectTriangle(const Triangle& tri, const Packet& p, PacketHits& hits)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one  = _mm_set1_ps(1.0f);
+
+  __m128 edge1[3], edge2[3], s[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    edge1[axis] = _mm_set1_ps(tri.edge1[axis]);
+    edge2[axis] = _mm_set1_ps(tri.edge2[axis]);
+    s[axis]     = _mm_sub_ps(p.origin[axis], _mm_set1_ps(tri.v0[axis]));
+  }
+
+  __m128 pv[3];
+  Cross(p.direction, edge2, pv);
+  __m128 det    = Dot3(edge1, pv);
+  __m128 invDet = _mm_div_ps(one, det);
+  __m128 u      = _mm_mul_ps(Dot3(s, pv), invDet);
+
+  __m128 q[3];
+  Cross(s, edge1, q);
+  __m128 v        = _mm_mul_ps(Dot3(p.direction, q), invDet);
+  __m128 distance = _mm_mul_ps(Dot3(edge2, q), invDet);
+
+  __m128 hit = _mm_and_ps(_mm_cmpneq_ps(det, zero), _mm_cmpge_ps(u, zero));
+  hit        = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+  hit        = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), one));
+  hit        = _mm_and_ps(hit, _mm_cmpge_ps(distance, zero));
+  hit        = _mm_and_ps(hit, _mm_cmplt_ps(distance, hits.distance));
+  if (_mm_movemask_ps(hit) == 0)
+  {
+    return;
+  }
+
+  __m128 index = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(tri.index)));
+  hits.triangle = _mm_castps_si128(
+    Select(_mm_castsi128_ps(hits.triangle), index, hit));
+  hits.distance = Select(hits.distance, distance, hit);
+  hits.u        = Select(hits.u, u, hit);
+  hits.v        = Select(hits.v, v, hit);
+}
+
+//------------------------------------------------------------------------------
+// Walks the tree once for the whole packet, descending into every node any of
+// its rays still hits closer than what it found so far.
+inline void
+TracePacket(const Tree& tree, const Packet& p, PacketHits& hits)
+{
+  uint32_t stack[MAX_DEPTH];
+  size_t depth   = 0;
+  uint32_t index = 0;
+  for (;;)
+  {
+    const Node& node = tree.nodes[index];
+
+    __m128 tMin = _mm_setzero_ps();
+    __m128 tMax = hits.distance;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      __m128 t0 = _mm_mul_ps(
+        _mm_sub_ps(_mm_set1_ps(node.boundsMin[axis]), p.origin[axis]),
+        p.invDirection[axis]);
+      __m128 t1 = _mm_mul_ps(
+        _mm_sub_ps(_mm_set1_ps(node.boundsMax[axis]), p.origin[axis]),
+        p.invDirection[axis]);
+      tMin = _mm_max_ps(_mm_min_ps(t1, t0), tMin);
+      tMax = _mm_min_ps(_mm_max_ps(t1, t0), tMax);
+    }
+
+    if (_mm_movemask_ps(_mm_cmple_ps(tMin, tMax)) != 0)
+    {
+      if (node.count == 0)
+      {
+        uint32_t nearer = node.first + p.nearer[node.axis];
+        stack[depth++]  = node.first + node.first + 1 - nearer;
+        index           = nearer;
+        continue;
+      }
+
+      for (uint32_t t = node.first; t < node.first + node.count; ++t)
+      {
+        IntersectTriangle(tree.triangles[t], p, hits);
+      }
+    }
+
+    if (depth == 0)
+    {
+      break;
+    }
+    index = stack[--depth];
+  }
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+MeshBvhImpl::IntersectSSE4(
+  const Tree& tree,
+  const Rays& rays,
+  size_t count,
+  float maxDistance,
+  const Hits& hits)
+{
+  for (size_t i = 0; i < count; i += WIDTH)
+  {
+    const size_t n = count - i < WIDTH ? count - i : WIDTH;
+
+    Packet p;
+    if (n == WIDTH)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        p.origin[axis]    = _mm_loadu_ps(rays.origin[axis] + i);
+        p.direction[axis] = _mm_loadu_ps(rays.direction[axis] + i);
+      }
+    }
+    else
+    {
+      // Pad the last packet by repeating its final ray.
+      alignas(16) float origin[3][WIDTH];
+      alignas(16) float direction[3][WIDTH];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        for (size_t k = 0; k < WIDTH; ++k)
+        {
+          size_t src         = i + (k < n ? k : n - 1);
+          origin[axis][k]    = rays.origin[axis][src];
+          direction[axis][k] = rays.direction[axis][src];
+        }
+        p.origin[axis]    = _mm_load_ps(origin[axis]);
+        p.direction[axis] = _mm_load_ps(direction[axis]);
+      }
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      p.invDirection[axis] = _mm_div_ps(_mm_set1_ps(1.0f), p.direction[axis]);
+
+      int negative = _mm_movemask_ps(
+        _mm_cmplt_ps(p.direction[axis], _mm_setzero_ps()));
+      int negatives = 0;
+      for (; negative != 0; negative &= negative - 1)
+      {
+        ++negatives;
+      }
+      p.nearer[axis] = negatives > static_cast<int>(WIDTH / 2) ? 1 : 0;
+    }
+
+    PacketHits packetHits;
+    packetHits.triangle = _mm_set1_epi32(static_cast<int>(NO_TRIANGLE));
+    packetHits.distance = _mm_set1_ps(maxDistance);
+    packetHits.u        = _mm_setzero_ps();
+    packetHits.v        = _mm_setzero_ps();
+    TracePacket(tree, p, packetHits);
+
+    alignas(16) uint32_t triangle[WIDTH];
+    alignas(16) float distance[WIDTH];
+    alignas(16) float u[WIDTH];
+    alignas(16) float v[WIDTH];
+    _mm_store_si128(reinterpret_cast<__m128i*>(triangle), packetHits.triangle);
+    _mm_store_ps(distance, packetHits.distance);
+    _mm_store_ps(u, packetHits.u);
+    _mm_store_ps(v, packetHits.v);
+    for (size_t k = 0; k < n; ++k)
+    {
+      hits.triangle[i + k] = triangle[k];
+      hits.distance[i + k] = distance[k];
+      hits.u[i + k]        = u[k];
+      hits.v[i + k]        = v[k];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
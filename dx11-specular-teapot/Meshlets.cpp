@@ -0,0 +1,344 @@
+#include "pch.h"
+#include "Meshlets.h"
+
+#include <cfloat>
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+// Cones whose normals stray further than this from the axis (about 84
+// degrees) can't cull anything useful, and their apex runs off to infinity.
+constexpr float MIN_CONE_SPREAD = 0.1f;
+
+// Marks a disabled cone test.
+constexpr float NO_CONE_CUTOFF = 2.0f;
+
+//------------------------------------------------------------------------------
+// The unnormalized normal on the side a triangle is drawn from. Right-handed
+// meshes from DirectXTK wind clockwise about their outward normals.
+XMVECTOR XM_CALLCONV
+FacingNormal(FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, bool rhcoords)
+{
+  XMVECTOR cross =
+    XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+  return rhcoords ? XMVectorNegate(cross) : cross;
+}
+
+//------------------------------------------------------------------------------
+XMVECTOR
+LoadPosition(
+  const std::vector<VertexPositionNormalTexture>& vertices, uint32_t index)
+{
+  return XMLoadFloat3(&vertices[index].position);
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Grows each meshlet from the first triangle not yet taken, in index order,
+// which after GeometricPrimitive::Optimize is spatially coherent. The
+// candidates are the untaken triangles sharing a vertex with the meshlet.
+//------------------------------------------------------------------------------
+void
+Meshlets::Build(
+  const std::vector<VertexPositionNormalTexture>& vertices,
+  const std::vector<uint32_t>& indices,
+  bool rhcoords,
+  size_t maxVertices,
+  size_t maxTriangles)
+{
+  if (maxVertices < 3 || maxTriangles < 1)
+  {
+    throw std::invalid_argument("Meshlets: too few vertices or triangles per meshlet");
+  }
+
+  m_meshlets.clear();
+  m_indices.clear();
+  m_indices.reserve(indices.size());
+  m_rhcoords = rhcoords;
+
+  const size_t triangleCount = indices.size() / 3;
+  const size_t vertexCount   = vertices.size();
+
+  // Unit facing normals; zero for degenerate triangles, which take no part
+  // in the cones.
+  std::vector<XMFLOAT3> normals(triangleCount);
+  for (size_t t = 0; t < triangleCount; ++t)
+  {
+    XMVECTOR normal = FacingNormal(
+      LoadPosition(vertices, indices[3 * t]),
+      LoadPosition(vertices, indices[3 * t + 1]),
+      LoadPosition(vertices, indices[3 * t + 2]),
+      rhcoords);
+    float length = XMVectorGetX(XMVector3Length(normal));
+    XMStoreFloat3(
+      &normals[t],
+      length > FLT_MIN ? XMVectorScale(normal, 1.0f / length) : XMVectorZero());
+  }
+
+  // The triangles using each vertex.
+  std::vector<uint32_t> vertexTriangleStarts(vertexCount + 1, 0);
+  for (uint32_t index : indices)
+  {
+    vertexTriangleStarts[index + 1]++;
+  }
+  for (size_t v = 0; v < vertexCount; ++v)
+  {
+    vertexTriangleStarts[v + 1] += vertexTriangleStarts[v];
+  }
+  std::vector<uint32_t> vertexTriangles(3 * triangleCount);
+  {
+    std::vector<uint32_t> fill(
+      vertexTriangleStarts.begin(), vertexTriangleStarts.end() - 1);
+    for (size_t i = 0; i < 3 * triangleCount; ++i)
+    {
+      vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<bool> taken(triangleCount, false);
+
+  // The meshlet each vertex was last added to.
+  std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+
+  std::vector<uint32_t> candidates;
+  std::vector<XMFLOAT3> points;
+  size_t seed = 0;
+  for (;;)
+  {
+    while (seed < triangleCount && taken[seed])
+    {
+      ++seed;
+    }
+    if (seed == triangleCount)
+    {
+      break;
+    }
+
+    const auto id      = static_cast<uint32_t>(m_meshlets.size());
+    Meshlet meshlet    = {};
+    meshlet.firstIndex = static_cast<uint32_t>(m_indices.size());
+    XMVECTOR normalSum = XMVectorZero();
+    candidates.clear();
+    points.clear();
+
+    size_t next = seed;
+    for (;;)
+    {
+      taken[next] = true;
+      meshlet.triangleCount++;
+      normalSum = XMVectorAdd(normalSum, XMLoadFloat3(&normals[next]));
+
+      for (size_t corner = 0; corner < 3; ++corner)
+      {
+        const uint32_t v = indices[3 * next + corner];
+        m_indices.push_back(v);
+        if (vertexMeshlet[v] == id)
+        {
+          continue;
+        }
+
+        vertexMeshlet[v] = id;
+        meshlet.vertexCount++;
+        points.push_back(vertices[v].position);
+        for (uint32_t i = vertexTriangleStarts[v];
+             i < vertexTriangleStarts[v + 1];
+             ++i)
+        {
+          if (!taken[vertexTriangles[i]])
+          {
+            candidates.push_back(vertexTriangles[i]);
+          }
+        }
+      }
+
+      if (meshlet.triangleCount == maxTriangles)
+      {
+        break;
+      }
+
+      // Fewest new vertices first, then the closest facing to the meshlet's.
+      const XMVECTOR facing = XMVector3Normalize(normalSum);
+      size_t best           = SIZE_MAX;
+      int bestNewVertices   = 4;
+      float bestFacing      = -FLT_MAX;
+      size_t kept           = 0;
+      for (uint32_t candidate : candidates)
+      {
+        if (taken[candidate])
+        {
+          continue;
+        }
+        candidates[kept++] = candidate;
+
+        int newVertices = 0;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+          newVertices += vertexMeshlet[indices[3 * candidate + corner]] != id;
+        }
+        if (meshlet.vertexCount + newVertices > maxVertices)
+        {
+          continue;
+        }
+
+        const float candidateFacing = XMVectorGetX(
+          XMVector3Dot(facing, XMLoadFloat3(&normals[candidate])));
+        if (newVertices < bestNewVertices
+            || (newVertices == bestNewVertices && candidateFacing > bestFacing))
+        {
+          best            = candidate;
+          bestNewVertices = newVertices;
+          bestFacing      = candidateFacing;
+        }
+      }
+      candidates.resize(kept);
+
+      if (best == SIZE_MAX)
+      {
+        break;
+      }
+      next = best;
+    }
+
+    BoundingSphere::CreateFromPoints(
+      meshlet.bounds, points.size(), points.data(), sizeof(XMFLOAT3));
+
+    // The cone's axis is the mean facing, its spread the widest angle from it
+    // to any triangle's. The apex is placed behind every triangle's plane, so
+    // that an eye inside the cone sees all of them from behind.
+    meshlet.coneCutoff = NO_CONE_CUTOFF;
+    meshlet.coneApex   = meshlet.bounds.Center;
+    meshlet.coneAxis   = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+    const float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+    if (sumLength > FLT_MIN)
+    {
+      const XMVECTOR axis   = XMVectorScale(normalSum, 1.0f / sumLength);
+      const XMVECTOR center = XMLoadFloat3(&meshlet.bounds.Center);
+
+      float minSpread = 1.0f;
+      float maxOffset = 0.0f;
+      for (uint32_t i = meshlet.firstIndex; i < m_indices.size(); i += 3)
+      {
+        const XMVECTOR p0 = LoadPosition(vertices, m_indices[i]);
+        const XMVECTOR normal =
+          FacingNormal(p0, LoadPosition(vertices, m_indices[i + 1]),
+                       LoadPosition(vertices, m_indices[i + 2]), rhcoords);
+        const float length = XMVectorGetX(XMVector3Length(normal));
+        if (length <= FLT_MIN)
+        {
+          continue;
+        }
+
+        const XMVECTOR unit = XMVectorScale(normal, 1.0f / length);
+        const float spread  = XMVectorGetX(XMVector3Dot(axis, unit));
+        minSpread           = std::min(minSpread, spread);
+        if (spread > MIN_CONE_SPREAD)
+        {
+          const float distance = XMVectorGetX(
+            XMVector3Dot(XMVectorSubtract(center, p0), unit));
+          maxOffset = std::max(maxOffset, distance / spread);
+        }
+      }
+
+      if (minSpread > MIN_CONE_SPREAD)
+      {
+        XMStoreFloat3(
+          &meshlet.coneApex,
+          XMVectorSubtract(center, XMVectorScale(axis, maxOffset)));
+        XMStoreFloat3(&meshlet.coneAxis, axis);
+        meshlet.coneCutoff = std::sqrt(1.0f - minSpread * minSpread);
+      }
+    }
+
+    m_meshlets.push_back(meshlet);
+  }
+}
+
+//------------------------------------------------------------------------------
+// The frustum planes and the eye are carried into model space, so the
+// meshlets are tested where they were built, whatever the world's scale.
+//------------------------------------------------------------------------------
+size_t XM_CALLCONV
+Meshlets::Cull(
+  FXMMATRIX world,
+  CXMMATRIX view,
+  CXMMATRIX projection,
+  std::vector<uint32_t>& indices,
+  CullStats* stats) const
+{
+  // As in TeapotField::Cull: a left-handed frustum from the projection with z
+  // flipped, its planes transformed by the inverse transpose of the point
+  // transform, here model * view * flipZ.
+  const XMMATRIX flipZ     = XMMatrixScaling(1.0f, 1.0f, -1.0f);
+  const XMMATRIX worldView = XMMatrixMultiply(world, view);
+
+  BoundingFrustum frustum;
+  BoundingFrustum::CreateFromMatrix(
+    frustum, XMMatrixMultiply(flipZ, projection));
+
+  XMVECTOR planes[6];
+  frustum.GetPlanes(
+    &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+  const XMMATRIX planeTransform =
+    XMMatrixTranspose(XMMatrixMultiply(worldView, flipZ));
+  for (auto& plane : planes)
+  {
+    plane = XMPlaneNormalize(XMPlaneTransform(plane, planeTransform));
+  }
+
+  const XMVECTOR eye = XMMatrixInverse(nullptr, worldView).r[3];
+
+  CullStats counts;
+  counts.meshlets  = m_meshlets.size();
+  counts.triangles = m_indices.size() / 3;
+
+  indices.clear();
+  for (const Meshlet& meshlet : m_meshlets)
+  {
+    if (meshlet.bounds.ContainedBy(
+          planes[0], planes[1], planes[2], planes[3], planes[4], planes[5])
+        == DISJOINT)
+    {
+      counts.frustumCulledMeshlets++;
+      counts.frustumCulledTriangles += meshlet.triangleCount;
+      continue;
+    }
+
+    if (meshlet.coneCutoff <= 1.0f)
+    {
+      const XMVECTOR toApex =
+        XMVectorSubtract(XMLoadFloat3(&meshlet.coneApex), eye);
+      const float along =
+        XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&meshlet.coneAxis)));
+      if (along >= meshlet.coneCutoff * XMVectorGetX(XMVector3Length(toApex)))
+      {
+        counts.backfaceCulledMeshlets++;
+        counts.backfaceCulledTriangles += meshlet.triangleCount;
+        continue;
+      }
+    }
+
+    auto first = m_indices.begin() + meshlet.firstIndex;
+    indices.insert(indices.end(), first, first + 3 * meshlet.triangleCount);
+  }
+
+  if (stats)
+  {
+    *stats = counts;
+  }
+  return indices.size() / 3;
+}
+
+//------------------------------------------------------------------------------
+bool XM_CALLCONV
+Meshlets::IsBackfacing(
+  FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, GXMVECTOR eye) const
+{
+  XMVECTOR normal = FacingNormal(p0, p1, p2, m_rhcoords);
+  return XMVectorGetX(XMVector3Dot(XMVectorSubtract(p0, eye), normal)) >= 0.0f;
+}
+
+//------------------------------------------------------------------------------
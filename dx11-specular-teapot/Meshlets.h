@@ -0,0 +1,95 @@
+//
+// Meshlets.h - Triangle clusters with bounding spheres and normal cones
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+// An indexed triangle list split into meshlets: clusters of at most
+// maxVertices distinct vertices and maxTriangles triangles, each grown across
+// shared edges from a seed triangle, preferring triangles that add the fewest
+// vertices and then those facing most like the cluster so far.
+//
+// Each meshlet keeps a bounding sphere and a cone around the facing normals
+// of its triangles. Cull uses them to drop meshlets outside the view frustum
+// and those facing wholly away from the eye, which is about half of a closed
+// mesh, and gathers the indices of the rest into one list for a single draw.
+//
+// Facing follows the winding, as the rasterizer's does, so rhcoords must be
+// what the mesh was generated with; mirroring world matrices are not handled.
+class Meshlets
+{
+public:
+  struct Meshlet
+  {
+    // Triangles GetIndices()[firstIndex, firstIndex + 3 * triangleCount).
+    uint32_t firstIndex;
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+
+    DirectX::BoundingSphere bounds;
+
+    // Every triangle faces away from an eye for which
+    // dot(normalize(coneApex - eye), coneAxis) >= coneCutoff. The cutoff is
+    // above 1, disabling the test, when the normals spread too far.
+    DirectX::XMFLOAT3 coneApex;
+    DirectX::XMFLOAT3 coneAxis;
+    float coneCutoff;
+  };
+
+  struct CullStats
+  {
+    size_t meshlets                = 0;
+    size_t triangles               = 0;
+    size_t frustumCulledMeshlets   = 0;
+    size_t frustumCulledTriangles  = 0;
+    size_t backfaceCulledMeshlets  = 0;
+    size_t backfaceCulledTriangles = 0;
+  };
+
+  Meshlets() = default;
+
+  Meshlets(Meshlets const&) = delete;
+  Meshlets& operator=(Meshlets const&) = delete;
+
+  void Build(
+    const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+    const std::vector<uint32_t>& indices,
+    bool rhcoords       = true,
+    size_t maxVertices  = 64,
+    size_t maxTriangles = 124);
+
+  const std::vector<Meshlet>& GetMeshlets() const { return m_meshlets; }
+
+  // The input triangles, regrouped by meshlet.
+  const std::vector<uint32_t>& GetIndices() const { return m_indices; }
+
+  // Replaces indices with the triangles of every meshlet that may be visible
+  // with the mesh placed by world and seen through view and projection (right
+  // handed, as Game's), in meshlet order. Returns the triangle count; the
+  // stats, if given, are overwritten.
+  size_t XM_CALLCONV Cull(
+    DirectX::FXMMATRIX world,
+    DirectX::CXMMATRIX view,
+    DirectX::CXMMATRIX projection,
+    std::vector<uint32_t>& indices,
+    CullStats* stats = nullptr) const;
+
+  // Whether the triangle faces away from eye, all in model space, by the
+  // winding Build was given; the test that the cones stand in for.
+  bool XM_CALLCONV IsBackfacing(
+    DirectX::FXMVECTOR p0,
+    DirectX::FXMVECTOR p1,
+    DirectX::FXMVECTOR p2,
+    DirectX::GXMVECTOR eye) const;
+
+private:
+  std::vector<Meshlet> m_meshlets;
+  std::vector<uint32_t> m_indices;
+  bool m_rhcoords = true;
+};
+}    // namespace DX
@@ -0,0 +1,464 @@
+//
+// Profiler.cpp - Lightweight CPU timing zones with Chrome trace export
+//
+
+#include "pch.h"
+#include "Profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <intrin.h>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+// Events per thread (16 bytes each). At a few hundred zones a frame this
+// holds several seconds of history. The events kept from threads that have
+// exited are capped at the same count.
+constexpr uint64_t BUFFER_CAPACITY = 1 << 16;
+constexpr uint64_t BUFFER_MASK     = BUFFER_CAPACITY - 1;
+
+// The time stamp counter is calibrated against steady_clock over at least
+// this long before timestamps are converted.
+constexpr double CALIBRATION_MS = 20.0;
+
+//------------------------------------------------------------------------------
+// A null name marks the end of the innermost open zone.
+struct Event
+{
+  const wchar_t* name;
+  uint64_t time;
+};
+
+// Written only by its thread. head counts every event ever written; the
+// events in [max(head - BUFFER_CAPACITY, clearedHead), head) are live.
+struct ThreadBuffer
+{
+  std::unique_ptr<Event[]> events;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> clearedHead;
+  uint32_t threadId;
+};
+
+struct Zone
+{
+  const wchar_t* name;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t threadId;
+  uint32_t depth;
+};
+
+// Events copied out of the buffer of a thread that has exited.
+struct RetiredEvents
+{
+  uint32_t threadId;
+  std::vector<Event> events;
+};
+
+//------------------------------------------------------------------------------
+// A buffer belongs to one thread at a time. When the thread exits its events
+// are copied to retired, oldest dropped first past BUFFER_CAPACITY in all,
+// and the buffer goes to freeBuffers for the next new thread. Pools that come
+// and go therefore cost no more buffers than the most threads alive at once.
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  std::vector<ThreadBuffer*> freeBuffers;
+  std::deque<RetiredEvents> retired;
+  size_t retiredEventCount = 0;
+  std::atomic<bool> enabled;
+
+  uint64_t originTicks;
+  std::chrono::steady_clock::time_point originTime;
+
+  Registry()
+      : enabled(true)
+      , originTicks(__rdtsc())
+      , originTime(std::chrono::steady_clock::now())
+  {
+  }
+};
+
+Registry&
+GetRegistry()
+{
+  static Registry registry;
+  return registry;
+}
+
+//------------------------------------------------------------------------------
+// Hands the thread's buffer back when the thread exits. Record reads the
+// plain pointer, t_buffer, which needs no construction check.
+struct ThreadBufferOwner
+{
+  ThreadBuffer* buffer = nullptr;
+
+  ~ThreadBufferOwner();
+};
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+thread_local ThreadBufferOwner t_owner;
+
+//------------------------------------------------------------------------------
+ThreadBuffer&
+RegisterThread()
+{
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  ThreadBuffer* buffer = nullptr;
+  if (!registry.freeBuffers.empty())
+  {
+    buffer = registry.freeBuffers.back();
+    registry.freeBuffers.pop_back();
+  }
+  else
+  {
+    auto created    = std::make_unique<ThreadBuffer>();
+    created->events = std::make_unique<Event[]>(BUFFER_CAPACITY);
+    created->head.store(0, std::memory_order_relaxed);
+    created->clearedHead.store(0, std::memory_order_relaxed);
+    created->threadId = static_cast<uint32_t>(registry.buffers.size());
+    buffer            = created.get();
+    registry.buffers.push_back(std::move(created));
+  }
+
+  t_buffer       = buffer;
+  t_owner.buffer = buffer;
+  return *buffer;
+}
+
+//------------------------------------------------------------------------------
+inline void
+Record(const wchar_t* name)
+{
+  ThreadBuffer* buffer = t_buffer;
+  if (!buffer)
+  {
+    buffer = &RegisterThread();
+  }
+
+  uint64_t head = buffer->head.load(std::memory_order_relaxed);
+  Event& event  = buffer->events[head & BUFFER_MASK];
+  event.name    = name;
+  event.time    = __rdtsc();
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+// Copies the live events of a buffer, minus any the owning thread may have
+// overwritten while they were being copied.
+std::vector<Event>
+Snapshot(const ThreadBuffer& buffer)
+{
+  uint64_t end     = buffer.head.load(std::memory_order_acquire);
+  uint64_t cleared = buffer.clearedHead.load(std::memory_order_relaxed);
+  uint64_t begin =
+    std::max(cleared, end > BUFFER_CAPACITY ? end - BUFFER_CAPACITY : 0);
+
+  std::vector<Event> events;
+  events.reserve(static_cast<size_t>(end - begin));
+  for (uint64_t i = begin; i < end; ++i)
+  {
+    events.push_back(buffer.events[i & BUFFER_MASK]);
+  }
+
+  // The slot of event 'after' was being written, and holds event
+  // 'after - BUFFER_CAPACITY' no longer.
+  uint64_t after = buffer.head.load(std::memory_order_acquire);
+  if (after + 1 > begin + BUFFER_CAPACITY)
+  {
+    uint64_t torn = std::min(end, after + 1 - BUFFER_CAPACITY) - begin;
+    events.erase(
+      events.begin(), events.begin() + static_cast<ptrdiff_t>(torn));
+  }
+  return events;
+}
+
+//------------------------------------------------------------------------------
+ThreadBufferOwner::~ThreadBufferOwner()
+{
+  if (!buffer)
+  {
+    return;
+  }
+
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  // The thread writes no more, so the snapshot is complete.
+  std::vector<Event> events = Snapshot(*buffer);
+  if (!events.empty())
+  {
+    registry.retiredEventCount += events.size();
+    registry.retired.push_back({buffer->threadId, std::move(events)});
+  }
+  while (registry.retiredEventCount > BUFFER_CAPACITY)
+  {
+    registry.retiredEventCount -= registry.retired.front().events.size();
+    registry.retired.pop_front();
+  }
+
+  // The next thread starts with the copied events cleared.
+  buffer->clearedHead.store(
+    buffer->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  registry.freeBuffers.push_back(buffer);
+
+  t_buffer = nullptr;
+  buffer   = nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Pairs up one thread's begin and end events into completed zones. Ends whose
+// begin was overwritten, and zones still open, are dropped.
+void
+PairEvents(
+  const std::vector<Event>& events, uint32_t threadId, std::vector<Zone>& zones)
+{
+  std::vector<const Event*> open;
+  for (const Event& event : events)
+  {
+    if (event.name)
+    {
+      open.push_back(&event);
+    }
+    else if (!open.empty())
+    {
+      const Event* begin = open.back();
+      open.pop_back();
+      zones.push_back(
+        {begin->name,
+         begin->time,
+         event.time,
+         threadId,
+         static_cast<uint32_t>(open.size())});
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Completed zones of the threads that have exited, then of the buffers. Free
+// buffers hold nothing live.
+std::vector<Zone>
+CollectZones()
+{
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::vector<Zone> zones;
+  for (const auto& retired : registry.retired)
+  {
+    PairEvents(retired.events, retired.threadId, zones);
+  }
+  for (const auto& buffer : registry.buffers)
+  {
+    PairEvents(Snapshot(*buffer), buffer->threadId, zones);
+  }
+  return zones;
+}
+
+//------------------------------------------------------------------------------
+// Milliseconds per time stamp counter tick.
+double
+GetTickPeriodMs()
+{
+  using namespace std::chrono;
+
+  Registry& registry = GetRegistry();
+  for (;;)
+  {
+    uint64_t ticks = __rdtsc();
+    double elapsedMs =
+      duration<double, std::milli>(steady_clock::now() - registry.originTime)
+        .count();
+    if (elapsedMs >= CALIBRATION_MS && ticks > registry.originTicks)
+    {
+      return elapsedMs / static_cast<double>(ticks - registry.originTicks);
+    }
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+}
+
+//------------------------------------------------------------------------------
+double
+Percentile(const std::vector<double>& sorted, double fraction)
+{
+  size_t rank = static_cast<size_t>(
+    std::ceil(fraction * static_cast<double>(sorted.size())));
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+//------------------------------------------------------------------------------
+// Zone names are identifiers, but escape them properly anyway.
+void
+WriteJsonString(std::ostream& out, const wchar_t* text)
+{
+  out << '"';
+  for (; *text; ++text)
+  {
+    wchar_t c = *text;
+    if (c == L'"' || c == L'\\')
+    {
+      out << '\\' << static_cast<char>(c);
+    }
+    else if (c < 0x20 || c > 0x7E)
+    {
+      char escaped[8];
+      snprintf(
+        escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c) & 0xFFFF);
+      out << escaped;
+    }
+    else
+    {
+      out << static_cast<char>(c);
+    }
+  }
+  out << '"';
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+DX::Profiler::BeginZone(_In_z_ const wchar_t* name)
+{
+  if (GetRegistry().enabled.load(std::memory_order_relaxed))
+  {
+    Record(name);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+DX::Profiler::EndZone()
+{
+  if (GetRegistry().enabled.load(std::memory_order_relaxed))
+  {
+    Record(nullptr);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+DX::Profiler::SetEnabled(bool enabled)
+{
+  GetRegistry().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+bool
+DX::Profiler::IsEnabled()
+{
+  return GetRegistry().enabled.load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+void
+DX::Profiler::Clear()
+{
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  for (auto& buffer : registry.buffers)
+  {
+    buffer->clearedHead.store(
+      buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+  registry.retired.clear();
+  registry.retiredEventCount = 0;
+}
+
+//------------------------------------------------------------------------------
+std::vector<DX::Profiler::ZoneSummary>
+DX::Profiler::Summarize()
+{
+  const double tickMs = GetTickPeriodMs();
+
+  std::map<std::wstring, std::vector<double>> durations;
+  for (const Zone& zone : CollectZones())
+  {
+    durations[zone.name].push_back(
+      static_cast<double>(zone.end - zone.begin) * tickMs);
+  }
+
+  std::vector<ZoneSummary> summaries;
+  for (auto& named : durations)
+  {
+    std::vector<double>& samples = named.second;
+    std::sort(samples.begin(), samples.end());
+
+    ZoneSummary summary;
+    summary.name    = named.first;
+    summary.count   = samples.size();
+    summary.totalMs = 0.0;
+    for (double ms : samples)
+    {
+      summary.totalMs += ms;
+    }
+    summary.p50Ms = Percentile(samples, 0.50);
+    summary.p95Ms = Percentile(samples, 0.95);
+    summary.p99Ms = Percentile(samples, 0.99);
+    summary.maxMs = samples.back();
+    summaries.push_back(summary);
+  }
+
+  std::sort(
+    summaries.begin(),
+    summaries.end(),
+    [](const ZoneSummary& a, const ZoneSummary& b) {
+      return a.totalMs > b.totalMs;
+    });
+  return summaries;
+}
+
+//------------------------------------------------------------------------------
+void
+DX::Profiler::WriteChromeTrace(_In_z_ const wchar_t* fileName)
+{
+  const double tickMs            = GetTickPeriodMs();
+  const std::vector<Zone> zones = CollectZones();
+
+  uint64_t origin = UINT64_MAX;
+  for (const Zone& zone : zones)
+  {
+    origin = std::min(origin, zone.begin);
+  }
+
+  std::ofstream outFile(fileName, std::ios::out | std::ios::binary);
+  if (!outFile)
+  {
+    throw std::runtime_error("WriteChromeTrace");
+  }
+
+  // Complete ("X") events, with times in microseconds.
+  outFile << "{\"traceEvents\":[";
+  char numbers[96];
+  for (size_t i = 0; i < zones.size(); ++i)
+  {
+    const Zone& zone = zones[i];
+    outFile << (i ? ",\n" : "\n") << "{\"name\":";
+    WriteJsonString(outFile, zone.name);
+    snprintf(
+      numbers,
+      sizeof(numbers),
+      ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+      zone.threadId,
+      static_cast<double>(zone.begin - origin) * tickMs * 1000.0,
+      static_cast<double>(zone.end - zone.begin) * tickMs * 1000.0);
+    outFile << numbers;
+  }
+  outFile << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  if (!outFile)
+  {
+    throw std::runtime_error("WriteChromeTrace");
+  }
+}
+
+//------------------------------------------------------------------------------
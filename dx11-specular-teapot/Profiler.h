@@ -0,0 +1,67 @@
+//
+// Profiler.h - Lightweight CPU timing zones with Chrome trace export
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace DX
+{
+// Records the begin and end of named zones into a ring buffer per thread.
+// Recording takes no locks: a thread only ever writes its own buffer, and
+// readers copy the buffers while they are written, discarding any events that
+// may have been overwritten during the copy. A full buffer overwrites its
+// oldest events. A thread's buffer is reused by later threads once it exits;
+// up to a buffer's worth of the zones of exited threads are kept.
+//
+// Names are stored by pointer, so must outlive the profiler (in practice,
+// string literals). Zones on one thread must nest.
+class Profiler
+{
+public:
+  struct ZoneSummary
+  {
+    std::wstring name;
+    size_t count;
+    double totalMs;
+    double p50Ms;
+    double p95Ms;
+    double p99Ms;
+    double maxMs;
+  };
+
+  static void BeginZone(_In_z_ const wchar_t* name);
+  static void EndZone();
+
+  // Recording is on by default.
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  // Discards every event recorded so far.
+  static void Clear();
+
+  // Durations of the completed zones still held in the buffers, per name,
+  // ordered by total time.
+  static std::vector<ZoneSummary> Summarize();
+
+  // Writes the completed zones as Chrome trace_event JSON, which loads in
+  // chrome://tracing and Perfetto.
+  static void WriteChromeTrace(_In_z_ const wchar_t* fileName);
+};
+
+// Profiles the enclosing scope.
+class ScopedZone
+{
+public:
+  explicit ScopedZone(_In_z_ const wchar_t* name)
+  {
+    Profiler::BeginZone(name);
+  }
+  ~ScopedZone() { Profiler::EndZone(); }
+
+  ScopedZone(ScopedZone const&) = delete;
+  ScopedZone& operator=(ScopedZone const&) = delete;
+};
+}
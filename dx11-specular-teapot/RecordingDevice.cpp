@@ -0,0 +1,2174 @@
+//
+// RecordingDevice.cpp - A Direct3D 11 device that records calls instead of
+//                       rendering
+//
+
+#include "pch.h"
+#include "RecordingDevice.h"
+
+#include <atomic>
+#include <mutex>
+
+using namespace DX;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Holds a reference to a COM object, like WRL's ComPtr but with only what
+// this file needs, so that it builds against D3D11 headers without WRL.
+template<class T>
+class Ref
+{
+public:
+  Ref()
+      : m_object(nullptr)
+  {
+  }
+
+  explicit Ref(T* object)
+      : m_object(object)
+  {
+    if (m_object)
+    {
+      m_object->AddRef();
+    }
+  }
+
+  Ref(const Ref& other)
+      : Ref(other.m_object)
+  {
+  }
+
+  ~Ref() { Reset(); }
+
+  Ref& operator=(const Ref& other) { return *this = other.m_object; }
+
+  Ref& operator=(T* object)
+  {
+    if (object)
+    {
+      object->AddRef();
+    }
+    Reset();
+    m_object = object;
+    return *this;
+  }
+
+  T* Get() const { return m_object; }
+  T* operator->() const { return m_object; }
+
+  void Reset()
+  {
+    if (m_object)
+    {
+      T* object = m_object;
+      m_object  = nullptr;
+      object->Release();
+    }
+  }
+
+  // Queries object for T, holding the result on success.
+  HRESULT QueryFrom(IUnknown* object)
+  {
+    Reset();
+    return object->QueryInterface(
+      __uuidof(T), reinterpret_cast<void**>(&m_object));
+  }
+
+private:
+  T* m_object;
+};
+
+//------------------------------------------------------------------------------
+// SetPrivateData storage, as every D3D object has.
+class PrivateData
+{
+public:
+  HRESULT Get(REFGUID guid, UINT* pDataSize, void* pData) const
+  {
+    if (!pDataSize)
+    {
+      return E_INVALIDARG;
+    }
+
+    for (const auto& entry : m_entries)
+    {
+      if (entry.guid != guid)
+      {
+        continue;
+      }
+
+      const auto size = static_cast<UINT>(entry.data.size());
+      if (pData)
+      {
+        if (*pDataSize < size)
+        {
+          *pDataSize = size;
+          return DXGI_ERROR_MORE_DATA;
+        }
+        memcpy(pData, entry.data.data(), size);
+      }
+      *pDataSize = size;
+      return S_OK;
+    }
+
+    *pDataSize = 0;
+    return DXGI_ERROR_NOT_FOUND;
+  }
+
+  HRESULT Set(REFGUID guid, UINT dataSize, const void* pData)
+  {
+    auto entry = std::find_if(
+      m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+        return e.guid == guid;
+      });
+    if (!pData)
+    {
+      if (entry != m_entries.end())
+      {
+        m_entries.erase(entry);
+      }
+      return S_OK;
+    }
+
+    if (entry == m_entries.end())
+    {
+      m_entries.push_back({guid, {}});
+      entry = m_entries.end() - 1;
+    }
+    auto bytes = static_cast<const uint8_t*>(pData);
+    entry->data.assign(bytes, bytes + dataSize);
+    return S_OK;
+  }
+
+private:
+  struct Entry
+  {
+    GUID guid;
+    std::vector<uint8_t> data;
+  };
+
+  std::vector<Entry> m_entries;
+};
+
+//------------------------------------------------------------------------------
+// IUnknown and ID3D11DeviceChild for an object implementing Interface, which
+// also answers QueryInterface for the intermediate interfaces in Bases.
+template<class Interface, class... Bases>
+class DeviceChild : public Interface
+{
+public:
+  explicit DeviceChild(ID3D11Device* device)
+      : m_refCount(1)
+      , m_device(device)
+  {
+  }
+
+  virtual ~DeviceChild() = default;
+
+  HRESULT STDMETHODCALLTYPE
+  QueryInterface(REFIID riid, void** ppvObject) override
+  {
+    if (!ppvObject)
+    {
+      return E_POINTER;
+    }
+
+    const bool isBase[] = {false, (riid == __uuidof(Bases))...};
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11DeviceChild)
+        || riid == __uuidof(Interface)
+        || std::find(std::begin(isBase), std::end(isBase), true)
+             != std::end(isBase))
+    {
+      *ppvObject = static_cast<Interface*>(this);
+      AddRef();
+      return S_OK;
+    }
+
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG refCount = --m_refCount;
+    if (refCount == 0)
+    {
+      delete this;
+    }
+    return refCount;
+  }
+
+  void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override
+  {
+    *ppDevice = m_device.Get();
+    (*ppDevice)->AddRef();
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override
+  {
+    return m_privateData.Get(guid, pDataSize, pData);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override
+  {
+    return m_privateData.Set(guid, DataSize, pData);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  SetPrivateDataInterface(REFGUID, const IUnknown*) override
+  {
+    return E_NOTIMPL;
+  }
+
+private:
+  std::atomic<ULONG> m_refCount;
+  Ref<ID3D11Device> m_device;
+  PrivateData m_privateData;
+};
+
+//------------------------------------------------------------------------------
+// Shaders and input layouts, which have nothing to describe.
+template<class Interface>
+class Opaque : public DeviceChild<Interface>
+{
+public:
+  explicit Opaque(ID3D11Device* device)
+      : DeviceChild<Interface>(device)
+  {
+  }
+};
+
+//------------------------------------------------------------------------------
+// State objects and views, which keep the description they were created with.
+template<class Interface, class Desc, class... Bases>
+class Described : public DeviceChild<Interface, Bases...>
+{
+public:
+  Described(ID3D11Device* device, const Desc& desc)
+      : DeviceChild<Interface, Bases...>(device)
+      , m_desc(desc)
+  {
+  }
+
+  void STDMETHODCALLTYPE GetDesc(Desc* pDesc) override { *pDesc = m_desc; }
+
+protected:
+  Desc m_desc;
+};
+
+//------------------------------------------------------------------------------
+template<class Interface, class Desc>
+class View : public Described<Interface, Desc, ID3D11View>
+{
+public:
+  View(ID3D11Device* device, ID3D11Resource* resource, const Desc& desc)
+      : Described<Interface, Desc, ID3D11View>(device, desc)
+      , m_resource(resource)
+  {
+  }
+
+  void STDMETHODCALLTYPE GetResource(ID3D11Resource** ppResource) override
+  {
+    *ppResource = m_resource.Get();
+    (*ppResource)->AddRef();
+  }
+
+private:
+  Ref<ID3D11Resource> m_resource;
+};
+
+//------------------------------------------------------------------------------
+template<class Interface, class Desc, D3D11_RESOURCE_DIMENSION DIMENSION>
+class Resource : public Described<Interface, Desc, ID3D11Resource>
+{
+public:
+  Resource(ID3D11Device* device, const Desc& desc)
+      : Described<Interface, Desc, ID3D11Resource>(device, desc)
+      , m_evictionPriority(0)
+  {
+  }
+
+  void STDMETHODCALLTYPE
+  GetType(D3D11_RESOURCE_DIMENSION* pResourceDimension) override
+  {
+    *pResourceDimension = DIMENSION;
+  }
+
+  void STDMETHODCALLTYPE SetEvictionPriority(UINT EvictionPriority) override
+  {
+    m_evictionPriority = EvictionPriority;
+  }
+
+  UINT STDMETHODCALLTYPE GetEvictionPriority() override
+  {
+    return m_evictionPriority;
+  }
+
+private:
+  UINT m_evictionPriority;
+};
+
+//------------------------------------------------------------------------------
+// Buffers keep their contents, so that what is mapped reads back as written.
+class Buffer
+    : public Resource<
+        ID3D11Buffer,
+        D3D11_BUFFER_DESC,
+        D3D11_RESOURCE_DIMENSION_BUFFER>
+{
+public:
+  Buffer(
+    ID3D11Device* device,
+    const D3D11_BUFFER_DESC& desc,
+    const D3D11_SUBRESOURCE_DATA* initialData)
+      : Resource(device, desc)
+      , m_data(desc.ByteWidth)
+      , m_mapped(false)
+      , m_mapType(D3D11_MAP_WRITE)
+  {
+    if (initialData && initialData->pSysMem)
+    {
+      memcpy(m_data.data(), initialData->pSysMem, m_data.size());
+    }
+  }
+
+  std::vector<uint8_t>& GetData() { return m_data; }
+
+  // Whether the buffer is mapped, how, and its contents before a
+  // NO_OVERWRITE map, so that Unmap can count only the bytes written.
+  bool IsMapped() const { return m_mapped; }
+  D3D11_MAP GetMapType() const { return m_mapType; }
+  const std::vector<uint8_t>& GetMapShadow() const { return m_mapShadow; }
+
+  void SetMapped(D3D11_MAP mapType)
+  {
+    m_mapped  = true;
+    m_mapType = mapType;
+    if (mapType == D3D11_MAP_WRITE_NO_OVERWRITE)
+    {
+      m_mapShadow = m_data;
+    }
+  }
+
+  void SetUnmapped() { m_mapped = false; }
+
+private:
+  std::vector<uint8_t> m_data;
+  bool m_mapped;
+  D3D11_MAP m_mapType;
+  std::vector<uint8_t> m_mapShadow;
+};
+
+using BlendState = Described<ID3D11BlendState, D3D11_BLEND_DESC>;
+using DepthStencilState =
+  Described<ID3D11DepthStencilState, D3D11_DEPTH_STENCIL_DESC>;
+using RasterizerState = Described<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>;
+using SamplerState    = Described<ID3D11SamplerState, D3D11_SAMPLER_DESC>;
+using Texture2D       = Resource<
+  ID3D11Texture2D,
+  D3D11_TEXTURE2D_DESC,
+  D3D11_RESOURCE_DIMENSION_TEXTURE2D>;
+using ShaderResourceView =
+  View<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>;
+using RenderTargetView =
+  View<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>;
+using DepthStencilView =
+  View<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC>;
+
+//------------------------------------------------------------------------------
+// Hands a new object to the caller, or releases it again when the caller is
+// only validating the arguments, to which D3D answers S_FALSE.
+template<class Interface, class T>
+HRESULT
+ReturnObject(Interface** ppObject, T* object)
+{
+  if (!ppObject)
+  {
+    object->Release();
+    return S_FALSE;
+  }
+  *ppObject = object;
+  return S_OK;
+}
+
+// Slot counts of the state the context keeps for its Get methods. Binds
+// beyond them are counted but not kept.
+constexpr UINT VERTEX_BUFFER_SLOTS   = 16;
+constexpr UINT CONSTANT_BUFFER_SLOTS = 14;
+constexpr UINT RESOURCE_SLOTS        = 16;
+constexpr UINT SAMPLER_SLOTS         = 16;
+constexpr UINT VIEWPORT_SLOTS        = 16;
+constexpr UINT RENDER_TARGET_SLOTS   = 8;
+
+// Bindings of one shader stage.
+struct StageState
+{
+  Ref<ID3D11Buffer> constantBuffers[CONSTANT_BUFFER_SLOTS];
+  Ref<ID3D11ShaderResourceView> resources[RESOURCE_SLOTS];
+  Ref<ID3D11SamplerState> samplers[SAMPLER_SLOTS];
+};
+}    // namespace
+
+//------------------------------------------------------------------------------
+// The immediate context. Shares its reference count with the device, as a
+// real immediate context does.
+//------------------------------------------------------------------------------
+class DX::RecordingDevice::Context final : public ID3D11DeviceContext
+{
+public:
+  explicit Context(ID3D11Device* device)
+      : m_device(device)
+  {
+    ClearState();
+    m_stats = RecordingStats();
+  }
+
+  RecordingStats m_stats;
+
+  // IUnknown
+  HRESULT STDMETHODCALLTYPE
+  QueryInterface(REFIID riid, void** ppvObject) override
+  {
+    if (!ppvObject)
+    {
+      return E_POINTER;
+    }
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11DeviceChild)
+        || riid == __uuidof(ID3D11DeviceContext))
+    {
+      *ppvObject = static_cast<ID3D11DeviceContext*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override { return m_device->AddRef(); }
+  ULONG STDMETHODCALLTYPE Release() override { return m_device->Release(); }
+
+  // ID3D11DeviceChild
+  void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override
+  {
+    *ppDevice = m_device;
+    m_device->AddRef();
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override
+  {
+    return m_privateData.Get(guid, pDataSize, pData);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override
+  {
+    return m_privateData.Set(guid, DataSize, pData);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  SetPrivateDataInterface(REFGUID, const IUnknown*) override
+  {
+    return E_NOTIMPL;
+  }
+
+  // Input assembler
+  void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout* pInputLayout)
+    override
+  {
+    ++m_stats.calls;
+    Bind(m_inputLayout, pInputLayout);
+  }
+
+  void STDMETHODCALLTYPE IASetVertexBuffers(
+    UINT StartSlot,
+    UINT NumBuffers,
+    ID3D11Buffer* const* ppVertexBuffers,
+    const UINT* pStrides,
+    const UINT* pOffsets) override
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+
+    bool redundant = true;
+    for (UINT i = 0; i < NumBuffers; ++i)
+    {
+      UINT slot = StartSlot + i;
+      if (slot >= VERTEX_BUFFER_SLOTS)
+      {
+        redundant = false;
+        continue;
+      }
+      ID3D11Buffer* buffer = ppVertexBuffers ? ppVertexBuffers[i] : nullptr;
+      UINT stride          = pStrides ? pStrides[i] : 0;
+      UINT offset          = pOffsets ? pOffsets[i] : 0;
+      redundant &= m_vertexBuffers[slot].Get() == buffer
+                   && m_vertexStrides[slot] == stride
+                   && m_vertexOffsets[slot] == offset;
+      m_vertexBuffers[slot] = buffer;
+      m_vertexStrides[slot] = stride;
+      m_vertexOffsets[slot] = offset;
+    }
+    if (redundant)
+    {
+      ++m_stats.redundantStateChanges;
+    }
+  }
+
+  void STDMETHODCALLTYPE IASetIndexBuffer(
+    ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset) override
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+    if (m_indexBuffer.Get() == pIndexBuffer && m_indexFormat == Format
+        && m_indexOffset == Offset)
+    {
+      ++m_stats.redundantStateChanges;
+    }
+    m_indexBuffer = pIndexBuffer;
+    m_indexFormat = Format;
+    m_indexOffset = Offset;
+  }
+
+  void STDMETHODCALLTYPE
+  IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology) override
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+    if (m_topology == Topology)
+    {
+      ++m_stats.redundantStateChanges;
+    }
+    m_topology = Topology;
+  }
+
+  void STDMETHODCALLTYPE IAGetInputLayout(ID3D11InputLayout** ppInputLayout)
+    override
+  {
+    ++m_stats.calls;
+    Get(m_inputLayout, ppInputLayout);
+  }
+
+  void STDMETHODCALLTYPE IAGetVertexBuffers(
+    UINT StartSlot,
+    UINT NumBuffers,
+    ID3D11Buffer** ppVertexBuffers,
+    UINT* pStrides,
+    UINT* pOffsets) override
+  {
+    ++m_stats.calls;
+    for (UINT i = 0; i < NumBuffers; ++i)
+    {
+      UINT slot = StartSlot + i;
+      bool kept = slot < VERTEX_BUFFER_SLOTS;
+      if (ppVertexBuffers)
+      {
+        ppVertexBuffers[i] = nullptr;
+        if (kept)
+        {
+          Get(m_vertexBuffers[slot], &ppVertexBuffers[i]);
+        }
+      }
+      if (pStrides)
+      {
+        pStrides[i] = kept ? m_vertexStrides[slot] : 0;
+      }
+      if (pOffsets)
+      {
+        pOffsets[i] = kept ? m_vertexOffsets[slot] : 0;
+      }
+    }
+  }
+
+  void STDMETHODCALLTYPE IAGetIndexBuffer(
+    ID3D11Buffer** pIndexBuffer, DXGI_FORMAT* Format, UINT* Offset) override
+  {
+    ++m_stats.calls;
+    if (pIndexBuffer)
+    {
+      Get(m_indexBuffer, pIndexBuffer);
+    }
+    if (Format)
+    {
+      *Format = m_indexFormat;
+    }
+    if (Offset)
+    {
+      *Offset = m_indexOffset;
+    }
+  }
+
+  void STDMETHODCALLTYPE
+  IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* pTopology) override
+  {
+    ++m_stats.calls;
+    *pTopology = m_topology;
+  }
+
+  // Vertex shader
+  void STDMETHODCALLTYPE VSSetShader(
+    ID3D11VertexShader* pVertexShader,
+    ID3D11ClassInstance* const*,
+    UINT) override
+  {
+    ++m_stats.calls;
+    Bind(m_vertexShader, pVertexShader);
+  }
+
+  void STDMETHODCALLTYPE VSSetConstantBuffers(
+    UINT StartSlot,
+    UINT NumBuffers,
+    ID3D11Buffer* const* ppConstantBuffers) override
+  {
+    ++m_stats.calls;
+    BindSlots(m_vs.constantBuffers, StartSlot, NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE VSSetShaderResources(
+    UINT StartSlot,
+    UINT NumViews,
+    ID3D11ShaderResourceView* const* ppShaderResourceViews) override
+  {
+    ++m_stats.calls;
+    BindSlots(m_vs.resources, StartSlot, NumViews, ppShaderResourceViews);
+  }
+
+  void STDMETHODCALLTYPE VSSetSamplers(
+    UINT StartSlot,
+    UINT NumSamplers,
+    ID3D11SamplerState* const* ppSamplers) override
+  {
+    ++m_stats.calls;
+    BindSlots(m_vs.samplers, StartSlot, NumSamplers, ppSamplers);
+  }
+
+  void STDMETHODCALLTYPE VSGetShader(
+    ID3D11VertexShader** ppVertexShader,
+    ID3D11ClassInstance**,
+    UINT* pNumClassInstances) override
+  {
+    ++m_stats.calls;
+    Get(m_vertexShader, ppVertexShader);
+    if (pNumClassInstances)
+    {
+      *pNumClassInstances = 0;
+    }
+  }
+
+  void STDMETHODCALLTYPE VSGetConstantBuffers(
+    UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override
+  {
+    ++m_stats.calls;
+    GetSlots(m_vs.constantBuffers, StartSlot, NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE VSGetShaderResources(
+    UINT StartSlot,
+    UINT NumViews,
+    ID3D11ShaderResourceView** ppShaderResourceViews) override
+  {
+    ++m_stats.calls;
+    GetSlots(m_vs.resources, StartSlot, NumViews, ppShaderResourceViews);
+  }
+
+  void STDMETHODCALLTYPE VSGetSamplers(
+    UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override
+  {
+    ++m_stats.calls;
+    GetSlots(m_vs.samplers, StartSlot, NumSamplers, ppSamplers);
+  }
+
+  // Pixel shader
+  void STDMETHODCALLTYPE PSSetShader(
+    ID3D11PixelShader* pPixelShader, ID3D11ClassInstance* const*, UINT) override
+  {
+    ++m_stats.calls;
+    Bind(m_pixelShader, pPixelShader);
+  }
+
+  void STDMETHODCALLTYPE PSSetConstantBuffers(
+    UINT StartSlot,
+    UINT NumBuffers,
+    ID3D11Buffer* const* ppConstantBuffers) override
+  {
+    ++m_stats.calls;
+    BindSlots(m_ps.constantBuffers, StartSlot, NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE PSSetShaderResources(
+    UINT StartSlot,
+    UINT NumViews,
+    ID3D11ShaderResourceView* const* ppShaderResourceViews) override
+  {
+    ++m_stats.calls;
+    BindSlots(m_ps.resources, StartSlot, NumViews, ppShaderResourceViews);
+  }
+
+  void STDMETHODCALLTYPE PSSetSamplers(
+    UINT StartSlot,
+    UINT NumSamplers,
+    ID3D11SamplerState* const* ppSamplers) override
+  {
+    ++m_stats.calls;
+    BindSlots(m_ps.samplers, StartSlot, NumSamplers, ppSamplers);
+  }
+
+  void STDMETHODCALLTYPE PSGetShader(
+    ID3D11PixelShader** ppPixelShader,
+    ID3D11ClassInstance**,
+    UINT* pNumClassInstances) override
+  {
+    ++m_stats.calls;
+    Get(m_pixelShader, ppPixelShader);
+    if (pNumClassInstances)
+    {
+      *pNumClassInstances = 0;
+    }
+  }
+
+  void STDMETHODCALLTYPE PSGetConstantBuffers(
+    UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override
+  {
+    ++m_stats.calls;
+    GetSlots(m_ps.constantBuffers, StartSlot, NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE PSGetShaderResources(
+    UINT StartSlot,
+    UINT NumViews,
+    ID3D11ShaderResourceView** ppShaderResourceViews) override
+  {
+    ++m_stats.calls;
+    GetSlots(m_ps.resources, StartSlot, NumViews, ppShaderResourceViews);
+  }
+
+  void STDMETHODCALLTYPE PSGetSamplers(
+    UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override
+  {
+    ++m_stats.calls;
+    GetSlots(m_ps.samplers, StartSlot, NumSamplers, ppSamplers);
+  }
+
+  // Rasterizer
+  void STDMETHODCALLTYPE RSSetState(ID3D11RasterizerState* pRasterizerState)
+    override
+  {
+    ++m_stats.calls;
+    Bind(m_rasterizerState, pRasterizerState);
+  }
+
+  void STDMETHODCALLTYPE
+  RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports) override
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+    m_viewportCount = std::min(NumViewports, VIEWPORT_SLOTS);
+    std::copy(pViewports, pViewports + m_viewportCount, m_viewports);
+  }
+
+  void STDMETHODCALLTYPE
+  RSSetScissorRects(UINT NumRects, const D3D11_RECT* pRects) override
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+    m_scissorCount = std::min(NumRects, VIEWPORT_SLOTS);
+    std::copy(pRects, pRects + m_scissorCount, m_scissors);
+  }
+
+  void STDMETHODCALLTYPE RSGetState(ID3D11RasterizerState** ppRasterizerState)
+    override
+  {
+    ++m_stats.calls;
+    Get(m_rasterizerState, ppRasterizerState);
+  }
+
+  void STDMETHODCALLTYPE
+  RSGetViewports(UINT* pNumViewports, D3D11_VIEWPORT* pViewports) override
+  {
+    ++m_stats.calls;
+    if (pViewports)
+    {
+      UINT count = std::min(*pNumViewports, m_viewportCount);
+      std::copy(m_viewports, m_viewports + count, pViewports);
+    }
+    *pNumViewports = m_viewportCount;
+  }
+
+  void STDMETHODCALLTYPE
+  RSGetScissorRects(UINT* pNumRects, D3D11_RECT* pRects) override
+  {
+    ++m_stats.calls;
+    if (pRects)
+    {
+      UINT count = std::min(*pNumRects, m_scissorCount);
+      std::copy(m_scissors, m_scissors + count, pRects);
+    }
+    *pNumRects = m_scissorCount;
+  }
+
+  // Output merger
+  void STDMETHODCALLTYPE OMSetRenderTargets(
+    UINT NumViews,
+    ID3D11RenderTargetView* const* ppRenderTargetViews,
+    ID3D11DepthStencilView* pDepthStencilView) override
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+    for (UINT slot = 0; slot < RENDER_TARGET_SLOTS; ++slot)
+    {
+      m_renderTargets[slot] = slot < NumViews && ppRenderTargetViews
+                                ? ppRenderTargetViews[slot]
+                                : nullptr;
+    }
+    m_depthStencilView = pDepthStencilView;
+  }
+
+  void STDMETHODCALLTYPE OMSetRenderTargetsAndUnorderedAccessViews(
+    UINT NumRTVs,
+    ID3D11RenderTargetView* const* ppRenderTargetViews,
+    ID3D11DepthStencilView* pDepthStencilView,
+    UINT,
+    UINT,
+    ID3D11UnorderedAccessView* const*,
+    const UINT*) override
+  {
+    if (NumRTVs != D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL)
+    {
+      OMSetRenderTargets(NumRTVs, ppRenderTargetViews, pDepthStencilView);
+    }
+    else
+    {
+      ++m_stats.calls;
+      ++m_stats.stateChanges;
+    }
+  }
+
+  void STDMETHODCALLTYPE OMSetBlendState(
+    ID3D11BlendState* pBlendState,
+    const FLOAT BlendFactor[4],
+    UINT SampleMask) override
+  {
+    ++m_stats.calls;
+    FLOAT factor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    if (BlendFactor)
+    {
+      std::copy(BlendFactor, BlendFactor + 4, factor);
+    }
+    bool sameExtras = m_sampleMask == SampleMask
+                      && std::equal(factor, factor + 4, m_blendFactor);
+    Bind(m_blendState, pBlendState, sameExtras);
+    std::copy(factor, factor + 4, m_blendFactor);
+    m_sampleMask = SampleMask;
+  }
+
+  void STDMETHODCALLTYPE OMSetDepthStencilState(
+    ID3D11DepthStencilState* pDepthStencilState, UINT StencilRef) override
+  {
+    ++m_stats.calls;
+    Bind(m_depthStencilState, pDepthStencilState, m_stencilRef == StencilRef);
+    m_stencilRef = StencilRef;
+  }
+
+  void STDMETHODCALLTYPE OMGetRenderTargets(
+    UINT NumViews,
+    ID3D11RenderTargetView** ppRenderTargetViews,
+    ID3D11DepthStencilView** ppDepthStencilView) override
+  {
+    ++m_stats.calls;
+    if (ppRenderTargetViews)
+    {
+      GetSlots(m_renderTargets, 0, NumViews, ppRenderTargetViews);
+    }
+    if (ppDepthStencilView)
+    {
+      Get(m_depthStencilView, ppDepthStencilView);
+    }
+  }
+
+  void STDMETHODCALLTYPE OMGetRenderTargetsAndUnorderedAccessViews(
+    UINT NumRTVs,
+    ID3D11RenderTargetView** ppRenderTargetViews,
+    ID3D11DepthStencilView** ppDepthStencilView,
+    UINT,
+    UINT NumUAVs,
+    ID3D11UnorderedAccessView** ppUnorderedAccessViews) override
+  {
+    OMGetRenderTargets(NumRTVs, ppRenderTargetViews, ppDepthStencilView);
+    ClearOutputs(NumUAVs, ppUnorderedAccessViews);
+  }
+
+  void STDMETHODCALLTYPE OMGetBlendState(
+    ID3D11BlendState** ppBlendState,
+    FLOAT BlendFactor[4],
+    UINT* pSampleMask) override
+  {
+    ++m_stats.calls;
+    if (ppBlendState)
+    {
+      Get(m_blendState, ppBlendState);
+    }
+    if (BlendFactor)
+    {
+      std::copy(m_blendFactor, m_blendFactor + 4, BlendFactor);
+    }
+    if (pSampleMask)
+    {
+      *pSampleMask = m_sampleMask;
+    }
+  }
+
+  void STDMETHODCALLTYPE OMGetDepthStencilState(
+    ID3D11DepthStencilState** ppDepthStencilState, UINT* pStencilRef) override
+  {
+    ++m_stats.calls;
+    if (ppDepthStencilState)
+    {
+      Get(m_depthStencilState, ppDepthStencilState);
+    }
+    if (pStencilRef)
+    {
+      *pStencilRef = m_stencilRef;
+    }
+  }
+
+  // Draws
+  void STDMETHODCALLTYPE Draw(UINT VertexCount, UINT) override
+  {
+    CountDraw(VertexCount, 1);
+  }
+
+  void STDMETHODCALLTYPE DrawIndexed(UINT IndexCount, UINT, INT) override
+  {
+    CountDraw(IndexCount, 1);
+  }
+
+  void STDMETHODCALLTYPE DrawInstanced(
+    UINT VertexCountPerInstance, UINT InstanceCount, UINT, UINT) override
+  {
+    CountDraw(VertexCountPerInstance, InstanceCount);
+  }
+
+  void STDMETHODCALLTYPE DrawIndexedInstanced(
+    UINT IndexCountPerInstance,
+    UINT InstanceCount,
+    UINT,
+    INT,
+    UINT) override
+  {
+    CountDraw(IndexCountPerInstance, InstanceCount);
+  }
+
+  void STDMETHODCALLTYPE DrawAuto() override { CountDraw(0, 0); }
+
+  void STDMETHODCALLTYPE
+  DrawIndexedInstancedIndirect(ID3D11Buffer*, UINT) override
+  {
+    CountDraw(0, 0);
+  }
+
+  void STDMETHODCALLTYPE DrawInstancedIndirect(ID3D11Buffer*, UINT) override
+  {
+    CountDraw(0, 0);
+  }
+
+  void STDMETHODCALLTYPE Dispatch(UINT, UINT, UINT) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE DispatchIndirect(ID3D11Buffer*, UINT) override
+  {
+    ++m_stats.calls;
+  }
+
+  // Resources
+  HRESULT STDMETHODCALLTYPE Map(
+    ID3D11Resource* pResource,
+    UINT Subresource,
+    D3D11_MAP MapType,
+    UINT,
+    D3D11_MAPPED_SUBRESOURCE* pMappedResource) override
+  {
+    ++m_stats.calls;
+
+    // Any number of buffers may be mapped at once, as PrimitiveBatch does
+    // with its index and vertex buffers, but each of them only once.
+    Ref<ID3D11Buffer> buffer;
+    if (Subresource != 0
+        || FAILED(buffer.QueryFrom(pResource))
+        || static_cast<Buffer*>(buffer.Get())->IsMapped())
+    {
+      return E_INVALIDARG;
+    }
+
+    auto mapped = static_cast<Buffer*>(buffer.Get());
+    auto& data  = mapped->GetData();
+    mapped->SetMapped(MapType);
+
+    pMappedResource->pData      = data.data();
+    pMappedResource->RowPitch   = static_cast<UINT>(data.size());
+    pMappedResource->DepthPitch = static_cast<UINT>(data.size());
+    return S_OK;
+  }
+
+  void STDMETHODCALLTYPE Unmap(ID3D11Resource* pResource, UINT Subresource)
+    override
+  {
+    ++m_stats.calls;
+
+    Ref<ID3D11Buffer> buffer;
+    if (Subresource != 0
+        || FAILED(buffer.QueryFrom(pResource))
+        || !static_cast<Buffer*>(buffer.Get())->IsMapped())
+    {
+      return;
+    }
+
+    auto mapped        = static_cast<Buffer*>(buffer.Get());
+    const auto& data   = mapped->GetData();
+    const auto& shadow = mapped->GetMapShadow();
+    ++m_stats.maps;
+    switch (mapped->GetMapType())
+    {
+      case D3D11_MAP_WRITE:
+      case D3D11_MAP_WRITE_DISCARD:
+      case D3D11_MAP_READ_WRITE:
+        m_stats.mapBytes += data.size();
+        break;
+
+      case D3D11_MAP_WRITE_NO_OVERWRITE:
+      {
+        auto first = std::mismatch(data.begin(), data.end(), shadow.begin());
+        if (first.first != data.end())
+        {
+          auto last =
+            std::mismatch(data.rbegin(), data.rend(), shadow.rbegin());
+          m_stats.mapBytes += static_cast<uint64_t>(
+            (data.rend() - last.first) - (first.first - data.begin()));
+        }
+        break;
+      }
+
+      default:
+        break;
+    }
+    mapped->SetUnmapped();
+  }
+
+  void STDMETHODCALLTYPE UpdateSubresource(
+    ID3D11Resource* pDstResource,
+    UINT,
+    const D3D11_BOX* pDstBox,
+    const void* pSrcData,
+    UINT SrcRowPitch,
+    UINT SrcDepthPitch) override
+  {
+    ++m_stats.calls;
+    ++m_stats.updates;
+
+    Ref<ID3D11Buffer> buffer;
+    if (SUCCEEDED(buffer.QueryFrom(pDstResource)))
+    {
+      auto& data   = static_cast<Buffer*>(buffer.Get())->GetData();
+      size_t left  = pDstBox ? pDstBox->left : 0;
+      size_t right = pDstBox ? pDstBox->right : data.size();
+      if (left < right && right <= data.size())
+      {
+        memcpy(&data[left], pSrcData, right - left);
+        m_stats.updateBytes += right - left;
+      }
+      return;
+    }
+
+    Ref<ID3D11Texture2D> texture;
+    if (SUCCEEDED(texture.QueryFrom(pDstResource)))
+    {
+      D3D11_TEXTURE2D_DESC desc;
+      texture->GetDesc(&desc);
+      UINT rows = pDstBox ? pDstBox->bottom - pDstBox->top : desc.Height;
+      m_stats.updateBytes += SrcDepthPitch ? SrcDepthPitch
+                                           : uint64_t(SrcRowPitch) * rows;
+    }
+  }
+
+  void STDMETHODCALLTYPE CopySubresourceRegion(
+    ID3D11Resource*,
+    UINT,
+    UINT,
+    UINT,
+    UINT,
+    ID3D11Resource*,
+    UINT,
+    const D3D11_BOX*) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE
+  CopyResource(ID3D11Resource* pDstResource, ID3D11Resource* pSrcResource)
+    override
+  {
+    ++m_stats.calls;
+
+    Ref<ID3D11Buffer> destination;
+    Ref<ID3D11Buffer> source;
+    if (SUCCEEDED(destination.QueryFrom(pDstResource))
+        && SUCCEEDED(source.QueryFrom(pSrcResource)))
+    {
+      auto& to         = static_cast<Buffer*>(destination.Get())->GetData();
+      const auto& from = static_cast<Buffer*>(source.Get())->GetData();
+      if (to.size() == from.size())
+      {
+        to = from;
+      }
+    }
+  }
+
+  void STDMETHODCALLTYPE
+  CopyStructureCount(ID3D11Buffer*, UINT, ID3D11UnorderedAccessView*) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE GenerateMips(ID3D11ShaderResourceView*) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE SetResourceMinLOD(ID3D11Resource*, FLOAT) override
+  {
+    ++m_stats.calls;
+  }
+
+  FLOAT STDMETHODCALLTYPE GetResourceMinLOD(ID3D11Resource*) override
+  {
+    ++m_stats.calls;
+    return 0.0f;
+  }
+
+  void STDMETHODCALLTYPE ResolveSubresource(
+    ID3D11Resource*, UINT, ID3D11Resource*, UINT, DXGI_FORMAT) override
+  {
+    ++m_stats.calls;
+  }
+
+  // Clears
+  void STDMETHODCALLTYPE
+  ClearRenderTargetView(ID3D11RenderTargetView*, const FLOAT[4]) override
+  {
+    ++m_stats.calls;
+    ++m_stats.clears;
+  }
+
+  void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(
+    ID3D11UnorderedAccessView*, const UINT[4]) override
+  {
+    ++m_stats.calls;
+    ++m_stats.clears;
+  }
+
+  void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(
+    ID3D11UnorderedAccessView*, const FLOAT[4]) override
+  {
+    ++m_stats.calls;
+    ++m_stats.clears;
+  }
+
+  void STDMETHODCALLTYPE
+  ClearDepthStencilView(ID3D11DepthStencilView*, UINT, FLOAT, UINT8) override
+  {
+    ++m_stats.calls;
+    ++m_stats.clears;
+  }
+
+  // Queries and predication, which never have results.
+  void STDMETHODCALLTYPE Begin(ID3D11Asynchronous*) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE End(ID3D11Asynchronous*) override
+  {
+    ++m_stats.calls;
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  GetData(ID3D11Asynchronous*, void*, UINT, UINT) override
+  {
+    ++m_stats.calls;
+    return E_NOTIMPL;
+  }
+
+  void STDMETHODCALLTYPE SetPredication(ID3D11Predicate*, BOOL) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE
+  GetPredication(ID3D11Predicate** ppPredicate, BOOL* pPredicateValue) override
+  {
+    ++m_stats.calls;
+    if (ppPredicate)
+    {
+      *ppPredicate = nullptr;
+    }
+    if (pPredicateValue)
+    {
+      *pPredicateValue = FALSE;
+    }
+  }
+
+  // Stages the recording device has no objects for: counted, never bound.
+  void STDMETHODCALLTYPE
+  GSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE GSSetShader(
+    ID3D11GeometryShader*, ID3D11ClassInstance* const*, UINT) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  GSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  GSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  HSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  HSSetShader(ID3D11HullShader*, ID3D11ClassInstance* const*, UINT) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  HSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  HSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  DSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  DSSetShader(ID3D11DomainShader*, ID3D11ClassInstance* const*, UINT) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  DSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  DSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  CSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE CSSetUnorderedAccessViews(
+    UINT, UINT, ID3D11UnorderedAccessView* const*, const UINT*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  CSSetShader(ID3D11ComputeShader*, ID3D11ClassInstance* const*, UINT) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  CSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  CSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE
+  SOSetTargets(UINT, ID3D11Buffer* const*, const UINT*) override
+  {
+    CountUnusedStage();
+  }
+
+  void STDMETHODCALLTYPE GSGetConstantBuffers(
+    UINT, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override
+  {
+    ClearOutputs(NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE GSGetShader(
+    ID3D11GeometryShader** ppGeometryShader,
+    ID3D11ClassInstance**,
+    UINT* pNumClassInstances) override
+  {
+    ClearShader(ppGeometryShader, pNumClassInstances);
+  }
+
+  void STDMETHODCALLTYPE GSGetShaderResources(
+    UINT, UINT NumViews, ID3D11ShaderResourceView** ppViews) override
+  {
+    ClearOutputs(NumViews, ppViews);
+  }
+
+  void STDMETHODCALLTYPE GSGetSamplers(
+    UINT, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override
+  {
+    ClearOutputs(NumSamplers, ppSamplers);
+  }
+
+  void STDMETHODCALLTYPE
+  SOGetTargets(UINT NumBuffers, ID3D11Buffer** ppSOTargets) override
+  {
+    ClearOutputs(NumBuffers, ppSOTargets);
+  }
+
+  void STDMETHODCALLTYPE HSGetShaderResources(
+    UINT, UINT NumViews, ID3D11ShaderResourceView** ppViews) override
+  {
+    ClearOutputs(NumViews, ppViews);
+  }
+
+  void STDMETHODCALLTYPE HSGetShader(
+    ID3D11HullShader** ppHullShader,
+    ID3D11ClassInstance**,
+    UINT* pNumClassInstances) override
+  {
+    ClearShader(ppHullShader, pNumClassInstances);
+  }
+
+  void STDMETHODCALLTYPE HSGetSamplers(
+    UINT, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override
+  {
+    ClearOutputs(NumSamplers, ppSamplers);
+  }
+
+  void STDMETHODCALLTYPE HSGetConstantBuffers(
+    UINT, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override
+  {
+    ClearOutputs(NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE DSGetShaderResources(
+    UINT, UINT NumViews, ID3D11ShaderResourceView** ppViews) override
+  {
+    ClearOutputs(NumViews, ppViews);
+  }
+
+  void STDMETHODCALLTYPE DSGetShader(
+    ID3D11DomainShader** ppDomainShader,
+    ID3D11ClassInstance**,
+    UINT* pNumClassInstances) override
+  {
+    ClearShader(ppDomainShader, pNumClassInstances);
+  }
+
+  void STDMETHODCALLTYPE DSGetSamplers(
+    UINT, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override
+  {
+    ClearOutputs(NumSamplers, ppSamplers);
+  }
+
+  void STDMETHODCALLTYPE DSGetConstantBuffers(
+    UINT, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override
+  {
+    ClearOutputs(NumBuffers, ppConstantBuffers);
+  }
+
+  void STDMETHODCALLTYPE CSGetShaderResources(
+    UINT, UINT NumViews, ID3D11ShaderResourceView** ppViews) override
+  {
+    ClearOutputs(NumViews, ppViews);
+  }
+
+  void STDMETHODCALLTYPE CSGetUnorderedAccessViews(
+    UINT, UINT NumUAVs, ID3D11UnorderedAccessView** ppViews) override
+  {
+    ClearOutputs(NumUAVs, ppViews);
+  }
+
+  void STDMETHODCALLTYPE CSGetShader(
+    ID3D11ComputeShader** ppComputeShader,
+    ID3D11ClassInstance**,
+    UINT* pNumClassInstances) override
+  {
+    ClearShader(ppComputeShader, pNumClassInstances);
+  }
+
+  void STDMETHODCALLTYPE CSGetSamplers(
+    UINT, UINT NumSamplers, ID3D11SamplerState** ppSamplers) override
+  {
+    ClearOutputs(NumSamplers, ppSamplers);
+  }
+
+  void STDMETHODCALLTYPE CSGetConstantBuffers(
+    UINT, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers) override
+  {
+    ClearOutputs(NumBuffers, ppConstantBuffers);
+  }
+
+  // Context
+  void STDMETHODCALLTYPE ExecuteCommandList(ID3D11CommandList*, BOOL) override
+  {
+    ++m_stats.calls;
+  }
+
+  void STDMETHODCALLTYPE ClearState() override
+  {
+    ++m_stats.calls;
+
+    m_inputLayout.Reset();
+    for (UINT slot = 0; slot < VERTEX_BUFFER_SLOTS; ++slot)
+    {
+      m_vertexBuffers[slot].Reset();
+      m_vertexStrides[slot] = 0;
+      m_vertexOffsets[slot] = 0;
+    }
+    m_indexBuffer.Reset();
+    m_indexFormat = DXGI_FORMAT_UNKNOWN;
+    m_indexOffset = 0;
+    m_topology    = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    m_vertexShader.Reset();
+    m_pixelShader.Reset();
+    m_vs = StageState();
+    m_ps = StageState();
+
+    m_rasterizerState.Reset();
+    m_viewportCount = 0;
+    m_scissorCount  = 0;
+
+    for (auto& renderTarget : m_renderTargets)
+    {
+      renderTarget.Reset();
+    }
+    m_depthStencilView.Reset();
+    m_blendState.Reset();
+    std::fill(m_blendFactor, m_blendFactor + 4, 1.0f);
+    m_sampleMask = UINT32_MAX;
+    m_depthStencilState.Reset();
+    m_stencilRef = 0;
+  }
+
+  void STDMETHODCALLTYPE Flush() override { ++m_stats.calls; }
+
+  D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE GetType() override
+  {
+    return D3D11_DEVICE_CONTEXT_IMMEDIATE;
+  }
+
+  UINT STDMETHODCALLTYPE GetContextFlags() override { return 0; }
+
+  HRESULT STDMETHODCALLTYPE
+  FinishCommandList(BOOL, ID3D11CommandList** ppCommandList) override
+  {
+    if (ppCommandList)
+    {
+      *ppCommandList = nullptr;
+    }
+    return DXGI_ERROR_INVALID_CALL;
+  }
+
+private:
+  // Binds value, counting the change and whether it changed anything.
+  template<class T>
+  void Bind(Ref<T>& bound, T* value, bool sameExtras = true)
+  {
+    ++m_stats.stateChanges;
+    if (bound.Get() == value && sameExtras)
+    {
+      ++m_stats.redundantStateChanges;
+    }
+    bound = value;
+  }
+
+  template<class T, size_t N>
+  void
+  BindSlots(Ref<T> (&bound)[N], UINT startSlot, UINT count, T* const* values)
+  {
+    ++m_stats.stateChanges;
+
+    bool redundant = true;
+    for (UINT i = 0; i < count; ++i)
+    {
+      UINT slot = startSlot + i;
+      T* value  = values ? values[i] : nullptr;
+      if (slot >= N)
+      {
+        redundant = false;
+        continue;
+      }
+      redundant &= bound[slot].Get() == value;
+      bound[slot] = value;
+    }
+    if (redundant)
+    {
+      ++m_stats.redundantStateChanges;
+    }
+  }
+
+  template<class T>
+  static void Get(const Ref<T>& bound, T** value)
+  {
+    *value = bound.Get();
+    if (*value)
+    {
+      (*value)->AddRef();
+    }
+  }
+
+  template<class T, size_t N>
+  static void GetSlots(
+    const Ref<T> (&bound)[N], UINT startSlot, UINT count, T** values)
+  {
+    for (UINT i = 0; i < count; ++i)
+    {
+      values[i] = nullptr;
+      if (startSlot + i < N)
+      {
+        Get(bound[startSlot + i], &values[i]);
+      }
+    }
+  }
+
+  template<class T>
+  void ClearOutputs(UINT count, T** values)
+  {
+    ++m_stats.calls;
+    if (values)
+    {
+      std::fill(values, values + count, nullptr);
+    }
+  }
+
+  template<class T>
+  void ClearShader(T** shader, UINT* classInstanceCount)
+  {
+    ++m_stats.calls;
+    if (shader)
+    {
+      *shader = nullptr;
+    }
+    if (classInstanceCount)
+    {
+      *classInstanceCount = 0;
+    }
+  }
+
+  void CountUnusedStage()
+  {
+    ++m_stats.calls;
+    ++m_stats.stateChanges;
+  }
+
+  void CountDraw(UINT count, UINT instanceCount)
+  {
+    ++m_stats.calls;
+    ++m_stats.draws;
+    m_stats.vertices += uint64_t(count) * instanceCount;
+  }
+
+  ID3D11Device* m_device;
+  PrivateData m_privateData;
+
+  Ref<ID3D11InputLayout> m_inputLayout;
+  Ref<ID3D11Buffer> m_vertexBuffers[VERTEX_BUFFER_SLOTS];
+  UINT m_vertexStrides[VERTEX_BUFFER_SLOTS];
+  UINT m_vertexOffsets[VERTEX_BUFFER_SLOTS];
+  Ref<ID3D11Buffer> m_indexBuffer;
+  DXGI_FORMAT m_indexFormat;
+  UINT m_indexOffset;
+  D3D11_PRIMITIVE_TOPOLOGY m_topology;
+
+  Ref<ID3D11VertexShader> m_vertexShader;
+  Ref<ID3D11PixelShader> m_pixelShader;
+  StageState m_vs;
+  StageState m_ps;
+
+  Ref<ID3D11RasterizerState> m_rasterizerState;
+  D3D11_VIEWPORT m_viewports[VIEWPORT_SLOTS];
+  UINT m_viewportCount;
+  D3D11_RECT m_scissors[VIEWPORT_SLOTS];
+  UINT m_scissorCount;
+
+  Ref<ID3D11RenderTargetView> m_renderTargets[RENDER_TARGET_SLOTS];
+  Ref<ID3D11DepthStencilView> m_depthStencilView;
+  Ref<ID3D11BlendState> m_blendState;
+  FLOAT m_blendFactor[4];
+  UINT m_sampleMask;
+  Ref<ID3D11DepthStencilState> m_depthStencilState;
+  UINT m_stencilRef;
+
+};
+
+//------------------------------------------------------------------------------
+class DX::RecordingDevice::Device final : public ID3D11Device
+{
+public:
+  explicit Device(D3D_FEATURE_LEVEL featureLevel)
+      : m_refCount(1)
+      , m_featureLevel(featureLevel)
+      , m_context(this)
+  {
+  }
+
+  Context& GetContext() { return m_context; }
+
+  // Counts of object creation, which may happen on any thread.
+  RecordingStats GetCreationStats()
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+  }
+
+  void ResetCreationStats()
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats = RecordingStats();
+  }
+
+  // IUnknown
+  HRESULT STDMETHODCALLTYPE
+  QueryInterface(REFIID riid, void** ppvObject) override
+  {
+    if (!ppvObject)
+    {
+      return E_POINTER;
+    }
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11Device))
+    {
+      *ppvObject = static_cast<ID3D11Device*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    ULONG refCount = --m_refCount;
+    if (refCount == 0)
+    {
+      delete this;
+    }
+    return refCount;
+  }
+
+  // Resources
+  HRESULT STDMETHODCALLTYPE CreateBuffer(
+    const D3D11_BUFFER_DESC* pDesc,
+    const D3D11_SUBRESOURCE_DATA* pInitialData,
+    ID3D11Buffer** ppBuffer) override
+  {
+    if (!pDesc || pDesc->ByteWidth == 0)
+    {
+      return E_INVALIDARG;
+    }
+
+    Buffer* buffer;
+    try
+    {
+      buffer = new Buffer(this, *pDesc, pInitialData);
+    }
+    catch (const std::bad_alloc&)
+    {
+      return E_OUTOFMEMORY;
+    }
+    CountCreate(pInitialData ? pDesc->ByteWidth : 0);
+    return ReturnObject(ppBuffer, buffer);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateTexture1D(
+    const D3D11_TEXTURE1D_DESC*,
+    const D3D11_SUBRESOURCE_DATA*,
+    ID3D11Texture1D** ppTexture1D) override
+  {
+    return Unsupported(ppTexture1D);
+  }
+
+  // Textures keep no texels; the initial data is only counted.
+  HRESULT STDMETHODCALLTYPE CreateTexture2D(
+    const D3D11_TEXTURE2D_DESC* pDesc,
+    const D3D11_SUBRESOURCE_DATA* pInitialData,
+    ID3D11Texture2D** ppTexture2D) override
+  {
+    if (!pDesc || pDesc->Width == 0 || pDesc->Height == 0)
+    {
+      return E_INVALIDARG;
+    }
+
+    uint64_t bytes = 0;
+    if (pInitialData)
+    {
+      for (UINT slice = 0; slice < pDesc->ArraySize; ++slice)
+      {
+        const auto& top = pInitialData[slice * std::max(pDesc->MipLevels, 1u)];
+        bytes += uint64_t(top.SysMemPitch) * pDesc->Height;
+      }
+    }
+    CountCreate(bytes);
+    return ReturnObject(ppTexture2D, new Texture2D(this, *pDesc));
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateTexture3D(
+    const D3D11_TEXTURE3D_DESC*,
+    const D3D11_SUBRESOURCE_DATA*,
+    ID3D11Texture3D** ppTexture3D) override
+  {
+    return Unsupported(ppTexture3D);
+  }
+
+  // Views
+  HRESULT STDMETHODCALLTYPE CreateShaderResourceView(
+    ID3D11Resource* pResource,
+    const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc,
+    ID3D11ShaderResourceView** ppSRView) override
+  {
+    return CreateView<ShaderResourceView>(pResource, pDesc, ppSRView);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateUnorderedAccessView(
+    ID3D11Resource*,
+    const D3D11_UNORDERED_ACCESS_VIEW_DESC*,
+    ID3D11UnorderedAccessView** ppUAView) override
+  {
+    return Unsupported(ppUAView);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateRenderTargetView(
+    ID3D11Resource* pResource,
+    const D3D11_RENDER_TARGET_VIEW_DESC* pDesc,
+    ID3D11RenderTargetView** ppRTView) override
+  {
+    return CreateView<RenderTargetView>(pResource, pDesc, ppRTView);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateDepthStencilView(
+    ID3D11Resource* pResource,
+    const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc,
+    ID3D11DepthStencilView** ppDepthStencilView) override
+  {
+    return CreateView<DepthStencilView>(pResource, pDesc, ppDepthStencilView);
+  }
+
+  // Shaders and input layouts
+  HRESULT STDMETHODCALLTYPE CreateInputLayout(
+    const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs,
+    UINT NumElements,
+    const void* pShaderBytecodeWithInputSignature,
+    SIZE_T,
+    ID3D11InputLayout** ppInputLayout) override
+  {
+    if (!pInputElementDescs || NumElements == 0
+        || !pShaderBytecodeWithInputSignature)
+    {
+      return E_INVALIDARG;
+    }
+    return CreateOpaque(ppInputLayout, 0);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateVertexShader(
+    const void* pShaderBytecode,
+    SIZE_T BytecodeLength,
+    ID3D11ClassLinkage*,
+    ID3D11VertexShader** ppVertexShader) override
+  {
+    return CreateShader(pShaderBytecode, BytecodeLength, ppVertexShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreatePixelShader(
+    const void* pShaderBytecode,
+    SIZE_T BytecodeLength,
+    ID3D11ClassLinkage*,
+    ID3D11PixelShader** ppPixelShader) override
+  {
+    return CreateShader(pShaderBytecode, BytecodeLength, ppPixelShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateGeometryShader(
+    const void*,
+    SIZE_T,
+    ID3D11ClassLinkage*,
+    ID3D11GeometryShader** ppGeometryShader) override
+  {
+    return Unsupported(ppGeometryShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateGeometryShaderWithStreamOutput(
+    const void*,
+    SIZE_T,
+    const D3D11_SO_DECLARATION_ENTRY*,
+    UINT,
+    const UINT*,
+    UINT,
+    UINT,
+    ID3D11ClassLinkage*,
+    ID3D11GeometryShader** ppGeometryShader) override
+  {
+    return Unsupported(ppGeometryShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateHullShader(
+    const void*,
+    SIZE_T,
+    ID3D11ClassLinkage*,
+    ID3D11HullShader** ppHullShader) override
+  {
+    return Unsupported(ppHullShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateDomainShader(
+    const void*,
+    SIZE_T,
+    ID3D11ClassLinkage*,
+    ID3D11DomainShader** ppDomainShader) override
+  {
+    return Unsupported(ppDomainShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateComputeShader(
+    const void*,
+    SIZE_T,
+    ID3D11ClassLinkage*,
+    ID3D11ComputeShader** ppComputeShader) override
+  {
+    return Unsupported(ppComputeShader);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  CreateClassLinkage(ID3D11ClassLinkage** ppLinkage) override
+  {
+    return Unsupported(ppLinkage);
+  }
+
+  // States
+  HRESULT STDMETHODCALLTYPE CreateBlendState(
+    const D3D11_BLEND_DESC* pBlendStateDesc,
+    ID3D11BlendState** ppBlendState) override
+  {
+    return CreateState<BlendState>(pBlendStateDesc, ppBlendState);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateDepthStencilState(
+    const D3D11_DEPTH_STENCIL_DESC* pDepthStencilDesc,
+    ID3D11DepthStencilState** ppDepthStencilState) override
+  {
+    return CreateState<DepthStencilState>(
+      pDepthStencilDesc, ppDepthStencilState);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateRasterizerState(
+    const D3D11_RASTERIZER_DESC* pRasterizerDesc,
+    ID3D11RasterizerState** ppRasterizerState) override
+  {
+    return CreateState<RasterizerState>(pRasterizerDesc, ppRasterizerState);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateSamplerState(
+    const D3D11_SAMPLER_DESC* pSamplerDesc,
+    ID3D11SamplerState** ppSamplerState) override
+  {
+    return CreateState<SamplerState>(pSamplerDesc, ppSamplerState);
+  }
+
+  // Queries and counters
+  HRESULT STDMETHODCALLTYPE
+  CreateQuery(const D3D11_QUERY_DESC*, ID3D11Query** ppQuery) override
+  {
+    return Unsupported(ppQuery);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreatePredicate(
+    const D3D11_QUERY_DESC*, ID3D11Predicate** ppPredicate) override
+  {
+    return Unsupported(ppPredicate);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  CreateCounter(const D3D11_COUNTER_DESC*, ID3D11Counter** ppCounter) override
+  {
+    return Unsupported(ppCounter);
+  }
+
+  HRESULT STDMETHODCALLTYPE CreateDeferredContext(
+    UINT, ID3D11DeviceContext** ppDeferredContext) override
+  {
+    return Unsupported(ppDeferredContext);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  OpenSharedResource(HANDLE, REFIID, void** ppResource) override
+  {
+    return Unsupported(ppResource);
+  }
+
+  // Capabilities: every format and feature the caller asks about is taken to
+  // be there, as nothing is ever drawn with them.
+  HRESULT STDMETHODCALLTYPE
+  CheckFormatSupport(DXGI_FORMAT, UINT* pFormatSupport) override
+  {
+    *pFormatSupport = UINT_MAX;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE CheckMultisampleQualityLevels(
+    DXGI_FORMAT, UINT SampleCount, UINT* pNumQualityLevels) override
+  {
+    *pNumQualityLevels = SampleCount <= 8 ? 1 : 0;
+    return S_OK;
+  }
+
+  void STDMETHODCALLTYPE CheckCounterInfo(D3D11_COUNTER_INFO* pCounterInfo)
+    override
+  {
+    *pCounterInfo = {};
+  }
+
+  HRESULT STDMETHODCALLTYPE CheckCounter(
+    const D3D11_COUNTER_DESC*,
+    D3D11_COUNTER_TYPE*,
+    UINT*,
+    LPSTR,
+    UINT*,
+    LPSTR,
+    UINT*,
+    LPSTR,
+    UINT*) override
+  {
+    return E_NOTIMPL;
+  }
+
+  HRESULT STDMETHODCALLTYPE CheckFeatureSupport(
+    D3D11_FEATURE,
+    void* pFeatureSupportData,
+    UINT FeatureSupportDataSize) override
+  {
+    memset(pFeatureSupportData, 0, FeatureSupportDataSize);
+    return E_INVALIDARG;
+  }
+
+  // Device
+  HRESULT STDMETHODCALLTYPE
+  GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override
+  {
+    return m_privateData.Get(guid, pDataSize, pData);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override
+  {
+    return m_privateData.Set(guid, DataSize, pData);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  SetPrivateDataInterface(REFGUID, const IUnknown*) override
+  {
+    return E_NOTIMPL;
+  }
+
+  D3D_FEATURE_LEVEL STDMETHODCALLTYPE GetFeatureLevel() override
+  {
+    return m_featureLevel;
+  }
+
+  UINT STDMETHODCALLTYPE GetCreationFlags() override { return 0; }
+
+  HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason() override { return S_OK; }
+
+  void STDMETHODCALLTYPE
+  GetImmediateContext(ID3D11DeviceContext** ppImmediateContext) override
+  {
+    *ppImmediateContext = &m_context;
+    AddRef();
+  }
+
+  HRESULT STDMETHODCALLTYPE SetExceptionMode(UINT) override { return S_OK; }
+
+  UINT STDMETHODCALLTYPE GetExceptionMode() override { return 0; }
+
+private:
+  void CountCreate(uint64_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    ++m_stats.objectsCreated;
+    m_stats.bytesCreated += bytes;
+  }
+
+  template<class T>
+  static HRESULT Unsupported(T** ppObject)
+  {
+    if (ppObject)
+    {
+      *ppObject = nullptr;
+    }
+    return E_NOTIMPL;
+  }
+
+  template<class Interface>
+  HRESULT CreateOpaque(Interface** ppObject, uint64_t bytes)
+  {
+    CountCreate(bytes);
+    return ReturnObject(ppObject, new Opaque<Interface>(this));
+  }
+
+  template<class Interface>
+  HRESULT CreateShader(
+    const void* pShaderBytecode, SIZE_T BytecodeLength, Interface** ppShader)
+  {
+    if (!pShaderBytecode || BytecodeLength == 0)
+    {
+      return E_INVALIDARG;
+    }
+    return CreateOpaque(ppShader, BytecodeLength);
+  }
+
+  template<class T, class Desc, class Interface>
+  HRESULT CreateState(const Desc* pDesc, Interface** ppState)
+  {
+    if (!pDesc)
+    {
+      return E_INVALIDARG;
+    }
+    CountCreate(0);
+    return ReturnObject(ppState, new T(this, *pDesc));
+  }
+
+  template<class T, class Desc, class Interface>
+  HRESULT
+  CreateView(ID3D11Resource* pResource, const Desc* pDesc, Interface** ppView)
+  {
+    if (!pResource)
+    {
+      return E_INVALIDARG;
+    }
+    Desc desc = {};
+    if (pDesc)
+    {
+      desc = *pDesc;
+    }
+    CountCreate(0);
+    return ReturnObject(ppView, new T(this, pResource, desc));
+  }
+
+  std::atomic<ULONG> m_refCount;
+  D3D_FEATURE_LEVEL m_featureLevel;
+  PrivateData m_privateData;
+  Context m_context;
+
+  std::mutex m_statsMutex;
+  RecordingStats m_stats;
+};
+
+//------------------------------------------------------------------------------
+RecordingStats&
+RecordingStats::operator+=(const RecordingStats& other)
+{
+  calls += other.calls;
+  stateChanges += other.stateChanges;
+  redundantStateChanges += other.redundantStateChanges;
+  draws += other.draws;
+  vertices += other.vertices;
+  clears += other.clears;
+  maps += other.maps;
+  mapBytes += other.mapBytes;
+  updates += other.updates;
+  updateBytes += other.updateBytes;
+  objectsCreated += other.objectsCreated;
+  bytesCreated += other.bytesCreated;
+  return *this;
+}
+
+//------------------------------------------------------------------------------
+RecordingDevice::RecordingDevice(D3D_FEATURE_LEVEL featureLevel)
+    : m_device(new Device(featureLevel))
+{
+}
+
+//------------------------------------------------------------------------------
+RecordingDevice::~RecordingDevice()
+{
+  // Bound objects hold the device, so would keep it alive through the
+  // context's references to them.
+  m_device->GetContext().ClearState();
+  m_device->Release();
+}
+
+//------------------------------------------------------------------------------
+ID3D11Device*
+RecordingDevice::GetDevice() const
+{
+  return m_device;
+}
+
+//------------------------------------------------------------------------------
+ID3D11DeviceContext*
+RecordingDevice::GetContext() const
+{
+  return &m_device->GetContext();
+}
+
+//------------------------------------------------------------------------------
+RecordingStats
+RecordingDevice::GetFrameStats() const
+{
+  RecordingStats stats = m_device->GetCreationStats();
+  stats += m_device->GetContext().m_stats;
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+void
+RecordingDevice::EndFrame()
+{
+  m_lastFrame = GetFrameStats();
+  m_total += m_lastFrame;
+
+  m_device->ResetCreationStats();
+  m_device->GetContext().m_stats = RecordingStats();
+}
+
+//------------------------------------------------------------------------------
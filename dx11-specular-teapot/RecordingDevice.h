@@ -0,0 +1,92 @@
+//
+// RecordingDevice.h - A Direct3D 11 device that records calls instead of
+//                     rendering
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace DX
+{
+// Work submitted to a RecordingDevice.
+struct RecordingStats
+{
+  // Context methods called, of any kind.
+  uint64_t calls = 0;
+
+  // Calls that bind state (IA, shaders and their resources, RS, OM), and
+  // those that bound exactly what was already bound.
+  uint64_t stateChanges          = 0;
+  uint64_t redundantStateChanges = 0;
+
+  uint64_t draws = 0;
+
+  // Vertices, or indices, drawn over every instance.
+  uint64_t vertices = 0;
+
+  uint64_t clears = 0;
+
+  // Buffers mapped for writing, and the bytes written: the whole buffer for
+  // WRITE_DISCARD and WRITE, the span that changed for WRITE_NO_OVERWRITE.
+  uint64_t maps     = 0;
+  uint64_t mapBytes = 0;
+
+  uint64_t updates     = 0;
+  uint64_t updateBytes = 0;
+
+  // Objects created through the device, and their initial data.
+  uint64_t objectsCreated = 0;
+  uint64_t bytesCreated   = 0;
+
+  RecordingStats& operator+=(const RecordingStats& other);
+};
+
+// An ID3D11Device and immediate context that keep no GPU state: buffers are
+// kept in memory so that Map and UpdateSubresource behave, bound state is
+// kept so that the Get methods answer as D3D would, and nothing is drawn.
+// Every call is counted instead, per frame, so that the frame loop can be
+// run without graphics hardware and its submission tracked over time.
+//
+// Covers what Game and DirectXTK's SpriteBatch, SpriteFont, PrimitiveBatch,
+// GeometricPrimitive, CommonStates and effects use: buffers, 2D textures and
+// their views, shaders, input layouts and state objects. Other objects fail
+// to create with E_NOTIMPL. Shader bytecode is not validated.
+//
+// Objects may be created from any thread; the context, like a real immediate
+// context, must only be used from one at a time.
+class RecordingDevice
+{
+public:
+  explicit RecordingDevice(
+    D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_11_0);
+  ~RecordingDevice();
+
+  RecordingDevice(RecordingDevice const&) = delete;
+  RecordingDevice& operator=(RecordingDevice const&) = delete;
+
+  // Not AddRef'd; live as long as this or any reference taken on them.
+  ID3D11Device* GetDevice() const;
+  ID3D11DeviceContext* GetContext() const;
+
+  // Counts since the last EndFrame.
+  RecordingStats GetFrameStats() const;
+
+  // Closes the current frame, whose counts become GetLastFrameStats and are
+  // added to GetTotalStats.
+  void EndFrame();
+
+  const RecordingStats& GetLastFrameStats() const { return m_lastFrame; }
+  const RecordingStats& GetTotalStats() const { return m_total; }
+
+private:
+  class Context;
+  class Device;
+
+  // Holds one reference.
+  Device* m_device;
+
+  RecordingStats m_lastFrame;
+  RecordingStats m_total;
+};
+}
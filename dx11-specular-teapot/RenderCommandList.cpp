@@ -0,0 +1,425 @@
+#include "pch.h"
+#include "RenderCommandList.h"
+
+using namespace DX;
+
+namespace
+{
+constexpr size_t DATA_ALIGNMENT = 16;
+
+//------------------------------------------------------------------------------
+bool
+IsUnslottedState(RenderCommandType type)
+{
+  switch (type)
+  {
+    case RenderCommandType::SetRasterizerState:
+    case RenderCommandType::SetBlendState:
+    case RenderCommandType::SetDepthStencilState:
+    case RenderCommandType::SetInputLayout:
+    case RenderCommandType::SetPrimitiveTopology:
+    case RenderCommandType::SetIndexBuffer:
+    case RenderCommandType::SetVertexShader:
+    case RenderCommandType::SetPixelShader:
+      return true;
+    default:
+      return false;
+  }
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::Clear()
+{
+  m_commands.clear();
+  m_data.clear();
+}
+
+//------------------------------------------------------------------------------
+RenderCommand&
+RenderCommandList::Append(RenderCommandType type, void* object)
+{
+  m_commands.emplace_back();
+  RenderCommand& command = m_commands.back();
+  command                = RenderCommand();
+  command.type           = type;
+  command.object         = object;
+  return command;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetRasterizerState(ID3D11RasterizerState* state)
+{
+  Append(RenderCommandType::SetRasterizerState, state);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetBlendState(ID3D11BlendState* state, uint32_t sampleMask)
+{
+  Append(RenderCommandType::SetBlendState, state).args[0] = sampleMask;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetDepthStencilState(
+  ID3D11DepthStencilState* state, uint32_t stencilRef)
+{
+  Append(RenderCommandType::SetDepthStencilState, state).args[0] = stencilRef;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+  Append(RenderCommandType::SetInputLayout, inputLayout);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+  Append(RenderCommandType::SetPrimitiveTopology).args[0] =
+    static_cast<uint32_t>(topology);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetVertexBuffer(
+  uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset)
+{
+  RenderCommand& command = Append(RenderCommandType::SetVertexBuffer, buffer);
+  command.slot           = static_cast<uint16_t>(slot);
+  command.args[0]        = stride;
+  command.args[1]        = offset;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetIndexBuffer(
+  ID3D11Buffer* buffer, DXGI_FORMAT format, uint32_t offset)
+{
+  RenderCommand& command = Append(RenderCommandType::SetIndexBuffer, buffer);
+  command.args[0]        = static_cast<uint32_t>(format);
+  command.args[1]        = offset;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetVertexShader(ID3D11VertexShader* shader)
+{
+  Append(RenderCommandType::SetVertexShader, shader);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetPixelShader(ID3D11PixelShader* shader)
+{
+  Append(RenderCommandType::SetPixelShader, shader);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::SetConstantBuffer(
+  uint32_t stages, uint32_t slot, ID3D11Buffer* buffer)
+{
+  RenderCommand& command = Append(RenderCommandType::SetConstantBuffer, buffer);
+  command.slot           = static_cast<uint16_t>(slot);
+  command.args[0]        = stages;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::UpdateBuffer(
+  ID3D11Buffer* buffer, UpdateMode mode, const void* data, size_t size)
+{
+  void* space = AllocateUpdate(buffer, mode, size);
+  if (size != 0)
+  {
+    memcpy(space, data, size);
+  }
+}
+
+//------------------------------------------------------------------------------
+void*
+RenderCommandList::AllocateUpdate(
+  ID3D11Buffer* buffer, UpdateMode mode, size_t size)
+{
+  // Nothing to write, as from an empty instance list: record nothing, and
+  // return a pointer that may not be written through.
+  if (size == 0)
+  {
+    return m_data.data() + m_data.size();
+  }
+
+  const size_t offset =
+    (m_data.size() + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+  if (offset + size > UINT32_MAX)
+  {
+    throw std::length_error("RenderCommandList::AllocateUpdate");
+  }
+  m_data.resize(offset + size);
+
+  RenderCommand& command = Append(RenderCommandType::UpdateBuffer, buffer);
+  command.slot           = static_cast<uint16_t>(mode);
+  command.args[0]        = static_cast<uint32_t>(offset);
+  command.args[1]        = static_cast<uint32_t>(size);
+  return m_data.data() + offset;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::ApplyEffect(DirectX::IEffect* effect)
+{
+  Append(RenderCommandType::ApplyEffect, effect);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+  RenderCommand& command = Append(RenderCommandType::Draw);
+  command.args[0]        = vertexCount;
+  command.args[1]        = startVertex;
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::DrawIndexed(
+  uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+  RenderCommand& command = Append(RenderCommandType::DrawIndexed);
+  command.args[0]        = indexCount;
+  command.args[1]        = startIndex;
+  command.args[2]        = static_cast<uint32_t>(baseVertex);
+}
+
+//------------------------------------------------------------------------------
+void
+RenderCommandList::DrawIndexedInstanced(
+  uint32_t indexCount,
+  uint32_t instanceCount,
+  uint32_t startIndex,
+  int32_t baseVertex,
+  uint32_t startInstance)
+{
+  RenderCommand& command = Append(RenderCommandType::DrawIndexedInstanced);
+  command.args[0]        = indexCount;
+  command.args[1]        = instanceCount;
+  command.args[2]        = startIndex;
+  command.args[3]        = static_cast<uint32_t>(baseVertex);
+  command.args[4]        = startInstance;
+}
+
+//------------------------------------------------------------------------------
+D3D11CommandExecutor::D3D11CommandExecutor(ID3D11DeviceContext* context)
+    : m_context(context)
+{
+}
+
+//------------------------------------------------------------------------------
+void
+D3D11CommandExecutor::Execute(const RenderCommandList& list)
+{
+  ID3D11DeviceContext* context = m_context;
+  for (const RenderCommand& command : list.GetCommands())
+  {
+    switch (command.type)
+    {
+      case RenderCommandType::SetRasterizerState:
+        context->RSSetState(
+          static_cast<ID3D11RasterizerState*>(command.object));
+        break;
+
+      case RenderCommandType::SetBlendState:
+        context->OMSetBlendState(
+          static_cast<ID3D11BlendState*>(command.object),
+          nullptr,
+          command.args[0]);
+        break;
+
+      case RenderCommandType::SetDepthStencilState:
+        context->OMSetDepthStencilState(
+          static_cast<ID3D11DepthStencilState*>(command.object),
+          command.args[0]);
+        break;
+
+      case RenderCommandType::SetInputLayout:
+        context->IASetInputLayout(
+          static_cast<ID3D11InputLayout*>(command.object));
+        break;
+
+      case RenderCommandType::SetPrimitiveTopology:
+        context->IASetPrimitiveTopology(
+          static_cast<D3D11_PRIMITIVE_TOPOLOGY>(command.args[0]));
+        break;
+
+      case RenderCommandType::SetVertexBuffer:
+      {
+        auto buffer = static_cast<ID3D11Buffer*>(command.object);
+        context->IASetVertexBuffers(
+          command.slot, 1, &buffer, &command.args[0], &command.args[1]);
+        break;
+      }
+
+      case RenderCommandType::SetIndexBuffer:
+        context->IASetIndexBuffer(
+          static_cast<ID3D11Buffer*>(command.object),
+          static_cast<DXGI_FORMAT>(command.args[0]),
+          command.args[1]);
+        break;
+
+      case RenderCommandType::SetVertexShader:
+        context->VSSetShader(
+          static_cast<ID3D11VertexShader*>(command.object), nullptr, 0);
+        break;
+
+      case RenderCommandType::SetPixelShader:
+        context->PSSetShader(
+          static_cast<ID3D11PixelShader*>(command.object), nullptr, 0);
+        break;
+
+      case RenderCommandType::SetConstantBuffer:
+      {
+        auto buffer = static_cast<ID3D11Buffer*>(command.object);
+        if (command.args[0] & RenderCommandList::VERTEX_STAGE)
+        {
+          context->VSSetConstantBuffers(command.slot, 1, &buffer);
+        }
+        if (command.args[0] & RenderCommandList::PIXEL_STAGE)
+        {
+          context->PSSetConstantBuffers(command.slot, 1, &buffer);
+        }
+        break;
+      }
+
+      case RenderCommandType::UpdateBuffer:
+      {
+        auto buffer = static_cast<ID3D11Buffer*>(command.object);
+        auto mode   = static_cast<RenderCommandList::UpdateMode>(command.slot);
+        const uint8_t* data = list.GetData(command.args[0]);
+        if (mode == RenderCommandList::UpdateMode::Discard)
+        {
+          D3D11_MAPPED_SUBRESOURCE mapped;
+          ThrowIfFailed(context->Map(
+            buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+          memcpy(mapped.pData, data, command.args[1]);
+          context->Unmap(buffer, 0);
+        }
+        else
+        {
+          context->UpdateSubresource(buffer, 0, nullptr, data, 0, 0);
+        }
+        break;
+      }
+
+      case RenderCommandType::ApplyEffect:
+        static_cast<DirectX::IEffect*>(command.object)->Apply(context);
+        break;
+
+      case RenderCommandType::Draw:
+        context->Draw(command.args[0], command.args[1]);
+        break;
+
+      case RenderCommandType::DrawIndexed:
+        context->DrawIndexed(
+          command.args[0],
+          command.args[1],
+          static_cast<INT>(command.args[2]));
+        break;
+
+      case RenderCommandType::DrawIndexedInstanced:
+        context->DrawIndexedInstanced(
+          command.args[0],
+          command.args[1],
+          command.args[2],
+          static_cast<INT>(command.args[3]),
+          command.args[4]);
+        break;
+
+      default:
+        throw std::logic_error("D3D11CommandExecutor::Execute");
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+NullCommandExecutor::Execute(const RenderCommandList& list)
+{
+  for (const RenderCommand& command : list.GetCommands())
+  {
+    const size_t type = static_cast<size_t>(command.type);
+    if (type >= size_t(RenderCommandType::Count))
+    {
+      throw std::logic_error("NullCommandExecutor::Execute");
+    }
+
+    ++m_stats.commands;
+    ++m_stats.perType[type];
+
+    if (IsUnslottedState(command.type))
+    {
+      const void* value =
+        command.type == RenderCommandType::SetPrimitiveTopology
+          ? reinterpret_cast<const void*>(uintptr_t(command.args[0]) + 1)
+          : command.object;
+      if (m_bound[type] == value)
+      {
+        ++m_stats.redundantSets;
+      }
+      m_bound[type] = value;
+      ++m_stats.stateChanges;
+      continue;
+    }
+
+    switch (command.type)
+    {
+      case RenderCommandType::SetVertexBuffer:
+      case RenderCommandType::SetConstantBuffer:
+      case RenderCommandType::ApplyEffect:
+        ++m_stats.stateChanges;
+        break;
+
+      case RenderCommandType::UpdateBuffer:
+      {
+        const uint8_t* data = list.GetData(command.args[0]);
+        uint64_t sum        = 0;
+        for (uint32_t i = 0; i < command.args[1]; ++i)
+        {
+          sum += data[i];
+        }
+        m_stats.checksum += sum;
+        m_stats.uploadBytes += command.args[1];
+        ++m_stats.uploads;
+        break;
+      }
+
+      case RenderCommandType::Draw:
+      case RenderCommandType::DrawIndexed:
+        m_stats.vertices += command.args[0];
+        ++m_stats.draws;
+        break;
+
+      case RenderCommandType::DrawIndexedInstanced:
+        m_stats.vertices += uint64_t(command.args[0]) * command.args[1];
+        ++m_stats.draws;
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+NullCommandExecutor::ResetStats()
+{
+  m_stats = Stats();
+  std::fill(std::begin(m_bound), std::end(m_bound), nullptr);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,190 @@
+//
+// RenderCommandList.h - Recorded draw submission, replayed by an executor
+//
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace DX
+{
+enum class RenderCommandType : uint16_t
+{
+  SetRasterizerState,
+  SetBlendState,
+  SetDepthStencilState,
+  SetInputLayout,
+  SetPrimitiveTopology,
+  SetVertexBuffer,
+  SetIndexBuffer,
+  SetVertexShader,
+  SetPixelShader,
+  SetConstantBuffer,
+  UpdateBuffer,
+  ApplyEffect,
+  Draw,
+  DrawIndexed,
+  DrawIndexedInstanced,
+  Count
+};
+
+// One recorded call. Objects are not referenced: whoever recorded the command
+// must keep them alive until the list has been executed.
+struct RenderCommand
+{
+  RenderCommandType type;
+  uint16_t slot;
+  uint32_t args[5];
+  void* object;
+};
+
+static_assert(
+  std::is_pod<RenderCommand>::value, "RenderCommand must stay plain data");
+
+// A list of state changes, buffer updates and draws for the immediate context,
+// recorded without touching the device.
+//
+// Recording only appends to the list's own vectors, so separate lists can be
+// recorded on separate threads and then executed, in order, on the thread
+// that owns the context. Buffer contents are copied into the list when
+// recorded. Clear keeps the allocations for the next frame.
+class RenderCommandList
+{
+public:
+  // Shader stages for SetConstantBuffer.
+  static const uint32_t VERTEX_STAGE = 0x1;
+  static const uint32_t PIXEL_STAGE  = 0x2;
+
+  // How UpdateBuffer writes: by mapping a dynamic buffer with WRITE_DISCARD,
+  // or with UpdateSubresource for a default usage buffer.
+  enum class UpdateMode : uint16_t
+  {
+    Discard,
+    Subresource
+  };
+
+  RenderCommandList() = default;
+
+  RenderCommandList(RenderCommandList const&) = delete;
+  RenderCommandList& operator=(RenderCommandList const&) = delete;
+
+  void Clear();
+
+  void SetRasterizerState(ID3D11RasterizerState* state);
+  void SetBlendState(ID3D11BlendState* state, uint32_t sampleMask = UINT32_MAX);
+  void
+  SetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef = 0);
+  void SetInputLayout(ID3D11InputLayout* inputLayout);
+  void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+  void SetVertexBuffer(
+    uint32_t slot, ID3D11Buffer* buffer, uint32_t stride, uint32_t offset = 0);
+  void SetIndexBuffer(
+    ID3D11Buffer* buffer, DXGI_FORMAT format, uint32_t offset = 0);
+  void SetVertexShader(ID3D11VertexShader* shader);
+  void SetPixelShader(ID3D11PixelShader* shader);
+  void SetConstantBuffer(uint32_t stages, uint32_t slot, ID3D11Buffer* buffer);
+
+  // Copies size bytes of data to be written to buffer when executed.
+  void UpdateBuffer(
+    ID3D11Buffer* buffer, UpdateMode mode, const void* data, size_t size);
+
+  // As UpdateBuffer, but returns the space for the caller to fill in. The
+  // pointer is only valid until the next command is recorded. Updates of zero
+  // bytes record no command.
+  void* AllocateUpdate(ID3D11Buffer* buffer, UpdateMode mode, size_t size);
+
+  // For effects that can only apply themselves to a context, such as those in
+  // DirectXTK. The effect is applied as it is when the list is executed, so it
+  // must not change between recording and execution.
+  void ApplyEffect(DirectX::IEffect* effect);
+
+  void Draw(uint32_t vertexCount, uint32_t startVertex = 0);
+  void DrawIndexed(
+    uint32_t indexCount, uint32_t startIndex = 0, int32_t baseVertex = 0);
+  void DrawIndexedInstanced(
+    uint32_t indexCount,
+    uint32_t instanceCount,
+    uint32_t startIndex    = 0,
+    int32_t baseVertex     = 0,
+    uint32_t startInstance = 0);
+
+  const std::vector<RenderCommand>& GetCommands() const { return m_commands; }
+  const uint8_t* GetData(uint32_t offset) const
+  {
+    return m_data.data() + offset;
+  }
+  size_t GetDataSize() const { return m_data.size(); }
+
+private:
+  RenderCommand& Append(RenderCommandType type, void* object = nullptr);
+
+  std::vector<RenderCommand> m_commands;
+
+  // Buffer contents for UpdateBuffer, each 16-byte aligned.
+  std::vector<uint8_t> m_data;
+};
+
+//------------------------------------------------------------------------------
+// Replays command lists. Lists are executed in the order they are passed in.
+class IRenderCommandExecutor
+{
+public:
+  virtual ~IRenderCommandExecutor() = default;
+
+  virtual void Execute(const RenderCommandList& list) = 0;
+};
+
+//------------------------------------------------------------------------------
+// Issues each command on a device context.
+class D3D11CommandExecutor : public IRenderCommandExecutor
+{
+public:
+  explicit D3D11CommandExecutor(ID3D11DeviceContext* context);
+
+  void Execute(const RenderCommandList& list) override;
+
+private:
+  ID3D11DeviceContext* m_context;
+};
+
+//------------------------------------------------------------------------------
+// Walks the commands without a device, counting them and summing the bytes
+// they upload, to time and check submission apart from the driver.
+class NullCommandExecutor : public IRenderCommandExecutor
+{
+public:
+  struct Stats
+  {
+    uint64_t commands      = 0;
+    uint64_t stateChanges  = 0;
+    uint64_t redundantSets = 0;
+    uint64_t uploads       = 0;
+    uint64_t uploadBytes   = 0;
+    uint64_t draws         = 0;
+
+    // Vertices, or indices, drawn over every instance.
+    uint64_t vertices = 0;
+
+    // Sum of every uploaded byte, so that the data is actually read.
+    uint64_t checksum = 0;
+
+    uint64_t perType[size_t(RenderCommandType::Count)] = {};
+  };
+
+  void Execute(const RenderCommandList& list) override;
+
+  const Stats& GetStats() const { return m_stats; }
+
+  // Also forgets the bound state.
+  void ResetStats();
+
+private:
+  Stats m_stats;
+
+  // Last object (or topology) set by each unslotted state command, to spot
+  // sets that change nothing. Kept across lists, as a context's state is.
+  const void* m_bound[size_t(RenderCommandType::Count)] = {};
+};
+}
@@ -0,0 +1,757 @@
+#include "pch.h"
+#include "SceneBvh.h"
+
+#include <cfloat>
+#include <numeric>
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+// Leaves hold at most this many objects.
+constexpr uint32_t MAX_LEAF_OBJECTS = 4;
+
+// Centroid bins tried along the widest axis by each SAH split.
+constexpr int SAH_BINS = 16;
+
+// Cost of visiting a node relative to testing one object.
+constexpr float SAH_TRAVERSAL_COST = 1.0f;
+
+// Below this depth ranges are split at their median instead, which bounds the
+// depth of the tree (and so the query stacks) whatever the input.
+constexpr int SAH_MAX_DEPTH = 32;
+
+// Each level pushes at most three more entries than it pops.
+constexpr size_t QUERY_STACK_SIZE = 256;
+
+//------------------------------------------------------------------------------
+float
+Component(const XMFLOAT3& v, int axis)
+{
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+//------------------------------------------------------------------------------
+float
+HalfSurfaceArea(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+  float dx = std::max(boundsMax.x - boundsMin.x, 0.0f);
+  float dy = std::max(boundsMax.y - boundsMin.y, 0.0f);
+  float dz = std::max(boundsMax.z - boundsMin.z, 0.0f);
+  return dx * dy + dy * dz + dz * dx;
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+Grow(
+  XMFLOAT3& boundsMin,
+  XMFLOAT3& boundsMax,
+  FXMVECTOR otherMin,
+  FXMVECTOR otherMax)
+{
+  XMStoreFloat3(&boundsMin, XMVectorMin(XMLoadFloat3(&boundsMin), otherMin));
+  XMStoreFloat3(&boundsMax, XMVectorMax(XMLoadFloat3(&boundsMax), otherMax));
+}
+
+//------------------------------------------------------------------------------
+void
+Grow(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax, const BoundingBox& box)
+{
+  XMVECTOR center  = XMLoadFloat3(&box.Center);
+  XMVECTOR extents = XMLoadFloat3(&box.Extents);
+  Grow(
+    boundsMin,
+    boundsMax,
+    XMVectorSubtract(center, extents),
+    XMVectorAdd(center, extents));
+}
+
+//------------------------------------------------------------------------------
+float
+HorizontalMin(const XMFLOAT4& v)
+{
+  return std::min(std::min(v.x, v.y), std::min(v.z, v.w));
+}
+
+//------------------------------------------------------------------------------
+float
+HorizontalMax(const XMFLOAT4& v)
+{
+  return std::max(std::max(v.x, v.y), std::max(v.z, v.w));
+}
+
+//------------------------------------------------------------------------------
+// A frustum plane splatted across the four lanes of a node, with masks that
+// pick, per axis, the corner of a box nearest the inside of the plane.
+struct PlaneLanes
+{
+  XMVECTOR normalX;
+  XMVECTOR normalY;
+  XMVECTOR normalZ;
+  XMVECTOR distance;
+  XMVECTOR useMinX;
+  XMVECTOR useMinY;
+  XMVECTOR useMinZ;
+};
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::Build(const std::vector<BoundingBox>& bounds)
+{
+  Clear();
+  if (bounds.empty())
+  {
+    return;
+  }
+  if (bounds.size() >= EMPTY)
+  {
+    throw std::invalid_argument("SceneBvh::Build: too many objects");
+  }
+
+  const auto objectCount = static_cast<uint32_t>(bounds.size());
+  m_objectBounds         = bounds;
+  m_objectNodes.resize(objectCount);
+
+  m_order.resize(objectCount);
+  std::iota(m_order.begin(), m_order.end(), 0u);
+
+  m_centroids.resize(objectCount);
+  for (uint32_t i = 0; i < objectCount; ++i)
+  {
+    m_centroids[i] = bounds[i].Center;
+  }
+
+  Range all = {0, objectCount, true, {}, {}};
+  ComputeRangeBounds(0, objectCount, all.boundsMin, all.boundsMax);
+
+  m_nodes.reserve(objectCount / MAX_LEAF_OBJECTS + 1);
+  BuildNode(all, INVALID_OBJECT, 0);
+
+  m_centroids.clear();
+  m_dirty.assign(m_nodes.size(), 0);
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::Clear()
+{
+  m_nodes.clear();
+  m_parents.clear();
+  m_objectBounds.clear();
+  m_order.clear();
+  m_objectNodes.clear();
+  m_centroids.clear();
+  m_dirty.clear();
+  m_dirtyFirst = UINT32_MAX;
+  m_dirtyLast  = 0;
+}
+
+//------------------------------------------------------------------------------
+// Splits the range into up to four children by repeatedly splitting the one
+// with the largest surface area, then recurses into those too big for a leaf.
+//------------------------------------------------------------------------------
+uint32_t
+SceneBvh::BuildNode(const Range& range, uint32_t parent, int depth)
+{
+  const auto index = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+  m_parents.push_back(parent);
+
+  Range ranges[4] = {range};
+  int rangeCount  = 1;
+  while (rangeCount < 4)
+  {
+    int widest       = -1;
+    float widestArea = -1.0f;
+    for (int i = 0; i < rangeCount; ++i)
+    {
+      float area = HalfSurfaceArea(ranges[i].boundsMin, ranges[i].boundsMax);
+      if (ranges[i].split && area > widestArea)
+      {
+        widest     = i;
+        widestArea = area;
+      }
+    }
+    if (widest < 0)
+    {
+      break;
+    }
+
+    if (SplitRange(ranges[widest], depth, ranges[rangeCount]))
+    {
+      ++rangeCount;
+    }
+    else
+    {
+      ranges[widest].split = false;
+    }
+  }
+
+  for (int lane = 0; lane < 4; ++lane)
+  {
+    if (lane >= rangeCount)
+    {
+      const XMFLOAT3 inverted[2] = {XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX),
+                                    XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX)};
+      Node& node = m_nodes[index];
+      SetLane(node, lane, inverted[0], inverted[1]);
+      node.child[lane] = EMPTY;
+      node.first[lane] = 0;
+      node.count[lane] = 0;
+      continue;
+    }
+
+    const Range& child = ranges[lane];
+    uint32_t childNode = LEAF;
+    if (child.count > MAX_LEAF_OBJECTS)
+    {
+      childNode = BuildNode(child, index, depth + 1);
+    }
+    else
+    {
+      for (uint32_t i = 0; i < child.count; ++i)
+      {
+        m_objectNodes[m_order[child.first + i]] = index;
+      }
+    }
+
+    // BuildNode may have reallocated m_nodes.
+    Node& node = m_nodes[index];
+    SetLane(node, lane, child.boundsMin, child.boundsMax);
+    node.child[lane] = childNode;
+    node.first[lane] = child.first;
+    node.count[lane] = child.count;
+  }
+
+  return index;
+}
+
+//------------------------------------------------------------------------------
+// Picks where to split the range in two, by binned SAH along the widest axis
+// of the centroids, and partitions m_order there: range keeps the left half
+// and right receives the other. Returns false, changing nothing, when the
+// range is better left as a leaf.
+//------------------------------------------------------------------------------
+bool
+SceneBvh::SplitRange(Range& range, int depth, Range& right)
+{
+  if (range.count < 2)
+  {
+    return false;
+  }
+
+  auto begin = m_order.begin() + range.first;
+  auto end   = begin + range.count;
+
+  XMVECTOR centroidMin = g_XMFltMax;
+  XMVECTOR centroidMax = XMVectorNegate(g_XMFltMax);
+  for (auto it = begin; it != end; ++it)
+  {
+    XMVECTOR centroid = XMLoadFloat3(&m_centroids[*it]);
+    centroidMin       = XMVectorMin(centroidMin, centroid);
+    centroidMax       = XMVectorMax(centroidMax, centroid);
+  }
+
+  XMFLOAT3 lowest, extent;
+  XMStoreFloat3(&lowest, centroidMin);
+  XMStoreFloat3(&extent, XMVectorSubtract(centroidMax, centroidMin));
+  int axis = extent.x >= extent.y ? 0 : 1;
+  axis     = Component(extent, axis) >= extent.z ? axis : 2;
+
+  const float axisMin    = Component(lowest, axis);
+  const float axisExtent = Component(extent, axis);
+  if (axisExtent <= 0.0f && range.count <= MAX_LEAF_OBJECTS)
+  {
+    return false;
+  }
+
+  // Splits at the median centroid, for when binning can't separate them.
+  auto splitMedian = [&]() {
+    uint32_t middle = range.first + range.count / 2;
+    std::nth_element(
+      begin, m_order.begin() + middle, end, [&](uint32_t a, uint32_t b) {
+        return Component(m_centroids[a], axis)
+               < Component(m_centroids[b], axis);
+      });
+
+    right.first = middle;
+    right.count = range.first + range.count - middle;
+    right.split = true;
+    range.count = middle - range.first;
+    ComputeRangeBounds(
+      range.first, range.count, range.boundsMin, range.boundsMax);
+    ComputeRangeBounds(
+      right.first, right.count, right.boundsMin, right.boundsMax);
+  };
+
+  if (axisExtent <= 0.0f || depth >= SAH_MAX_DEPTH)
+  {
+    splitMedian();
+    return true;
+  }
+
+  // Bin the objects by centroid.
+  const float binScale = SAH_BINS * (1.0f - 1.0e-5f) / axisExtent;
+  auto binOf           = [&](uint32_t object) {
+    float offset = Component(m_centroids[object], axis) - axisMin;
+    return std::min(static_cast<int>(offset * binScale), SAH_BINS - 1);
+  };
+
+  uint32_t binCounts[SAH_BINS] = {};
+  XMFLOAT3 binMin[SAH_BINS];
+  XMFLOAT3 binMax[SAH_BINS];
+  for (int bin = 0; bin < SAH_BINS; ++bin)
+  {
+    binMin[bin] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+    binMax[bin] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  }
+  for (auto it = begin; it != end; ++it)
+  {
+    int bin = binOf(*it);
+    ++binCounts[bin];
+    Grow(binMin[bin], binMax[bin], m_objectBounds[*it]);
+  }
+
+  // Sweep from the right, keeping the bounds of bins [i, SAH_BINS), then
+  // evaluate each plane sweeping from the left.
+  XMFLOAT3 rightMin[SAH_BINS];
+  XMFLOAT3 rightMax[SAH_BINS];
+  uint32_t rightCounts[SAH_BINS];
+  XMFLOAT3 sweepMin(FLT_MAX, FLT_MAX, FLT_MAX);
+  XMFLOAT3 sweepMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  uint32_t sweepCount = 0;
+  for (int bin = SAH_BINS - 1; bin > 0; --bin)
+  {
+    sweepCount += binCounts[bin];
+    Grow(
+      sweepMin,
+      sweepMax,
+      XMLoadFloat3(&binMin[bin]),
+      XMLoadFloat3(&binMax[bin]));
+    rightMin[bin]    = sweepMin;
+    rightMax[bin]    = sweepMax;
+    rightCounts[bin] = sweepCount;
+  }
+
+  int bestBin    = -1;
+  float bestCost = FLT_MAX;
+  XMFLOAT3 bestLeftMin, bestLeftMax;
+  sweepMin   = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+  sweepMax   = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  sweepCount = 0;
+  for (int bin = 1; bin < SAH_BINS; ++bin)
+  {
+    sweepCount += binCounts[bin - 1];
+    Grow(
+      sweepMin,
+      sweepMax,
+      XMLoadFloat3(&binMin[bin - 1]),
+      XMLoadFloat3(&binMax[bin - 1]));
+    if (sweepCount == 0 || rightCounts[bin] == 0)
+    {
+      continue;
+    }
+
+    float cost =
+      HalfSurfaceArea(sweepMin, sweepMax) * static_cast<float>(sweepCount)
+      + HalfSurfaceArea(rightMin[bin], rightMax[bin])
+          * static_cast<float>(rightCounts[bin]);
+    if (cost < bestCost)
+    {
+      bestBin     = bin;
+      bestCost    = cost;
+      bestLeftMin = sweepMin;
+      bestLeftMax = sweepMax;
+    }
+  }
+
+  const float area     = HalfSurfaceArea(range.boundsMin, range.boundsMax);
+  const float leafCost = area * static_cast<float>(range.count);
+  if (range.count <= MAX_LEAF_OBJECTS
+      && (bestBin < 0 || SAH_TRAVERSAL_COST * area + bestCost >= leafCost))
+  {
+    return false;
+  }
+
+  if (bestBin < 0)
+  {
+    splitMedian();
+    return true;
+  }
+
+  auto split = std::partition(
+    begin, end, [&](uint32_t object) { return binOf(object) < bestBin; });
+  auto middle = static_cast<uint32_t>(split - m_order.begin());
+
+  right.first     = middle;
+  right.count     = range.first + range.count - middle;
+  right.split     = true;
+  right.boundsMin = rightMin[bestBin];
+  right.boundsMax = rightMax[bestBin];
+  range.count     = middle - range.first;
+  range.boundsMin = bestLeftMin;
+  range.boundsMax = bestLeftMax;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::ComputeRangeBounds(
+  uint32_t first,
+  uint32_t count,
+  XMFLOAT3& boundsMin,
+  XMFLOAT3& boundsMax) const
+{
+  boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+  boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for (uint32_t i = first; i < first + count; ++i)
+  {
+    Grow(boundsMin, boundsMax, m_objectBounds[m_order[i]]);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::SetLane(
+  Node& node, int lane, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+  (&node.minX.x)[lane] = boundsMin.x;
+  (&node.minY.x)[lane] = boundsMin.y;
+  (&node.minZ.x)[lane] = boundsMin.z;
+  (&node.maxX.x)[lane] = boundsMax.x;
+  (&node.maxY.x)[lane] = boundsMax.y;
+  (&node.maxZ.x)[lane] = boundsMax.z;
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::UpdateObject(uint32_t object, const BoundingBox& bounds)
+{
+  m_objectBounds[object] = bounds;
+
+  uint32_t node = m_objectNodes[object];
+  if (!m_dirty[node])
+  {
+    m_dirty[node] = 1;
+    m_dirtyFirst  = std::min(m_dirtyFirst, node);
+    m_dirtyLast   = std::max(m_dirtyLast, node);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Children are always created after their parents, so walking the dirty span
+// backwards refits every node after all of its children.
+//------------------------------------------------------------------------------
+void
+SceneBvh::Refit()
+{
+  if (m_dirtyFirst > m_dirtyLast)
+  {
+    return;
+  }
+
+  for (uint32_t node = m_dirtyLast + 1; node-- > m_dirtyFirst;)
+  {
+    if (!m_dirty[node])
+    {
+      continue;
+    }
+    m_dirty[node] = 0;
+    RefitNode(node);
+
+    uint32_t parent = m_parents[node];
+    if (parent != INVALID_OBJECT && !m_dirty[parent])
+    {
+      m_dirty[parent] = 1;
+      m_dirtyFirst    = std::min(m_dirtyFirst, parent);
+    }
+  }
+
+  m_dirtyFirst = UINT32_MAX;
+  m_dirtyLast  = 0;
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::RefitNode(uint32_t index)
+{
+  Node& node = m_nodes[index];
+  for (int lane = 0; lane < 4; ++lane)
+  {
+    if (node.child[lane] == EMPTY)
+    {
+      continue;
+    }
+
+    XMFLOAT3 boundsMin, boundsMax;
+    if (node.child[lane] == LEAF)
+    {
+      ComputeRangeBounds(
+        node.first[lane], node.count[lane], boundsMin, boundsMax);
+    }
+    else
+    {
+      const Node& child = m_nodes[node.child[lane]];
+      boundsMin         = XMFLOAT3(
+        HorizontalMin(child.minX),
+        HorizontalMin(child.minY),
+        HorizontalMin(child.minZ));
+      boundsMax = XMFLOAT3(
+        HorizontalMax(child.maxX),
+        HorizontalMax(child.maxY),
+        HorizontalMax(child.maxZ));
+    }
+    SetLane(node, lane, boundsMin, boundsMax);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::AppendObjects(
+  uint32_t first, uint32_t count, std::vector<uint32_t>& objects) const
+{
+  objects.insert(
+    objects.end(),
+    m_order.begin() + first,
+    m_order.begin() + first + count);
+}
+
+//------------------------------------------------------------------------------
+// Tests the four children of a node against each plane at once. A child is
+// rejected when its corner nearest the inside of some plane is outside it,
+// and taken whole, without visiting its subtree, when its farthest corner is
+// inside every plane.
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+SceneBvh::QueryFrustum(
+  const XMVECTOR planes[6], std::vector<uint32_t>& objects) const
+{
+  if (m_nodes.empty())
+  {
+    return;
+  }
+
+  PlaneLanes lanes[6];
+  for (int i = 0; i < 6; ++i)
+  {
+    lanes[i].normalX  = XMVectorSplatX(planes[i]);
+    lanes[i].normalY  = XMVectorSplatY(planes[i]);
+    lanes[i].normalZ  = XMVectorSplatZ(planes[i]);
+    lanes[i].distance = XMVectorSplatW(planes[i]);
+    lanes[i].useMinX  = XMVectorGreater(lanes[i].normalX, g_XMZero);
+    lanes[i].useMinY  = XMVectorGreater(lanes[i].normalY, g_XMZero);
+    lanes[i].useMinZ  = XMVectorGreater(lanes[i].normalZ, g_XMZero);
+  }
+
+  uint32_t stack[QUERY_STACK_SIZE];
+  size_t stackSize   = 0;
+  stack[stackSize++] = 0;
+
+  while (stackSize > 0)
+  {
+    const Node& node = m_nodes[stack[--stackSize]];
+
+    XMVECTOR minX = XMLoadFloat4(&node.minX);
+    XMVECTOR minY = XMLoadFloat4(&node.minY);
+    XMVECTOR minZ = XMLoadFloat4(&node.minZ);
+    XMVECTOR maxX = XMLoadFloat4(&node.maxX);
+    XMVECTOR maxY = XMLoadFloat4(&node.maxY);
+    XMVECTOR maxZ = XMLoadFloat4(&node.maxZ);
+
+    XMVECTOR outside  = XMVectorFalseInt();
+    XMVECTOR straddle = XMVectorFalseInt();
+    for (const auto& plane : lanes)
+    {
+      XMVECTOR nearDistance = XMVectorMultiplyAdd(
+        plane.normalX,
+        XMVectorSelect(maxX, minX, plane.useMinX),
+        XMVectorMultiplyAdd(
+          plane.normalY,
+          XMVectorSelect(maxY, minY, plane.useMinY),
+          XMVectorMultiplyAdd(
+            plane.normalZ,
+            XMVectorSelect(maxZ, minZ, plane.useMinZ),
+            plane.distance)));
+      XMVECTOR farDistance = XMVectorMultiplyAdd(
+        plane.normalX,
+        XMVectorSelect(minX, maxX, plane.useMinX),
+        XMVectorMultiplyAdd(
+          plane.normalY,
+          XMVectorSelect(minY, maxY, plane.useMinY),
+          XMVectorMultiplyAdd(
+            plane.normalZ,
+            XMVectorSelect(minZ, maxZ, plane.useMinZ),
+            plane.distance)));
+
+      outside =
+        XMVectorOrInt(outside, XMVectorGreater(nearDistance, g_XMZero));
+      straddle =
+        XMVectorOrInt(straddle, XMVectorGreater(farDistance, g_XMZero));
+    }
+
+    uint32_t outsideMask[4];
+    uint32_t straddleMask[4];
+    XMStoreInt4(outsideMask, outside);
+    XMStoreInt4(straddleMask, straddle);
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+      if (node.count[lane] == 0 || outsideMask[lane])
+      {
+        continue;
+      }
+
+      if (!straddleMask[lane])
+      {
+        AppendObjects(node.first[lane], node.count[lane], objects);
+      }
+      else if (node.child[lane] == LEAF)
+      {
+        for (uint32_t i = 0; i < node.count[lane]; ++i)
+        {
+          uint32_t object = m_order[node.first[lane] + i];
+          ContainmentType containment = m_objectBounds[object].ContainedBy(
+            planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]);
+          if (containment != DISJOINT)
+          {
+            objects.push_back(object);
+          }
+        }
+      }
+      else
+      {
+        stack[stackSize++] = node.child[lane];
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+SceneBvh::QueryFrustum(
+  const BoundingFrustum& frustum, std::vector<uint32_t>& objects) const
+{
+  XMVECTOR planes[6];
+  frustum.GetPlanes(
+    &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+  QueryFrustum(planes, objects);
+}
+
+//------------------------------------------------------------------------------
+// Slab tests the four children of a node at once and visits those hit nearest
+// first, skipping any that start beyond the closest hit so far.
+//------------------------------------------------------------------------------
+uint32_t XM_CALLCONV
+SceneBvh::RayCast(
+  FXMVECTOR origin,
+  FXMVECTOR direction,
+  float maxDistance,
+  float& distance) const
+{
+  distance = maxDistance;
+  if (m_nodes.empty())
+  {
+    return INVALID_OBJECT;
+  }
+
+  const XMVECTOR originX = XMVectorSplatX(origin);
+  const XMVECTOR originY = XMVectorSplatY(origin);
+  const XMVECTOR originZ = XMVectorSplatZ(origin);
+  const XMVECTOR invDir  = XMVectorReciprocal(direction);
+  const XMVECTOR invDirX = XMVectorSplatX(invDir);
+  const XMVECTOR invDirY = XMVectorSplatY(invDir);
+  const XMVECTOR invDirZ = XMVectorSplatZ(invDir);
+
+  struct Entry
+  {
+    uint32_t node;
+    float entry;
+  };
+  Entry stack[QUERY_STACK_SIZE];
+  size_t stackSize   = 0;
+  stack[stackSize++] = {0, 0.0f};
+
+  uint32_t nearest = INVALID_OBJECT;
+  while (stackSize > 0)
+  {
+    const Entry top = stack[--stackSize];
+    if (top.entry > distance)
+    {
+      continue;
+    }
+    const Node& node = m_nodes[top.node];
+
+    XMVECTOR t0X = XMVectorMultiply(
+      XMVectorSubtract(XMLoadFloat4(&node.minX), originX), invDirX);
+    XMVECTOR t1X = XMVectorMultiply(
+      XMVectorSubtract(XMLoadFloat4(&node.maxX), originX), invDirX);
+    XMVECTOR t0Y = XMVectorMultiply(
+      XMVectorSubtract(XMLoadFloat4(&node.minY), originY), invDirY);
+    XMVECTOR t1Y = XMVectorMultiply(
+      XMVectorSubtract(XMLoadFloat4(&node.maxY), originY), invDirY);
+    XMVECTOR t0Z = XMVectorMultiply(
+      XMVectorSubtract(XMLoadFloat4(&node.minZ), originZ), invDirZ);
+    XMVECTOR t1Z = XMVectorMultiply(
+      XMVectorSubtract(XMLoadFloat4(&node.maxZ), originZ), invDirZ);
+
+    XMVECTOR entry = XMVectorMax(
+      XMVectorMax(XMVectorMin(t0X, t1X), XMVectorMin(t0Y, t1Y)),
+      XMVectorMax(XMVectorMin(t0Z, t1Z), g_XMZero));
+    XMVECTOR exit = XMVectorMin(
+      XMVectorMin(XMVectorMax(t0X, t1X), XMVectorMax(t0Y, t1Y)),
+      XMVectorMin(XMVectorMax(t0Z, t1Z), XMVectorReplicate(distance)));
+
+    uint32_t hitMask[4];
+    XMFLOAT4 entries;
+    XMStoreInt4(hitMask, XMVectorLessOrEqual(entry, exit));
+    XMStoreFloat4(&entries, entry);
+
+    Entry children[4];
+    int childCount = 0;
+    for (int lane = 0; lane < 4; ++lane)
+    {
+      if (node.count[lane] == 0 || !hitMask[lane])
+      {
+        continue;
+      }
+
+      if (node.child[lane] != LEAF)
+      {
+        children[childCount++] = {node.child[lane], (&entries.x)[lane]};
+        continue;
+      }
+
+      for (uint32_t i = 0; i < node.count[lane]; ++i)
+      {
+        uint32_t object = m_order[node.first[lane] + i];
+        float hit;
+        if (m_objectBounds[object].Intersects(origin, direction, hit))
+        {
+          // Rays starting inside a box report a negative distance.
+          hit = std::max(hit, 0.0f);
+          if (hit < distance)
+          {
+            distance = hit;
+            nearest  = object;
+          }
+        }
+      }
+    }
+
+    // Push the farthest first so the nearest is visited next.
+    std::sort(
+      children, children + childCount, [](const Entry& a, const Entry& b) {
+        return a.entry > b.entry;
+      });
+    for (int i = 0; i < childCount; ++i)
+    {
+      stack[stackSize++] = children[i];
+    }
+  }
+
+  return nearest;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,128 @@
+//
+// SceneBvh.h - Bounding volume hierarchy over scene objects for culling
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+// A 4-wide bounding volume hierarchy over axis aligned object bounds.
+//
+// Each node keeps the bounds of its (up to) four children in SoA form, so a
+// frustum or ray query tests all four with a handful of vector operations.
+// Build uses the surface area heuristic over binned centroids. Objects that
+// move are updated with UpdateObject and the tree is refitted with Refit,
+// which only revisits the nodes above the objects that moved; the topology is
+// kept, so a tree that has drifted far from its objects should be rebuilt.
+//
+// Queries are const and may run concurrently; updates may not.
+class SceneBvh
+{
+public:
+  static constexpr uint32_t INVALID_OBJECT = UINT32_MAX;
+
+  SceneBvh() = default;
+
+  SceneBvh(SceneBvh const&) = delete;
+  SceneBvh& operator=(SceneBvh const&) = delete;
+
+  // Objects are identified by their index in bounds.
+  void Build(const std::vector<DirectX::BoundingBox>& bounds);
+  void Clear();
+
+  size_t GetObjectCount() const { return m_objectBounds.size(); }
+  size_t GetNodeCount() const { return m_nodes.size(); }
+  const DirectX::BoundingBox& GetObjectBounds(uint32_t object) const
+  {
+    return m_objectBounds[object];
+  }
+
+  // Moves an object. Its ancestors are not updated until the next Refit.
+  void UpdateObject(uint32_t object, const DirectX::BoundingBox& bounds);
+  void Refit();
+
+  // Appends every object whose bounds are not entirely outside the planes, in
+  // tree order. Planes face outwards, as from BoundingFrustum::GetPlanes and
+  // as taken by the ContainedBy methods of the collision types.
+  void XM_CALLCONV QueryFrustum(
+    const DirectX::XMVECTOR planes[6], std::vector<uint32_t>& objects) const;
+  void QueryFrustum(
+    const DirectX::BoundingFrustum& frustum,
+    std::vector<uint32_t>& objects) const;
+
+  // The object whose bounds the ray enters first, within maxDistance, or
+  // INVALID_OBJECT. direction must be normalized.
+  uint32_t XM_CALLCONV RayCast(
+    DirectX::FXMVECTOR origin,
+    DirectX::FXMVECTOR direction,
+    float maxDistance,
+    float& distance) const;
+
+private:
+  static constexpr uint32_t LEAF  = UINT32_MAX;
+  static constexpr uint32_t EMPTY = UINT32_MAX - 1;
+
+  // Child bounds as min/max per axis, one lane per child. Empty lanes hold
+  // inverted bounds, which no query can hit. (Loaded unaligned: the vector of
+  // nodes is only 8-byte aligned on x86.)
+  struct Node
+  {
+    DirectX::XMFLOAT4 minX, minY, minZ;
+    DirectX::XMFLOAT4 maxX, maxY, maxZ;
+
+    // Index of a child node, or LEAF or EMPTY.
+    uint32_t child[4];
+
+    // Every object below a child is in m_order[first, first + count).
+    uint32_t first[4];
+    uint32_t count[4];
+  };
+
+  // Objects m_order[first, first + count) and their bounds, while building a
+  // node. split is cleared once the SAH prefers to keep the range as a leaf.
+  struct Range
+  {
+    uint32_t first;
+    uint32_t count;
+    bool split;
+    DirectX::XMFLOAT3 boundsMin;
+    DirectX::XMFLOAT3 boundsMax;
+  };
+
+  uint32_t BuildNode(const Range& range, uint32_t parent, int depth);
+  bool SplitRange(Range& range, int depth, Range& right);
+  void ComputeRangeBounds(
+    uint32_t first,
+    uint32_t count,
+    DirectX::XMFLOAT3& boundsMin,
+    DirectX::XMFLOAT3& boundsMax) const;
+  void RefitNode(uint32_t node);
+  void SetLane(
+    Node& node,
+    int lane,
+    const DirectX::XMFLOAT3& boundsMin,
+    const DirectX::XMFLOAT3& boundsMax);
+  void AppendObjects(
+    uint32_t first, uint32_t count, std::vector<uint32_t>& objects) const;
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_parents;
+
+  std::vector<DirectX::BoundingBox> m_objectBounds;
+
+  // Object indices grouped by leaf, and the node holding each object's leaf.
+  std::vector<uint32_t> m_order;
+  std::vector<uint32_t> m_objectNodes;
+
+  // Centroids, used during Build only.
+  std::vector<DirectX::XMFLOAT3> m_centroids;
+
+  // Nodes waiting for Refit; a node's parent always has a lower index.
+  std::vector<uint8_t> m_dirty;
+  uint32_t m_dirtyFirst = UINT32_MAX;
+  uint32_t m_dirtyLast  = 0;
+};
+}
@@ -1,28 +1,42 @@
 #include "pch.h"
 #include "MyEffect.h"
+#include "MyEffectConstants.h"
+#include "RenderCommandList.h"
 
 using namespace DirectX;
 
 //------------------------------------------------------------------------------
-struct StaticConstantBuffer
+// Tracks which constant buffers need uploading and which derived values need
+// recomputing (cf. EffectDirtyFlags in DirectXTK's EffectCommon.h).
+namespace MyEffectDirtyFlags
 {
-  DirectX::XMFLOAT4 modelColor;
-  DirectX::XMFLOAT4 ambientIC;
-  DirectX::XMFLOAT4 diffuseIC;
-  DirectX::XMFLOAT4 specularIC;
-  DirectX::XMFLOAT4 lightDir;
-};
+const int StaticBuffer  = 0x01;
+const int DynamicBuffer = 0x02;
+const int World         = 0x04;
+const int View          = 0x08;
+const int Projection    = 0x10;
+}
 
 //------------------------------------------------------------------------------
-struct DynamicConstantBuffer
-{
-  DirectX::XMFLOAT4X4 model;
-  DirectX::XMFLOAT4X4 view;
-  DirectX::XMFLOAT4X4 projection;
-  DirectX::XMFLOAT4X4 worldInverseTranspose;
-  DirectX::XMFLOAT4 vEyePos;
+const D3D11_INPUT_ELEMENT_DESC
+  MyEffect::InstancedInputElements[MyEffect::InstancedInputElementCount] = {
+    // clang-format off
+    {"SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0},
+    {"NORMAL",      0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0},
+    {"TEXCOORD",    0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0},
+    {"WORLD",       0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"WORLD",       1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"WORLD",       2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"WORLDIT",     0, DXGI_FORMAT_R32G32B32_FLOAT,    1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"WORLDIT",     1, DXGI_FORMAT_R32G32B32_FLOAT,    1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"WORLDIT",     2, DXGI_FORMAT_R32G32B32_FLOAT,    1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    // clang-format on
 };
 
+static_assert(
+  sizeof(InstanceData) == 3 * 16 + 3 * 12,
+  "InstanceData must match MyEffect::InstancedInputElements");
+
 //------------------------------------------------------------------------------
 class MyEffect::Impl
 {
@@ -30,23 +44,34 @@ public:
   XMMATRIX m_world;
   XMMATRIX m_view;
   XMMATRIX m_projection;
-  bool m_isInit = false;
+  bool m_isInit     = false;
+  bool m_instancing = false;
+  int m_dirtyFlags  = -1;
+  ApplyStats m_stats;
 
   Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
+  Microsoft::WRL::ComPtr<ID3D11VertexShader> m_instancedVertexShader;
   Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
   Microsoft::WRL::ComPtr<ID3D11Buffer> m_staticConstantBuffer;
   Microsoft::WRL::ComPtr<ID3D11Buffer> m_dynamicConstantBuffer;
   StaticConstantBuffer m_staticData;
   DynamicConstantBuffer m_dynamicData;
 
-  std::vector<uint8_t> m_VSBytecode;
+  // Kept mapped for input layout creation.
+  DX::MappedData m_VSBytecode;
+  DX::MappedData m_instancedVSBytecode;
 
-  MyEffect::Impl(_In_ ID3D11Device* device);
+  // Scratch list for applying straight to a context.
+  DX::RenderCommandList m_applyCommands;
+
+  // Reads the shaders from file when bytecode is null.
+  MyEffect::Impl(_In_ ID3D11Device* device, ShaderBytecode* bytecode);
   void Apply(_In_ ID3D11DeviceContext* deviceContext);
+  void Apply(DX::RenderCommandList& commandList);
   void GetVertexShaderBytecode(
     _Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength);
 
-  HRESULT loadShaders(ID3D11Device* device);
+  HRESULT loadShaders(ID3D11Device* device, ShaderBytecode* bytecode);
 
   // Allocate aligned memory. (Required as we are storing raw XMMATRIX types.
   static void* operator new(size_t size)
@@ -67,24 +92,17 @@ public:
 };
 
 //------------------------------------------------------------------------------
-MyEffect::Impl::Impl(_In_ ID3D11Device* device)
+MyEffect::Impl::Impl(_In_ ID3D11Device* device, ShaderBytecode* bytecode)
+    : m_world(XMMatrixIdentity())
+    , m_view(XMMatrixIdentity())
+    , m_projection(XMMatrixIdentity())
 {
   m_isInit = false;
 
   // Populate Static Data
-  static const XMVECTORF32 modelColor = {1.0f, 0.0f, 0.0f, 1.0f};
-  static const XMVECTORF32 ambientIC  = {0.3f, 0.27f, 0.24f, 1.0f};
-  static const XMVECTORF32 diffuseIC  = {0.7f, 0.7f, 0.7f, 1.0f};
-  static const XMVECTORF32 specularIC = {1.0f, 1.0f, 1.0f, 1.0f};
-  static const XMVECTORF32 lightDir   = {0.6f, 0.0f, -1.0f, 0.0f};
-
-  XMStoreFloat4(&m_staticData.modelColor, modelColor);
-  XMStoreFloat4(&m_staticData.ambientIC, ambientIC);
-  XMStoreFloat4(&m_staticData.diffuseIC, diffuseIC);
-  XMStoreFloat4(&m_staticData.specularIC, specularIC);
-  XMStoreFloat4(&m_staticData.lightDir, lightDir);
-
-  if (FAILED(loadShaders(device)))
+  InitStaticConstants(m_staticData);
+
+  if (FAILED(loadShaders(device, bytecode)))
   {
     return;
   }
@@ -98,8 +116,12 @@ MyEffect::Impl::Impl(_In_ ID3D11Device* device)
     return;
   }
 
+  // Rewritten with WRITE_DISCARD whenever a matrix changes.
   CD3D11_BUFFER_DESC dynamicBufferDesc(
-    sizeof(DynamicConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+    sizeof(DynamicConstantBuffer),
+    D3D11_BIND_CONSTANT_BUFFER,
+    D3D11_USAGE_DYNAMIC,
+    D3D11_CPU_ACCESS_WRITE);
 
   if (FAILED(device->CreateBuffer(
         &dynamicBufferDesc, nullptr, &m_dynamicConstantBuffer)))
@@ -114,43 +136,77 @@ MyEffect::Impl::Impl(_In_ ID3D11Device* device)
 void
 MyEffect::Impl::Apply(_In_ ID3D11DeviceContext* deviceContext)
 {
+  m_applyCommands.Clear();
+  Apply(m_applyCommands);
+  DX::D3D11CommandExecutor(deviceContext).Execute(m_applyCommands);
+}
+
+//------------------------------------------------------------------------------
+void
+MyEffect::Impl::Apply(DX::RenderCommandList& commandList)
+{
+  using DX::RenderCommandList;
+
   if (!m_isInit)
   {
     return;
   }
 
+  ++m_stats.applies;
+
+  const uint32_t bothStages =
+    RenderCommandList::VERTEX_STAGE | RenderCommandList::PIXEL_STAGE;
+
   // Update the static buffer
-  deviceContext->UpdateSubresource(
-    m_staticConstantBuffer.Get(), 0, NULL, &m_staticData, 0, 0);
+  if (m_dirtyFlags & MyEffectDirtyFlags::StaticBuffer)
+  {
+    commandList.UpdateBuffer(
+      m_staticConstantBuffer.Get(),
+      RenderCommandList::UpdateMode::Subresource,
+      &m_staticData,
+      sizeof(m_staticData));
 
-  deviceContext->VSSetConstantBuffers(
-    0, 1, m_staticConstantBuffer.GetAddressOf());
-  deviceContext->PSSetConstantBuffers(
-    0, 1, m_staticConstantBuffer.GetAddressOf());
+    ++m_stats.staticUploads;
+  }
+
+  commandList.SetConstantBuffer(bothStages, 0, m_staticConstantBuffer.Get());
 
   // Update the Dynamic buffer
-  XMStoreFloat4x4(&m_dynamicData.model, XMMatrixTranspose(m_world));
-  XMStoreFloat4x4(&m_dynamicData.view, XMMatrixTranspose(m_view));
-  XMStoreFloat4x4(&m_dynamicData.projection, XMMatrixTranspose(m_projection));
+  if (m_dirtyFlags & MyEffectDirtyFlags::World)
+  {
+    ComputeWorldConstants(m_dynamicData, m_world);
+    ++m_stats.worldInverses;
+  }
+
+  if (m_dirtyFlags & MyEffectDirtyFlags::View)
+  {
+    ComputeViewConstants(m_dynamicData, m_view);
+    ++m_stats.viewInverses;
+  }
 
-  // NB. Missing Transpose intentional. Shader will implicitly transpose this.
-  XMMATRIX worldInverse = XMMatrixInverse(nullptr, m_world);
-  XMStoreFloat4x4(&m_dynamicData.worldInverseTranspose, worldInverse);
+  if (m_dirtyFlags & MyEffectDirtyFlags::Projection)
+  {
+    ComputeProjectionConstants(m_dynamicData, m_projection);
+  }
 
-  // NB. Missing Transpose intentional. Shader will implicitly transpose this.
-  XMMATRIX viewInverse = XMMatrixInverse(nullptr, m_view);
-  XMStoreFloat4(&m_dynamicData.vEyePos, viewInverse.r[3]);
+  if (m_dirtyFlags & MyEffectDirtyFlags::DynamicBuffer)
+  {
+    commandList.UpdateBuffer(
+      m_dynamicConstantBuffer.Get(),
+      RenderCommandList::UpdateMode::Discard,
+      &m_dynamicData,
+      sizeof(m_dynamicData));
 
-  deviceContext->UpdateSubresource(
-    m_dynamicConstantBuffer.Get(), 0, NULL, &m_dynamicData, 0, 0);
+    ++m_stats.dynamicUploads;
+  }
 
-  deviceContext->VSSetConstantBuffers(
-    1, 1, m_dynamicConstantBuffer.GetAddressOf());
-  deviceContext->PSSetConstantBuffers(
-    1, 1, m_dynamicConstantBuffer.GetAddressOf());
+  m_dirtyFlags = 0;
 
-  deviceContext->VSSetShader(m_vertexShader.Get(), nullptr, 0);
-  deviceContext->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+  commandList.SetConstantBuffer(bothStages, 1, m_dynamicConstantBuffer.Get());
+
+  commandList.SetVertexShader(
+    m_instancing ? m_instancedVertexShader.Get() : m_vertexShader.Get());
+  commandList.SetPixelShader(m_pixelShader.Get());
 }
 
 //------------------------------------------------------------------------------
@@ -158,24 +214,40 @@ void
 MyEffect::Impl::GetVertexShaderBytecode(
   _Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength)
 {
-  *pShaderByteCode = m_VSBytecode.empty() ? nullptr : &m_VSBytecode[0];
-  *pByteCodeLength = m_VSBytecode.size();
+  const DX::MappedData& bytecode =
+    m_instancing ? m_instancedVSBytecode : m_VSBytecode;
+  *pShaderByteCode = bytecode.empty() ? nullptr : bytecode.data();
+  *pByteCodeLength = bytecode.size();
 }
 
 //------------------------------------------------------------------------------
 HRESULT
-MyEffect::Impl::loadShaders(ID3D11Device* device)
+MyEffect::Impl::loadShaders(ID3D11Device* device, ShaderBytecode* bytecode)
 {
   try
   {
-    m_VSBytecode = DX::ReadData(L"VertexShader.cso");
+    ShaderBytecode read;
+    if (!bytecode)
+    {
+      read     = ReadShaderBytecode();
+      bytecode = &read;
+    }
+
+    m_VSBytecode = std::move(bytecode->vertexShader);
     DX::ThrowIfFailed(device->CreateVertexShader(
       m_VSBytecode.data(),
       m_VSBytecode.size(),
       nullptr,
       m_vertexShader.ReleaseAndGetAddressOf()));
 
-    auto psData = DX::ReadData(L"PixelShader.cso");
+    m_instancedVSBytecode = std::move(bytecode->instancedVertexShader);
+    DX::ThrowIfFailed(device->CreateVertexShader(
+      m_instancedVSBytecode.data(),
+      m_instancedVSBytecode.size(),
+      nullptr,
+      m_instancedVertexShader.ReleaseAndGetAddressOf()));
+
+    const auto& psData = bytecode->pixelShader;
     DX::ThrowIfFailed(device->CreatePixelShader(
       psData.data(),
       psData.size(),
@@ -191,9 +263,26 @@ MyEffect::Impl::loadShaders(ID3D11Device* device)
 
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+MyEffect::ShaderBytecode
+MyEffect::ReadShaderBytecode()
+{
+  ShaderBytecode bytecode;
+  bytecode.vertexShader          = DX::MapData(L"VertexShader.cso");
+  bytecode.instancedVertexShader = DX::MapData(L"VertexShaderInstanced.cso");
+  bytecode.pixelShader           = DX::MapData(L"PixelShader.cso");
+  return bytecode;
+}
+
 //------------------------------------------------------------------------------
 MyEffect::MyEffect(_In_ ID3D11Device* device)
-    : m_pImpl(new Impl(device))
+    : m_pImpl(new Impl(device, nullptr))
+{
+}
+
+//------------------------------------------------------------------------------
+MyEffect::MyEffect(_In_ ID3D11Device* device, ShaderBytecode bytecode)
+    : m_pImpl(new Impl(device, &bytecode))
 {
 }
 
@@ -221,6 +310,27 @@ MyEffect::isInit() const
   return m_pImpl->m_isInit;
 }
 
+//------------------------------------------------------------------------------
+const MyEffect::ApplyStats&
+MyEffect::GetApplyStats() const
+{
+  return m_pImpl->m_stats;
+}
+
+//------------------------------------------------------------------------------
+void
+MyEffect::SetInstancing(bool value)
+{
+  m_pImpl->m_instancing = value;
+}
+
+//------------------------------------------------------------------------------
+bool
+MyEffect::GetInstancing() const
+{
+  return m_pImpl->m_instancing;
+}
+
 //------------------------------------------------------------------------------
 void
 MyEffect::Apply(_In_ ID3D11DeviceContext* deviceContext)
@@ -228,6 +338,13 @@ MyEffect::Apply(_In_ ID3D11DeviceContext* deviceContext)
   m_pImpl->Apply(deviceContext);
 }
 
+//------------------------------------------------------------------------------
+void
+MyEffect::Apply(DX::RenderCommandList& commandList)
+{
+  m_pImpl->Apply(commandList);
+}
+
 //------------------------------------------------------------------------------
 void
 MyEffect::GetVertexShaderBytecode(
@@ -241,6 +358,8 @@ void XM_CALLCONV
 MyEffect::SetWorld(FXMMATRIX value)
 {
   m_pImpl->m_world = value;
+  m_pImpl->m_dirtyFlags |=
+    MyEffectDirtyFlags::World | MyEffectDirtyFlags::DynamicBuffer;
 }
 
 //------------------------------------------------------------------------------
@@ -248,6 +367,8 @@ void XM_CALLCONV
 MyEffect::SetView(FXMMATRIX value)
 {
   m_pImpl->m_view = value;
+  m_pImpl->m_dirtyFlags |=
+    MyEffectDirtyFlags::View | MyEffectDirtyFlags::DynamicBuffer;
 }
 
 //------------------------------------------------------------------------------
@@ -255,6 +376,8 @@ void XM_CALLCONV
 MyEffect::SetProjection(FXMMATRIX value)
 {
   m_pImpl->m_projection = value;
+  m_pImpl->m_dirtyFlags |=
+    MyEffectDirtyFlags::Projection | MyEffectDirtyFlags::DynamicBuffer;
 }
 
 //------------------------------------------------------------------------------
@@ -264,6 +387,9 @@ MyEffect::SetMatrices(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection)
   m_pImpl->m_world      = world;
   m_pImpl->m_view       = view;
   m_pImpl->m_projection = projection;
+  m_pImpl->m_dirtyFlags |= MyEffectDirtyFlags::World | MyEffectDirtyFlags::View
+                           | MyEffectDirtyFlags::Projection
+                           | MyEffectDirtyFlags::DynamicBuffer;
 }
 
 //------------------------------------------------------------------------------
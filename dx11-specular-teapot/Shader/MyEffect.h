@@ -2,11 +2,33 @@
 
 #include "pch.h"
 
+#include "MappedData.h"
+
+namespace DX
+{
+class RenderCommandList;
+}
+
 //------------------------------------------------------------------------------
 class MyEffect : public DirectX::IEffect, public DirectX::IEffectMatrices
 {
 public:
+  // Compiled shaders, as built to VertexShader.cso, VertexShaderInstanced.cso
+  // and PixelShader.cso, mapped rather than copied into memory.
+  struct ShaderBytecode
+  {
+    DX::MappedData vertexShader;
+    DX::MappedData instancedVertexShader;
+    DX::MappedData pixelShader;
+  };
+
+  // Maps the .cso files, throwing if one can't be opened. Makes no device
+  // calls, so loading can run on another thread ahead of construction.
+  static ShaderBytecode ReadShaderBytecode();
+
+  // Reads the shaders itself; isInit() is false if that fails.
   explicit MyEffect(_In_ ID3D11Device* device);
+  MyEffect(_In_ ID3D11Device* device, ShaderBytecode bytecode);
 
   MyEffect(MyEffect&& moveFrom);
   MyEffect& operator=(MyEffect&& moveFrom);
@@ -18,6 +40,34 @@ public:
 
   bool isInit() const;
 
+  // Work done by Apply over the effect's lifetime. Constant buffers are only
+  // uploaded, and derived values recomputed, when their inputs change.
+  struct ApplyStats
+  {
+    uint64_t applies        = 0;
+    uint64_t staticUploads  = 0;
+    uint64_t dynamicUploads = 0;
+    uint64_t worldInverses  = 0;
+    uint64_t viewInverses   = 0;
+  };
+  const ApplyStats& GetApplyStats() const;
+
+  // Takes the world matrices from a per-instance vertex stream instead of
+  // SetWorld, for GeometricPrimitive::DrawInstanced. Changes the vertex shader
+  // bytecode, so input layouts must be created after setting this.
+  void SetInstancing(bool value);
+  bool GetInstancing() const;
+
+  // Input layout for instanced drawing: GeometricPrimitive::VertexType in
+  // slot 0 and InstanceData (see MyEffectConstants.h) in slot 1.
+  static const UINT InstancedInputElementCount = 9;
+  static const D3D11_INPUT_ELEMENT_DESC
+    InstancedInputElements[InstancedInputElementCount];
+
+  // Records what Apply would do to a context, for executing later. Apply
+  // itself records into a list of its own and executes it straight away.
+  void Apply(DX::RenderCommandList& commandList);
+
   // IEffect
   void __cdecl Apply(_In_ ID3D11DeviceContext* deviceContext) override;
   void __cdecl GetVertexShaderBytecode(
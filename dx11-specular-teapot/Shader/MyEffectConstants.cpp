@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "MyEffectConstants.h"
+
+using namespace DirectX;
+
+//------------------------------------------------------------------------------
+void
+InitStaticConstants(StaticConstantBuffer& data)
+{
+  static const XMVECTORF32 modelColor = {1.0f, 0.0f, 0.0f, 1.0f};
+  static const XMVECTORF32 ambientIC  = {0.3f, 0.27f, 0.24f, 1.0f};
+  static const XMVECTORF32 diffuseIC  = {0.7f, 0.7f, 0.7f, 1.0f};
+  static const XMVECTORF32 specularIC = {1.0f, 1.0f, 1.0f, 1.0f};
+  static const XMVECTORF32 lightDir   = {0.6f, 0.0f, -1.0f, 0.0f};
+
+  XMStoreFloat4(&data.modelColor, modelColor);
+  XMStoreFloat4(&data.ambientIC, ambientIC);
+  XMStoreFloat4(&data.diffuseIC, diffuseIC);
+  XMStoreFloat4(&data.specularIC, specularIC);
+  XMStoreFloat4(&data.lightDir, lightDir);
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+ComputeDynamicConstants(
+  DynamicConstantBuffer& data,
+  FXMMATRIX world,
+  CXMMATRIX view,
+  CXMMATRIX projection)
+{
+  ComputeWorldConstants(data, world);
+  ComputeViewConstants(data, view);
+  ComputeProjectionConstants(data, projection);
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+ComputeWorldConstants(DynamicConstantBuffer& data, FXMMATRIX world)
+{
+  XMStoreFloat4x4(&data.model, XMMatrixTranspose(world));
+
+  // NB. Missing Transpose intentional. Shader will implicitly transpose this.
+  XMMATRIX worldInverse = XMMatrixInverse(nullptr, world);
+  XMStoreFloat4x4(&data.worldInverseTranspose, worldInverse);
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+ComputeViewConstants(DynamicConstantBuffer& data, FXMMATRIX view)
+{
+  XMStoreFloat4x4(&data.view, XMMatrixTranspose(view));
+
+  // NB. Missing Transpose intentional. Shader will implicitly transpose this.
+  XMMATRIX viewInverse = XMMatrixInverse(nullptr, view);
+  XMStoreFloat4(&data.vEyePos, viewInverse.r[3]);
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+ComputeProjectionConstants(DynamicConstantBuffer& data, FXMMATRIX projection)
+{
+  XMStoreFloat4x4(&data.projection, XMMatrixTranspose(projection));
+}
+
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+PackInstance(InstanceData& data, FXMMATRIX world)
+{
+  XMMATRIX transposed = XMMatrixTranspose(world);
+  XMStoreFloat4(&data.world[0], transposed.r[0]);
+  XMStoreFloat4(&data.world[1], transposed.r[1]);
+  XMStoreFloat4(&data.world[2], transposed.r[2]);
+
+  // NB. Missing Transpose intentional, as for the constant buffer.
+  XMMATRIX worldInverse = XMMatrixInverse(nullptr, world);
+  XMStoreFloat3(&data.worldInverseTranspose[0], worldInverse.r[0]);
+  XMStoreFloat3(&data.worldInverseTranspose[1], worldInverse.r[1]);
+  XMStoreFloat3(&data.worldInverseTranspose[2], worldInverse.r[2]);
+}
+
+//------------------------------------------------------------------------------
+XMMATRIX
+UnpackInstanceWorld(const InstanceData& data)
+{
+  XMMATRIX transposed(
+    XMLoadFloat4(&data.world[0]),
+    XMLoadFloat4(&data.world[1]),
+    XMLoadFloat4(&data.world[2]),
+    g_XMIdentityR3);
+  return XMMatrixTranspose(transposed);
+}
+
+//------------------------------------------------------------------------------
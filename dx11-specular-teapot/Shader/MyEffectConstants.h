@@ -0,0 +1,63 @@
+#pragma once
+
+#include "pch.h"
+
+//------------------------------------------------------------------------------
+// Constant buffer layouts used by MyEffect. These must match the cbuffer
+// declarations in VertexShader.hlsl and PixelShader.hlsl, and are shared with
+// the CPU renderer so both paths shade with identical inputs.
+//------------------------------------------------------------------------------
+struct StaticConstantBuffer
+{
+  DirectX::XMFLOAT4 modelColor;
+  DirectX::XMFLOAT4 ambientIC;
+  DirectX::XMFLOAT4 diffuseIC;
+  DirectX::XMFLOAT4 specularIC;
+  DirectX::XMFLOAT4 lightDir;
+};
+
+//------------------------------------------------------------------------------
+struct DynamicConstantBuffer
+{
+  DirectX::XMFLOAT4X4 model;
+  DirectX::XMFLOAT4X4 view;
+  DirectX::XMFLOAT4X4 projection;
+  DirectX::XMFLOAT4X4 worldInverseTranspose;
+  DirectX::XMFLOAT4 vEyePos;
+};
+
+//------------------------------------------------------------------------------
+// Per-instance vertex data for VertexShaderInstanced.hlsl: the first three
+// rows of the transposed world matrix (the fourth is always 0, 0, 0, 1) and
+// the 3x3 part of the world inverse transpose.
+struct InstanceData
+{
+  DirectX::XMFLOAT4 world[3];
+  DirectX::XMFLOAT3 worldInverseTranspose[3];
+};
+
+//------------------------------------------------------------------------------
+// Fills in the light and material constants.
+void InitStaticConstants(StaticConstantBuffer& data);
+
+// Computes the per-draw constants from the current matrices.
+void XM_CALLCONV ComputeDynamicConstants(
+  DynamicConstantBuffer& data,
+  DirectX::FXMMATRIX world,
+  DirectX::CXMMATRIX view,
+  DirectX::CXMMATRIX projection);
+
+// Compute the parts of the per-draw constants that depend on one matrix, for
+// callers that track which matrices changed.
+void XM_CALLCONV
+ComputeWorldConstants(DynamicConstantBuffer& data, DirectX::FXMMATRIX world);
+void XM_CALLCONV
+ComputeViewConstants(DynamicConstantBuffer& data, DirectX::FXMMATRIX view);
+void XM_CALLCONV ComputeProjectionConstants(
+  DynamicConstantBuffer& data, DirectX::FXMMATRIX projection);
+
+// Packs an affine world matrix for instanced drawing, and recovers it.
+void XM_CALLCONV PackInstance(InstanceData& data, DirectX::FXMMATRIX world);
+DirectX::XMMATRIX UnpackInstanceWorld(const InstanceData& data);
+
+//------------------------------------------------------------------------------
@@ -22,6 +22,13 @@ public:
   {
   }
 
+  Impl(_In_ ID3D11Device* device, MyEffect::ShaderBytecode&& shaderBytecode)
+      : m_baseFactory(device)
+      , m_device(device)
+      , m_effect(std::make_shared<MyEffect>(device, std::move(shaderBytecode)))
+  {
+  }
+
   std::shared_ptr<IEffect> CreateEffect(
     _In_ IEffectFactory* factory,
     _In_ const IEffectFactory::EffectInfo& info,
@@ -79,6 +86,14 @@ MyEffectFactory::MyEffectFactory(_In_ ID3D11Device* device)
 {
 }
 
+//------------------------------------------------------------------------------
+MyEffectFactory::MyEffectFactory(
+  _In_ ID3D11Device* device, MyEffect::ShaderBytecode shaderBytecode)
+    : pImpl(std::make_unique<MyEffectFactory::Impl>(
+        device, std::move(shaderBytecode)))
+{
+}
+
 //------------------------------------------------------------------------------
 MyEffectFactory::~MyEffectFactory() {}
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "pch.h"
+#include "MyEffect.h"
 #include <DirectXMath.h>
 #include <memory>
 
@@ -9,6 +10,10 @@ class MyEffectFactory : public DirectX::IEffectFactory
 {
 public:
   explicit MyEffectFactory(_In_ ID3D11Device* device);
+
+  // Creates its effect from shaders already read; see MyEffect.
+  MyEffectFactory(
+    _In_ ID3D11Device* device, MyEffect::ShaderBytecode shaderBytecode);
   MyEffectFactory(MyEffectFactory&& moveFrom);
   MyEffectFactory& operator=(MyEffectFactory&& moveFrom);
 
@@ -0,0 +1,80 @@
+cbuffer StaticBuffer : register(b0)
+{
+  float4 modelColor;
+  float4 ambientIC;
+  float4 diffuseIC;
+  float4 specularIC;
+  float4 lightDir;
+};
+
+//------------------------------------------------------------------------------
+cbuffer DynamicBuffer : register(b1)
+{
+  matrix model;
+  matrix view;
+  matrix projection;
+  matrix worldInverseTranspose;
+  float4 eyePos;
+};
+
+//------------------------------------------------------------------------------
+// Per-vertex data from the mesh in slot 0, and per-instance data (see
+// InstanceData in MyEffectConstants.h) in slot 1. The instance matrices
+// replace the model and worldInverseTranspose constants.
+//------------------------------------------------------------------------------
+struct VertexShaderInput
+{
+  float3 pos : SV_Position;
+  float3 normal : NORMAL;
+  float2 texCoord : TEXCOORD;
+
+  float4 world0 : WORLD0;
+  float4 world1 : WORLD1;
+  float4 world2 : WORLD2;
+  float3 worldInverseTranspose0 : WORLDIT0;
+  float3 worldInverseTranspose1 : WORLDIT1;
+  float3 worldInverseTranspose2 : WORLDIT2;
+};
+
+//------------------------------------------------------------------------------
+// Per-pixel color data passed through the pixel shader.
+//------------------------------------------------------------------------------
+struct PixelShaderInput
+{
+  float4 pos : SV_POSITION;
+  float3 normal : NORMAL;
+  float3 eyeRay : TEXCOORD2;
+};
+
+//------------------------------------------------------------------------------
+// VertexShader.hlsl, with the world transform taken from the instance.
+//------------------------------------------------------------------------------
+PixelShaderInput
+main(VertexShaderInput input)
+{
+  PixelShaderInput output;
+  float4 pos = float4(input.pos, 1.0f);
+
+  float3x4 instanceWorld =
+    float3x4(input.world0, input.world1, input.world2);
+  float3x3 instanceWorldInverseTranspose = float3x3(
+    input.worldInverseTranspose0,
+    input.worldInverseTranspose1,
+    input.worldInverseTranspose2);
+
+  // Transform the vertex position into projected space.
+  float4 worldPos = float4(mul(instanceWorld, pos), 1.0f);
+  pos             = mul(worldPos, view);
+  pos             = mul(pos, projection);
+  output.pos      = pos;
+
+  // transform the normal
+  output.normal = mul(instanceWorldInverseTranspose, input.normal);
+
+  // for specular light
+  output.eyeRay = (eyePos - worldPos).xyz;
+
+  return output;
+}
+
+//------------------------------------------------------------------------------
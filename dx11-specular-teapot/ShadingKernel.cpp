@@ -0,0 +1,230 @@
+#include "pch.h"
+#include "ShadingKernel.h"
+
+#include <cmath>
+#include <intrin.h>
+
+using namespace DirectX;
+
+//------------------------------------------------------------------------------
+namespace
+{
+inline float
+Saturate(float v)
+{
+  // NaN saturates to 0, as on the GPU.
+  return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+}
+
+//------------------------------------------------------------------------------
+inline uint32_t
+ToByte(float v)
+{
+  return static_cast<uint32_t>(v * 255.0f + 0.5f);
+}
+
+//------------------------------------------------------------------------------
+inline void
+Normalize(float& x, float& y, float& z)
+{
+  float invLength = 1.0f / std::sqrt(x * x + y * y + z * z);
+  x *= invLength;
+  y *= invLength;
+  z *= invLength;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Reference implementation; the vector paths follow the same steps.
+//------------------------------------------------------------------------------
+void
+ShadingKernelImpl::ShadeScalar(
+  const Constants& c, const Streams& in, size_t count, const Output& out)
+{
+  const float lx = c.lightRay[0];
+  const float ly = c.lightRay[1];
+  const float lz = c.lightRay[2];
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    float nx = in.normal[0][i];
+    float ny = in.normal[1][i];
+    float nz = in.normal[2][i];
+    Normalize(nx, ny, nz);
+
+    float vx = c.eyePos[0] - in.worldPos[0][i];
+    float vy = c.eyePos[1] - in.worldPos[1][i];
+    float vz = c.eyePos[2] - in.worldPos[2][i];
+    Normalize(vx, vy, vz);
+
+    float cosLight = nx * lx + ny * ly + nz * lz;
+    float diffuse  = Saturate(cosLight);
+
+    // R = 2(n.l)n -l
+    float rx = 2.0f * cosLight * nx - lx;
+    float ry = 2.0f * cosLight * ny - ly;
+    float rz = 2.0f * cosLight * nz - lz;
+    Normalize(rx, ry, rz);
+
+    // Spec = pow(R.V, 32), as five squarings.
+    float specular = Saturate(rx * vx + ry * vy + rz * vz);
+    for (int n = 0; n < 5; ++n)
+    {
+      specular *= specular;
+    }
+
+    float rgba[4];
+    for (int ch = 0; ch < 4; ++ch)
+    {
+      rgba[ch] = Saturate(
+        c.ambientIC[ch] + diffuse * c.diffuseIC[ch]
+        + specular * c.specularIC[ch]);
+    }
+
+    if (out.colors)
+    {
+      out.colors[i] = (ToByte(rgba[3]) << 24) | (ToByte(rgba[0]) << 16)
+                      | (ToByte(rgba[1]) << 8) | ToByte(rgba[2]);
+    }
+    if (out.rgba[0])
+    {
+      for (int ch = 0; ch < 4; ++ch)
+      {
+        out.rgba[ch][i] = rgba[ch];
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+ShadingKernel::Isa
+ShadingKernel::DetectIsa()
+{
+  int info[4];
+  __cpuid(info, 0);
+  const int maxLeaf = info[0];
+
+  __cpuid(info, 1);
+  const bool ssse3   = (info[2] & (1 << 9)) != 0;
+  const bool fma     = (info[2] & (1 << 12)) != 0;
+  const bool sse41   = (info[2] & (1 << 19)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx     = (info[2] & (1 << 28)) != 0;
+
+  bool avx2 = false;
+  if (maxLeaf >= 7 && osxsave && avx && fma)
+  {
+    // The OS must save the upper halves of the YMM registers.
+    const bool ymmState = (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(info, 7, 0);
+    avx2 = ymmState && (info[1] & (1 << 5)) != 0;
+  }
+
+  if (avx2)
+  {
+    return Isa::AVX2;
+  }
+  if (sse41 && ssse3)
+  {
+    return Isa::SSE4;
+  }
+  return Isa::Scalar;
+}
+
+//------------------------------------------------------------------------------
+const char*
+ShadingKernel::GetIsaName(Isa isa)
+{
+  switch (isa)
+  {
+    case Isa::SSE4: return "sse4";
+    case Isa::AVX2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+//------------------------------------------------------------------------------
+ShadingKernel::ShadingKernel(const StaticConstantBuffer& material, Isa isa)
+    : m_constants()
+    , m_isa(isa)
+{
+  XMVECTOR lightDir = XMLoadFloat4(&material.lightDir);
+  XMFLOAT3 lightRay;
+  XMStoreFloat3(&lightRay, XMVector3Normalize(XMVectorNegate(lightDir)));
+
+  m_constants.lightRay[0] = lightRay.x;
+  m_constants.lightRay[1] = lightRay.y;
+  m_constants.lightRay[2] = lightRay.z;
+  memcpy(m_constants.ambientIC, &material.ambientIC, sizeof(XMFLOAT4));
+  memcpy(m_constants.diffuseIC, &material.diffuseIC, sizeof(XMFLOAT4));
+  memcpy(m_constants.specularIC, &material.specularIC, sizeof(XMFLOAT4));
+}
+
+//------------------------------------------------------------------------------
+void
+ShadingKernel::SetDrawConstants(const DynamicConstantBuffer& draw)
+{
+  m_constants.eyePos[0] = draw.vEyePos.x;
+  m_constants.eyePos[1] = draw.vEyePos.y;
+  m_constants.eyePos[2] = draw.vEyePos.z;
+}
+
+//------------------------------------------------------------------------------
+size_t
+ShadingKernel::GetPacketSize() const
+{
+  switch (m_isa)
+  {
+    case Isa::SSE4: return 4;
+    case Isa::AVX2: return 8;
+    default: return 1;
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+ShadingKernel::Shade(const Fragments& in, size_t count, uint32_t* colors) const
+{
+  ShadingKernelImpl::Output out = {};
+  out.colors                    = colors;
+  Run(in, count, out);
+}
+
+//------------------------------------------------------------------------------
+void
+ShadingKernel::ShadeFloat(
+  const Fragments& in, size_t count, float* rgba[4]) const
+{
+  ShadingKernelImpl::Output out = {};
+  for (int ch = 0; ch < 4; ++ch)
+  {
+    out.rgba[ch] = rgba[ch];
+  }
+  Run(in, count, out);
+}
+
+//------------------------------------------------------------------------------
+void
+ShadingKernel::Run(
+  const Fragments& in,
+  size_t count,
+  const ShadingKernelImpl::Output& out) const
+{
+  switch (m_isa)
+  {
+    case Isa::AVX2:
+      ShadingKernelImpl::ShadeAVX2(m_constants, in, count, out);
+      break;
+
+    case Isa::SSE4:
+      ShadingKernelImpl::ShadeSSE4(m_constants, in, count, out);
+      break;
+
+    default:
+      ShadingKernelImpl::ShadeScalar(m_constants, in, count, out);
+      break;
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.h"
+#include "ShadingKernelImpl.h"
+#include "Shader/MyEffectConstants.h"
+
+//------------------------------------------------------------------------------
+// CPU version of PixelShader.hlsl that shades fragments in packets of 4 (SSE4)
+// or 8 (AVX2), with a scalar fallback. Fragments are passed as separate
+// x/y/z arrays of interpolated world-space normals and positions; the
+// material, light and eye position come from the same constant buffers that
+// MyEffect uploads.
+//------------------------------------------------------------------------------
+class ShadingKernel
+{
+public:
+  enum class Isa
+  {
+    Scalar,
+    SSE4,
+    AVX2,
+  };
+
+  // normal[0..2] and worldPos[0..2] each point at count floats.
+  using Fragments = ShadingKernelImpl::Streams;
+
+  // Best instruction set supported by both the CPU and the OS.
+  static Isa DetectIsa();
+  static const char* GetIsaName(Isa isa);
+
+  explicit ShadingKernel(
+    const StaticConstantBuffer& material, Isa isa = DetectIsa());
+
+  // Takes the eye position of the draw being shaded.
+  void SetDrawConstants(const DynamicConstantBuffer& draw);
+
+  Isa GetIsa() const { return m_isa; }
+  size_t GetPacketSize() const;
+
+  // Shades count fragments into B8G8R8A8 colours.
+  void Shade(const Fragments& in, size_t count, uint32_t* colors) const;
+
+  // As Shade, but returns the saturated colours before quantization, one array
+  // per channel. Used to measure the accuracy of the vector paths.
+  void ShadeFloat(const Fragments& in, size_t count, float* rgba[4]) const;
+
+private:
+  void Run(
+    const Fragments& in,
+    size_t count,
+    const ShadingKernelImpl::Output& out) const;
+
+  ShadingKernelImpl::Constants m_constants;
+  Isa m_isa;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,202 @@
+//
+// ShadingKernelAVX2.cpp - 8-wide AVX2/FMA path of ShadingKernel
+//
+// Built without the precompiled header; see ShadingKernelImpl.h.
+//
+
+#include "ShadingKernelImpl.h"
+
+#include <immintrin.h>
+
+using namespace ShadingKernelImpl;
+
+namespace
+{
+constexpr size_t WIDTH = 8;
+
+//------------------------------------------------------------------------------
+struct Packet
+{
+  __m256 normal[3];
+  __m256 worldPos[3];
+};
+
+//------------------------------------------------------------------------------
+inline __m256
+Dot3(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+{
+  __m256 r = _mm256_mul_ps(ax, bx);
+  r        = _mm256_fmadd_ps(ay, by, r);
+  return _mm256_fmadd_ps(az, bz, r);
+}
+
+//------------------------------------------------------------------------------
+inline __m256
+Saturate(__m256 v)
+{
+  // VMAXPS returns the second operand for NaN, so NaN saturates to 0.
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one  = _mm256_set1_ps(1.0f);
+  return _mm256_min_ps(_mm256_max_ps(v, zero), one);
+}
+
+//------------------------------------------------------------------------------
+inline void
+Normalize(__m256& x, __m256& y, __m256& z)
+{
+  __m256 invLength = _mm256_div_ps(
+    _mm256_set1_ps(1.0f), _mm256_sqrt_ps(Dot3(x, y, z, x, y, z)));
+
+  x = _mm256_mul_ps(x, invLength);
+  y = _mm256_mul_ps(y, invLength);
+  z = _mm256_mul_ps(z, invLength);
+}
+
+//------------------------------------------------------------------------------
+// Mirrors ShadeScalar, with fused multiply-adds.
+inline void
+ShadePacket(const Constants& c, const Packet& p, __m256 rgba[4])
+{
+  const __m256 lx = _mm256_set1_ps(c.lightRay[0]);
+  const __m256 ly = _mm256_set1_ps(c.lightRay[1]);
+  const __m256 lz = _mm256_set1_ps(c.lightRay[2]);
+
+  __m256 nx = p.normal[0];
+  __m256 ny = p.normal[1];
+  __m256 nz = p.normal[2];
+  Normalize(nx, ny, nz);
+
+  __m256 vx = _mm256_sub_ps(_mm256_set1_ps(c.eyePos[0]), p.worldPos[0]);
+  __m256 vy = _mm256_sub_ps(_mm256_set1_ps(c.eyePos[1]), p.worldPos[1]);
+  __m256 vz = _mm256_sub_ps(_mm256_set1_ps(c.eyePos[2]), p.worldPos[2]);
+  Normalize(vx, vy, vz);
+
+  __m256 cosLight = Dot3(nx, ny, nz, lx, ly, lz);
+  __m256 diffuse  = Saturate(cosLight);
+
+  // R = 2(n.l)n -l
+  __m256 twoCos = _mm256_add_ps(cosLight, cosLight);
+  __m256 rx     = _mm256_fmsub_ps(twoCos, nx, lx);
+  __m256 ry     = _mm256_fmsub_ps(twoCos, ny, ly);
+  __m256 rz     = _mm256_fmsub_ps(twoCos, nz, lz);
+  Normalize(rx, ry, rz);
+
+  __m256 specular = Saturate(Dot3(rx, ry, rz, vx, vy, vz));
+  for (int n = 0; n < 5; ++n)
+  {
+    specular = _mm256_mul_ps(specular, specular);
+  }
+
+  for (int ch = 0; ch < 4; ++ch)
+  {
+    __m256 diffuseIC  = _mm256_set1_ps(c.diffuseIC[ch]);
+    __m256 specularIC = _mm256_set1_ps(c.specularIC[ch]);
+
+    __m256 color = _mm256_set1_ps(c.ambientIC[ch]);
+    color        = _mm256_fmadd_ps(diffuse, diffuseIC, color);
+    color        = _mm256_fmadd_ps(specular, specularIC, color);
+    rgba[ch]     = Saturate(color);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Converts saturated RGBA to eight B8G8R8A8 pixels. The packs and the shuffle
+// work within 128-bit lanes, so each lane ends up holding four whole pixels in
+// order.
+inline __m256i
+PackColors(const __m256 rgba[4])
+{
+  const __m256 scale = _mm256_set1_ps(255.0f);
+  const __m256 half  = _mm256_set1_ps(0.5f);
+
+  __m256i channel[4];
+  for (int ch = 0; ch < 4; ++ch)
+  {
+    channel[ch] = _mm256_cvttps_epi32(_mm256_fmadd_ps(rgba[ch], scale, half));
+  }
+
+  // Per lane: b0..b3 g0..g3 r0..r3 a0..a3, then interleave into pixels.
+  __m256i bg    = _mm256_packus_epi32(channel[2], channel[1]);
+  __m256i ra    = _mm256_packus_epi32(channel[0], channel[3]);
+  __m256i bytes = _mm256_packus_epi16(bg, ra);
+  return _mm256_shuffle_epi8(
+    bytes,
+    _mm256_setr_epi8(
+      0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+      0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+ShadingKernelImpl::ShadeAVX2(
+  const Constants& c, const Streams& in, size_t count, const Output& out)
+{
+  for (size_t i = 0; i < count; i += WIDTH)
+  {
+    const size_t n = count - i < WIDTH ? count - i : WIDTH;
+
+    Packet p;
+    if (n == WIDTH)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        p.normal[axis]   = _mm256_loadu_ps(in.normal[axis] + i);
+        p.worldPos[axis] = _mm256_loadu_ps(in.worldPos[axis] + i);
+      }
+    }
+    else
+    {
+      // Pad the last packet by repeating its final fragment.
+      alignas(32) float normal[3][WIDTH];
+      alignas(32) float worldPos[3][WIDTH];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        for (size_t k = 0; k < WIDTH; ++k)
+        {
+          size_t src        = i + (k < n ? k : n - 1);
+          normal[axis][k]   = in.normal[axis][src];
+          worldPos[axis][k] = in.worldPos[axis][src];
+        }
+        p.normal[axis]   = _mm256_load_ps(normal[axis]);
+        p.worldPos[axis] = _mm256_load_ps(worldPos[axis]);
+      }
+    }
+
+    __m256 rgba[4];
+    ShadePacket(c, p, rgba);
+
+    if (out.colors)
+    {
+      __m256i colors = PackColors(rgba);
+      if (n == WIDTH)
+      {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out.colors + i), colors);
+      }
+      else
+      {
+        alignas(32) uint32_t packed[WIDTH];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(packed), colors);
+        for (size_t k = 0; k < n; ++k)
+        {
+          out.colors[i + k] = packed[k];
+        }
+      }
+    }
+
+    if (out.rgba[0])
+    {
+      for (int ch = 0; ch < 4; ++ch)
+      {
+        alignas(32) float values[WIDTH];
+        _mm256_store_ps(values, rgba[ch]);
+        for (size_t k = 0; k < n; ++k)
+        {
+          out.rgba[ch][i + k] = values[k];
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+//
+// ShadingKernelImpl.h - Instruction set specific halves of ShadingKernel
+//
+// Included by the SSE4 and AVX2 translation units, which are compiled without
+// the precompiled header so that each can use its own /arch setting without
+// leaking wide instructions into inline functions shared with the rest of the
+// program. Keep this header free of DirectXMath and Windows types.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ShadingKernelImpl
+{
+// PixelShader.hlsl constants, pre-processed for the kernels.
+struct Constants
+{
+  float lightRay[3];    // normalize(-lightDir)
+  float eyePos[3];      // DynamicConstantBuffer::vEyePos
+  float ambientIC[4];
+  float diffuseIC[4];
+  float specularIC[4];
+};
+
+// Structure-of-arrays fragment streams; every pointer addresses count floats.
+struct Streams
+{
+  const float* normal[3];
+  const float* worldPos[3];
+};
+
+// Either output may be null. Float colours are saturated RGBA.
+struct Output
+{
+  uint32_t* colors;
+  float* rgba[4];
+};
+
+void
+ShadeScalar(
+  const Constants& constants,
+  const Streams& in,
+  size_t count,
+  const Output& out);
+
+void
+ShadeSSE4(
+  const Constants& constants,
+  const Streams& in,
+  size_t count,
+  const Output& out);
+
+void
+ShadeAVX2(
+  const Constants& constants,
+  const Streams& in,
+  size_t count,
+  const Output& out);
+}
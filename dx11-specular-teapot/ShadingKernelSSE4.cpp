@@ -0,0 +1,196 @@
+//
+// ShadingKernelSSE4.cpp - 4-wide SSE4.1 path of ShadingKernel
+//
+// Built without the precompiled header; see ShadingKernelImpl.h.
+//
+
+#include "ShadingKernelImpl.h"
+
+#include <smmintrin.h>
+
+using namespace ShadingKernelImpl;
+
+namespace
+{
+constexpr size_t WIDTH = 4;
+
+//------------------------------------------------------------------------------
+struct Packet
+{
+  __m128 normal[3];
+  __m128 worldPos[3];
+};
+
+//------------------------------------------------------------------------------
+inline __m128
+Dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+  __m128 r = _mm_mul_ps(ax, bx);
+  r        = _mm_add_ps(r, _mm_mul_ps(ay, by));
+  return _mm_add_ps(r, _mm_mul_ps(az, bz));
+}
+
+//------------------------------------------------------------------------------
+inline __m128
+Saturate(__m128 v)
+{
+  // MAXPS returns the second operand for NaN, so NaN saturates to 0.
+  return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+//------------------------------------------------------------------------------
+inline void
+Normalize(__m128& x, __m128& y, __m128& z)
+{
+  __m128 invLength = _mm_div_ps(
+    _mm_set1_ps(1.0f), _mm_sqrt_ps(Dot3(x, y, z, x, y, z)));
+
+  x = _mm_mul_ps(x, invLength);
+  y = _mm_mul_ps(y, invLength);
+  z = _mm_mul_ps(z, invLength);
+}
+
+//------------------------------------------------------------------------------
+// Mirrors ShadeScalar.
+inline void
+ShadePacket(const Constants& c, const Packet& p, __m128 rgba[4])
+{
+  const __m128 lx = _mm_set1_ps(c.lightRay[0]);
+  const __m128 ly = _mm_set1_ps(c.lightRay[1]);
+  const __m128 lz = _mm_set1_ps(c.lightRay[2]);
+
+  __m128 nx = p.normal[0];
+  __m128 ny = p.normal[1];
+  __m128 nz = p.normal[2];
+  Normalize(nx, ny, nz);
+
+  __m128 vx = _mm_sub_ps(_mm_set1_ps(c.eyePos[0]), p.worldPos[0]);
+  __m128 vy = _mm_sub_ps(_mm_set1_ps(c.eyePos[1]), p.worldPos[1]);
+  __m128 vz = _mm_sub_ps(_mm_set1_ps(c.eyePos[2]), p.worldPos[2]);
+  Normalize(vx, vy, vz);
+
+  __m128 cosLight = Dot3(nx, ny, nz, lx, ly, lz);
+  __m128 diffuse  = Saturate(cosLight);
+
+  // R = 2(n.l)n -l
+  __m128 twoCos = _mm_add_ps(cosLight, cosLight);
+  __m128 rx     = _mm_sub_ps(_mm_mul_ps(twoCos, nx), lx);
+  __m128 ry     = _mm_sub_ps(_mm_mul_ps(twoCos, ny), ly);
+  __m128 rz     = _mm_sub_ps(_mm_mul_ps(twoCos, nz), lz);
+  Normalize(rx, ry, rz);
+
+  __m128 specular = Saturate(Dot3(rx, ry, rz, vx, vy, vz));
+  for (int n = 0; n < 5; ++n)
+  {
+    specular = _mm_mul_ps(specular, specular);
+  }
+
+  for (int ch = 0; ch < 4; ++ch)
+  {
+    __m128 diffuseIC  = _mm_set1_ps(c.diffuseIC[ch]);
+    __m128 specularIC = _mm_set1_ps(c.specularIC[ch]);
+
+    __m128 color = _mm_set1_ps(c.ambientIC[ch]);
+    color        = _mm_add_ps(color, _mm_mul_ps(diffuse, diffuseIC));
+    color        = _mm_add_ps(color, _mm_mul_ps(specular, specularIC));
+    rgba[ch]     = Saturate(color);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Converts saturated RGBA to four B8G8R8A8 pixels.
+inline __m128i
+PackColors(const __m128 rgba[4])
+{
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half  = _mm_set1_ps(0.5f);
+
+  __m128i channel[4];
+  for (int ch = 0; ch < 4; ++ch)
+  {
+    channel[ch] =
+      _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(rgba[ch], scale), half));
+  }
+
+  // b0..b3 g0..g3 r0..r3 a0..a3, then interleave into pixels.
+  __m128i bg    = _mm_packus_epi32(channel[2], channel[1]);
+  __m128i ra    = _mm_packus_epi32(channel[0], channel[3]);
+  __m128i bytes = _mm_packus_epi16(bg, ra);
+  return _mm_shuffle_epi8(
+    bytes, _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+ShadingKernelImpl::ShadeSSE4(
+  const Constants& c, const Streams& in, size_t count, const Output& out)
+{
+  for (size_t i = 0; i < count; i += WIDTH)
+  {
+    const size_t n = count - i < WIDTH ? count - i : WIDTH;
+
+    Packet p;
+    if (n == WIDTH)
+    {
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        p.normal[axis]   = _mm_loadu_ps(in.normal[axis] + i);
+        p.worldPos[axis] = _mm_loadu_ps(in.worldPos[axis] + i);
+      }
+    }
+    else
+    {
+      // Pad the last packet by repeating its final fragment.
+      alignas(16) float normal[3][WIDTH];
+      alignas(16) float worldPos[3][WIDTH];
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        for (size_t k = 0; k < WIDTH; ++k)
+        {
+          size_t src        = i + (k < n ? k : n - 1);
+          normal[axis][k]   = in.normal[axis][src];
+          worldPos[axis][k] = in.worldPos[axis][src];
+        }
+        p.normal[axis]   = _mm_load_ps(normal[axis]);
+        p.worldPos[axis] = _mm_load_ps(worldPos[axis]);
+      }
+    }
+
+    __m128 rgba[4];
+    ShadePacket(c, p, rgba);
+
+    if (out.colors)
+    {
+      __m128i colors = PackColors(rgba);
+      if (n == WIDTH)
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out.colors + i), colors);
+      }
+      else
+      {
+        alignas(16) uint32_t packed[WIDTH];
+        _mm_store_si128(reinterpret_cast<__m128i*>(packed), colors);
+        for (size_t k = 0; k < n; ++k)
+        {
+          out.colors[i + k] = packed[k];
+        }
+      }
+    }
+
+    if (out.rgba[0])
+    {
+      for (int ch = 0; ch < 4; ++ch)
+      {
+        alignas(16) float values[WIDTH];
+        _mm_store_ps(values, rgba[ch]);
+        for (size_t k = 0; k < n; ++k)
+        {
+          out.rgba[ch][i + k] = values[k];
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
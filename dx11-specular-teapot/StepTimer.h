@@ -4,39 +4,177 @@
 
 #pragma once
 
-#include <exception>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
 #include <stdint.h>
+#include <thread>
+#include <vector>
 
 namespace DX
 {
+// Time source for StepTimer. GetCounter returns a monotonic count that
+// advances GetFrequency times per second.
+class IClock
+{
+public:
+  virtual ~IClock() = default;
+
+  virtual uint64_t GetFrequency() const = 0;
+  virtual uint64_t GetCounter()         = 0;
+
+  // Blocks the calling thread for about the given number of counts. May
+  // overrun by as much as the scheduler's granularity.
+  virtual void SleepFor(uint64_t counts)
+  {
+    std::this_thread::sleep_for(std::chrono::duration<double>(
+      static_cast<double>(counts) / static_cast<double>(GetFrequency())));
+  }
+};
+
+// The system's monotonic clock (QueryPerformanceCounter on Windows,
+// clock_gettime(CLOCK_MONOTONIC) elsewhere).
+class SteadyClock : public IClock
+{
+public:
+  uint64_t GetFrequency() const override
+  {
+    using Period = std::chrono::steady_clock::period;
+    static_assert(Period::num == 1, "steady_clock ticks must divide a second");
+    return static_cast<uint64_t>(Period::den);
+  }
+
+  uint64_t GetCounter() override
+  {
+    return static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  }
+};
+
+// A clock that only moves when told to, for reproducible runs. Advance moves
+// it directly; Step moves it by the next delta of a script, which repeats.
+class ReplayClock : public IClock
+{
+public:
+  explicit ReplayClock(uint64_t frequency = 10000000)
+      : m_frequency(frequency)
+      , m_counter(0)
+      , m_scriptPosition(0)
+  {
+    if (frequency == 0)
+    {
+      throw std::invalid_argument("ReplayClock frequency");
+    }
+  }
+
+  uint64_t GetFrequency() const override { return m_frequency; }
+  uint64_t GetCounter() override { return m_counter; }
+
+  // Sleeping advances the clock exactly, so paced frames never spin on it.
+  void SleepFor(uint64_t counts) override { m_counter += counts; }
+
+  void Advance(uint64_t counts) { m_counter += counts; }
+  void AdvanceSeconds(double seconds)
+  {
+    m_counter += static_cast<uint64_t>(seconds * m_frequency);
+  }
+
+  // Deltas in counts, e.g. recorded frame times.
+  void SetScript(std::vector<uint64_t> deltas)
+  {
+    m_script         = std::move(deltas);
+    m_scriptPosition = 0;
+  }
+
+  void Step()
+  {
+    if (m_script.empty())
+    {
+      throw std::logic_error("ReplayClock has no script");
+    }
+
+    m_counter += m_script[m_scriptPosition];
+    m_scriptPosition = (m_scriptPosition + 1) % m_script.size();
+  }
+
+private:
+  uint64_t m_frequency;
+  uint64_t m_counter;
+  std::vector<uint64_t> m_script;
+  size_t m_scriptPosition;
+};
+
 // Helper class for animation and simulation timing.
 class StepTimer
 {
 public:
-  StepTimer()
+  // How closely paced frames kept to the frame interval. Errors are the
+  // absolute difference between each frame interval and the target, over the
+  // most recent frames.
+  struct PacingStats
+  {
+    uint32_t frames;
+    double meanErrorMs;
+    double p99ErrorMs;
+    double maxErrorMs;
+
+    // Time spent waiting for frames, asleep and spinning.
+    double sleptMs;
+    double spunMs;
+
+    // The current estimate of how far a sleep overruns.
+    double oversleepMs;
+  };
+
+  // Uses a SteadyClock unless given another clock.
+  explicit StepTimer(std::shared_ptr<IClock> clock = nullptr)
       : m_elapsedTicks(0)
       , m_totalTicks(0)
       , m_leftOverTicks(0)
       , m_frameCount(0)
       , m_framesPerSecond(0)
       , m_framesThisSecond(0)
-      , m_qpcSecondCounter(0)
+      , m_clockSecondCounter(0)
       , m_isFixedTimeStep(false)
       , m_targetElapsedTicks(TicksPerSecond / 60)
+      , m_frameIntervalTicks(0)
+      , m_pacingStarted(false)
+      , m_lastFrameTime(0)
+      , m_nextFrameTime(0)
+      , m_oversleepMean(0.0)
+      , m_oversleepVariance(0.0)
+      , m_pacedFrames(0)
+      , m_pacingSleptCounts(0)
+      , m_pacingSpunCounts(0)
+      , m_nextIntervalError(0)
   {
-    if (!QueryPerformanceFrequency(&m_qpcFrequency))
-    {
-      throw std::exception("QueryPerformanceFrequency");
-    }
+    SetClock(std::move(clock));
+  }
 
-    if (!QueryPerformanceCounter(&m_qpcLastTime))
+  // Replaces the time source. Elapsed time is reset, as the new clock's
+  // counter is unrelated to the old one.
+  void SetClock(std::shared_ptr<IClock> clock)
+  {
+    m_clock = clock ? std::move(clock) : std::make_shared<SteadyClock>();
+
+    m_clockFrequency = m_clock->GetFrequency();
+    if (m_clockFrequency == 0)
     {
-      throw std::exception("QueryPerformanceCounter");
+      throw std::invalid_argument("IClock::GetFrequency");
     }
 
     // Initialize max delta to 1/10 of a second.
-    m_qpcMaxDelta = m_qpcFrequency.QuadPart / 10;
+    m_clockMaxDelta = m_clockFrequency / 10;
+
+    m_oversleepMean     = 0.0;
+    m_oversleepVariance = 0.0;
+    ResetElapsedTime();
+    ResetPacingStats();
   }
+  IClock& GetClock() const { return *m_clock; }
 
   // Get elapsed time since the previous Update call.
   uint64_t GetElapsedTicks() const { return m_elapsedTicks; }
@@ -71,6 +209,128 @@ public:
   // Integer format represents time using 10,000,000 ticks per second.
   static const uint64_t TicksPerSecond = 10000000;
 
+  // Set the shortest time between the start of one Tick and the next; Tick
+  // waits out the rest of the interval, sleeping while there is time to spare
+  // and spinning for the last part, so the calling loop need not spin. Zero
+  // (the default) doesn't wait.
+  void SetFrameIntervalTicks(uint64_t interval)
+  {
+    m_frameIntervalTicks = interval;
+    m_pacingStarted      = false;
+  }
+  void SetFrameRateLimit(double framesPerSecond)
+  {
+    SetFrameIntervalTicks(
+      framesPerSecond > 0.0 ? SecondsToTicks(1.0 / framesPerSecond) : 0);
+  }
+  uint64_t GetFrameIntervalTicks() const { return m_frameIntervalTicks; }
+
+  PacingStats GetPacingStats() const
+  {
+    PacingStats stats = {};
+    stats.frames      = m_pacedFrames;
+    stats.sleptMs     = CountsToMs(m_pacingSleptCounts);
+    stats.spunMs      = CountsToMs(m_pacingSpunCounts);
+    stats.oversleepMs = CountsToMs(OversleepMargin());
+    if (m_intervalErrorsMs.empty())
+    {
+      return stats;
+    }
+
+    std::vector<double> errors = m_intervalErrorsMs;
+    std::sort(errors.begin(), errors.end());
+    double sum = 0.0;
+    for (double error : errors)
+    {
+      sum += error;
+    }
+    stats.meanErrorMs = sum / static_cast<double>(errors.size());
+    stats.p99ErrorMs  = errors[(errors.size() * 99 + 99) / 100 - 1];
+    stats.maxErrorMs  = errors.back();
+    return stats;
+  }
+
+  // The wait Tick begins with when a frame interval is set. Can be called
+  // alone to keep to the interval through frames that skip Tick.
+  void WaitForNextFrame()
+  {
+    if (m_frameIntervalTicks == 0)
+    {
+      return;
+    }
+
+    const uint64_t interval =
+      m_frameIntervalTicks * m_clockFrequency / TicksPerSecond;
+    uint64_t now = m_clock->GetCounter();
+    if (!m_pacingStarted)
+    {
+      m_pacingStarted = true;
+      m_lastFrameTime = now;
+      m_nextFrameTime = now + interval;
+      return;
+    }
+
+    // Sleep in slices of at most a millisecond, so that each overrun is
+    // measured and allowed for by the next, then spin until the frame is due.
+    const uint64_t maxSleep  = std::max<uint64_t>(1, m_clockFrequency / 1000);
+    const uint64_t waitStart = now;
+    uint64_t slept           = 0;
+    while (now < m_nextFrameTime)
+    {
+      const uint64_t remaining = m_nextFrameTime - now;
+      const uint64_t margin    = OversleepMargin();
+      if (remaining > margin + 1)
+      {
+        const uint64_t request = std::min(remaining - margin, maxSleep);
+        m_clock->SleepFor(request);
+
+        const uint64_t woke = m_clock->GetCounter();
+        MeasureOversleep(request, woke - now);
+        slept += woke - now;
+        now = woke;
+      }
+      else
+      {
+        now = m_clock->GetCounter();
+      }
+    }
+    m_pacingSleptCounts += slept;
+    m_pacingSpunCounts += (now - waitStart) - slept;
+
+    const double intervalMs = CountsToMs(now - m_lastFrameTime);
+    const double errorMs    = std::abs(intervalMs - CountsToMs(interval));
+    if (m_intervalErrorsMs.size() < PACING_HISTORY)
+    {
+      m_intervalErrorsMs.push_back(errorMs);
+    }
+    else
+    {
+      m_intervalErrorsMs[m_nextIntervalError] = errorMs;
+    }
+    m_nextIntervalError = (m_nextIntervalError + 1) % PACING_HISTORY;
+    m_pacedFrames++;
+
+    // Keep to the schedule, so that the rate is exact on average, unless a
+    // frame overran it by a whole interval; then start again from now rather
+    // than running frames back to back to catch up.
+    m_lastFrameTime = now;
+    m_nextFrameTime += interval;
+    if (m_nextFrameTime <= now)
+    {
+      m_nextFrameTime = now + interval;
+    }
+  }
+
+  // Clears the statistics, but not the oversleep estimate.
+  void ResetPacingStats()
+  {
+    m_pacedFrames       = 0;
+    m_pacingSleptCounts = 0;
+    m_pacingSpunCounts  = 0;
+    m_intervalErrorsMs.clear();
+    m_nextIntervalError = 0;
+  }
+
   static double TicksToSeconds(uint64_t ticks)
   {
     return static_cast<double>(ticks) / TicksPerSecond;
@@ -86,15 +346,13 @@ public:
 
   void ResetElapsedTime()
   {
-    if (!QueryPerformanceCounter(&m_qpcLastTime))
-    {
-      throw std::exception("QueryPerformanceCounter");
-    }
+    m_clockLastTime = m_clock->GetCounter();
 
-    m_leftOverTicks    = 0;
-    m_framesPerSecond  = 0;
-    m_framesThisSecond = 0;
-    m_qpcSecondCounter = 0;
+    m_leftOverTicks      = 0;
+    m_framesPerSecond    = 0;
+    m_framesThisSecond   = 0;
+    m_clockSecondCounter = 0;
+    m_pacingStarted      = false;
   }
 
   // Update timer state, calling the specified Update function the appropriate
@@ -102,29 +360,25 @@ public:
   template <typename TUpdate>
   void Tick(const TUpdate& update)
   {
-    // Query the current time.
-    LARGE_INTEGER currentTime;
+    WaitForNextFrame();
 
-    if (!QueryPerformanceCounter(&currentTime))
-    {
-      throw std::exception("QueryPerformanceCounter");
-    }
-
-    uint64_t timeDelta = currentTime.QuadPart - m_qpcLastTime.QuadPart;
+    // Query the current time.
+    uint64_t currentTime = m_clock->GetCounter();
+    uint64_t timeDelta   = currentTime - m_clockLastTime;
 
-    m_qpcLastTime = currentTime;
-    m_qpcSecondCounter += timeDelta;
+    m_clockLastTime = currentTime;
+    m_clockSecondCounter += timeDelta;
 
     // Clamp excessively large time deltas (e.g. after paused in the debugger).
-    if (timeDelta > m_qpcMaxDelta)
+    if (timeDelta > m_clockMaxDelta)
     {
-      timeDelta = m_qpcMaxDelta;
+      timeDelta = m_clockMaxDelta;
     }
 
-    // Convert QPC units into a canonical tick format. This cannot overflow due
-    // to the previous clamp.
+    // Convert clock units into a canonical tick format. This cannot overflow
+    // due to the previous clamp.
     timeDelta *= TicksPerSecond;
-    timeDelta /= m_qpcFrequency.QuadPart;
+    timeDelta /= m_clockFrequency;
 
     uint32_t lastFrameCount = m_frameCount;
 
@@ -142,7 +396,7 @@ public:
       // running smoothly.
 
       if (
-        abs(static_cast<int64_t>(timeDelta - m_targetElapsedTicks))
+        std::llabs(static_cast<int64_t>(timeDelta - m_targetElapsedTicks))
         < TicksPerSecond / 4000)
       {
         timeDelta = m_targetElapsedTicks;
@@ -177,19 +431,48 @@ public:
       m_framesThisSecond++;
     }
 
-    if (m_qpcSecondCounter >= static_cast<uint64_t>(m_qpcFrequency.QuadPart))
+    if (m_clockSecondCounter >= m_clockFrequency)
     {
       m_framesPerSecond  = m_framesThisSecond;
       m_framesThisSecond = 0;
-      m_qpcSecondCounter %= m_qpcFrequency.QuadPart;
+      m_clockSecondCounter %= m_clockFrequency;
     }
   }
 
 private:
-  // Source timing data uses QPC units.
-  LARGE_INTEGER m_qpcFrequency;
-  LARGE_INTEGER m_qpcLastTime;
-  uint64_t m_qpcMaxDelta;
+  // Frame intervals beyond this many ago are left out of PacingStats.
+  static const size_t PACING_HISTORY = 1024;
+
+  double CountsToMs(uint64_t counts) const
+  {
+    return 1000.0 * static_cast<double>(counts)
+           / static_cast<double>(m_clockFrequency);
+  }
+
+  // Time kept back from sleeping so that an overrunning sleep still wakes
+  // before the frame is due: the mean overrun plus one standard deviation.
+  uint64_t OversleepMargin() const
+  {
+    return static_cast<uint64_t>(
+      m_oversleepMean + std::sqrt(m_oversleepVariance));
+  }
+
+  // Moving mean and variance of the overrun, weighted to recent sleeps so
+  // the margin follows changes in the scheduler.
+  void MeasureOversleep(uint64_t requested, uint64_t slept)
+  {
+    const double overrun =
+      slept > requested ? static_cast<double>(slept - requested) : 0.0;
+    const double delta = overrun - m_oversleepMean;
+    m_oversleepMean += delta / 16.0;
+    m_oversleepVariance += (delta * delta - m_oversleepVariance) / 16.0;
+  }
+
+  // Source timing data uses clock units.
+  std::shared_ptr<IClock> m_clock;
+  uint64_t m_clockFrequency;
+  uint64_t m_clockLastTime;
+  uint64_t m_clockMaxDelta;
 
   // Derived timing data uses a canonical tick format.
   uint64_t m_elapsedTicks;
@@ -200,10 +483,24 @@ private:
   uint32_t m_frameCount;
   uint32_t m_framesPerSecond;
   uint32_t m_framesThisSecond;
-  uint64_t m_qpcSecondCounter;
+  uint64_t m_clockSecondCounter;
 
   // Members for configuring fixed timestep mode.
   bool m_isFixedTimeStep;
   uint64_t m_targetElapsedTicks;
+
+  // Members for frame pacing. Times are in clock units.
+  uint64_t m_frameIntervalTicks;
+  bool m_pacingStarted;
+  uint64_t m_lastFrameTime;
+  uint64_t m_nextFrameTime;
+  double m_oversleepMean;
+  double m_oversleepVariance;
+
+  uint32_t m_pacedFrames;
+  uint64_t m_pacingSleptCounts;
+  uint64_t m_pacingSpunCounts;
+  std::vector<double> m_intervalErrorsMs;
+  size_t m_nextIntervalError;
 };
 }
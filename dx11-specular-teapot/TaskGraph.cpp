@@ -0,0 +1,245 @@
+//
+// TaskGraph.cpp - Named tasks with dependencies, run once on a ThreadPool
+//
+
+#include "pch.h"
+#include "TaskGraph.h"
+
+#include "Profiler.h"
+
+#include <chrono>
+
+namespace
+{
+//------------------------------------------------------------------------------
+double
+NowMs()
+{
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+    .count();
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+DX::TaskGraph::TaskId
+DX::TaskGraph::AddTask(
+  const wchar_t* name,
+  std::function<void()> work,
+  const std::vector<TaskId>& dependencies)
+{
+  if (m_hasRun)
+  {
+    throw std::logic_error("TaskGraph::AddTask after Run");
+  }
+
+  const TaskId id = m_tasks.size();
+  for (TaskId dependency : dependencies)
+  {
+    if (dependency >= id)
+    {
+      throw std::invalid_argument("TaskGraph::AddTask dependency");
+    }
+    m_tasks[dependency].dependents.push_back(id);
+  }
+
+  Task task;
+  task.work                = std::move(work);
+  task.pendingDependencies = dependencies.size();
+  m_tasks.push_back(std::move(task));
+  m_timings.push_back({name, 0.0, 0.0, false});
+  return id;
+}
+
+//------------------------------------------------------------------------------
+void
+DX::TaskGraph::Run(ThreadPool& pool)
+{
+  if (m_hasRun)
+  {
+    throw std::logic_error("TaskGraph::Run twice");
+  }
+  m_hasRun = true;
+
+  m_remaining = m_tasks.size();
+  for (TaskId id = 0; id < m_tasks.size(); ++id)
+  {
+    if (m_tasks[id].pendingDependencies == 0)
+    {
+      m_ready.push_back(id);
+    }
+  }
+
+  // Every thread takes ready tasks until none remain, waiting while those it
+  // could run next are still being worked on, and helping with their loops.
+  const double originMs = NowMs();
+  pool.ParallelFor(
+    pool.GetConcurrency(), [this, originMs](size_t) { RunTasks(originMs); });
+  m_elapsedMs = NowMs() - originMs;
+
+  if (m_error)
+  {
+    std::rethrow_exception(m_error);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+DX::TaskGraph::RunTasks(double originMs)
+{
+  for (;;)
+  {
+    TaskId id;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_taskReady.wait(lock, [this]() {
+        return !m_loops.empty() || !m_ready.empty() || m_remaining == 0;
+      });
+
+      // Loops first: the task waiting on one may be holding up the rest.
+      if (!m_loops.empty())
+      {
+        RunLoopIndex(*m_loops.front(), lock);
+        continue;
+      }
+      if (m_remaining == 0)
+      {
+        return;
+      }
+      id = m_ready.front();
+      m_ready.erase(m_ready.begin());
+    }
+
+    Task& task = m_tasks[id];
+    if (task.failed)
+    {
+      Finish(id, false);
+      continue;
+    }
+
+    Timing& timing = m_timings[id];
+    bool succeeded = true;
+    timing.startMs = NowMs() - originMs;
+    try
+    {
+      ScopedZone zone(timing.name);
+      task.work();
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error)
+      {
+        m_error = std::current_exception();
+      }
+      succeeded = false;
+    }
+    timing.endMs = NowMs() - originMs;
+    timing.ran   = true;
+
+    Finish(id, succeeded);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Releases the tasks waiting on id, which are skipped if it did not succeed.
+void
+DX::TaskGraph::Finish(TaskId id, bool succeeded)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (TaskId dependent : m_tasks[id].dependents)
+    {
+      Task& task = m_tasks[dependent];
+      task.failed |= !succeeded;
+      if (--task.pendingDependencies == 0)
+      {
+        m_ready.push_back(dependent);
+      }
+    }
+    --m_remaining;
+  }
+  m_taskReady.notify_all();
+}
+
+//------------------------------------------------------------------------------
+void
+DX::TaskGraph::ParallelFor(
+  size_t count, const std::function<void(size_t)>& job)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  Loop loop;
+  loop.job   = &job;
+  loop.count = count;
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_loops.push_back(&loop);
+  m_taskReady.notify_all();
+
+  // Take indices alongside the helpers, then wait for those they took.
+  while (RunLoopIndex(loop, lock))
+  {
+  }
+  m_taskReady.wait(lock, [&loop]() { return loop.running == 0; });
+  lock.unlock();
+
+  if (loop.error)
+  {
+    std::rethrow_exception(loop.error);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Makes the next call of the loop, with lock released, and returns true; or
+// returns false if every index has been handed out. The last index handed out
+// retires the loop from m_loops.
+bool
+DX::TaskGraph::RunLoopIndex(Loop& loop, std::unique_lock<std::mutex>& lock)
+{
+  if (loop.next >= loop.count)
+  {
+    return false;
+  }
+
+  const size_t index = loop.next++;
+  if (loop.next == loop.count)
+  {
+    m_loops.erase(std::find(m_loops.begin(), m_loops.end(), &loop));
+  }
+  ++loop.running;
+
+  lock.unlock();
+  std::exception_ptr error;
+  try
+  {
+    (*loop.job)(index);
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+  }
+  lock.lock();
+
+  if (error && !loop.error)
+  {
+    loop.error = error;
+    if (loop.next < loop.count)
+    {
+      loop.next = loop.count;
+      m_loops.erase(std::find(m_loops.begin(), m_loops.end(), &loop));
+    }
+  }
+
+  // The loop's owner waits for its last call on m_taskReady.
+  if (--loop.running == 0 && loop.next >= loop.count)
+  {
+    m_taskReady.notify_all();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
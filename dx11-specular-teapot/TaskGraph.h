@@ -0,0 +1,105 @@
+//
+// TaskGraph.h - Named tasks with dependencies, run once on a ThreadPool
+//
+
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <exception>
+#include <functional>
+#include <vector>
+
+namespace DX
+{
+// A set of tasks, each started as soon as every task it depends on has
+// finished, in the order they were added. Independent tasks run at the same
+// time on the pool's threads, so the graph takes as long as its slowest chain
+// rather than the sum of its tasks. Each task is timed, and profiled as a zone
+// under its name.
+//
+// Tasks may only depend on tasks added before them, which keeps the graph
+// acyclic. A task that throws skips every task that depends on it; Run throws
+// the first such exception once the rest of the graph has finished.
+//
+// A task that has data-parallel work of its own passes it to ParallelFor,
+// which shares it with the graph's idle threads instead of starting more.
+class TaskGraph
+{
+public:
+  using TaskId = size_t;
+
+  struct Timing
+  {
+    const wchar_t* name;
+
+    // Since the start of Run. Both zero for a task that was skipped.
+    double startMs;
+    double endMs;
+
+    bool ran;
+  };
+
+  TaskGraph() = default;
+
+  TaskGraph(TaskGraph const&) = delete;
+  TaskGraph& operator=(TaskGraph const&) = delete;
+
+  // The name is stored by pointer, as with Profiler zones.
+  TaskId AddTask(
+    _In_z_ const wchar_t* name,
+    std::function<void()> work,
+    const std::vector<TaskId>& dependencies = {});
+
+  // Runs every task and blocks until all have finished or been skipped. The
+  // calling thread takes tasks too. A graph runs once.
+  void Run(ThreadPool& pool);
+
+  // For use by a running task: calls job(index) for every index in
+  // [0, count), on the calling thread and any of Run's threads waiting for a
+  // task, and returns once every call has. If a call throws, no further
+  // indices are handed out and the first exception is rethrown here. Outside
+  // Run, the calling thread makes every call itself.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+  // In the order the tasks were added.
+  const std::vector<Timing>& GetTimings() const { return m_timings; }
+  double GetElapsedMs() const { return m_elapsedMs; }
+
+private:
+  struct Task
+  {
+    std::function<void()> work;
+    std::vector<TaskId> dependents;
+    size_t pendingDependencies = 0;
+    bool failed                = false;
+  };
+
+  // A ParallelFor in progress.
+  struct Loop
+  {
+    const std::function<void(size_t)>* job;
+    size_t count;
+    size_t next    = 0;
+    size_t running = 0;
+    std::exception_ptr error;
+  };
+
+  void RunTasks(double originMs);
+  void Finish(TaskId id, bool succeeded);
+  bool RunLoopIndex(Loop& loop, std::unique_lock<std::mutex>& lock);
+
+  std::vector<Task> m_tasks;
+  std::vector<Timing> m_timings;
+  double m_elapsedMs = 0.0;
+  bool m_hasRun      = false;
+
+  // Run state, guarded by m_mutex.
+  std::mutex m_mutex;
+  std::condition_variable m_taskReady;
+  std::vector<TaskId> m_ready;
+  std::vector<Loop*> m_loops;
+  size_t m_remaining = 0;
+  std::exception_ptr m_error;
+};
+}
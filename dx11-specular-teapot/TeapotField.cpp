@@ -0,0 +1,364 @@
+#include "pch.h"
+#include "TeapotField.h"
+#include "Profiler.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+// An instance moves to a coarser level only once the level's projected error
+// is within this fraction of the threshold.
+constexpr float LOD_HYSTERESIS = 0.5f;
+}    // namespace
+
+//------------------------------------------------------------------------------
+TeapotField::TeapotField()
+    : m_modelBounds(XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f)
+{
+}
+
+//------------------------------------------------------------------------------
+std::vector<XMFLOAT4X4>
+TeapotField::CreateRings(int count, float spacing)
+{
+  std::vector<XMFLOAT4X4> placements;
+  for (int ring = 0; static_cast<int>(placements.size()) < count; ++ring)
+  {
+    for (int z = -ring; z <= ring; ++z)
+    {
+      for (int x = -ring; x <= ring; ++x)
+      {
+        if (std::max(std::abs(x), std::abs(z)) != ring
+            || static_cast<int>(placements.size()) == count)
+        {
+          continue;
+        }
+        placements.emplace_back();
+        XMStoreFloat4x4(
+          &placements.back(),
+          XMMatrixTranslation(x * spacing, 0.0f, z * spacing));
+      }
+    }
+  }
+  return placements;
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::SetModelBounds(const BoundingSphere& bounds)
+{
+  m_modelBounds = bounds;
+  m_bvhValid    = false;
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::SetPlacements(std::vector<XMFLOAT4X4> placements)
+{
+  m_placements = std::move(placements);
+
+  m_placementScales.clear();
+  m_placementScales.reserve(m_placements.size());
+  for (const auto& placement : m_placements)
+  {
+    XMMATRIX m       = XMLoadFloat4x4(&placement);
+    XMVECTOR scaleSq = XMVectorMax(
+      XMVector3LengthSq(m.r[0]),
+      XMVectorMax(XMVector3LengthSq(m.r[1]), XMVector3LengthSq(m.r[2])));
+    m_placementScales.push_back(std::sqrt(XMVectorGetX(scaleSq)));
+  }
+
+  m_bvhValid = false;
+  m_instanceLevels.assign(m_placements.size(), 0);
+
+  m_visible.clear();
+  m_visible.reserve(m_placements.size());
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::SetLevelsOfDetail(std::vector<float> levelErrors, float pixelError)
+{
+  if (levelErrors.size() > UINT8_MAX || !(pixelError > 0.0f))
+  {
+    throw std::invalid_argument("TeapotField::SetLevelsOfDetail");
+  }
+
+  m_levelErrors = std::move(levelErrors);
+  m_pixelError  = pixelError;
+  m_instanceLevels.assign(m_placements.size(), 0);
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::SetViewportHeight(float viewportHeight)
+{
+  m_viewportHeight = viewportHeight;
+}
+
+//------------------------------------------------------------------------------
+// Brings the instance bounds and the tree over them up to date with
+// modelWorld. Only the bounds move when modelWorld does, so the tree built for
+// the placements is refitted rather than rebuilt.
+//------------------------------------------------------------------------------
+void XM_CALLCONV
+TeapotField::UpdateBounds(FXMMATRIX modelWorld)
+{
+  XMFLOAT4X4 world;
+  XMStoreFloat4x4(&world, modelWorld);
+  if (m_bvhValid && memcmp(&world, &m_bvhModelWorld, sizeof(world)) == 0)
+  {
+    return;
+  }
+
+  DX::ScopedZone zone(L"TeapotField::UpdateBounds");
+
+  // Each instance's bounds are the model's, moved by its placement and grown
+  // by the placement's largest scale.
+  BoundingSphere modelBounds;
+  m_modelBounds.Transform(modelBounds, modelWorld);
+  const XMVECTOR center = XMLoadFloat3(&modelBounds.Center);
+
+  m_instanceBounds.resize(m_placements.size());
+  std::vector<BoundingBox> boxes(m_bvhValid ? 0 : m_placements.size());
+  for (size_t i = 0; i < m_placements.size(); ++i)
+  {
+    BoundingSphere& bounds = m_instanceBounds[i];
+    XMStoreFloat3(
+      &bounds.Center,
+      XMVector3Transform(center, XMLoadFloat4x4(&m_placements[i])));
+    bounds.Radius = modelBounds.Radius * m_placementScales[i];
+
+    BoundingBox box;
+    BoundingBox::CreateFromSphere(box, bounds);
+    if (m_bvhValid)
+    {
+      m_bvh.UpdateObject(static_cast<uint32_t>(i), box);
+    }
+    else
+    {
+      boxes[i] = box;
+    }
+  }
+
+  if (m_bvhValid)
+  {
+    m_bvh.Refit();
+  }
+  else
+  {
+    m_bvh.Build(boxes);
+  }
+
+  m_bvhModelWorld = world;
+  m_bvhValid      = true;
+}
+
+//------------------------------------------------------------------------------
+size_t XM_CALLCONV
+TeapotField::Cull(FXMMATRIX modelWorld, CXMMATRIX view, CXMMATRIX projection)
+{
+  DX::ScopedZone zone(L"TeapotField::Cull");
+
+  // BoundingFrustum::CreateFromMatrix expects a left-handed projection, which
+  // ours becomes when z is flipped. That gives a frustum in view space with z
+  // flipped, whose planes are then carried into world space. (Planes transform
+  // by the inverse transpose of the point transform, view * flipZ.)
+  const XMMATRIX flipZ = XMMatrixScaling(1.0f, 1.0f, -1.0f);
+
+  BoundingFrustum frustum;
+  BoundingFrustum::CreateFromMatrix(
+    frustum, XMMatrixMultiply(flipZ, projection));
+
+  XMVECTOR planes[6];
+  frustum.GetPlanes(
+    &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+  const XMMATRIX planeTransform =
+    XMMatrixTranspose(XMMatrixMultiply(view, flipZ));
+  for (auto& plane : planes)
+  {
+    plane = XMPlaneNormalize(XMPlaneTransform(plane, planeTransform));
+  }
+
+  UpdateBounds(modelWorld);
+
+  // The tree tests boxes around the spheres, so the spheres of the candidates
+  // are tested again; only the survivors, kept in tree order, pay for level
+  // selection and packing.
+  m_candidates.clear();
+  m_bvh.QueryFrustum(planes, m_candidates);
+
+  size_t visibleCount = 0;
+  for (uint32_t i : m_candidates)
+  {
+    if (m_instanceBounds[i].ContainedBy(
+          planes[0], planes[1], planes[2], planes[3], planes[4], planes[5])
+        != DISJOINT)
+    {
+      m_candidates[visibleCount++] = i;
+    }
+  }
+  m_candidates.resize(visibleCount);
+
+  const bool selectLevels = m_levelErrors.size() > 1 && m_viewportHeight > 0.0f;
+  const size_t levelCount = selectLevels ? m_levelErrors.size() : 1;
+  m_levelCounts.assign(levelCount, 0);
+  if (selectLevels)
+  {
+    // Pixels covered by one unit at unit distance.
+    const XMVECTOR eye        = XMMatrixInverse(nullptr, view).r[3];
+    const float pixelsPerUnit =
+      0.5f * m_viewportHeight * XMVectorGetY(projection.r[1]);
+    for (uint32_t i : m_candidates)
+    {
+      m_instanceLevels[i] = SelectLevel(i, eye, pixelsPerUnit);
+      m_levelCounts[m_instanceLevels[i]]++;
+    }
+  }
+  else
+  {
+    m_levelCounts[0] = static_cast<uint32_t>(visibleCount);
+  }
+
+  // Pack the instances grouped by level.
+  m_levelStarts.assign(levelCount, 0);
+  for (size_t level = 1; level < levelCount; ++level)
+  {
+    m_levelStarts[level] = m_levelStarts[level - 1] + m_levelCounts[level - 1];
+  }
+
+  m_visible.resize(visibleCount);
+  for (uint32_t i : m_candidates)
+  {
+    const size_t level = selectLevels ? m_instanceLevels[i] : 0;
+    PackInstance(
+      m_visible[m_levelStarts[level]++],
+      XMMatrixMultiply(modelWorld, XMLoadFloat4x4(&m_placements[i])));
+  }
+
+  return m_visible.size();
+}
+
+//------------------------------------------------------------------------------
+// Refines the instance's level while its projected error is over the
+// threshold, then coarsens it while the next level's is well under, starting
+// from the level it was last drawn at. The error is projected at the nearest
+// point of the instance's bounds.
+//------------------------------------------------------------------------------
+uint8_t XM_CALLCONV
+TeapotField::SelectLevel(uint32_t instance, FXMVECTOR eye, float pixelsPerUnit)
+{
+  const BoundingSphere& bounds = m_instanceBounds[instance];
+  const float distance =
+    XMVectorGetX(
+      XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds.Center), eye)))
+    - bounds.Radius;
+
+  // Model space to pixels, scaled as the instance is.
+  const float scale = bounds.Radius / m_modelBounds.Radius * pixelsPerUnit
+                      / std::max(distance, 1.0e-4f);
+
+  const size_t lastLevel = m_levelErrors.size() - 1;
+  size_t level           = m_instanceLevels[instance];
+  while (level > 0 && m_levelErrors[level] * scale > m_pixelError)
+  {
+    --level;
+  }
+  while (level < lastLevel
+         && m_levelErrors[level + 1] * scale <= m_pixelError * LOD_HYSTERESIS)
+  {
+    ++level;
+  }
+  return static_cast<uint8_t>(level);
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::CreateDeviceResources(_In_ ID3D11Device* device)
+{
+  m_instanceCapacity = std::max<size_t>(m_placements.size(), 1);
+
+  CD3D11_BUFFER_DESC desc(
+    static_cast<UINT>(m_instanceCapacity * sizeof(InstanceData)),
+    D3D11_BIND_VERTEX_BUFFER,
+    D3D11_USAGE_DYNAMIC,
+    D3D11_CPU_ACCESS_WRITE);
+
+  DX::ThrowIfFailed(device->CreateBuffer(
+    &desc, nullptr, m_instanceBuffer.ReleaseAndGetAddressOf()));
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::ReleaseDeviceResources()
+{
+  m_instanceBuffer.Reset();
+  m_instanceCapacity = 0;
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::Upload(_In_ ID3D11DeviceContext* context)
+{
+  if (!m_instanceBuffer || m_visible.size() > m_instanceCapacity)
+  {
+    throw std::logic_error("TeapotField::Upload");
+  }
+
+  if (m_visible.empty())
+  {
+    return;
+  }
+
+  D3D11_MAPPED_SUBRESOURCE mapped;
+  DX::ThrowIfFailed(context->Map(
+    m_instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+  memcpy(
+    mapped.pData, m_visible.data(), m_visible.size() * sizeof(InstanceData));
+  context->Unmap(m_instanceBuffer.Get(), 0);
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::Upload(DX::RenderCommandList& commandList)
+{
+  if (!m_instanceBuffer || m_visible.size() > m_instanceCapacity)
+  {
+    throw std::logic_error("TeapotField::Upload");
+  }
+
+  if (m_visible.empty())
+  {
+    return;
+  }
+
+  commandList.UpdateBuffer(
+    m_instanceBuffer.Get(),
+    DX::RenderCommandList::UpdateMode::Discard,
+    m_visible.data(),
+    m_visible.size() * sizeof(InstanceData));
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::SetVertexBuffer(_In_ ID3D11DeviceContext* context, UINT slot) const
+{
+  ID3D11Buffer* buffer = m_instanceBuffer.Get();
+  UINT stride          = sizeof(InstanceData);
+  UINT offset          = 0;
+  context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotField::SetVertexBuffer(
+  DX::RenderCommandList& commandList, UINT slot) const
+{
+  commandList.SetVertexBuffer(
+    slot, m_instanceBuffer.Get(), sizeof(InstanceData));
+}
+
+//------------------------------------------------------------------------------
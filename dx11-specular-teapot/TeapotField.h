@@ -0,0 +1,122 @@
+#pragma once
+
+#include "pch.h"
+#include "RenderCommandList.h"
+#include "SceneBvh.h"
+#include "Shader/MyEffectConstants.h"
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Many copies of one model, drawn with a single instanced draw.
+//
+// Each frame Cull queries a SceneBvh over the instances' bounds for those in
+// the view frustum, tests their bounding spheres against it and packs the
+// visible ones as InstanceData. The tree is refitted whenever the model's
+// world matrix changes and rebuilt when the placements or bounds change.
+// Culling and packing need no device, so the headless renderer and the
+// benchmarks use them as is; Upload then copies the packed instances into a
+// dynamic vertex buffer for MyEffect's instanced vertex shader.
+//
+// Given levels of detail, Cull also picks one for each visible instance from
+// its projected size, and packs the instances grouped by level, so that each
+// level is drawn with one instanced draw.
+//------------------------------------------------------------------------------
+class TeapotField
+{
+public:
+  TeapotField();
+
+  TeapotField(TeapotField const&) = delete;
+  TeapotField& operator=(TeapotField const&) = delete;
+
+  // Translations for count instances spaced out on the XZ plane: the first at
+  // the origin, the rest filling square rings around it.
+  static std::vector<DirectX::XMFLOAT4X4>
+  CreateRings(int count, float spacing);
+
+  // Bounds of the model in its own space. Defaults to the unit sphere.
+  void SetModelBounds(const DirectX::BoundingSphere& bounds);
+
+  // Per-instance transforms, applied after the model's world matrix. Must be
+  // set before CreateDeviceResources, which sizes the buffer to fit them all.
+  void SetPlacements(std::vector<DirectX::XMFLOAT4X4> placements);
+  size_t GetPlacementCount() const { return m_placements.size(); }
+
+  // The geometric error of each level of detail in model space, finest first.
+  // Each instance is drawn at the coarsest level whose error projects to no
+  // more than pixelError pixels, on a viewport viewportHeight pixels tall.
+  // An instance only moves to a coarser level once that level's error is
+  // within half of pixelError, so that one at the threshold doesn't flicker
+  // between two levels. With no levels, or no viewport height, every instance
+  // is at level 0.
+  void SetLevelsOfDetail(std::vector<float> levelErrors, float pixelError);
+  void SetViewportHeight(float viewportHeight);
+
+  // Poses every instance with modelWorld followed by its placement, culls it
+  // against the frustum of view and projection (right-handed, as used by
+  // Game) and packs the survivors, in tree order. Returns the number visible.
+  size_t XM_CALLCONV Cull(
+    DirectX::FXMMATRIX modelWorld,
+    DirectX::CXMMATRIX view,
+    DirectX::CXMMATRIX projection);
+
+  const std::vector<InstanceData>& GetVisibleInstances() const
+  {
+    return m_visible;
+  }
+
+  // How many of the visible instances are at each level of detail. They are
+  // packed in level order, so level i's begin after those of the levels
+  // before it.
+  const std::vector<uint32_t>& GetLevelInstanceCounts() const
+  {
+    return m_levelCounts;
+  }
+
+  // Instance buffer management.
+  void CreateDeviceResources(_In_ ID3D11Device* device);
+  void ReleaseDeviceResources();
+
+  // Writes the visible instances with WRITE_DISCARD.
+  void Upload(_In_ ID3D11DeviceContext* context);
+  void Upload(DX::RenderCommandList& commandList);
+
+  // Binds the instance buffer as vertex buffer slot (for setCustomState).
+  void SetVertexBuffer(_In_ ID3D11DeviceContext* context, UINT slot) const;
+  void SetVertexBuffer(DX::RenderCommandList& commandList, UINT slot) const;
+
+private:
+  void XM_CALLCONV UpdateBounds(DirectX::FXMMATRIX modelWorld);
+  uint8_t XM_CALLCONV
+  SelectLevel(uint32_t instance, DirectX::FXMVECTOR eye, float pixelsPerUnit);
+
+  DirectX::BoundingSphere m_modelBounds;
+  std::vector<DirectX::XMFLOAT4X4> m_placements;
+
+  // Largest axis scale of each placement, to grow the bounds by.
+  std::vector<float> m_placementScales;
+
+  // Instance bounds as posed by m_bvhModelWorld; the tree holds their boxes.
+  std::vector<DirectX::BoundingSphere> m_instanceBounds;
+  DX::SceneBvh m_bvh;
+  DirectX::XMFLOAT4X4 m_bvhModelWorld;
+  bool m_bvhValid = false;
+
+  // Levels of detail, and the level each instance was last drawn at.
+  std::vector<float> m_levelErrors;
+  float m_pixelError     = 1.0f;
+  float m_viewportHeight = 0.0f;
+  std::vector<uint8_t> m_instanceLevels;
+
+  // Reused between frames to avoid reallocation.
+  std::vector<uint32_t> m_candidates;
+  std::vector<uint32_t> m_levelStarts;
+  std::vector<uint32_t> m_levelCounts;
+  std::vector<InstanceData> m_visible;
+
+  Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceBuffer;
+  size_t m_instanceCapacity = 0;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "TeapotLod.h"
+
+using namespace DirectX;
+
+namespace
+{
+using Vertices = std::vector<VertexPositionNormalTexture>;
+
+//------------------------------------------------------------------------------
+float
+Distance(const XMFLOAT3& point, const XMFLOAT3& a, const XMFLOAT3& b)
+{
+  const XMVECTOR midpoint =
+    XMVectorScale(XMVectorAdd(XMLoadFloat3(&a), XMLoadFloat3(&b)), 0.5f);
+  return XMVectorGetX(
+    XMVector3Length(XMVectorSubtract(XMLoadFloat3(&point), midpoint)));
+}
+
+//------------------------------------------------------------------------------
+// The furthest the triangles of coarse stray from the surface, measured at the
+// vertices of fine, at twice its tessellation. Both tessellate every patch in
+// the same order as a (tessellation + 1)^2 grid of surface points, so each
+// fine point between two coarse ones lies on the surface midway between them,
+// where the coarse mesh has the midpoint of their edge. The centres of coarse
+// cells are measured against both diagonals, whichever the triangles use.
+float
+MeasureError(const Vertices& coarse, size_t tessellation, const Vertices& fine)
+{
+  const size_t coarseSide  = tessellation + 1;
+  const size_t fineSide    = 2 * tessellation + 1;
+  const size_t patchCount  = coarse.size() / (coarseSide * coarseSide);
+  const size_t coarsePatch = coarseSide * coarseSide;
+  const size_t finePatch   = fineSide * fineSide;
+
+  float error = 0.0f;
+  for (size_t patch = 0; patch < patchCount; ++patch)
+  {
+    auto c = [&](size_t i, size_t j) -> const XMFLOAT3& {
+      return coarse[patch * coarsePatch + i * coarseSide + j].position;
+    };
+
+    for (size_t i = 0; i < fineSide; ++i)
+    {
+      for (size_t j = 0; j < fineSide; ++j)
+      {
+        if (i % 2 == 0 && j % 2 == 0)
+        {
+          continue;
+        }
+
+        const XMFLOAT3& p = fine[patch * finePatch + i * fineSide + j].position;
+        const size_t i0   = i / 2;
+        const size_t j0   = j / 2;
+        if (j % 2 == 0)
+        {
+          error = std::max(error, Distance(p, c(i0, j0), c(i0 + 1, j0)));
+        }
+        else if (i % 2 == 0)
+        {
+          error = std::max(error, Distance(p, c(i0, j0), c(i0, j0 + 1)));
+        }
+        else
+        {
+          error = std::max(
+            error,
+            std::max(
+              Distance(p, c(i0, j0), c(i0 + 1, j0 + 1)),
+              Distance(p, c(i0 + 1, j0), c(i0, j0 + 1))));
+        }
+      }
+    }
+  }
+  return error;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+void
+TeapotLod::CreateMesh(
+  size_t tessellation,
+  size_t levelCount,
+  Mesh& mesh,
+  const GeometricPrimitive::ParallelFor& parallelFor)
+{
+  if (tessellation < 1 || levelCount < 1)
+  {
+    throw std::invalid_argument("TeapotLod::CreateMesh");
+  }
+
+  mesh.vertices.clear();
+  mesh.indices.clear();
+  mesh.levels.clear();
+
+  Vertices finer;
+  Vertices vertices;
+  Vertices optimizedVertices;
+  std::vector<uint32_t> indices;
+  for (size_t level = 0; level < levelCount; ++level)
+  {
+    GeometricPrimitive::CreateTeapot(
+      vertices, indices, 1.0f, tessellation, true, parallelFor);
+
+    Level lod;
+    lod.tessellation   = tessellation;
+    lod.geometricError = 0.0f;
+    if (level > 0)
+    {
+      lod.geometricError = MeasureError(vertices, tessellation, finer);
+    }
+
+    // Measured on the generator's patch grids, so optimized after. The
+    // shaders don't use texture coordinates, so the patch seams are welded.
+    optimizedVertices = vertices;
+    GeometricPrimitive::Optimize(optimizedVertices, indices, true);
+
+    lod.startIndex = static_cast<uint32_t>(mesh.indices.size());
+    lod.indexCount = static_cast<uint32_t>(indices.size());
+    lod.baseVertex = static_cast<int32_t>(mesh.vertices.size());
+    mesh.levels.push_back(lod);
+
+    mesh.vertices.insert(
+      mesh.vertices.end(), optimizedVertices.begin(), optimizedVertices.end());
+    mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+
+    if (tessellation % 2 != 0)
+    {
+      break;
+    }
+    tessellation /= 2;
+    std::swap(finer, vertices);
+  }
+
+  // The finest level has nothing finer to be measured against. The error of
+  // a smooth surface falls with the square of the tessellation, so it is taken
+  // as a quarter of the next level's.
+  if (mesh.levels.size() > 1)
+  {
+    mesh.levels[0].geometricError = mesh.levels[1].geometricError / 4.0f;
+  }
+}
+
+//------------------------------------------------------------------------------
+TeapotLod::TeapotLod(_In_ ID3D11Device* device, Mesh&& mesh)
+    : m_mesh(std::move(mesh))
+{
+  if (m_mesh.levels.empty())
+  {
+    throw std::invalid_argument("TeapotLod mesh");
+  }
+
+  CD3D11_BUFFER_DESC vertexDesc(
+    static_cast<UINT>(
+      m_mesh.vertices.size() * sizeof(VertexPositionNormalTexture)),
+    D3D11_BIND_VERTEX_BUFFER,
+    D3D11_USAGE_IMMUTABLE);
+  D3D11_SUBRESOURCE_DATA vertexData = {m_mesh.vertices.data(), 0, 0};
+  DX::ThrowIfFailed(device->CreateBuffer(
+    &vertexDesc, &vertexData, m_vertexBuffer.ReleaseAndGetAddressOf()));
+
+  // Indices are relative to each level's base vertex, so 16 bits are enough
+  // unless a single level has 65535 vertices or more.
+  const uint32_t maxIndex =
+    *std::max_element(m_mesh.indices.begin(), m_mesh.indices.end());
+  std::vector<uint16_t> narrowIndices;
+  const void* indices = m_mesh.indices.data();
+  size_t indexSize    = sizeof(uint32_t);
+  m_indexFormat       = DXGI_FORMAT_R32_UINT;
+  if (maxIndex < USHRT_MAX)
+  {
+    narrowIndices.assign(m_mesh.indices.begin(), m_mesh.indices.end());
+    indices       = narrowIndices.data();
+    indexSize     = sizeof(uint16_t);
+    m_indexFormat = DXGI_FORMAT_R16_UINT;
+  }
+
+  CD3D11_BUFFER_DESC indexDesc(
+    static_cast<UINT>(m_mesh.indices.size() * indexSize),
+    D3D11_BIND_INDEX_BUFFER,
+    D3D11_USAGE_IMMUTABLE);
+  D3D11_SUBRESOURCE_DATA indexData = {indices, 0, 0};
+  DX::ThrowIfFailed(device->CreateBuffer(
+    &indexDesc, &indexData, m_indexBuffer.ReleaseAndGetAddressOf()));
+}
+
+//------------------------------------------------------------------------------
+std::vector<float>
+TeapotLod::GetLevelErrors() const
+{
+  std::vector<float> errors;
+  errors.reserve(m_mesh.levels.size());
+  for (const auto& level : m_mesh.levels)
+  {
+    errors.push_back(level.geometricError);
+  }
+  return errors;
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotLod::SetBuffers(DX::RenderCommandList& commandList) const
+{
+  commandList.SetVertexBuffer(
+    0, m_vertexBuffer.Get(), sizeof(VertexPositionNormalTexture));
+  commandList.SetIndexBuffer(m_indexBuffer.Get(), m_indexFormat);
+}
+
+//------------------------------------------------------------------------------
+void
+TeapotLod::DrawInstanced(
+  DX::RenderCommandList& commandList,
+  size_t level,
+  uint32_t instanceCount,
+  uint32_t startInstance) const
+{
+  const Level& lod = m_mesh.levels.at(level);
+  commandList.DrawIndexedInstanced(
+    lod.indexCount,
+    instanceCount,
+    lod.startIndex,
+    lod.baseVertex,
+    startInstance);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "pch.h"
+#include "RenderCommandList.h"
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// The teapot tessellated at several levels of detail, each at half the
+// tessellation of the one before, kept together in one immutable vertex and
+// index buffer. Level 0 is the finest.
+//
+// Each level records its geometric error: how far, in model space, its flat
+// triangles stray from the Bezier surface. A renderer can then draw each
+// teapot at the coarsest level whose error projects to under a pixel or so.
+//------------------------------------------------------------------------------
+class TeapotLod
+{
+public:
+  struct Level
+  {
+    size_t tessellation;
+    uint32_t startIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;
+    float geometricError;
+  };
+
+  // Every level's vertices and indices, relative to its base vertex, welded
+  // and reordered by GeometricPrimitive::Optimize. The index buffer is 16 bit
+  // if every level fits, so only tessellations above 45 or so need 32.
+  struct Mesh
+  {
+    std::vector<DirectX::VertexPositionNormalTexture> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Level> levels;
+  };
+
+  // Tessellates up to levelCount levels from tessellation down, stopping after
+  // a level with an odd tessellation, which can't be halved. Needs no device,
+  // so can run on another thread ahead of construction. Given parallelFor,
+  // each level's patches are tessellated through it, e.g. across a ThreadPool
+  // or the threads of a TaskGraph.
+  static void CreateMesh(
+    size_t tessellation,
+    size_t levelCount,
+    Mesh& mesh,
+    const DirectX::GeometricPrimitive::ParallelFor& parallelFor = nullptr);
+
+  TeapotLod(_In_ ID3D11Device* device, Mesh&& mesh);
+
+  TeapotLod(TeapotLod const&) = delete;
+  TeapotLod& operator=(TeapotLod const&) = delete;
+
+  const Mesh& GetMesh() const { return m_mesh; }
+  const std::vector<Level>& GetLevels() const { return m_mesh.levels; }
+  std::vector<float> GetLevelErrors() const;
+
+  DXGI_FORMAT GetIndexFormat() const { return m_indexFormat; }
+
+  // Binds the vertex buffer to slot 0 and the index buffer.
+  void SetBuffers(DX::RenderCommandList& commandList) const;
+
+  void DrawInstanced(
+    DX::RenderCommandList& commandList,
+    size_t level,
+    uint32_t instanceCount,
+    uint32_t startInstance) const;
+
+private:
+  Mesh m_mesh;
+  Microsoft::WRL::ComPtr<ID3D11Buffer> m_vertexBuffer;
+  Microsoft::WRL::ComPtr<ID3D11Buffer> m_indexBuffer;
+  DXGI_FORMAT m_indexFormat = DXGI_FORMAT_R16_UINT;
+};
+
+//------------------------------------------------------------------------------
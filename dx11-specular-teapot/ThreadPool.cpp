@@ -0,0 +1,159 @@
+//
+// ThreadPool.cpp - A fixed-size pool of worker threads for data-parallel loops
+//
+
+#include "pch.h"
+#include "ThreadPool.h"
+
+//------------------------------------------------------------------------------
+DX::ThreadPool::ThreadPool(int threadCount)
+    : m_nextIndex(0)
+{
+  if (threadCount < 0)
+  {
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    threadCount =
+      hardwareThreads > 1 ? static_cast<int>(hardwareThreads) - 1 : 0;
+  }
+
+  m_workers.reserve(static_cast<size_t>(threadCount));
+  for (int i = 0; i < threadCount; ++i)
+  {
+    m_workers.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+//------------------------------------------------------------------------------
+DX::ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_wakeWorkers.notify_all();
+
+  for (auto& worker : m_workers)
+  {
+    worker.join();
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+DX::ThreadPool::ParallelFor(
+  size_t count, const std::function<void(size_t)>& job)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  if (m_workers.empty() || count == 1)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      job(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_job           = &job;
+    m_jobSize       = count;
+    m_activeWorkers = m_workers.size();
+    m_nextIndex.store(0, std::memory_order_relaxed);
+    ++m_generation;
+  }
+  m_wakeWorkers.notify_all();
+
+  RunJob();
+
+  // Wait for the workers to drain, so the job outlives every call into it,
+  // even when it threw.
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobDone.wait(lock, [this]() { return m_activeWorkers == 0; });
+    m_job = nullptr;
+    std::swap(exception, m_exception);
+  }
+
+  if (exception)
+  {
+    std::rethrow_exception(exception);
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+DX::ThreadPool::WorkerLoop()
+{
+  uint64_t seenGeneration = 0;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeWorkers.wait(lock, [&]() {
+        return m_shutdown || m_generation != seenGeneration;
+      });
+
+      if (m_shutdown)
+      {
+        return;
+      }
+      seenGeneration = m_generation;
+    }
+
+    RunJob();
+
+    bool isLast = false;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      isLast = (--m_activeWorkers == 0);
+    }
+    if (isLast)
+    {
+      m_jobDone.notify_one();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void
+DX::ThreadPool::RunJob()
+{
+  const auto& job    = *m_job;
+  const size_t count = m_jobSize;
+
+  for (;;)
+  {
+    size_t index = m_nextIndex.fetch_add(1, std::memory_order_relaxed);
+    if (index >= count)
+    {
+      return;
+    }
+
+    try
+    {
+      job(index);
+    }
+    catch (...)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_exception)
+        {
+          m_exception = std::current_exception();
+        }
+      }
+
+      // Hand out no more indices; the other threads finish their current ones.
+      m_nextIndex.store(count, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
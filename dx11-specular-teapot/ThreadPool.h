@@ -0,0 +1,60 @@
+//
+// ThreadPool.h - A fixed-size pool of worker threads for data-parallel loops
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DX
+{
+// Runs index-based jobs across a fixed set of worker threads. The calling
+// thread takes part in every job, so a pool of N threads executes on N + 1
+// cores. A pool created with zero threads runs everything inline.
+class ThreadPool
+{
+public:
+  // threadCount of -1 picks one worker per hardware thread, minus the caller.
+  explicit ThreadPool(int threadCount = -1);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  // Number of threads that execute a job, including the caller.
+  size_t GetConcurrency() const { return m_workers.size() + 1; }
+
+  // Calls job(index) for every index in [0, count) and blocks until all calls
+  // have returned. Indices are handed out dynamically so uneven work balances
+  // itself. If a call throws, no further indices are handed out and the
+  // first exception is rethrown here once every thread has stopped. Jobs must
+  // not call back into the same pool.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+private:
+  void WorkerLoop();
+  void RunJob();
+
+  std::vector<std::thread> m_workers;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wakeWorkers;
+  std::condition_variable m_jobDone;
+
+  // Current job, guarded by m_mutex apart from the atomic counters.
+  const std::function<void(size_t)>* m_job = nullptr;
+  size_t m_jobSize                         = 0;
+  uint64_t m_generation                    = 0;
+  size_t m_activeWorkers                   = 0;
+  bool m_shutdown                          = false;
+  std::exception_ptr m_exception;
+  std::atomic<size_t> m_nextIndex;
+};
+}
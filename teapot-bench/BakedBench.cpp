@@ -0,0 +1,233 @@
+//
+// BakedBench.cpp - "baked" mode: compile-time teapot tables against runtime
+//
+
+#include "pch.h"
+#include "Bench.h"
+
+#include <utility>
+
+// DirectXTK's own Bezier helpers, teapot patches and baked tables, which
+// aren't part of its public headers.
+#include "../DirectXTK-dec2017/Src/Bezier.h"
+
+using namespace DirectX;
+
+namespace
+{
+#include "../DirectXTK-dec2017/Src/TeapotData.inc"
+#include "../DirectXTK-dec2017/Src/TeapotTables.inc"
+
+using Vertices = std::vector<VertexPositionNormalTexture>;
+
+struct Result
+{
+  size_t vertexCount;
+  float genericPositionError;
+  float genericNormalError;
+  float tablesPositionError;
+  float tablesNormalError;
+  size_t mismatches;
+  double runtimeMs;
+  double bakedMs;
+};
+
+//------------------------------------------------------------------------------
+float
+MaxDifference(const float* a, const float* b, size_t count)
+{
+  float difference = 0.0f;
+  for (size_t i = 0; i < count; ++i)
+  {
+    difference = std::max(difference, std::abs(a[i] - b[i]));
+  }
+  return difference;
+}
+
+//------------------------------------------------------------------------------
+// Tessellates every patch copy at runtime, in ComputeTeapot's order, with the
+// generic Bezier templates or, given a tessellation's PatchBasis, its tables.
+void
+Tessellate(
+  size_t tessellation,
+  const Bezier::PatchBasis* basis,
+  Vertices& vertices,
+  std::vector<size_t>& indices)
+{
+  vertices.clear();
+  indices.clear();
+  auto output = [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR uv) {
+    vertices.push_back(VertexPositionNormalTexture(position, normal, uv));
+  };
+
+  for (const TeapotPatch& patch : TeapotPatches)
+  {
+    for (size_t mirror = 0; mirror < (patch.mirrorZ ? 4u : 2u); ++mirror)
+    {
+      const float scaleX    = (mirror == 1 || mirror == 3) ? -1.0f : 1.0f;
+      const float scaleZ    = (mirror == 2 || mirror == 3) ? -1.0f : 1.0f;
+      const bool isMirrored = (mirror == 1 || mirror == 2);
+
+      XMVECTOR controlPoints[16];
+      for (int i = 0; i < 16; ++i)
+      {
+        const TeapotControlPoint& point = TeapotControlPoints[patch.indices[i]];
+        controlPoints[i] =
+          XMVectorSet(point.x * scaleX, point.y, point.z * scaleZ, 0.0f);
+      }
+
+      const size_t vbase = vertices.size();
+      Bezier::CreatePatchIndices(tessellation, isMirrored, [&](size_t index) {
+        indices.push_back(vbase + index);
+      });
+
+      if (basis)
+      {
+        Bezier::CreatePatchVertices(controlPoints, *basis, isMirrored, output);
+      }
+      else
+      {
+        Bezier::CreatePatchVertices(
+          controlPoints, tessellation, isMirrored, output);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Compares the baked teapot at a tessellation with both runtime evaluations,
+// and times the runtime tessellation ComputeTeapot would otherwise do against
+// GeometricPrimitive::CreateTeapot's copy of the tables.
+template<size_t Tessellation>
+Result
+Check(int runs)
+{
+  const BakedTeapot<Tessellation>& baked = BakedTeapotData<Tessellation>;
+
+  Vertices generic;
+  Vertices tabled;
+  std::vector<size_t> indices;
+  Tessellate(Tessellation, nullptr, generic, indices);
+
+  std::vector<double> runtimeMs;
+  for (int run = 0; run < runs; ++run)
+  {
+    double start = Bench::NowMs();
+    const Bezier::PatchBasis basis(Tessellation);
+    Tessellate(Tessellation, &basis, tabled, indices);
+    runtimeMs.push_back(Bench::NowMs() - start);
+  }
+
+  Result result = {};
+  size_t vertex = 0;
+  size_t index  = 0;
+  for (const auto& bakedCopy : baked.copies)
+  {
+    for (const BakedVertex& v : bakedCopy.vertices)
+    {
+      const VertexPositionNormalTexture& g = generic[vertex];
+      const VertexPositionNormalTexture& t = tabled[vertex];
+      result.genericPositionError = std::max(
+        result.genericPositionError,
+        MaxDifference(v.position, &g.position.x, 3));
+      result.genericNormalError = std::max(
+        result.genericNormalError, MaxDifference(v.normal, &g.normal.x, 3));
+      result.tablesPositionError = std::max(
+        result.tablesPositionError,
+        MaxDifference(v.position, &t.position.x, 3));
+      result.tablesNormalError = std::max(
+        result.tablesNormalError, MaxDifference(v.normal, &t.normal.x, 3));
+      if (MaxDifference(v.textureCoordinate, &g.textureCoordinate.x, 2) > 0)
+      {
+        ++result.mismatches;
+      }
+      ++vertex;
+    }
+    for (uint16_t i : bakedCopy.indices)
+    {
+      result.mismatches += (i != indices[index++]);
+    }
+  }
+  result.vertexCount = vertex;
+
+  std::vector<double> bakedMs;
+  Vertices vertices;
+  std::vector<uint16_t> bakedIndices;
+  for (int run = 0; run < runs; ++run)
+  {
+    double start = Bench::NowMs();
+    GeometricPrimitive::CreateTeapot(
+      vertices, bakedIndices, 1.0f, Tessellation);
+    bakedMs.push_back(Bench::NowMs() - start);
+  }
+
+  result.runtimeMs = Bench::Summarize(runtimeMs).p50;
+  result.bakedMs   = Bench::Summarize(bakedMs).p50;
+  return result;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Compares each teapot baked into DirectXTK at compile time with the same
+// tessellation computed at runtime, through the generic Bezier templates and
+// through the PatchBasis tables that ComputeTeapot uses at other levels, and
+// times GeometricPrimitive::CreateTeapot, which copies the baked tables,
+// against the runtime tessellation. Texture coordinates and indices must match
+// exactly, positions and normals to within --max-error.
+//------------------------------------------------------------------------------
+int
+Bench::RunBakedBench(const Options& options)
+{
+  const int runs        = std::max(1, options.GetInt(L"runs", 20));
+  const double maxError = options.GetDouble(L"max-error", 1.0e-5);
+
+  const std::pair<size_t, Result> results[] = {
+    {1, Check<1>(runs)},
+    {2, Check<2>(runs)},
+    {4, Check<4>(runs)},
+    {8, Check<8>(runs)},
+  };
+
+  printf("baked: %d runs, median times\n", runs);
+  printf(
+    "%5s %9s %11s %11s %11s %11s %8s %11s %10s\n",
+    "tess",
+    "vertices",
+    "generic pos",
+    "normal",
+    "tables pos",
+    "normal",
+    "exact",
+    "runtime ms",
+    "baked ms");
+
+  int exitCode = 0;
+  for (const auto& entry : results)
+  {
+    const Result& r = entry.second;
+    printf(
+      "%5zu %9zu %11.2e %11.2e %11.2e %11.2e %8s %11.4f %10.4f\n",
+      entry.first,
+      r.vertexCount,
+      r.genericPositionError,
+      r.genericNormalError,
+      r.tablesPositionError,
+      r.tablesNormalError,
+      r.mismatches == 0 ? "yes" : "no",
+      r.runtimeMs,
+      r.bakedMs);
+
+    const float largest = std::max(
+      std::max(r.genericPositionError, r.genericNormalError),
+      std::max(r.tablesPositionError, r.tablesNormalError));
+    if (r.mismatches > 0 || largest > maxError)
+    {
+      printf("  FAIL: baked tables differ from the runtime generator\n");
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
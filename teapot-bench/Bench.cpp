@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "Bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+//------------------------------------------------------------------------------
+Bench::Options::Options(int argc, wchar_t* argv[])
+{
+  for (int i = 0; i < argc; ++i)
+  {
+    std::wstring arg = argv[i];
+    if (arg.compare(0, 2, L"--") != 0 || arg.size() == 2)
+    {
+      throw std::invalid_argument("unexpected argument");
+    }
+
+    std::wstring value;
+    if (i + 1 < argc && std::wstring(argv[i + 1]).compare(0, 2, L"--") != 0)
+    {
+      value = argv[++i];
+    }
+    m_values.emplace_back(arg.substr(2), value);
+  }
+}
+
+//------------------------------------------------------------------------------
+const std::wstring*
+Bench::Options::Find(const wchar_t* name) const
+{
+  // Later options override earlier ones.
+  for (auto it = m_values.rbegin(); it != m_values.rend(); ++it)
+  {
+    if (it->first == name)
+    {
+      return &it->second;
+    }
+  }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool
+Bench::Options::Has(const wchar_t* name) const
+{
+  return Find(name) != nullptr;
+}
+
+//------------------------------------------------------------------------------
+int
+Bench::Options::GetInt(const wchar_t* name, int defaultValue) const
+{
+  const std::wstring* value = Find(name);
+  return value ? std::stoi(*value) : defaultValue;
+}
+
+//------------------------------------------------------------------------------
+double
+Bench::Options::GetDouble(const wchar_t* name, double defaultValue) const
+{
+  const std::wstring* value = Find(name);
+  return value ? std::stod(*value) : defaultValue;
+}
+
+//------------------------------------------------------------------------------
+std::wstring
+Bench::Options::GetString(
+  const wchar_t* name, const wchar_t* defaultValue) const
+{
+  const std::wstring* value = Find(name);
+  return value ? *value : std::wstring(defaultValue);
+}
+
+//------------------------------------------------------------------------------
+std::vector<int>
+Bench::Options::GetIntList(
+  const wchar_t* name, const std::vector<int>& defaultValue) const
+{
+  const std::wstring* value = Find(name);
+  if (!value)
+  {
+    return defaultValue;
+  }
+
+  std::vector<int> result;
+  std::wstringstream stream(*value);
+  std::wstring item;
+  while (std::getline(stream, item, L','))
+  {
+    result.push_back(std::stoi(item));
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+Bench::Summary
+Bench::Summarize(std::vector<double> samples)
+{
+  Summary summary;
+  if (samples.empty())
+  {
+    return summary;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  auto percentile = [&samples](double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+    return samples[std::min(std::max(rank, size_t(1)), samples.size()) - 1];
+  };
+
+  summary.min  = samples.front();
+  summary.max  = samples.back();
+  summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0)
+                 / samples.size();
+  summary.p50 = percentile(0.50);
+  summary.p95 = percentile(0.95);
+  summary.p99 = percentile(0.99);
+  return summary;
+}
+
+//------------------------------------------------------------------------------
+double
+Bench::NowMs()
+{
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+    .count();
+}
+
+//------------------------------------------------------------------------------
+namespace
+{
+using Vertices = Bench::Shape::Vertices;
+using Indices  = Bench::Shape::Indices;
+
+struct Solid
+{
+  const char* name;
+  void (*create)(Vertices&, Indices&, float, bool);
+};
+
+const Solid SOLIDS[] = {
+  {"cube", DirectX::GeometricPrimitive::CreateCube},
+  {"tetrahedron", DirectX::GeometricPrimitive::CreateTetrahedron},
+  {"octahedron", DirectX::GeometricPrimitive::CreateOctahedron},
+  {"dodecahedron", DirectX::GeometricPrimitive::CreateDodecahedron},
+  {"icosahedron", DirectX::GeometricPrimitive::CreateIcosahedron},
+};
+}    // namespace
+
+//------------------------------------------------------------------------------
+std::vector<Bench::Shape>
+Bench::CreateShapes(const std::vector<int>& tessellations)
+{
+  using GP = DirectX::GeometricPrimitive;
+
+  std::vector<Shape> shapes;
+  for (const Solid& solid : SOLIDS)
+  {
+    auto create = solid.create;
+    shapes.push_back(
+      {solid.name, [=](Vertices& v, Indices& i) { create(v, i, 1.0f, true); }});
+  }
+
+  for (int tessellation : tessellations)
+  {
+    const size_t t = static_cast<size_t>(std::max(3, tessellation));
+    // Each level of a geosphere quadruples its triangles.
+    const size_t levels      = std::min<size_t>(t / 4 + 1, 5);
+    const std::string suffix = " " + std::to_string(t);
+
+    shapes.push_back({"sphere" + suffix, [=](Vertices& v, Indices& i) {
+                        GP::CreateSphere(v, i, 1.0f, t);
+                      }});
+    shapes.push_back({"geosphere" + suffix, [=](Vertices& v, Indices& i) {
+                        GP::CreateGeoSphere(v, i, 1.0f, levels);
+                      }});
+    shapes.push_back({"cylinder" + suffix, [=](Vertices& v, Indices& i) {
+                        GP::CreateCylinder(v, i, 1.0f, 1.0f, t);
+                      }});
+    shapes.push_back({"cone" + suffix, [=](Vertices& v, Indices& i) {
+                        GP::CreateCone(v, i, 1.0f, 1.0f, t);
+                      }});
+    shapes.push_back({"torus" + suffix, [=](Vertices& v, Indices& i) {
+                        GP::CreateTorus(v, i, 1.0f, 0.333f, t);
+                      }});
+    shapes.push_back({"teapot" + suffix, [=](Vertices& v, Indices& i) {
+                        GP::CreateTeapot(v, i, 1.0f, t);
+                      }});
+  }
+  return shapes;
+}
+
+//------------------------------------------------------------------------------
+void
+Bench::CreateWarpDevice(
+  Microsoft::WRL::ComPtr<ID3D11Device>& device,
+  Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context)
+{
+  static const D3D_FEATURE_LEVEL featureLevels[] = {
+    D3D_FEATURE_LEVEL_11_0,
+    D3D_FEATURE_LEVEL_10_1,
+    D3D_FEATURE_LEVEL_10_0,
+  };
+
+  DX::ThrowIfFailed(D3D11CreateDevice(
+    nullptr,
+    D3D_DRIVER_TYPE_WARP,
+    nullptr,
+    0,
+    featureLevels,
+    _countof(featureLevels),
+    D3D11_SDK_VERSION,
+    device.ReleaseAndGetAddressOf(),
+    nullptr,
+    context.ReleaseAndGetAddressOf()));
+}
+
+//------------------------------------------------------------------------------
+namespace
+{
+std::atomic<uint64_t> g_allocationCount(0);
+std::atomic<uint64_t> g_allocationBytes(0);
+}    // namespace
+
+//------------------------------------------------------------------------------
+Bench::AllocationCounts
+Bench::GetAllocationCounts()
+{
+  AllocationCounts counts;
+  counts.count = g_allocationCount.load(std::memory_order_relaxed);
+  counts.bytes = g_allocationBytes.load(std::memory_order_relaxed);
+  return counts;
+}
+
+//------------------------------------------------------------------------------
+// Replacing the global allocation functions counts every allocation in the
+// tool, including those of the standard library and the thread pool. The
+// array and nothrow forms forward to these by default.
+//------------------------------------------------------------------------------
+void*
+operator new(size_t size)
+{
+  g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+  g_allocationBytes.fetch_add(size, std::memory_order_relaxed);
+
+  void* block = malloc(size ? size : 1);
+  if (!block)
+  {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+//------------------------------------------------------------------------------
+void
+operator delete(void* block) noexcept
+{
+  free(block);
+}
+
+//------------------------------------------------------------------------------
+void
+operator delete(void* block, size_t) noexcept
+{
+  free(block);
+}
+
+//------------------------------------------------------------------------------
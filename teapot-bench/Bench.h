@@ -0,0 +1,109 @@
+//
+// Bench.h - Shared helpers for the teapot-bench command line tool
+//
+
+#pragma once
+
+#include "pch.h"
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Bench
+{
+// Options of the form "--name value" or "--flag" following the mode name.
+class Options
+{
+public:
+  Options(int argc, wchar_t* argv[]);
+
+  bool Has(const wchar_t* name) const;
+  int GetInt(const wchar_t* name, int defaultValue) const;
+  double GetDouble(const wchar_t* name, double defaultValue) const;
+  std::wstring
+  GetString(const wchar_t* name, const wchar_t* defaultValue) const;
+
+  // Comma separated list, e.g. "--threads 1,2,4".
+  std::vector<int>
+  GetIntList(const wchar_t* name, const std::vector<int>& defaultValue) const;
+
+private:
+  const std::wstring* Find(const wchar_t* name) const;
+
+  std::vector<std::pair<std::wstring, std::wstring>> m_values;
+};
+
+//------------------------------------------------------------------------------
+struct Summary
+{
+  double min  = 0.0;
+  double mean = 0.0;
+  double p50  = 0.0;
+  double p95  = 0.0;
+  double p99  = 0.0;
+  double max  = 0.0;
+};
+
+// Nearest-rank percentiles of the samples.
+Summary Summarize(std::vector<double> samples);
+
+// Milliseconds on a monotonic clock.
+double NowMs();
+
+// Heap allocations made through operator new, by any thread, since start-up.
+struct AllocationCounts
+{
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+};
+
+AllocationCounts GetAllocationCounts();
+
+// Output of one of GeometricPrimitive's generators.
+struct Shape
+{
+  using Vertices = std::vector<DirectX::GeometricPrimitive::VertexType>;
+  using Indices  = std::vector<uint32_t>;
+
+  std::string name;
+  std::function<void(Vertices&, Indices&)> generate;
+};
+
+// Every generator at its default size, the tessellated ones at each of the
+// given tessellations.
+std::vector<Shape> CreateShapes(const std::vector<int>& tessellations);
+
+// A device on the WARP software rasterizer, for modes that only need D3D to
+// accept their calls, not to draw quickly.
+void CreateWarpDevice(
+  Microsoft::WRL::ComPtr<ID3D11Device>& device,
+  Microsoft::WRL::ComPtr<ID3D11DeviceContext>& context);
+
+//------------------------------------------------------------------------------
+// Modes
+//------------------------------------------------------------------------------
+int RunBakedBench(const Options& options);
+int RunBezierBench(const Options& options);
+int RunBvhBench(const Options& options);
+int RunCacheBench(const Options& options);
+int RunCommandBench(const Options& options);
+int RunCpuBench(const Options& options);
+int RunCullBench(const Options& options);
+int RunEffectBench(const Options& options);
+int RunFramesBench(const Options& options);
+int RunGeometryBench(const Options& options);
+int RunLoadBench(const Options& options);
+int RunLodBench(const Options& options);
+int RunMeshletBench(const Options& options);
+int RunPacingBench(const Options& options);
+int RunPackedBench(const Options& options);
+int RunPickBench(const Options& options);
+int RunPowerBench(const Options& options);
+int RunProfileBench(const Options& options);
+int RunRecordBench(const Options& options);
+int RunShadeBench(const Options& options);
+int RunTessellateBench(const Options& options);
+int RunTimerBench(const Options& options);
+}
@@ -0,0 +1,192 @@
+//
+// BenchMain.cpp - Entry point of the teapot-bench command line tool
+//
+
+#include "pch.h"
+#include "Bench.h"
+
+using namespace DirectX;
+
+// Game calls this on Escape and on fatal errors. The benchmarks own the loop
+// and never create a window, so there is nothing to tear down.
+void
+ExitGame()
+{
+}
+
+namespace
+{
+struct Mode
+{
+  const wchar_t* name;
+  int (*run)(const Bench::Options&);
+  const char* usage;
+};
+
+const Mode MODES[] = {
+  {L"baked",
+   Bench::RunBakedBench,
+   "Teapots baked into DirectXTK at compile time against the runtime\n"
+   "      generator; fails on any difference over --max-error\n"
+   "      --runs 20 --max-error 1e-5"},
+  {L"bezier",
+   Bench::RunBezierBench,
+   "Bezier::CreatePatchVertices over the teapot patches, generic templates\n"
+   "      against precomputed basis tables; fails over --max-error\n"
+   "      --tessellation 4,8,16,32,64 --runs 20 --max-error 1e-4"},
+  {L"bvh",
+   Bench::RunBvhBench,
+   "SceneBvh build, refit and frustum/ray query costs against a scan\n"
+   "      --counts 10000,100000,1000000 --queries 100 --moved 1"},
+  {L"cache",
+   Bench::RunCacheBench,
+   "GeometricPrimitive geometry cache: generation against writing and\n"
+   "      loading cached entries, checked bit for bit against the generators\n"
+   "      --tessellation 16,64,128 --runs 10 [--dir <kept cache directory>]"},
+  {L"commands",
+   Bench::RunCommandBench,
+   "RenderCommandList recording per thread count, replayed by the null\n"
+   "      executor\n"
+   "      --draws 100000 --frames 20 --threads 1,2,4,8,16"},
+  {L"cpu",
+   Bench::RunCpuBench,
+   "CPU rasterizer frame times per thread count\n"
+   "      --width 1024 --height 768 --frames 120 --threads 1,2,4,...\n"
+   "      --golden <file.ppm> [--update-golden] [--tolerance 0]"},
+  {L"cull",
+   Bench::RunCullBench,
+   "TeapotField frustum culling and packing throughput, then recording the\n"
+   "      instanced draw into a deferred context (WARP device)\n"
+   "      --teapots 10000 --frames 100 --tessellation 8"},
+  {L"effect",
+   Bench::RunEffectBench,
+   "MyEffect::Apply cost and constant buffer upload counts (WARP device)\n"
+   "      --teapots 10000 --frames 10"},
+  {L"frames",
+   Bench::RunFramesBench,
+   "Game::Tick frame times on a scripted camera path, as JSON\n"
+   "      --width 1024 --height 768 --threads <all> --frames 300 --warmup 30\n"
+   "      --teapots 1 --tessellation 8 --grid-divisions 20 --grid-lod 1"},
+  {L"geometry",
+   Bench::RunGeometryBench,
+   "GeometricPrimitive::Optimize vertex counts and cache miss ratios,\n"
+   "      before and after, for every generator\n"
+   "      --tessellation 8,16,32 [--weld-seams]"},
+  {L"load",
+   Bench::RunLoadBench,
+   "Game device resource creation as a task graph, per loading thread\n"
+   "      count, with the time of each task (recording device)\n"
+   "      --runs 10 --threads 1,2,4,8 --tessellation 8 --grid-divisions 20"},
+  {L"lod",
+   Bench::RunLodBench,
+   "TeapotField level of detail: triangles drawn and instances per level\n"
+   "      for each pixel error threshold (0 for none)\n"
+   "      --teapots 10000 --frames 200 --height 768 --pixel-error 0,1,2,4,8\n"
+   "      --tessellation 32 --levels 6"},
+  {L"meshlets",
+   Bench::RunMeshletBench,
+   "Meshlets frustum and normal cone culling of the teapot along the\n"
+   "      frames path: triangles rejected against a per-triangle backface\n"
+   "      test, and cull time; fails if a visible triangle is dropped\n"
+   "      --tessellation 8,16,32,64 --frames 240 --width 1024 --height 768\n"
+   "      --max-vertices 64 --max-triangles 124"},
+  {L"pacing",
+   Bench::RunPacingBench,
+   "StepTimer frame rate limits: interval error and CPU use per limit\n"
+   "      --fps 0,30,60,120,240 --frames 300 --work-ms 2 [--max-p99-ms 0.5]"},
+  {L"packed",
+   Bench::RunPackedBench,
+   "GeometricPrimitive::PackedVertexType decode error for every generator\n"
+   "      and random vertices, against its documented bounds, with encode\n"
+   "      and decode throughput\n"
+   "      --tessellation 8,16,32,64 --runs 20 --random 1000000"},
+  {L"picking",
+   Bench::RunPickBench,
+   "MeshBvh build time and camera ray picking rate per instruction set and\n"
+   "      on every thread, checked against the scalar path and a linear scan\n"
+   "      --tessellation 8,16,32,64 --runs 10 --width 512 --height 384\n"
+   "      --threads <all> --scan 2048 --max-mismatch 0.001"},
+  {L"power",
+   Bench::RunPowerBench,
+   "Game::Tick rate, renders and skipped frames through activation,\n"
+   "      deactivation, suspension and resumption (recording device); fails\n"
+   "      if an idle state ticks faster than the background rate\n"
+   "      --ticks 60 --fps 60 --teapots 1"},
+  {L"profile",
+   Bench::RunProfileBench,
+   "Profiler zone cost, then per-zone times and a Chrome trace of the\n"
+   "      CPU renderer\n"
+   "      --zones 4194304 --max-ns 50 --width 1024 --height 768 --frames 60\n"
+   "      --trace teapot-bench-trace.json"},
+  {L"record",
+   Bench::RunRecordBench,
+   "Game::Tick on a recording device: per-frame calls, state changes, draws\n"
+   "      and upload bytes, as JSON; fails when over any --max limit\n"
+   "      --width 1024 --height 768 --frames 120 --teapots 1 --tessellation 8\n"
+   "      --grid-divisions 20 --grid-lod 1 --max-draws 0\n"
+   "      --max-state-changes 0 --max-upload-kb 0"},
+  {L"shade",
+   Bench::RunShadeBench,
+   "ShadingKernel speed and accuracy per instruction set\n"
+   "      --count 1048576 --runs 20 --max-ulp 128"},
+  {L"tessellate",
+   Bench::RunTessellateBench,
+   "GeometricPrimitive::CreateTeapot time per thread count, checked\n"
+   "      against the serial output bit for bit\n"
+   "      --tessellation 64,128 --threads 1,2,4,8,16 --runs 10"},
+  {L"timer",
+   Bench::RunTimerBench,
+   "StepTimer fixed/variable timestep replay with a scripted clock\n"
+   "      --ticks 100000 --seed 1 --jitter-ms 2 --hitch-rate 0.01"},
+};
+
+//------------------------------------------------------------------------------
+void
+PrintUsage()
+{
+  printf("usage: teapot-bench <mode> [options]\n\nmodes:\n");
+  for (const auto& mode : MODES)
+  {
+    printf("  %ls\n      %s\n", mode.name, mode.usage);
+  }
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+int
+wmain(int argc, wchar_t* argv[])
+{
+  if (!XMVerifyCPUSupport())
+  {
+    return 1;
+  }
+
+  if (argc < 2)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  for (const auto& mode : MODES)
+  {
+    if (wcscmp(argv[1], mode.name) != 0)
+    {
+      continue;
+    }
+
+    try
+    {
+      return mode.run(Bench::Options(argc - 2, argv + 2));
+    }
+    catch (const std::exception& e)
+    {
+      fprintf(stderr, "teapot-bench %ls: %s\n", mode.name, e.what());
+      return 1;
+    }
+  }
+
+  PrintUsage();
+  return 1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,159 @@
+//
+// BezierBench.cpp - "bezier" mode: teapot patch evaluation, generic and tabled
+//
+
+#include "pch.h"
+#include "Bench.h"
+
+// DirectXTK's own Bezier helpers and teapot patches, which aren't part of its
+// public headers.
+#include "../DirectXTK-dec2017/Src/Bezier.h"
+
+using namespace DirectX;
+
+namespace
+{
+#include "../DirectXTK-dec2017/Src/TeapotData.inc"
+
+using Vertices = std::vector<VertexPositionNormalTexture>;
+
+//------------------------------------------------------------------------------
+// Evaluates every teapot patch, as stored and mirrored, into vertices, with the
+// generic templates or, given a tessellation's PatchBasis, with the tables.
+void
+Evaluate(
+  size_t tessellation,
+  const Bezier::PatchBasis* basis,
+  Vertices& vertices)
+{
+  vertices.clear();
+  auto output = [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR uv) {
+    vertices.push_back(VertexPositionNormalTexture(position, normal, uv));
+  };
+
+  for (const TeapotPatch& patch : TeapotPatches)
+  {
+    XMVECTOR controlPoints[16];
+    for (int i = 0; i < 16; ++i)
+    {
+      const TeapotControlPoint& point = TeapotControlPoints[patch.indices[i]];
+      controlPoints[i] = XMVectorSet(point.x, point.y, point.z, 0.0f);
+    }
+
+    for (bool isMirrored : {false, true})
+    {
+      if (basis)
+      {
+        Bezier::CreatePatchVertices(controlPoints, *basis, isMirrored, output);
+      }
+      else
+      {
+        Bezier::CreatePatchVertices(
+          controlPoints, tessellation, isMirrored, output);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+float
+MaxDifference(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+  return std::max(
+    std::abs(a.x - b.x), std::max(std::abs(a.y - b.y), std::abs(a.z - b.z)));
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Times Bezier::CreatePatchVertices over the teapot's patches, first through
+// the generic CubicInterpolate and CubicTangent templates, then through the
+// PatchBasis tables (including building them), and reports the speedup and
+// the largest difference in any position or normal component between the two.
+// Fails if that exceeds --max-error.
+//------------------------------------------------------------------------------
+int
+Bench::RunBezierBench(const Options& options)
+{
+  const auto tessellations =
+    options.GetIntList(L"tessellation", {4, 8, 16, 32, 64});
+  const int runs        = std::max(1, options.GetInt(L"runs", 20));
+  const double maxError = options.GetDouble(L"max-error", 1.0e-4);
+
+  printf(
+    "bezier: %zu patches, %d runs, median times\n",
+    2 * _countof(TeapotPatches),
+    runs);
+  printf(
+    "%6s %9s %11s %11s %10s %10s %8s %11s %11s\n",
+    "tess",
+    "vertices",
+    "generic ms",
+    "tables ms",
+    "ns/vertex",
+    "ns/vertex",
+    "speedup",
+    "pos error",
+    "norm error");
+
+  int exitCode = 0;
+  for (int tessellation : tessellations)
+  {
+    const size_t t = static_cast<size_t>(std::max(1, tessellation));
+
+    Vertices generic;
+    Vertices tabled;
+    std::vector<double> genericMs;
+    std::vector<double> tabledMs;
+    for (int run = 0; run < runs; ++run)
+    {
+      double start = NowMs();
+      Evaluate(t, nullptr, generic);
+      genericMs.push_back(NowMs() - start);
+
+      start = NowMs();
+      Bezier::PatchBasis basis(t);
+      Evaluate(t, &basis, tabled);
+      tabledMs.push_back(NowMs() - start);
+    }
+
+    if (tabled.size() != generic.size())
+    {
+      throw std::logic_error("Bezier tables produced a different vertex count");
+    }
+
+    float positionError = 0.0f;
+    float normalError   = 0.0f;
+    for (size_t i = 0; i < generic.size(); ++i)
+    {
+      positionError = std::max(
+        positionError, MaxDifference(generic[i].position, tabled[i].position));
+      normalError = std::max(
+        normalError, MaxDifference(generic[i].normal, tabled[i].normal));
+    }
+
+    Summary g              = Summarize(genericMs);
+    Summary r              = Summarize(tabledMs);
+    const double perVertex = 1.0e6 / static_cast<double>(generic.size());
+    printf(
+      "%6zu %9zu %11.3f %11.3f %10.2f %10.2f %7.2fx %11.2e %11.2e\n",
+      t,
+      generic.size(),
+      g.p50,
+      r.p50,
+      g.p50 * perVertex,
+      r.p50 * perVertex,
+      g.p50 / std::max(r.p50, 1.0e-6),
+      positionError,
+      normalError);
+
+    if (positionError > maxError || normalError > maxError)
+    {
+      printf("  FAIL: tables differ from the generic evaluation\n");
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
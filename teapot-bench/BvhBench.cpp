@@ -0,0 +1,291 @@
+//
+// BvhBench.cpp - "bvh" mode: SceneBvh build, refit and query costs
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "SceneBvh.h"
+
+#include <cfloat>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Boxes of a few sizes scattered through a cube, at roughly the same density
+// whatever their number.
+std::vector<BoundingBox>
+MakeObjects(size_t count, std::mt19937& rng, float& side)
+{
+  side = 2.0f * std::cbrt(static_cast<float>(count));
+  std::uniform_real_distribution<float> position(-0.5f * side, 0.5f * side);
+  std::uniform_real_distribution<float> extent(0.2f, 0.8f);
+
+  std::vector<BoundingBox> objects(count);
+  for (auto& object : objects)
+  {
+    object.Center  = XMFLOAT3(position(rng), position(rng), position(rng));
+    object.Extents = XMFLOAT3(extent(rng), extent(rng), extent(rng));
+  }
+  return objects;
+}
+
+//------------------------------------------------------------------------------
+// A camera inside the cube looking in a random direction, seeing a quarter of
+// the way across it.
+struct Camera
+{
+  XMFLOAT3 position;
+  XMFLOAT3 forward;
+  XMVECTOR planes[6];
+};
+
+Camera
+MakeCamera(float side, std::mt19937& rng)
+{
+  std::uniform_real_distribution<float> position(-0.4f * side, 0.4f * side);
+  std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+  Camera camera;
+  camera.position = XMFLOAT3(position(rng), position(rng), position(rng));
+  XMVECTOR eye    = XMLoadFloat3(&camera.position);
+  XMVECTOR forward;
+  do
+  {
+    forward = XMVectorSet(direction(rng), direction(rng), direction(rng), 0.0f);
+  } while (XMVectorGetX(XMVector3LengthSq(forward)) < 0.01f);
+  forward = XMVector3Normalize(forward);
+  XMStoreFloat3(&camera.forward, forward);
+
+  XMVECTOR up = fabsf(XMVectorGetY(forward)) > 0.9f ? g_XMIdentityR0
+                                                    : g_XMIdentityR1;
+  XMMATRIX view       = XMMatrixLookAtRH(eye, XMVectorAdd(eye, forward), up);
+  XMMATRIX projection = XMMatrixPerspectiveFovRH(
+    XMConvertToRadians(70.0f), 16.0f / 9.0f, 0.1f, 0.25f * side);
+
+  // Outward facing clip planes of view * projection (Gribb & Hartmann).
+  XMMATRIX columns = XMMatrixTranspose(XMMatrixMultiply(view, projection));
+  camera.planes[0] = XMVectorAdd(columns.r[3], columns.r[0]);
+  camera.planes[1] = XMVectorSubtract(columns.r[3], columns.r[0]);
+  camera.planes[2] = XMVectorAdd(columns.r[3], columns.r[1]);
+  camera.planes[3] = XMVectorSubtract(columns.r[3], columns.r[1]);
+  camera.planes[4] = columns.r[2];
+  camera.planes[5] = XMVectorSubtract(columns.r[3], columns.r[2]);
+  for (auto& plane : camera.planes)
+  {
+    plane = XMVectorNegate(XMPlaneNormalize(plane));
+  }
+  return camera;
+}
+
+//------------------------------------------------------------------------------
+size_t
+CountInFrustum(
+  const std::vector<BoundingBox>& objects, const XMVECTOR planes[6])
+{
+  size_t count = 0;
+  for (const auto& object : objects)
+  {
+    ContainmentType containment = object.ContainedBy(
+      planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]);
+    if (containment != DISJOINT)
+    {
+      ++count;
+    }
+  }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+float XM_CALLCONV
+NearestHit(
+  const std::vector<BoundingBox>& objects,
+  FXMVECTOR origin,
+  FXMVECTOR direction)
+{
+  float nearest = FLT_MAX;
+  for (const auto& object : objects)
+  {
+    float distance;
+    if (object.Intersects(origin, direction, distance))
+    {
+      nearest = std::min(nearest, std::max(distance, 0.0f));
+    }
+  }
+  return nearest;
+}
+
+//------------------------------------------------------------------------------
+struct Result
+{
+  double buildMs       = 0.0;
+  double refitFewMs    = 0.0;
+  double refitAllMs    = 0.0;
+  double frustumBvhUs  = 0.0;
+  double frustumScanUs = 0.0;
+  double rayBvhUs      = 0.0;
+  double rayScanUs     = 0.0;
+  double visible       = 0.0;
+  size_t nodes         = 0;
+  size_t mismatches    = 0;
+};
+
+//------------------------------------------------------------------------------
+Result
+Measure(size_t count, int queries, double movedFraction)
+{
+  std::mt19937 rng(1);
+  float side;
+  std::vector<BoundingBox> objects = MakeObjects(count, rng, side);
+
+  Result result;
+  DX::SceneBvh bvh;
+  double start = Bench::NowMs();
+  bvh.Build(objects);
+  result.buildMs = Bench::NowMs() - start;
+  result.nodes   = bvh.GetNodeCount();
+
+  // Refit after nudging a few objects, then all of them.
+  std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+  std::uniform_int_distribution<size_t> pick(0, count - 1);
+  auto move = [&](size_t i) {
+    objects[i].Center.x += nudge(rng);
+    objects[i].Center.y += nudge(rng);
+    objects[i].Center.z += nudge(rng);
+  };
+
+  const auto few = std::max<size_t>(
+    1, static_cast<size_t>(movedFraction * static_cast<double>(count)));
+  std::vector<size_t> moved(few);
+  for (auto& i : moved)
+  {
+    i = pick(rng);
+    move(i);
+  }
+  start = Bench::NowMs();
+  for (size_t i : moved)
+  {
+    bvh.UpdateObject(static_cast<uint32_t>(i), objects[i]);
+  }
+  bvh.Refit();
+  result.refitFewMs = Bench::NowMs() - start;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    move(i);
+  }
+  start = Bench::NowMs();
+  for (size_t i = 0; i < count; ++i)
+  {
+    bvh.UpdateObject(static_cast<uint32_t>(i), objects[i]);
+  }
+  bvh.Refit();
+  result.refitAllMs = Bench::NowMs() - start;
+
+  // Queries against the refitted tree, checked against a scan of every object.
+  std::vector<uint32_t> found;
+  found.reserve(count);
+  double frustumBvhMs   = 0.0;
+  double frustumScanMs  = 0.0;
+  double rayBvhMs       = 0.0;
+  double rayScanMs      = 0.0;
+  uint64_t visibleTotal = 0;
+  for (int query = 0; query < queries; ++query)
+  {
+    Camera camera = MakeCamera(side, rng);
+
+    found.clear();
+    start = Bench::NowMs();
+    bvh.QueryFrustum(camera.planes, found);
+    frustumBvhMs += Bench::NowMs() - start;
+
+    start           = Bench::NowMs();
+    size_t expected = CountInFrustum(objects, camera.planes);
+    frustumScanMs += Bench::NowMs() - start;
+
+    visibleTotal += found.size();
+    result.mismatches += found.size() > expected ? found.size() - expected
+                                                 : expected - found.size();
+
+    XMVECTOR origin    = XMLoadFloat3(&camera.position);
+    XMVECTOR direction = XMLoadFloat3(&camera.forward);
+    float distance;
+    start = Bench::NowMs();
+    bvh.RayCast(origin, direction, FLT_MAX, distance);
+    rayBvhMs += Bench::NowMs() - start;
+
+    start                  = Bench::NowMs();
+    float expectedDistance = NearestHit(objects, origin, direction);
+    rayScanMs += Bench::NowMs() - start;
+
+    if (fabsf(distance - expectedDistance)
+        > 1.0e-4f * std::max(1.0f, expectedDistance))
+    {
+      ++result.mismatches;
+    }
+  }
+
+  result.frustumBvhUs  = 1.0e3 * frustumBvhMs / queries;
+  result.frustumScanUs = 1.0e3 * frustumScanMs / queries;
+  result.rayBvhUs      = 1.0e3 * rayBvhMs / queries;
+  result.rayScanUs     = 1.0e3 * rayScanMs / queries;
+  result.visible =
+    100.0 * static_cast<double>(visibleTotal) / (double(count) * queries);
+  return result;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Builds a SceneBvh over randomly placed boxes at each size, refits it after
+// moving some and then all of them, and times frustum and ray queries against
+// scanning every object, which the query results must also match.
+//------------------------------------------------------------------------------
+int
+Bench::RunBvhBench(const Options& options)
+{
+  const auto counts =
+    options.GetIntList(L"counts", {10000, 100000, 1000000});
+  const int queries = std::max(1, options.GetInt(L"queries", 100));
+  const double moved =
+    std::min(1.0, std::max(0.0, options.GetDouble(L"moved", 1.0) / 100.0));
+
+  int exitCode = 0;
+  for (int count : counts)
+  {
+    if (count < 1)
+    {
+      continue;
+    }
+
+    Result r = Measure(static_cast<size_t>(count), queries, moved);
+    printf("bvh: %d objects, %d queries\n", count, queries);
+    printf("  build    %9.2f ms, %zu nodes\n", r.buildMs, r.nodes);
+    printf(
+      "  refit    %9.3f ms with %.1f%% moved, %.3f ms with all moved\n",
+      r.refitFewMs,
+      100.0 * moved,
+      r.refitAllMs);
+    printf(
+      "  frustum  %9.2f us/query, scan %9.2f us (%.1fx), %.2f%% visible\n",
+      r.frustumBvhUs,
+      r.frustumScanUs,
+      r.frustumScanUs / std::max(r.frustumBvhUs, 1.0e-3),
+      r.visible);
+    printf(
+      "  ray      %9.2f us/query, scan %9.2f us (%.1fx)\n",
+      r.rayBvhUs,
+      r.rayScanUs,
+      r.rayScanUs / std::max(r.rayBvhUs, 1.0e-3));
+
+    if (r.mismatches > 0)
+    {
+      printf("  FAIL: %zu results differ from the scan\n", r.mismatches);
+      exitCode = 1;
+    }
+  }
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
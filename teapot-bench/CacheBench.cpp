@@ -0,0 +1,188 @@
+//
+// CacheBench.cpp - "cache" mode: GeometricPrimitive on-disk geometry cache
+//
+
+#include "pch.h"
+#include "Bench.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+template<typename T>
+bool
+SameBits(const std::vector<T>& a, const std::vector<T>& b)
+{
+  return a.size() == b.size()
+         && memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+//------------------------------------------------------------------------------
+// A new directory under the user's temporary directory.
+std::wstring
+CreateTempDirectory()
+{
+  wchar_t temp[MAX_PATH] = {};
+  if (!GetTempPathW(MAX_PATH, temp))
+  {
+    throw std::runtime_error("GetTempPath");
+  }
+
+  std::wstring directory = std::wstring(temp) + L"teapot-bench-cache-"
+                           + std::to_wstring(GetCurrentProcessId());
+  if (!CreateDirectoryW(directory.c_str(), nullptr))
+  {
+    throw std::runtime_error("CreateDirectory");
+  }
+  return directory;
+}
+
+//------------------------------------------------------------------------------
+// Deletes the cache entries in directory, then directory itself.
+void
+RemoveCacheDirectory(const std::wstring& directory)
+{
+  WIN32_FIND_DATAW found;
+  HANDLE find = FindFirstFileExW(
+    (directory + L"\\*.vbo*").c_str(),
+    FindExInfoBasic,
+    &found,
+    FindExSearchNameMatch,
+    nullptr,
+    0);
+  if (find != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      DeleteFileW((directory + L"\\" + found.cFileName).c_str());
+    } while (FindNextFileW(find, &found));
+    FindClose(find);
+  }
+  RemoveDirectoryW(directory.c_str());
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Generates every shape with the cache off, then with it on: once to miss and
+// write the entry, then repeatedly to load it. Reports the median time of
+// each and the entry's size, and fails if a load differs in any bit from the
+// generated geometry or the cache stats don't add up. The cache lives in a
+// new temporary directory unless --dir names one, which is then kept, so that
+// a second run measures loads by a fresh process.
+//------------------------------------------------------------------------------
+int
+Bench::RunCacheBench(const Options& options)
+{
+  const auto tessellations =
+    options.GetIntList(L"tessellation", {16, 64, 128});
+  const int runs = std::max(1, options.GetInt(L"runs", 10));
+
+  const bool keep = options.Has(L"dir");
+  const std::wstring directory =
+    keep ? options.GetString(L"dir", L"") : CreateTempDirectory();
+
+  printf("cache: %ls, %d runs, median times\n", directory.c_str(), runs);
+  printf(
+    "%-16s %8s %9s %11s %11s %11s %8s\n",
+    "shape",
+    "verts",
+    "KB",
+    "generate ms",
+    "miss ms",
+    "hit ms",
+    "speedup");
+
+  int exitCode = 0;
+  for (const Shape& shape : CreateShapes(tessellations))
+  {
+    Shape::Vertices generated;
+    Shape::Indices generatedIndices;
+    Shape::Vertices vertices;
+    Shape::Indices indices;
+
+    GeometricPrimitive::SetCacheDirectory(nullptr);
+    std::vector<double> generateMs;
+    for (int run = 0; run < runs; ++run)
+    {
+      double start = NowMs();
+      shape.generate(generated, generatedIndices);
+      generateMs.push_back(NowMs() - start);
+    }
+
+    GeometricPrimitive::SetCacheDirectory(directory.c_str());
+    const GeometricPrimitive::CacheStats before =
+      GeometricPrimitive::GetCacheStats();
+
+    // With --dir the entry may be there already, from an earlier run.
+    double start = NowMs();
+    shape.generate(vertices, indices);
+    const double firstMs = NowMs() - start;
+
+    bool same = SameBits(vertices, generated)
+                && SameBits(indices, generatedIndices);
+
+    std::vector<double> hitMs;
+    for (int run = 0; run < runs; ++run)
+    {
+      vertices.clear();
+      indices.clear();
+      start = NowMs();
+      shape.generate(vertices, indices);
+      hitMs.push_back(NowMs() - start);
+      same &= SameBits(vertices, generated)
+              && SameBits(indices, generatedIndices);
+    }
+
+    const GeometricPrimitive::CacheStats after =
+      GeometricPrimitive::GetCacheStats();
+    const size_t hits   = after.hits - before.hits;
+    const size_t misses = after.misses - before.misses;
+    const size_t writes = after.writes - before.writes;
+    const size_t failed = after.writeFailures - before.writeFailures;
+
+    const double generateP50 = Summarize(generateMs).p50;
+    const double hitP50      = Summarize(hitMs).p50;
+    const double bytes =
+      8.0 + generated.size() * sizeof(GeometricPrimitive::VertexType)
+      + generatedIndices.size() * sizeof(uint32_t);
+
+    printf(
+      "%-16s %8zu %9.1f %11.3f %11.3f %11.4f %7.0fx\n",
+      shape.name.c_str(),
+      generated.size(),
+      bytes / 1024.0,
+      generateP50,
+      firstMs,
+      hitP50,
+      hitP50 > 0.0 ? generateP50 / hitP50 : 0.0);
+
+    if (!same)
+    {
+      printf("  FAIL: cached geometry differs from the generator's\n");
+      exitCode = 1;
+    }
+    if (hits + misses != static_cast<size_t>(runs) + 1 || misses != writes
+        || misses > 1 || failed > 0)
+    {
+      printf(
+        "  FAIL: %zu hits, %zu misses, %zu writes, %zu write failures\n",
+        hits,
+        misses,
+        writes,
+        failed);
+      exitCode = 1;
+    }
+  }
+
+  GeometricPrimitive::SetCacheDirectory(nullptr);
+  if (!keep)
+  {
+    RemoveCacheDirectory(directory);
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
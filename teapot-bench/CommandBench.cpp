@@ -0,0 +1,223 @@
+//
+// CommandBench.cpp - "commands" mode: RenderCommandList recording and replay
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "RenderCommandList.h"
+#include "Shader/MyEffectConstants.h"
+#include "ThreadPool.h"
+
+using namespace DirectX;
+
+namespace
+{
+constexpr float TEAPOT_SPACING = 1.5f;
+
+// Stand-ins for device objects. The null executor never dereferences them,
+// only compares them, so distinct addresses are all that is needed.
+struct FakeObjects
+{
+  char inputLayout, vertexBuffer, indexBuffer, constantBuffer;
+  char vertexShader, pixelShader;
+};
+
+template<typename T>
+T*
+Fake(char& object)
+{
+  return reinterpret_cast<T*>(&object);
+}
+
+//------------------------------------------------------------------------------
+// What a non-instanced submission of one teapot looks like: per-draw constants
+// uploaded, the mesh bound and drawn.
+void
+RecordDraws(
+  DX::RenderCommandList& commandList,
+  FakeObjects& objects,
+  const std::vector<XMFLOAT4X4>& worlds,
+  size_t first,
+  size_t count,
+  CXMMATRIX view,
+  CXMMATRIX projection)
+{
+  using DX::RenderCommandList;
+
+  const uint32_t bothStages =
+    RenderCommandList::VERTEX_STAGE | RenderCommandList::PIXEL_STAGE;
+
+  commandList.SetInputLayout(Fake<ID3D11InputLayout>(objects.inputLayout));
+  commandList.SetVertexShader(Fake<ID3D11VertexShader>(objects.vertexShader));
+  commandList.SetPixelShader(Fake<ID3D11PixelShader>(objects.pixelShader));
+  commandList.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+  // An update of an empty instance list, which must record nothing.
+  auto constantBuffer = Fake<ID3D11Buffer>(objects.constantBuffer);
+  commandList.UpdateBuffer(
+    constantBuffer, RenderCommandList::UpdateMode::Discard, nullptr, 0);
+
+  for (size_t i = first; i < first + count; ++i)
+  {
+    auto constants = static_cast<DynamicConstantBuffer*>(
+      commandList.AllocateUpdate(
+        constantBuffer,
+        RenderCommandList::UpdateMode::Discard,
+        sizeof(DynamicConstantBuffer)));
+    ComputeDynamicConstants(
+      *constants, XMLoadFloat4x4(&worlds[i]), view, projection);
+
+    commandList.SetConstantBuffer(bothStages, 1, constantBuffer);
+    commandList.SetVertexBuffer(
+      0,
+      Fake<ID3D11Buffer>(objects.vertexBuffer),
+      sizeof(VertexPositionNormalTexture));
+    commandList.SetIndexBuffer(
+      Fake<ID3D11Buffer>(objects.indexBuffer), DXGI_FORMAT_R16_UINT);
+    commandList.DrawIndexed(6144);
+  }
+}
+
+//------------------------------------------------------------------------------
+struct Result
+{
+  Bench::Summary recordMs;
+  Bench::Summary executeMs;
+  DX::NullCommandExecutor::Stats stats;
+};
+
+Result
+Measure(
+  size_t threads,
+  int frames,
+  const std::vector<XMFLOAT4X4>& worlds,
+  FakeObjects& objects)
+{
+  DX::ThreadPool pool(static_cast<int>(threads) - 1);
+
+  // One list per thread, each taking a contiguous run of draws, so executing
+  // them in order replays the draws in their original order.
+  std::vector<DX::RenderCommandList> lists(threads);
+  const size_t perList = (worlds.size() + threads - 1) / threads;
+
+  DX::NullCommandExecutor executor;
+  std::vector<double> recordMs;
+  std::vector<double> executeMs;
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    float angle   = frame * 0.01f;
+    XMMATRIX view = XMMatrixLookAtRH(
+      XMVectorSet(10.0f * sinf(angle), 7.0f, 10.0f * cosf(angle), 0.0f),
+      g_XMZero,
+      g_XMIdentityR1);
+    XMMATRIX projection = XMMatrixPerspectiveFovRH(
+      XMConvertToRadians(70.0f), 4.0f / 3.0f, 0.01f, 100.0f);
+
+    double start = Bench::NowMs();
+    pool.ParallelFor(threads, [&](size_t index) {
+      DX::RenderCommandList& commandList = lists[index];
+      commandList.Clear();
+
+      size_t first = std::min(index * perList, worlds.size());
+      size_t count = std::min(perList, worlds.size() - first);
+      RecordDraws(
+        commandList, objects, worlds, first, count, view, projection);
+    });
+    recordMs.push_back(Bench::NowMs() - start);
+
+    start = Bench::NowMs();
+    for (const auto& commandList : lists)
+    {
+      executor.Execute(commandList);
+    }
+    executeMs.push_back(Bench::NowMs() - start);
+  }
+
+  Result result;
+  result.recordMs  = Bench::Summarize(recordMs);
+  result.executeMs = Bench::Summarize(executeMs);
+  result.stats     = executor.GetStats();
+  return result;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Records a frame of per-teapot draws into one command list per thread, then
+// replays the lists with the null executor, separating the CPU cost of
+// building the submission from that of any driver. Every thread count must
+// replay the same draws and upload the same bytes, with one upload per draw:
+// the empty update each list records must leave no command.
+//------------------------------------------------------------------------------
+int
+Bench::RunCommandBench(const Options& options)
+{
+  const int draws  = std::max(1, options.GetInt(L"draws", 100000));
+  const int frames = std::max(1, options.GetInt(L"frames", 20));
+  const auto threadCounts =
+    options.GetIntList(L"threads", {1, 2, 4, 8, 16});
+
+  const int side = static_cast<int>(ceil(sqrt(static_cast<double>(draws))));
+  std::vector<XMFLOAT4X4> worlds(static_cast<size_t>(draws));
+  for (int i = 0; i < draws; ++i)
+  {
+    XMStoreFloat4x4(
+      &worlds[i],
+      XMMatrixTranslation(
+        (i % side) * TEAPOT_SPACING, 0.0f, (i / side) * TEAPOT_SPACING));
+  }
+
+  FakeObjects objects;
+  printf("commands: %d draws, %d frames\n", draws, frames);
+
+  int exitCode      = 0;
+  double baselineMs = 0.0;
+  uint64_t checksum = 0;
+  bool haveBaseline = false;
+  for (int threads : threadCounts)
+  {
+    if (threads < 1)
+    {
+      continue;
+    }
+
+    Result r = Measure(static_cast<size_t>(threads), frames, worlds, objects);
+    if (!haveBaseline)
+    {
+      baselineMs   = r.recordMs.mean;
+      checksum     = r.stats.checksum;
+      haveBaseline = true;
+
+      printf(
+        "  per frame: %llu commands, %.2f MB uploaded, %llu redundant sets\n",
+        static_cast<unsigned long long>(r.stats.commands / frames),
+        static_cast<double>(r.stats.uploadBytes) / (1.0e6 * frames),
+        static_cast<unsigned long long>(r.stats.redundantSets / frames));
+    }
+
+    printf(
+      "  %2d threads: record %8.3f ms (%5.1f ns/draw, %.2fx), "
+      "execute %8.3f ms (%5.1f ns/draw)\n",
+      threads,
+      r.recordMs.mean,
+      r.recordMs.mean * 1.0e6 / draws,
+      baselineMs / std::max(r.recordMs.mean, 1.0e-6),
+      r.executeMs.mean,
+      r.executeMs.mean * 1.0e6 / draws);
+
+    const uint64_t expectedDraws = uint64_t(draws) * frames;
+    if (r.stats.draws != expectedDraws || r.stats.checksum != checksum)
+    {
+      printf("  FAIL: %d threads replayed different commands\n", threads);
+      exitCode = 1;
+    }
+    if (r.stats.uploads != expectedDraws)
+    {
+      printf("  FAIL: %d threads replayed empty updates\n", threads);
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
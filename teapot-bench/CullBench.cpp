@@ -0,0 +1,231 @@
+//
+// CullBench.cpp - "cull" mode: TeapotField culling and instance recording
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "TeapotField.h"
+#include "Shader/MyEffect.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+constexpr float TEAPOT_SPACING = 1.5f;
+
+//------------------------------------------------------------------------------
+// Orbits Game's camera around the middle of the field.
+XMMATRIX
+CameraView(int frame)
+{
+  float angle = frame * 0.02f;
+  return XMMatrixLookAtRH(
+    XMVectorSet(1.2f * sinf(angle), 0.7f, 1.2f * cosf(angle), 0.0f),
+    XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f),
+    g_XMIdentityR1);
+}
+
+//------------------------------------------------------------------------------
+// Inward facing clip planes of view * projection (Gribb & Hartmann), found
+// independently of BoundingFrustum to check TeapotField::Cull against.
+void XM_CALLCONV
+ExtractClipPlanes(FXMMATRIX viewProjection, XMVECTOR planes[6])
+{
+  XMMATRIX columns = XMMatrixTranspose(viewProjection);
+  planes[0]        = XMVectorAdd(columns.r[3], columns.r[0]);
+  planes[1]        = XMVectorSubtract(columns.r[3], columns.r[0]);
+  planes[2]        = XMVectorAdd(columns.r[3], columns.r[1]);
+  planes[3]        = XMVectorSubtract(columns.r[3], columns.r[1]);
+  planes[4]        = columns.r[2];
+  planes[5]        = XMVectorSubtract(columns.r[3], columns.r[2]);
+  for (int i = 0; i < 6; ++i)
+  {
+    planes[i] = XMPlaneNormalize(planes[i]);
+  }
+}
+
+//------------------------------------------------------------------------------
+size_t XM_CALLCONV
+CountVisible(
+  const BoundingSphere& modelBounds,
+  const std::vector<XMFLOAT4X4>& placements,
+  FXMMATRIX modelWorld,
+  CXMMATRIX view,
+  CXMMATRIX projection)
+{
+  XMVECTOR planes[6];
+  ExtractClipPlanes(XMMatrixMultiply(view, projection), planes);
+
+  size_t visible = 0;
+  for (const auto& placement : placements)
+  {
+    BoundingSphere bounds;
+    modelBounds.Transform(
+      bounds, XMMatrixMultiply(modelWorld, XMLoadFloat4x4(&placement)));
+
+    XMVECTOR center = XMLoadFloat3(&bounds.Center);
+    bool inside     = true;
+    for (const auto& plane : planes)
+    {
+      inside &= XMVectorGetX(XMPlaneDotCoord(plane, center)) >= -bounds.Radius;
+    }
+    visible += inside ? 1 : 0;
+  }
+  return visible;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Culls and packs a field of teapots, as Game::Render does each frame, first
+// on its own and then together with recording the upload and instanced draw
+// into a deferred context. The visible counts are checked against a clip
+// space test.
+//------------------------------------------------------------------------------
+int
+Bench::RunCullBench(const Options& options)
+{
+  const int teapots = std::max(1, options.GetInt(L"teapots", 10000));
+  const int frames  = std::max(1, options.GetInt(L"frames", 100));
+  const size_t tessellation =
+    static_cast<size_t>(std::max(1, options.GetInt(L"tessellation", 8)));
+
+  std::vector<VertexPositionNormalTexture> vertices;
+  std::vector<uint16_t> indices;
+  GeometricPrimitive::CreateTeapot(vertices, indices, 1.0f, tessellation);
+
+  BoundingSphere modelBounds;
+  BoundingSphere::CreateFromPoints(
+    modelBounds,
+    vertices.size(),
+    &vertices[0].position,
+    sizeof(VertexPositionNormalTexture));
+
+  std::vector<XMFLOAT4X4> placements =
+    TeapotField::CreateRings(teapots, TEAPOT_SPACING);
+
+  TeapotField field;
+  field.SetModelBounds(modelBounds);
+  field.SetPlacements(placements);
+
+  const XMMATRIX projection = XMMatrixPerspectiveFovRH(
+    XMConvertToRadians(70.0f), 4.0f / 3.0f, 0.01f, 100.0f);
+
+  // Culling and packing alone.
+  std::vector<double> cullMs;
+  uint64_t visibleTotal = 0;
+  size_t worstMismatch  = 0;
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    XMMATRIX modelWorld = XMMatrixRotationY(frame * 0.05f);
+    XMMATRIX view       = CameraView(frame);
+
+    double start   = NowMs();
+    size_t visible = field.Cull(modelWorld, view, projection);
+    cullMs.push_back(NowMs() - start);
+    visibleTotal += visible;
+
+    size_t expected =
+      CountVisible(modelBounds, placements, modelWorld, view, projection);
+    size_t mismatch =
+      visible > expected ? visible - expected : expected - visible;
+    worstMismatch = std::max(worstMismatch, mismatch);
+  }
+
+  // The same, recording the upload and draw as Game::Render issues them.
+  ComPtr<ID3D11Device> device;
+  ComPtr<ID3D11DeviceContext> immediateContext;
+  CreateWarpDevice(device, immediateContext);
+
+  ComPtr<ID3D11DeviceContext> context;
+  DX::ThrowIfFailed(
+    device->CreateDeferredContext(0, context.ReleaseAndGetAddressOf()));
+
+  MyEffect effect(device.Get());
+  if (!effect.isInit())
+  {
+    throw std::runtime_error(
+      "MyEffect failed to initialize (are the shader .cso files next to the "
+      "executable?)");
+  }
+  effect.SetInstancing(true);
+  effect.SetProjection(projection);
+
+  auto mesh =
+    GeometricPrimitive::CreateCustom(context.Get(), vertices, indices);
+  field.CreateDeviceResources(device.Get());
+
+  void const* shaderByteCode;
+  size_t byteCodeLength;
+  effect.GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+
+  ComPtr<ID3D11InputLayout> inputLayout;
+  DX::ThrowIfFailed(device->CreateInputLayout(
+    MyEffect::InstancedInputElements,
+    MyEffect::InstancedInputElementCount,
+    shaderByteCode,
+    byteCodeLength,
+    inputLayout.ReleaseAndGetAddressOf()));
+
+  std::vector<double> recordMs;
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    XMMATRIX modelWorld = XMMatrixRotationY(frame * 0.05f);
+    XMMATRIX view       = CameraView(frame);
+
+    double start = NowMs();
+    effect.SetView(view);
+    auto instanceCount =
+      static_cast<uint32_t>(field.Cull(modelWorld, view, projection));
+    if (instanceCount > 0)
+    {
+      field.Upload(context.Get());
+      mesh->DrawInstanced(
+        &effect,
+        inputLayout.Get(),
+        instanceCount,
+        false,
+        false,
+        0,
+        [&]() { field.SetVertexBuffer(context.Get(), 1); });
+    }
+
+    ComPtr<ID3D11CommandList> commandList;
+    DX::ThrowIfFailed(
+      context->FinishCommandList(FALSE, commandList.GetAddressOf()));
+    recordMs.push_back(NowMs() - start);
+  }
+
+  Summary cull   = Summarize(cullMs);
+  Summary record = Summarize(recordMs);
+
+  printf("cull: %d teapots, %d frames\n", teapots, frames);
+  printf(
+    "  %.1f%% visible on average\n",
+    100.0 * static_cast<double>(visibleTotal) / (double(teapots) * frames));
+  printf(
+    "  cull and pack   %8.1f ns/instance, %6.1f M instances/s "
+    "(p50 frame %.3f ms)\n",
+    cull.mean * 1.0e6 / teapots,
+    teapots / (cull.mean * 1.0e3),
+    cull.p50);
+  printf(
+    "  with recording  %8.1f ns/instance, %6.1f M instances/s "
+    "(p50 frame %.3f ms)\n",
+    record.mean * 1.0e6 / teapots,
+    teapots / (record.mean * 1.0e3),
+    record.p50);
+
+  // The two tests only disagree on spheres within rounding of a plane.
+  const size_t allowed = std::max<size_t>(1, size_t(teapots) / 1000);
+  if (worstMismatch > allowed)
+  {
+    printf(
+      "  FAIL: visible count differs from the clip space test by %zu\n",
+      worstMismatch);
+    return 1;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,119 @@
+//
+// EffectBench.cpp - "effect" mode: MyEffect::Apply cost and upload counts
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Shader/MyEffect.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+constexpr float TEAPOT_SPACING = 1.5f;
+
+//------------------------------------------------------------------------------
+bool
+Check(uint64_t actual, uint64_t expected, const char* what)
+{
+  if (actual != expected)
+  {
+    printf(
+      "  FAIL: %s: %llu, expected %llu\n",
+      what,
+      static_cast<unsigned long long>(actual),
+      static_cast<unsigned long long>(expected));
+    return false;
+  }
+  return true;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Applies MyEffect for a field of static teapots over several frames, as
+// Game::Render does for each teapot, and checks that the effect only uploads
+// and recomputes what changed: the static buffer once, the view inverse once
+// per frame, and the world inverse once per draw.
+//------------------------------------------------------------------------------
+int
+Bench::RunEffectBench(const Options& options)
+{
+  const int teapots = std::max(1, options.GetInt(L"teapots", 10000));
+  const int frames  = std::max(1, options.GetInt(L"frames", 10));
+
+  ComPtr<ID3D11Device> device;
+  ComPtr<ID3D11DeviceContext> context;
+
+  // Apply does not draw, so the software rasterizer is enough; this mode needs
+  // no graphics hardware.
+  CreateWarpDevice(device, context);
+
+  MyEffect effect(device.Get());
+  if (!effect.isInit())
+  {
+    throw std::runtime_error(
+      "MyEffect failed to initialize (are VertexShader.cso and "
+      "PixelShader.cso next to the executable?)");
+  }
+
+  const int side = static_cast<int>(ceil(sqrt(static_cast<double>(teapots))));
+  std::vector<XMFLOAT4X4> worlds(static_cast<size_t>(teapots));
+  for (int i = 0; i < teapots; ++i)
+  {
+    XMStoreFloat4x4(
+      &worlds[i],
+      XMMatrixTranslation(
+        (i % side) * TEAPOT_SPACING, 0.0f, (i / side) * TEAPOT_SPACING));
+  }
+
+  effect.SetProjection(XMMatrixPerspectiveFovRH(
+    XMConvertToRadians(70.0f), 4.0f / 3.0f, 0.01f, 100.0f));
+
+  std::vector<double> frameMs;
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    float angle = frame * 0.01f;
+    effect.SetView(XMMatrixLookAtRH(
+      XMVectorSet(sinf(angle), 0.7f, cosf(angle), 0.0f),
+      XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f),
+      g_XMIdentityR1));
+
+    double start = NowMs();
+    for (const auto& world : worlds)
+    {
+      effect.SetWorld(XMLoadFloat4x4(&world));
+      effect.Apply(context.Get());
+    }
+    frameMs.push_back(NowMs() - start);
+  }
+
+  const MyEffect::ApplyStats& stats = effect.GetApplyStats();
+  Summary summary                   = Summarize(frameMs);
+  const uint64_t draws              = uint64_t(teapots) * frames;
+
+  printf("effect: %d teapots, %d frames\n", teapots, frames);
+  printf(
+    "  %.1f ns/apply (p50 frame %.3f ms)\n",
+    summary.mean * 1.0e6 / teapots,
+    summary.p50);
+  printf(
+    "  applies %llu, static uploads %llu, dynamic uploads %llu, "
+    "world inverses %llu, view inverses %llu\n",
+    static_cast<unsigned long long>(stats.applies),
+    static_cast<unsigned long long>(stats.staticUploads),
+    static_cast<unsigned long long>(stats.dynamicUploads),
+    static_cast<unsigned long long>(stats.worldInverses),
+    static_cast<unsigned long long>(stats.viewInverses));
+
+  bool ok = true;
+  ok &= Check(stats.applies, draws, "applies");
+  ok &= Check(stats.staticUploads, 1, "static buffer uploads");
+  ok &= Check(stats.dynamicUploads, draws, "dynamic buffer uploads");
+  ok &= Check(stats.worldInverses, draws, "world inverses");
+  ok &= Check(stats.viewInverses, uint64_t(frames), "view inverses");
+
+  return ok ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
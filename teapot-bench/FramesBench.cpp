@@ -0,0 +1,130 @@
+//
+// FramesBench.cpp - "frames" mode: scripted Game::Tick frame times as JSON
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+
+using namespace DirectX;
+
+namespace
+{
+constexpr uint64_t FRAME_TICKS = DX::StepTimer::TicksPerSecond / 60;
+
+//------------------------------------------------------------------------------
+// Orbits the camera while bobbing it up and down, and spins the model at the
+// interactive rate with a wobble, so that every frame sees a new view.
+Game::ScenePose
+CameraPath(double totalSeconds)
+{
+  const double t = totalSeconds;
+
+  Game::ScenePose pose;
+  pose.cameraRotationX = static_cast<float>(0.35 * sin(0.7 * t));
+  pose.cameraRotationY = static_cast<float>(0.5 * t);
+  pose.modelRotationY =
+    static_cast<float>(XMConvertToRadians(45.0f) * t + 0.3 * sin(2.0 * t));
+  return pose;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Runs Game::Tick headless for a fixed number of frames, driving the timer
+// with a ReplayClock and the scene with CameraPath, so every run updates and
+// draws exactly the same frames. The report is a JSON object on stdout.
+//------------------------------------------------------------------------------
+int
+Bench::RunFramesBench(const Options& options)
+{
+  const int width   = options.GetInt(L"width", 1024);
+  const int height  = options.GetInt(L"height", 768);
+  const int threads = options.GetInt(L"threads", -1);
+  const int frames  = std::max(1, options.GetInt(L"frames", 300));
+  const int warmup  = std::max(0, options.GetInt(L"warmup", 30));
+
+  Game::SceneOptions scene;
+  scene.teapotCount  = options.GetInt(L"teapots", 1);
+  scene.tessellation = static_cast<size_t>(options.GetInt(L"tessellation", 8));
+  scene.grid.divisions =
+    static_cast<uint32_t>(std::max(1, options.GetInt(L"grid-divisions", 20)));
+  scene.grid.lodLevels =
+    static_cast<uint32_t>(std::max(1, options.GetInt(L"grid-lod", 1)));
+
+  auto clock = std::make_shared<DX::ReplayClock>(DX::StepTimer::TicksPerSecond);
+
+  // The worker count excludes the calling thread.
+  Game game;
+  game.SetSceneOptions(scene);
+  game.SetSceneScript(CameraPath);
+  game.InitializeHeadless(width, height, threads < 0 ? -1 : threads - 1);
+  game.SetClock(clock);
+
+  const CpuRenderer& renderer = *game.GetCpuRenderer();
+
+  std::vector<double> frameMs;
+  frameMs.reserve(static_cast<size_t>(frames));
+  AllocationCounts allocations;
+  uint64_t triangles = 0;
+  uint64_t pixels    = 0;
+
+  for (int frame = -warmup; frame < frames; ++frame)
+  {
+    clock->Advance(FRAME_TICKS);
+
+    AllocationCounts before = GetAllocationCounts();
+    double start            = NowMs();
+    game.Tick();
+    double elapsed         = NowMs() - start;
+    AllocationCounts after = GetAllocationCounts();
+
+    if (frame >= 0)
+    {
+      frameMs.push_back(elapsed);
+      allocations.count += after.count - before.count;
+      allocations.bytes += after.bytes - before.bytes;
+      triangles += renderer.GetFrameStats().trianglesSubmitted;
+      pixels += renderer.GetFrameStats().pixelsShaded;
+    }
+  }
+
+  Summary summary = Summarize(frameMs);
+  double totalS   = summary.mean * frames / 1000.0;
+
+  printf("{\n");
+  printf("  \"mode\": \"frames\",\n");
+  printf("  \"width\": %d,\n", width);
+  printf("  \"height\": %d,\n", height);
+  printf("  \"threads\": %zu,\n", renderer.GetConcurrency());
+  printf("  \"teapots\": %d,\n", scene.teapotCount);
+  printf("  \"tessellation\": %zu,\n", scene.tessellation);
+  printf("  \"grid_divisions\": %u,\n", scene.grid.divisions);
+  printf("  \"grid_lod\": %u,\n", scene.grid.lodLevels);
+  printf("  \"frames\": %d,\n", frames);
+  printf("  \"warmup\": %d,\n", warmup);
+  printf("  \"frame_ms\": {\n");
+  printf("    \"min\": %.4f,\n", summary.min);
+  printf("    \"mean\": %.4f,\n", summary.mean);
+  printf("    \"p50\": %.4f,\n", summary.p50);
+  printf("    \"p95\": %.4f,\n", summary.p95);
+  printf("    \"p99\": %.4f,\n", summary.p99);
+  printf("    \"max\": %.4f\n", summary.max);
+  printf("  },\n");
+  printf(
+    "  \"allocations_per_frame\": %.2f,\n",
+    static_cast<double>(allocations.count) / frames);
+  printf(
+    "  \"allocated_bytes_per_frame\": %.1f,\n",
+    static_cast<double>(allocations.bytes) / frames);
+  printf("  \"frames_per_second\": %.2f,\n", frames / totalS);
+  printf(
+    "  \"triangles_per_second\": %.0f,\n",
+    static_cast<double>(triangles) / totalS);
+  printf(
+    "  \"pixels_per_second\": %.0f\n", static_cast<double>(pixels) / totalS);
+  printf("}\n");
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+//
+// GeometryBench.cpp - "geometry" mode: GeometricPrimitive::Optimize results
+//
+
+#include "pch.h"
+#include "Bench.h"
+
+using namespace DirectX;
+
+//------------------------------------------------------------------------------
+// Runs GeometricPrimitive::Optimize over the output of every generator and
+// reports the vertex and triangle counts and the post-transform cache miss
+// ratio (ACMR, for a 16 entry FIFO) before and after, with the time it took.
+// --weld-seams also welds across texture seams, as the teapot renderers do.
+//------------------------------------------------------------------------------
+int
+Bench::RunGeometryBench(const Options& options)
+{
+  const auto tessellations = options.GetIntList(L"tessellation", {8, 16, 32});
+  const bool weldSeams     = options.Has(L"weld-seams");
+
+  printf("geometry: %s texture seams\n", weldSeams ? "welding" : "keeping");
+  printf(
+    "%-16s %8s %8s %8s %8s %7s %7s %9s\n",
+    "shape",
+    "verts",
+    "welded",
+    "tris",
+    "after",
+    "acmr",
+    "after",
+    "ms");
+
+  for (const Shape& shape : CreateShapes(tessellations))
+  {
+    Shape::Vertices vertices;
+    Shape::Indices indices;
+    shape.generate(vertices, indices);
+
+    GeometricPrimitive::OptimizeStats stats = {};
+
+    double start = NowMs();
+    GeometricPrimitive::Optimize(vertices, indices, weldSeams, &stats);
+    double elapsedMs = NowMs() - start;
+
+    printf(
+      "%-16s %8zu %8zu %8zu %8zu %7.3f %7.3f %9.3f\n",
+      shape.name.c_str(),
+      stats.verticesBefore,
+      stats.verticesAfter,
+      stats.trianglesBefore,
+      stats.trianglesAfter,
+      stats.acmrBefore,
+      stats.acmrAfter,
+      elapsedMs);
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
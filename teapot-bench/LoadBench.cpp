@@ -0,0 +1,112 @@
+//
+// LoadBench.cpp - "load" mode: Game device resource creation per thread count
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+
+namespace
+{
+struct Result
+{
+  Bench::Summary loadMs;
+
+  // Mean time each task took, in the order the tasks were added.
+  std::vector<const wchar_t*> names;
+  std::vector<double> taskMs;
+};
+
+//------------------------------------------------------------------------------
+Result
+Measure(const Game::SceneOptions& scene, int runs)
+{
+  Result result;
+  std::vector<double> loadMs;
+  for (int run = 0; run < runs; ++run)
+  {
+    Game game;
+    game.SetSceneOptions(scene);
+    game.InitializeRecording(640, 480);
+    loadMs.push_back(game.GetLoadMs());
+
+    const auto& timings = game.GetLoadTimings();
+    if (result.names.empty())
+    {
+      for (const auto& timing : timings)
+      {
+        result.names.push_back(timing.name);
+      }
+      result.taskMs.resize(timings.size());
+    }
+    for (size_t i = 0; i < timings.size(); ++i)
+    {
+      result.taskMs[i] += (timings[i].endMs - timings[i].startMs) / runs;
+    }
+  }
+
+  result.loadMs = Bench::Summarize(loadMs);
+  return result;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Creates Game's device resources on a recording device with each number of
+// loading threads, timing the whole and each task. With the reads and the
+// tessellation overlapped, the whole should approach the longest task plus
+// device object creation, rather than the sum of every task. The first run
+// reads the files cold; the rest from the file cache.
+//------------------------------------------------------------------------------
+int
+Bench::RunLoadBench(const Options& options)
+{
+  const int runs          = std::max(1, options.GetInt(L"runs", 10));
+  const auto threadCounts = options.GetIntList(L"threads", {1, 2, 4, 8});
+
+  Game::SceneOptions scene;
+  scene.tessellation =
+    static_cast<size_t>(std::max(1, options.GetInt(L"tessellation", 8)));
+  scene.grid.divisions =
+    static_cast<uint32_t>(std::max(1, options.GetInt(L"grid-divisions", 20)));
+
+  printf(
+    "load: %d runs, tessellation %zu, grid divisions %u\n",
+    runs,
+    scene.tessellation,
+    scene.grid.divisions);
+
+  for (int threads : threadCounts)
+  {
+    if (threads < 1)
+    {
+      continue;
+    }
+
+    // The worker count excludes the calling thread.
+    scene.loadThreads = threads - 1;
+    Result r          = Measure(scene, runs);
+
+    double taskSumMs = 0.0;
+    for (double ms : r.taskMs)
+    {
+      taskSumMs += ms;
+    }
+
+    printf(
+      "  %2d threads: load %8.3f ms (p50 %8.3f, max %8.3f), "
+      "tasks sum to %8.3f ms\n",
+      threads,
+      r.loadMs.mean,
+      r.loadMs.p50,
+      r.loadMs.max,
+      taskSumMs);
+    for (size_t i = 0; i < r.names.size(); ++i)
+    {
+      printf("    %-24ls %8.3f ms\n", r.names[i], r.taskMs[i]);
+    }
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+//
+// LodBench.cpp - "lod" mode: TeapotField level of detail selection
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "TeapotField.h"
+#include "TeapotLod.h"
+
+using namespace DirectX;
+
+namespace
+{
+constexpr float TEAPOT_SPACING = 1.5f;
+
+//------------------------------------------------------------------------------
+// Flies low over the field and back out, so teapots pass from filling the
+// screen to a few pixels.
+XMMATRIX
+CameraView(int frame, int frames)
+{
+  float t      = static_cast<float>(frame) / static_cast<float>(frames);
+  float height = 0.5f + 20.0f * (0.5f + 0.5f * cosf(XM_2PI * t));
+  float angle  = XM_2PI * t;
+  return XMMatrixLookAtRH(
+    XMVectorSet(height * sinf(angle), height, height * cosf(angle), 0.0f),
+    XMVectorZero(),
+    g_XMIdentityR1);
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Culls a field of teapots along a camera path at each pixel error threshold
+// and reports how many triangles the levels chosen would draw, against
+// drawing every visible teapot at the finest level, along with how the
+// instances were spread over the levels. A threshold of 0 turns levels of
+// detail off.
+//------------------------------------------------------------------------------
+int
+Bench::RunLodBench(const Options& options)
+{
+  const int teapots = std::max(1, options.GetInt(L"teapots", 10000));
+  const int frames  = std::max(1, options.GetInt(L"frames", 200));
+  const int height  = std::max(1, options.GetInt(L"height", 768));
+  const auto pixelErrors =
+    options.GetIntList(L"pixel-error", {0, 1, 2, 4, 8});
+  const size_t tessellation =
+    static_cast<size_t>(std::max(1, options.GetInt(L"tessellation", 32)));
+  const size_t levels =
+    static_cast<size_t>(std::max(1, options.GetInt(L"levels", 6)));
+
+  TeapotLod::Mesh mesh;
+  TeapotLod::CreateMesh(tessellation, levels, mesh);
+
+  printf(
+    "lod: %d teapots, %d frames, %d px viewport\n", teapots, frames, height);
+  printf("%6s %6s %10s %12s\n", "level", "tess", "triangles", "error");
+  std::vector<float> levelErrors;
+  for (size_t level = 0; level < mesh.levels.size(); ++level)
+  {
+    const TeapotLod::Level& lod = mesh.levels[level];
+    levelErrors.push_back(lod.geometricError);
+    printf(
+      "%6zu %6zu %10u %12.6f\n",
+      level,
+      lod.tessellation,
+      lod.indexCount / 3,
+      lod.geometricError);
+  }
+
+  BoundingSphere modelBounds;
+  BoundingSphere::CreateFromPoints(
+    modelBounds,
+    mesh.vertices.size(),
+    &mesh.vertices[0].position,
+    sizeof(VertexPositionNormalTexture));
+
+  const std::vector<XMFLOAT4X4> placements =
+    TeapotField::CreateRings(teapots, TEAPOT_SPACING);
+  const XMMATRIX projection = XMMatrixPerspectiveFovRH(
+    XMConvertToRadians(70.0f), 4.0f / 3.0f, 0.01f, 100.0f);
+  const uint64_t finestTriangles = mesh.levels[0].indexCount / 3;
+
+  printf(
+    "\n%6s %9s %13s %13s %8s %9s  %s\n",
+    "px err",
+    "visible",
+    "triangles",
+    "finest only",
+    "ratio",
+    "cull ms",
+    "instances per level");
+
+  for (int pixelError : pixelErrors)
+  {
+    TeapotField field;
+    field.SetModelBounds(modelBounds);
+    field.SetPlacements(placements);
+    field.SetViewportHeight(static_cast<float>(height));
+    if (pixelError > 0)
+    {
+      field.SetLevelsOfDetail(levelErrors, static_cast<float>(pixelError));
+    }
+
+    std::vector<double> cullMs;
+    std::vector<uint64_t> levelTotals(mesh.levels.size());
+    uint64_t visibleTotal = 0;
+    uint64_t triangles    = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      const XMMATRIX view = CameraView(frame, frames);
+
+      double start   = NowMs();
+      size_t visible = field.Cull(XMMatrixIdentity(), view, projection);
+      cullMs.push_back(NowMs() - start);
+      visibleTotal += visible;
+
+      const std::vector<uint32_t>& counts = field.GetLevelInstanceCounts();
+      for (size_t level = 0; level < counts.size(); ++level)
+      {
+        levelTotals[level] += counts[level];
+        triangles += static_cast<uint64_t>(counts[level])
+                     * (mesh.levels[level].indexCount / 3);
+      }
+    }
+
+    const uint64_t finestTotal = visibleTotal * finestTriangles;
+    Summary cull               = Summarize(cullMs);
+    printf(
+      "%6d %9.1f %13.0f %13.0f %8.2f %9.4f ",
+      pixelError,
+      static_cast<double>(visibleTotal) / frames,
+      static_cast<double>(triangles) / frames,
+      static_cast<double>(finestTotal) / frames,
+      triangles > 0
+        ? static_cast<double>(finestTotal) / static_cast<double>(triangles)
+        : 0.0,
+      cull.p50);
+    for (uint64_t total : levelTotals)
+    {
+      printf(" %.1f", static_cast<double>(total) / frames);
+    }
+    printf("\n");
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
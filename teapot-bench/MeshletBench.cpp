@@ -0,0 +1,254 @@
+//
+// MeshletBench.cpp - "meshlets" mode: Meshlets frustum and cone culling
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+#include "Meshlets.h"
+
+using namespace DirectX;
+
+namespace
+{
+// Backfacing triangles nearly edge on may round either way; a dropped
+// triangle within this cosine of edge on is not counted as a failure.
+constexpr float EDGE_ON_COSINE = 1.0e-4f;
+
+// Slack, in model units, for corners on a clip plane, which the two plane
+// derivations may put on either side of it.
+constexpr float PLANE_TOLERANCE = 1.0e-5f;
+
+//------------------------------------------------------------------------------
+// FramesBench's path: the camera orbits while bobbing up and down, and the
+// model spins with a wobble.
+Game::ScenePose
+CameraPath(double totalSeconds)
+{
+  const double t = totalSeconds;
+
+  Game::ScenePose pose;
+  pose.cameraRotationX = static_cast<float>(0.35 * sin(0.7 * t));
+  pose.cameraRotationY = static_cast<float>(0.5 * t);
+  pose.modelRotationY =
+    static_cast<float>(XMConvertToRadians(45.0f) * t + 0.3 * sin(2.0 * t));
+  return pose;
+}
+
+//------------------------------------------------------------------------------
+// Inward facing clip planes of the model * view * projection transform
+// (Gribb & Hartmann), in model space, found independently of Meshlets::Cull.
+void XM_CALLCONV
+ExtractClipPlanes(FXMMATRIX worldViewProjection, XMVECTOR planes[6])
+{
+  XMMATRIX columns = XMMatrixTranspose(worldViewProjection);
+  planes[0]        = XMVectorAdd(columns.r[3], columns.r[0]);
+  planes[1]        = XMVectorSubtract(columns.r[3], columns.r[0]);
+  planes[2]        = XMVectorAdd(columns.r[3], columns.r[1]);
+  planes[3]        = XMVectorSubtract(columns.r[3], columns.r[1]);
+  planes[4]        = columns.r[2];
+  planes[5]        = XMVectorSubtract(columns.r[3], columns.r[2]);
+  for (int i = 0; i < 6; ++i)
+  {
+    planes[i] = XMPlaneNormalize(planes[i]);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Whether the triangle can't be seen: facing away from the eye, or with every
+// corner outside the same clip plane.
+bool XM_CALLCONV
+IsHidden(
+  const DX::Meshlets& meshlets,
+  FXMVECTOR p0,
+  FXMVECTOR p1,
+  FXMVECTOR p2,
+  GXMVECTOR eye,
+  const XMVECTOR planes[6])
+{
+  if (meshlets.IsBackfacing(p0, p1, p2, eye))
+  {
+    return true;
+  }
+
+  for (int i = 0; i < 6; ++i)
+  {
+    if (
+      XMVectorGetX(XMPlaneDotCoord(planes[i], p0)) < PLANE_TOLERANCE
+      && XMVectorGetX(XMPlaneDotCoord(planes[i], p1)) < PLANE_TOLERANCE
+      && XMVectorGetX(XMPlaneDotCoord(planes[i], p2)) < PLANE_TOLERANCE)
+    {
+      return true;
+    }
+  }
+
+  // Nearly edge on.
+  XMVECTOR normal =
+    XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+  XMVECTOR toEye = XMVectorSubtract(eye, p0);
+  float cosine   = std::abs(XMVectorGetX(XMVector3Dot(normal, toEye)));
+  return cosine <= EDGE_ON_COSINE * XMVectorGetX(XMVector3Length(normal))
+                     * XMVectorGetX(XMVector3Length(toEye));
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Splits the optimized teapot at each tessellation into meshlets and culls
+// them along FramesBench's camera path, with Game's view and projection.
+// Reports the share of triangles rejected by the frustum and by the normal
+// cones, against the share a per-triangle test finds backfacing, and the cost
+// of the pass. Fails if any triangle left out of the compacted index list
+// could have been seen.
+//------------------------------------------------------------------------------
+int
+Bench::RunMeshletBench(const Options& options)
+{
+  const auto tessellations =
+    options.GetIntList(L"tessellation", {8, 16, 32, 64});
+  const int frames      = std::max(1, options.GetInt(L"frames", 240));
+  const int width       = std::max(1, options.GetInt(L"width", 1024));
+  const int height      = std::max(1, options.GetInt(L"height", 768));
+  const int maxVertices = std::max(3, options.GetInt(L"max-vertices", 64));
+  const int maxTriangles =
+    std::max(1, options.GetInt(L"max-triangles", 124));
+
+  const XMMATRIX projection =
+    Game::CreateProjection(static_cast<float>(width) / height);
+
+  printf(
+    "meshlets: %d vertices, %d triangles each, %d frames, percentages of\n"
+    "triangles rejected per frame\n",
+    maxVertices,
+    maxTriangles,
+    frames);
+  printf(
+    "%5s %9s %8s %7s %7s %9s %9s %9s %9s %9s\n",
+    "tess",
+    "triangles",
+    "meshlets",
+    "verts",
+    "tris",
+    "frustum",
+    "cone",
+    "backface",
+    "drawn",
+    "cull us");
+
+  int exitCode = 0;
+  for (int tessellation : tessellations)
+  {
+    std::vector<VertexPositionNormalTexture> vertices;
+    std::vector<uint32_t> indices;
+    GeometricPrimitive::CreateTeapot(
+      vertices, indices, 1.0f, static_cast<size_t>(std::max(1, tessellation)));
+    GeometricPrimitive::Optimize(vertices, indices, true);
+
+    DX::Meshlets meshlets;
+    meshlets.Build(
+      vertices,
+      indices,
+      true,
+      static_cast<size_t>(maxVertices),
+      static_cast<size_t>(maxTriangles));
+
+    const auto& clusters         = meshlets.GetMeshlets();
+    const auto& clusteredIndices = meshlets.GetIndices();
+    size_t clusterVertices       = 0;
+    for (const auto& meshlet : clusters)
+    {
+      clusterVertices += meshlet.vertexCount;
+    }
+
+    std::vector<uint32_t> visible;
+    visible.reserve(clusteredIndices.size());
+    std::vector<double> cullUs;
+    uint64_t frustumTriangles  = 0;
+    uint64_t coneTriangles     = 0;
+    uint64_t backfaceTriangles = 0;
+    uint64_t drawnTriangles    = 0;
+    size_t failures            = 0;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      const Game::ScenePose pose = CameraPath(frame / 60.0);
+      const XMMATRIX world       = XMMatrixRotationY(pose.modelRotationY);
+      const XMMATRIX view =
+        Game::CreateCameraView(pose.cameraRotationX, pose.cameraRotationY);
+
+      DX::Meshlets::CullStats stats;
+      double start = NowMs();
+      size_t drawn = meshlets.Cull(world, view, projection, visible, &stats);
+      cullUs.push_back((NowMs() - start) * 1000.0);
+
+      frustumTriangles += stats.frustumCulledTriangles;
+      coneTriangles += stats.backfaceCulledTriangles;
+      drawnTriangles += drawn;
+
+      // The per-triangle answer, and a check of every dropped triangle. Kept
+      // meshlets appear in the compacted list in order, unchanged.
+      const XMMATRIX worldView = XMMatrixMultiply(world, view);
+      const XMVECTOR eye       = XMMatrixInverse(nullptr, worldView).r[3];
+      XMVECTOR planes[6];
+      ExtractClipPlanes(XMMatrixMultiply(worldView, projection), planes);
+
+      size_t next = 0;
+      for (const auto& meshlet : clusters)
+      {
+        auto first = clusteredIndices.begin() + meshlet.firstIndex;
+        auto last  = first + 3 * meshlet.triangleCount;
+        bool kept  = visible.size() - next >= 3 * meshlet.triangleCount
+                    && std::equal(first, last, visible.begin() + next);
+        if (kept)
+        {
+          next += 3 * meshlet.triangleCount;
+        }
+
+        for (auto index = first; index != last; index += 3)
+        {
+          XMVECTOR p0 = XMLoadFloat3(&vertices[index[0]].position);
+          XMVECTOR p1 = XMLoadFloat3(&vertices[index[1]].position);
+          XMVECTOR p2 = XMLoadFloat3(&vertices[index[2]].position);
+          backfaceTriangles += meshlets.IsBackfacing(p0, p1, p2, eye) ? 1 : 0;
+          if (!kept && !IsHidden(meshlets, p0, p1, p2, eye, planes))
+          {
+            failures++;
+          }
+        }
+      }
+      if (next != visible.size())
+      {
+        failures++;
+      }
+    }
+
+    const double triangles =
+      static_cast<double>(clusteredIndices.size() / 3) * frames;
+    auto percent = [triangles](uint64_t count) {
+      return triangles > 0.0 ? 100.0 * count / triangles : 0.0;
+    };
+
+    printf(
+      "%5d %9zu %8zu %7.1f %7.1f %8.1f%% %8.1f%% %8.1f%% %8.1f%% %9.1f\n",
+      tessellation,
+      clusteredIndices.size() / 3,
+      clusters.size(),
+      clusters.empty() ? 0.0 : double(clusterVertices) / clusters.size(),
+      clusters.empty() ? 0.0
+                       : double(clusteredIndices.size() / 3) / clusters.size(),
+      percent(frustumTriangles),
+      percent(coneTriangles),
+      percent(backfaceTriangles),
+      percent(drawnTriangles),
+      Summarize(cullUs).p50);
+
+    if (failures > 0)
+    {
+      printf("  FAIL: %zu visible triangles culled\n", failures);
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,119 @@
+//
+// PacingBench.cpp - "pacing" mode: StepTimer frame rate limits, wall clock
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "StepTimer.h"
+
+namespace
+{
+//------------------------------------------------------------------------------
+// CPU time used by the calling thread, in milliseconds.
+double
+ThreadCpuMs()
+{
+  FILETIME creation;
+  FILETIME exit;
+  FILETIME kernel;
+  FILETIME user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+  {
+    return 0.0;
+  }
+
+  auto toMs = [](const FILETIME& time) {
+    ULARGE_INTEGER value;
+    value.LowPart  = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return static_cast<double>(value.QuadPart) / 10000.0;
+  };
+  return toMs(kernel) + toMs(user);
+}
+
+//------------------------------------------------------------------------------
+// Stands in for the work of a frame.
+void
+Spin(double ms)
+{
+  const double end = Bench::NowMs() + ms;
+  while (Bench::NowMs() < end)
+  {
+  }
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Ticks a StepTimer on the system clock at each frame rate limit, with a
+// fixed amount of busy work per frame, and reports how closely the frame
+// intervals kept to the limit and how much of a core the loop used. A limit
+// of 0 runs unpaced, as the main loop did before, for comparison.
+//
+// --max-p99-ms fails the run if any limit's p99 interval error exceeds it.
+//------------------------------------------------------------------------------
+int
+Bench::RunPacingBench(const Options& options)
+{
+  const auto limits   = options.GetIntList(L"fps", {0, 30, 60, 120, 240});
+  const int frames    = std::max(1, options.GetInt(L"frames", 300));
+  const double work   = std::max(0.0, options.GetDouble(L"work-ms", 2.0));
+  const double maxP99 = options.GetDouble(L"max-p99-ms", 0.0);
+
+  printf("pacing: %d frames, %.2f ms of work per frame\n", frames, work);
+  printf(
+    "%6s %8s %7s %9s %9s %9s %10s %10s %10s\n",
+    "limit",
+    "fps",
+    "cpu %",
+    "err mean",
+    "err p99",
+    "err max",
+    "slept ms",
+    "spun ms",
+    "oversleep");
+
+  bool passed = true;
+  for (int limit : limits)
+  {
+    DX::StepTimer timer;
+    timer.SetFrameRateLimit(limit);
+
+    const double startMs    = NowMs();
+    const double startCpuMs = ThreadCpuMs();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      timer.Tick([]() {});
+      Spin(work);
+    }
+    const double wallMs = NowMs() - startMs;
+    const double cpuMs  = ThreadCpuMs() - startCpuMs;
+
+    const DX::StepTimer::PacingStats stats = timer.GetPacingStats();
+    printf(
+      "%6d %8.1f %7.1f %9.4f %9.4f %9.4f %10.1f %10.1f %10.4f\n",
+      limit,
+      1000.0 * frames / wallMs,
+      100.0 * cpuMs / wallMs,
+      stats.meanErrorMs,
+      stats.p99ErrorMs,
+      stats.maxErrorMs,
+      stats.sleptMs,
+      stats.spunMs,
+      stats.oversleepMs);
+
+    if (limit > 0 && maxP99 > 0.0 && stats.p99ErrorMs > maxP99)
+    {
+      fprintf(
+        stderr,
+        "pacing: FAIL %d fps p99 error %.4f ms exceeds %.4f\n",
+        limit,
+        stats.p99ErrorMs,
+        maxP99);
+      passed = false;
+    }
+  }
+
+  return passed ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,198 @@
+//
+// PackedBench.cpp - "packed" mode: VertexPositionNormalTexturePacked accuracy
+//
+
+#include "pch.h"
+#include "Bench.h"
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+using Packed = GeometricPrimitive::PackedVertexType;
+
+// The decode bounds documented on VertexPositionNormalTexturePacked. Half
+// floats round to within 2^-11 of a value's magnitude, down to the smallest
+// normal half, 2^-14, below which the error stays at 2^-25.
+const float MAX_POSITION_ERROR = 1.0f / 2048.0f;
+const float MIN_NORMAL_HALF    = 1.0f / 16384.0f;
+const float MAX_NORMAL_ERROR   = 1.0e-4f;
+const float MAX_TEXCOORD_ERROR = 8.0e-6f;
+
+struct Errors
+{
+  float position = 0.0f;
+  float normal   = 0.0f;
+  float texcoord = 0.0f;
+};
+
+//------------------------------------------------------------------------------
+Errors
+Measure(const Shape::Vertices& original, const Shape::Vertices& decoded)
+{
+  Errors errors;
+  for (size_t i = 0; i < original.size(); ++i)
+  {
+    const auto& a = original[i];
+    const auto& b = decoded[i];
+
+    const float* p = &a.position.x;
+    const float* q = &b.position.x;
+    for (int c = 0; c < 3; ++c)
+    {
+      const float magnitude = std::max(std::abs(p[c]), MIN_NORMAL_HALF);
+      errors.position =
+        std::max(errors.position, std::abs(q[c] - p[c]) / magnitude);
+    }
+
+    // Against the unit normal, so generator rounding doesn't count.
+    XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&a.normal));
+    XMVECTOR d = XMVectorSubtract(XMLoadFloat3(&b.normal), n);
+    errors.normal = std::max(errors.normal, XMVectorGetX(XMVector3Length(d)));
+
+    errors.texcoord = std::max(
+      errors.texcoord,
+      std::max(
+        std::abs(b.textureCoordinate.x - a.textureCoordinate.x),
+        std::abs(b.textureCoordinate.y - a.textureCoordinate.y)));
+  }
+  return errors;
+}
+
+//------------------------------------------------------------------------------
+// Vertices spread over every direction and a wide range of magnitudes, for
+// the cases the generators never produce.
+Shape::Vertices
+CreateRandomVertices(size_t count)
+{
+  std::mt19937 random(1);
+  std::normal_distribution<float> direction;
+  std::uniform_real_distribution<float> exponent(-20.0f, 12.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  Shape::Vertices vertices(count);
+  for (auto& vertex : vertices)
+  {
+    const float scale = std::exp2(exponent(random));
+    XMStoreFloat3(
+      &vertex.position,
+      XMVectorScale(
+        XMVectorSet(direction(random), direction(random), direction(random), 0),
+        scale));
+
+    XMVECTOR normal = XMVectorZero();
+    while (XMVector3Equal(normal, XMVectorZero()))
+    {
+      normal =
+        XMVectorSet(direction(random), direction(random), direction(random), 0);
+    }
+    XMStoreFloat3(&vertex.normal, XMVector3Normalize(normal));
+
+    vertex.textureCoordinate = XMFLOAT2(unit(random), unit(random));
+  }
+  return vertices;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Packs the output of every generator, and a million random vertices, into
+// GeometricPrimitive::PackedVertexType and back. Reports the largest decode
+// errors, the vertex memory saved and encode/decode throughput, and fails if
+// any error exceeds the bounds documented on the packed vertex type.
+//------------------------------------------------------------------------------
+int
+Bench::RunPackedBench(const Options& options)
+{
+  const auto tessellations =
+    options.GetIntList(L"tessellation", {8, 16, 32, 64});
+  const int runs = std::max(1, options.GetInt(L"runs", 20));
+  const size_t randomCount =
+    static_cast<size_t>(std::max(0, options.GetInt(L"random", 1000000)));
+
+  std::vector<std::pair<std::string, Shape::Vertices>> inputs;
+  for (const Shape& shape : CreateShapes(tessellations))
+  {
+    Shape::Vertices vertices;
+    Shape::Indices indices;
+    shape.generate(vertices, indices);
+    inputs.emplace_back(shape.name, std::move(vertices));
+  }
+  if (randomCount > 0)
+  {
+    inputs.emplace_back("random", CreateRandomVertices(randomCount));
+  }
+
+  printf(
+    "packed: %zu to %zu bytes per vertex, %d runs, median times\n",
+    sizeof(GeometricPrimitive::VertexType),
+    sizeof(Packed),
+    runs);
+  printf(
+    "bounds: position %.2e relative, normal %.2e, texcoord %.2e\n",
+    MAX_POSITION_ERROR,
+    MAX_NORMAL_ERROR,
+    MAX_TEXCOORD_ERROR);
+  printf(
+    "%-16s %8s %10s %10s %10s %10s %10s %10s\n",
+    "shape",
+    "verts",
+    "KB saved",
+    "position",
+    "normal",
+    "texcoord",
+    "enc Mv/s",
+    "dec Mv/s");
+
+  int exitCode = 0;
+  for (const auto& input : inputs)
+  {
+    const Shape::Vertices& vertices = input.second;
+    std::vector<Packed> packed(vertices.size());
+    Shape::Vertices decoded(vertices.size());
+
+    std::vector<double> encodeMs;
+    std::vector<double> decodeMs;
+    for (int run = 0; run < runs; ++run)
+    {
+      double start = NowMs();
+      Packed::Encode(vertices.data(), vertices.size(), packed.data());
+      encodeMs.push_back(NowMs() - start);
+
+      start = NowMs();
+      Packed::Decode(packed.data(), packed.size(), decoded.data());
+      decodeMs.push_back(NowMs() - start);
+    }
+
+    const Errors errors = Measure(vertices, decoded);
+    const double count  = static_cast<double>(vertices.size());
+    auto throughput     = [count](double ms) {
+      return ms > 0.0 ? count / (ms * 1000.0) : 0.0;
+    };
+
+    printf(
+      "%-16s %8zu %10.1f %10.2e %10.2e %10.2e %10.1f %10.1f\n",
+      input.first.c_str(),
+      vertices.size(),
+      count * (sizeof(GeometricPrimitive::VertexType) - sizeof(Packed))
+        / 1024.0,
+      errors.position,
+      errors.normal,
+      errors.texcoord,
+      throughput(Summarize(encodeMs).p50),
+      throughput(Summarize(decodeMs).p50));
+
+    if (
+      errors.position > MAX_POSITION_ERROR || errors.normal > MAX_NORMAL_ERROR
+      || errors.texcoord > MAX_TEXCOORD_ERROR)
+    {
+      printf("  FAIL: decode error over its documented bound\n");
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,448 @@
+//
+// PickBench.cpp - "picking" mode: MeshBvh build time and ray throughput
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+#include "MeshBvh.h"
+#include "ThreadPool.h"
+
+#include <cfloat>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+using SimpleMath::Ray;
+
+namespace
+{
+// Rays handed to a thread at a time.
+constexpr size_t RAYS_PER_JOB = 1024;
+
+// Distances to the same surface agree to within this, relative to the
+// distance, across instruction sets and against DirectXCollision's test.
+constexpr float DISTANCE_TOLERANCE = 1.0e-4f;
+
+using Vertices = std::vector<VertexPositionNormalTexture>;
+using Indices  = std::vector<uint32_t>;
+
+//------------------------------------------------------------------------------
+struct Mesh
+{
+  std::string name;
+  Vertices vertices;
+  Indices indices;
+};
+
+std::vector<Mesh>
+CreateMeshes(const std::vector<int>& tessellations)
+{
+  std::vector<Mesh> meshes;
+  for (int tessellation : tessellations)
+  {
+    const size_t t           = static_cast<size_t>(std::max(1, tessellation));
+    const std::string suffix = " " + std::to_string(t);
+
+    Mesh teapot;
+    teapot.name = "teapot" + suffix;
+    GeometricPrimitive::CreateTeapot(teapot.vertices, teapot.indices, 1.0f, t);
+    GeometricPrimitive::Optimize(teapot.vertices, teapot.indices, true);
+    meshes.push_back(std::move(teapot));
+
+    Mesh sphere;
+    sphere.name = "sphere" + suffix;
+    GeometricPrimitive::CreateSphere(
+      sphere.vertices, sphere.indices, 1.0f, std::max<size_t>(3, t));
+    meshes.push_back(std::move(sphere));
+  }
+  return meshes;
+}
+
+//------------------------------------------------------------------------------
+// A ray through the centre of every pixel from Game's camera, in the space of
+// a model turned as Game turns it, as a mouse pick would cast them.
+std::vector<Ray>
+CreateCameraRays(int width, int height)
+{
+  const XMMATRIX world = XMMatrixRotationY(XMConvertToRadians(30.0f));
+  const XMMATRIX view  = Game::CreateCameraView(0.2f, 0.4f);
+  const XMMATRIX projection =
+    Game::CreateProjection(static_cast<float>(width) / height);
+
+  std::vector<Ray> rays;
+  rays.reserve(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      XMVECTOR nearPoint = XMVector3Unproject(
+        XMVectorSet(x + 0.5f, y + 0.5f, 0.0f, 0.0f),
+        0.0f,
+        0.0f,
+        static_cast<float>(width),
+        static_cast<float>(height),
+        0.0f,
+        1.0f,
+        projection,
+        view,
+        world);
+      XMVECTOR farPoint = XMVector3Unproject(
+        XMVectorSet(x + 0.5f, y + 0.5f, 1.0f, 0.0f),
+        0.0f,
+        0.0f,
+        static_cast<float>(width),
+        static_cast<float>(height),
+        0.0f,
+        1.0f,
+        projection,
+        view,
+        world);
+
+      Ray ray;
+      ray.position = nearPoint;
+      ray.direction =
+        XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint));
+      rays.push_back(ray);
+    }
+  }
+  return rays;
+}
+
+//------------------------------------------------------------------------------
+std::vector<DX::MeshBvh::Isa>
+SupportedIsas()
+{
+  std::vector<DX::MeshBvh::Isa> isas = {DX::MeshBvh::Isa::Scalar};
+
+  DX::MeshBvh::Isa best = ShadingKernel::DetectIsa();
+  if (best != DX::MeshBvh::Isa::Scalar)
+  {
+    isas.push_back(DX::MeshBvh::Isa::SSE4);
+  }
+  if (best == DX::MeshBvh::Isa::AVX2)
+  {
+    isas.push_back(DX::MeshBvh::Isa::AVX2);
+  }
+  return isas;
+}
+
+//------------------------------------------------------------------------------
+// Whether two answers for the same ray find the same surface. Where triangles
+// meet, either may be hit, at the same distance.
+bool
+SameHit(
+  uint32_t triangleA, float distanceA, uint32_t triangleB, float distanceB)
+{
+  if (triangleA == DX::MeshBvh::NO_TRIANGLE
+      || triangleB == DX::MeshBvh::NO_TRIANGLE)
+  {
+    return triangleA == triangleB;
+  }
+  return triangleA == triangleB
+         || std::abs(distanceA - distanceB)
+              <= DISTANCE_TOLERANCE * std::max(1.0f, distanceA);
+}
+
+//------------------------------------------------------------------------------
+// The nearest triangle by a linear scan with DirectXCollision's ray test.
+void
+ScanTriangles(
+  const Mesh& mesh, const Ray& ray, uint32_t& triangle, float& distance)
+{
+  triangle = DX::MeshBvh::NO_TRIANGLE;
+  distance = FLT_MAX;
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+  {
+    float d;
+    if (
+      ray.Intersects(
+        mesh.vertices[mesh.indices[i]].position,
+        mesh.vertices[mesh.indices[i + 1]].position,
+        mesh.vertices[mesh.indices[i + 2]].position,
+        d)
+      && d < distance)
+    {
+      triangle = static_cast<uint32_t>(i / 3);
+      distance = d;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Whether the hit's barycentrics and texture coordinate describe a point on
+// the triangle, at the hit's distance along the ray.
+bool
+IsConsistent(const Mesh& mesh, const Ray& ray, const DX::MeshBvh::Hit& hit)
+{
+  const float u  = hit.barycentrics.x;
+  const float v  = hit.barycentrics.y;
+  const auto& v0 = mesh.vertices[mesh.indices[3 * hit.triangle]];
+  const auto& v1 = mesh.vertices[mesh.indices[3 * hit.triangle + 1]];
+  const auto& v2 = mesh.vertices[mesh.indices[3 * hit.triangle + 2]];
+
+  XMVECTOR point = XMVectorScale(XMLoadFloat3(&v0.position), 1.0f - u - v);
+  point = XMVectorAdd(point, XMVectorScale(XMLoadFloat3(&v1.position), u));
+  point = XMVectorAdd(point, XMVectorScale(XMLoadFloat3(&v2.position), v));
+  XMVECTOR along = XMVectorAdd(
+    XMLoadFloat3(&ray.position),
+    XMVectorScale(XMLoadFloat3(&ray.direction), hit.distance));
+
+  XMVECTOR uv = XMVectorScale(
+    XMLoadFloat2(&v0.textureCoordinate), 1.0f - u - v);
+  uv = XMVectorAdd(uv, XMVectorScale(XMLoadFloat2(&v1.textureCoordinate), u));
+  uv = XMVectorAdd(uv, XMVectorScale(XMLoadFloat2(&v2.textureCoordinate), v));
+
+  const float tolerance = DISTANCE_TOLERANCE * std::max(1.0f, hit.distance);
+  return XMVectorGetX(XMVector3Length(XMVectorSubtract(point, along)))
+           <= tolerance
+         && XMVector2NearEqual(
+              uv,
+              XMLoadFloat2(&hit.textureCoordinate),
+              XMVectorReplicate(DISTANCE_TOLERANCE));
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Builds a MeshBvh over the teapot and a sphere at each tessellation, then
+// casts a ray through every pixel from Game's camera, one thread per
+// instruction set the machine supports and then every thread with the best.
+// Reports the median build time, and rays per second in total and per core.
+// Fails if the packet paths, or the threads, find a different surface than
+// the scalar path on more than --max-mismatch of the rays, if the scalar path
+// disagrees with a linear scan over every triangle on a sample of them, or if
+// a hit's barycentrics or texture coordinate are off.
+//------------------------------------------------------------------------------
+int
+Bench::RunPickBench(const Options& options)
+{
+  const auto tessellations =
+    options.GetIntList(L"tessellation", {8, 16, 32, 64});
+  const int runs    = std::max(1, options.GetInt(L"runs", 10));
+  const int width   = std::max(1, options.GetInt(L"width", 512));
+  const int height  = std::max(1, options.GetInt(L"height", 384));
+  const int threads = std::max(
+    1,
+    options.GetInt(
+      L"threads", static_cast<int>(std::thread::hardware_concurrency())));
+  const size_t scanned =
+    static_cast<size_t>(std::max(1, options.GetInt(L"scan", 2048)));
+  const double maxMismatch = options.GetDouble(L"max-mismatch", 1.0e-3);
+
+  const std::vector<Ray> rays = CreateCameraRays(width, height);
+  const size_t count          = rays.size();
+
+  printf(
+    "picking: %zu rays, median build of %d runs, best trace of %d runs\n",
+    count,
+    runs,
+    runs);
+  printf(
+    "%-10s %9s %7s %9s %7s %7s %6s %9s %9s %8s %9s\n",
+    "shape",
+    "triangles",
+    "nodes",
+    "build ms",
+    "isa",
+    "threads",
+    "hit %",
+    "Mrays/s",
+    "per core",
+    "speedup",
+    "mismatch");
+
+  int exitCode = 0;
+  for (const Mesh& mesh : CreateMeshes(tessellations))
+  {
+    std::vector<double> buildMs;
+    for (int run = 0; run < runs; ++run)
+    {
+      DX::MeshBvh bvh;
+      double start = NowMs();
+      bvh.Build(mesh.vertices, mesh.indices);
+      buildMs.push_back(NowMs() - start);
+    }
+
+    std::vector<DX::MeshBvh::Hit> reference(count);
+    std::vector<DX::MeshBvh::Hit> hits(count);
+    double scalarMs = 0.0;
+    bool firstRow   = true;
+
+    auto report = [&](
+                    const DX::MeshBvh& bvh,
+                    size_t concurrency,
+                    double ms,
+                    size_t mismatches) {
+      size_t hitCount = 0;
+      for (const auto& hit : hits)
+      {
+        hitCount += hit.triangle != DX::MeshBvh::NO_TRIANGLE ? 1 : 0;
+      }
+
+      const double raysPerSecond = count / (ms * 1.0e-3);
+      if (firstRow)
+      {
+        printf(
+          "%-10s %9zu %7zu %9.3f ",
+          mesh.name.c_str(),
+          bvh.GetTriangleCount(),
+          bvh.GetNodeCount(),
+          Summarize(buildMs).p50);
+      }
+      else
+      {
+        printf("%-10s %9s %7s %9s ", "", "", "", "");
+      }
+      firstRow = false;
+
+      printf(
+        "%7s %7zu %5.1f%% %9.2f %9.2f %7.2fx %9zu\n",
+        ShadingKernel::GetIsaName(bvh.GetIsa()),
+        concurrency,
+        100.0 * hitCount / count,
+        raysPerSecond * 1.0e-6,
+        raysPerSecond * 1.0e-6 / concurrency,
+        scalarMs / ms,
+        mismatches);
+
+      if (mismatches > maxMismatch * count)
+      {
+        printf("  FAIL: more than %g of the rays disagree\n", maxMismatch);
+        exitCode = 1;
+      }
+    };
+
+    auto countMismatches = [&]() {
+      size_t mismatches = 0;
+      for (size_t i = 0; i < count; ++i)
+      {
+        mismatches += SameHit(
+                        reference[i].triangle,
+                        reference[i].distance,
+                        hits[i].triangle,
+                        hits[i].distance)
+                        ? 0
+                        : 1;
+      }
+      return mismatches;
+    };
+
+    std::unique_ptr<DX::MeshBvh> best;
+    for (DX::MeshBvh::Isa isa : SupportedIsas())
+    {
+      auto bvh = std::make_unique<DX::MeshBvh>(isa);
+      bvh->Build(mesh.vertices, mesh.indices);
+
+      double bestMs = 0.0;
+      for (int run = 0; run < runs; ++run)
+      {
+        double start = NowMs();
+        bvh->Intersect(rays.data(), count, FLT_MAX, hits.data());
+        double elapsed = NowMs() - start;
+        bestMs         = run == 0 ? elapsed : std::min(bestMs, elapsed);
+      }
+
+      size_t mismatches = 0;
+      if (isa == DX::MeshBvh::Isa::Scalar)
+      {
+        reference = hits;
+        scalarMs  = bestMs;
+      }
+      else
+      {
+        mismatches = countMismatches();
+      }
+      report(*bvh, 1, bestMs, mismatches);
+      best = std::move(bvh);
+    }
+
+    // The best path on every thread; each ray's answer must not change.
+    {
+      const std::vector<DX::MeshBvh::Hit> singleThreaded = hits;
+      const size_t jobs = (count + RAYS_PER_JOB - 1) / RAYS_PER_JOB;
+      DX::ThreadPool pool(threads - 1);
+
+      double bestMs = 0.0;
+      for (int run = 0; run < runs; ++run)
+      {
+        double start = NowMs();
+        pool.ParallelFor(jobs, [&](size_t job) {
+          const size_t first = job * RAYS_PER_JOB;
+          best->Intersect(
+            rays.data() + first,
+            std::min(RAYS_PER_JOB, count - first),
+            FLT_MAX,
+            hits.data() + first);
+        });
+        double elapsed = NowMs() - start;
+        bestMs         = run == 0 ? elapsed : std::min(bestMs, elapsed);
+      }
+
+      size_t mismatches = countMismatches();
+      report(*best, pool.GetConcurrency(), bestMs, mismatches);
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        if (
+          hits[i].triangle != singleThreaded[i].triangle
+          || (hits[i].triangle != DX::MeshBvh::NO_TRIANGLE
+              && memcmp(&hits[i], &singleThreaded[i], sizeof(hits[i])) != 0))
+        {
+          printf("  FAIL: threads changed the answer for ray %zu\n", i);
+          exitCode = 1;
+          break;
+        }
+      }
+    }
+
+    // A sample of the scalar answers against a scan of every triangle, and
+    // every hit's barycentrics and texture coordinate.
+    size_t scanMismatches = 0;
+    size_t inconsistent   = 0;
+    const size_t stride   = std::max<size_t>(1, count / scanned);
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (reference[i].triangle != DX::MeshBvh::NO_TRIANGLE
+          && !IsConsistent(mesh, rays[i], reference[i]))
+      {
+        inconsistent++;
+      }
+
+      if (i % stride == 0)
+      {
+        uint32_t triangle;
+        float distance;
+        ScanTriangles(mesh, rays[i], triangle, distance);
+        scanMismatches += SameHit(
+                            triangle,
+                            distance,
+                            reference[i].triangle,
+                            reference[i].distance)
+                            ? 0
+                            : 1;
+      }
+    }
+
+    const size_t sampled = (count + stride - 1) / stride;
+    if (scanMismatches > maxMismatch * sampled)
+    {
+      printf(
+        "  FAIL: %zu of %zu rays disagree with a linear scan\n",
+        scanMismatches,
+        sampled);
+      exitCode = 1;
+    }
+    if (inconsistent > 0)
+    {
+      printf(
+        "  FAIL: %zu hits with barycentrics off the ray or the wrong texture\n"
+        "  coordinate\n",
+        inconsistent);
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
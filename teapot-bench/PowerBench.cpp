@@ -0,0 +1,145 @@
+//
+// PowerBench.cpp - "power" mode: Game::Tick work in each window power state
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+
+namespace
+{
+// Slack on the background rate, for rounding of the frame interval.
+constexpr double RATE_TOLERANCE = 1.01;
+
+struct Phase
+{
+  const char* name;
+  void (Game::*enter)();
+};
+
+//------------------------------------------------------------------------------
+const char*
+StateName(Game::PowerState state)
+{
+  switch (state)
+  {
+    case Game::PowerState::Active: return "active";
+    case Game::PowerState::Background: return "background";
+    case Game::PowerState::Occluded: return "occluded";
+    case Game::PowerState::Suspended: return "suspended";
+  }
+  return "?";
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Runs Game::Tick on a RecordingDevice through activation, deactivation,
+// suspension and resumption, as the window messages would, with a ReplayClock
+// that only moves while Tick waits for the next frame. Reports for each phase
+// how much simulated time the ticks took and what they drew, so the rate each
+// state runs at and the frames it skips can be checked without a window.
+// Fails if an idle state wakes Tick more often than Game::BACKGROUND_FRAME_RATE
+// or a suspended one updates or draws. Occlusion needs a swap chain, so isn't
+// covered.
+//------------------------------------------------------------------------------
+int
+Bench::RunPowerBench(const Options& options)
+{
+  const int ticks   = std::max(1, options.GetInt(L"ticks", 60));
+  const double fps  = options.GetDouble(L"fps", 60.0);
+  const int teapots = options.GetInt(L"teapots", 1);
+
+  Game::SceneOptions scene;
+  scene.teapotCount = teapots;
+
+  auto clock = std::make_shared<DX::ReplayClock>(DX::StepTimer::TicksPerSecond);
+
+  Game game;
+  game.SetSceneOptions(scene);
+  game.InitializeRecording(640, 480);
+  game.SetClock(clock);
+  game.SetFrameRateLimit(fps);
+
+  DX::RecordingDevice& device = *game.GetRecordingDevice();
+  device.EndFrame();
+
+  const Phase phases[] = {
+    {"activated", &Game::OnActivated},
+    {"deactivated", &Game::OnDeactivated},
+    {"suspended", &Game::OnSuspending},
+    {"resumed", &Game::OnResuming},
+    {"reactivated", &Game::OnActivated},
+  };
+
+  printf("power: %d ticks per phase, %.1f fps limit\n", ticks, fps);
+  printf(
+    "%12s %11s %10s %10s %9s %9s %8s\n",
+    "phase",
+    "state",
+    "tick ms",
+    "rendered",
+    "skipped",
+    "updates",
+    "draws");
+
+  int exitCode = 0;
+  for (const Phase& phase : phases)
+  {
+    (game.*phase.enter)();
+
+    const Game::PowerStats before = game.GetPowerStats();
+    const uint64_t startCounter   = clock->GetCounter();
+    uint64_t draws                = 0;
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+      game.Tick();
+      device.EndFrame();
+      draws += device.GetLastFrameStats().draws;
+    }
+    const Game::PowerStats& after = game.GetPowerStats();
+
+    const double elapsedMs =
+      1000.0 * DX::StepTimer::TicksToSeconds(clock->GetCounter() - startCounter);
+    const uint64_t skippedUpdates = after.skippedUpdates - before.skippedUpdates;
+    const uint64_t rendered       = after.renderedFrames - before.renderedFrames;
+    const Game::PowerState state  = game.GetPowerState();
+    printf(
+      "%12s %11s %10.2f %10llu %9llu %9llu %8llu\n",
+      phase.name,
+      StateName(state),
+      elapsedMs / ticks,
+      static_cast<unsigned long long>(rendered),
+      static_cast<unsigned long long>(
+        after.skippedFrames - before.skippedFrames),
+      static_cast<unsigned long long>(ticks - skippedUpdates),
+      static_cast<unsigned long long>(draws));
+
+    // The first tick after a state change isn't paced, so the rate is taken
+    // over the intervals between the rest.
+    if (state != Game::PowerState::Active && ticks > 1)
+    {
+      const double intervalMs = elapsedMs / (ticks - 1);
+      const double budgetMs =
+        1000.0 / (Game::BACKGROUND_FRAME_RATE * RATE_TOLERANCE);
+      if (intervalMs < budgetMs)
+      {
+        printf(
+          "  FAIL: %s ticked every %.2f ms, more often than %.1f fps\n",
+          phase.name,
+          intervalMs,
+          Game::BACKGROUND_FRAME_RATE);
+        exitCode = 1;
+      }
+    }
+    if (state == Game::PowerState::Suspended
+        && (rendered != 0 || skippedUpdates != uint64_t(ticks) || draws != 0))
+    {
+      printf("  FAIL: %s updated or drew while suspended\n", phase.name);
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+//
+// ProfileBench.cpp - "profile" mode: Profiler overhead and a traced CPU render
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+#include "Profiler.h"
+
+namespace
+{
+constexpr double FRAME_TIME_S = 1.0 / 60.0;
+
+//------------------------------------------------------------------------------
+// Nanoseconds per begin/end pair, nested two deep like real frames.
+double
+MeasureZoneNs(size_t zones)
+{
+  double start = Bench::NowMs();
+  for (size_t i = 0; i < zones; i += 2)
+  {
+    DX::ScopedZone outer(L"Outer");
+    DX::ScopedZone inner(L"Inner");
+  }
+  return (Bench::NowMs() - start) * 1.0e6 / static_cast<double>(zones);
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Measures what a zone costs with recording on and off, then profiles frames
+// of the headless renderer and writes them out as a Chrome trace.
+//------------------------------------------------------------------------------
+int
+Bench::RunProfileBench(const Options& options)
+{
+  const size_t zones = static_cast<size_t>(options.GetInt(L"zones", 1 << 22));
+  const int width    = options.GetInt(L"width", 1024);
+  const int height   = options.GetInt(L"height", 768);
+  const int frames   = options.GetInt(L"frames", 60);
+  const double maxNs = options.GetDouble(L"max-ns", 50.0);
+  const std::wstring trace =
+    options.GetString(L"trace", L"teapot-bench-trace.json");
+
+  int exitCode = 0;
+
+  // Warm up, which also registers this thread's buffer.
+  MeasureZoneNs(zones / 16);
+  double enabledNs = MeasureZoneNs(zones);
+  DX::Profiler::SetEnabled(false);
+  double disabledNs = MeasureZoneNs(zones);
+  DX::Profiler::SetEnabled(true);
+
+  printf("profile: %zu zones\n", zones);
+  printf("  enabled  %8.2f ns/zone\n", enabledNs);
+  printf("  disabled %8.2f ns/zone\n", disabledNs);
+  if (enabledNs > maxNs)
+  {
+    printf("  FAIL: a zone costs more than %.1f ns\n", maxNs);
+    exitCode = 1;
+  }
+
+  Game game;
+  game.InitializeHeadless(width, height);
+
+  DX::Profiler::Clear();
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    game.RenderHeadless(frame * FRAME_TIME_S);
+  }
+
+  printf(
+    "\n%d frames at %dx%d\n%24s %8s %10s %9s %9s %9s %9s\n",
+    frames,
+    width,
+    height,
+    "zone",
+    "count",
+    "total ms",
+    "p50 ms",
+    "p95 ms",
+    "p99 ms",
+    "max ms");
+  for (const auto& zone : DX::Profiler::Summarize())
+  {
+    printf(
+      "%24ls %8zu %10.3f %9.4f %9.4f %9.4f %9.4f\n",
+      zone.name.c_str(),
+      zone.count,
+      zone.totalMs,
+      zone.p50Ms,
+      zone.p95Ms,
+      zone.p99Ms,
+      zone.maxMs);
+  }
+
+  DX::Profiler::WriteChromeTrace(trace.c_str());
+  printf("\ntrace written to %ls\n", trace.c_str());
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,244 @@
+//
+// RasterBench.cpp - "cpu" mode: CpuRenderer throughput and golden images
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+
+#include <fstream>
+#include <thread>
+
+namespace
+{
+// Scene time of the image compared against --golden.
+constexpr double GOLDEN_TIME_S = 1.0;
+
+// Frames advance at a fixed rate so every run draws the same poses.
+constexpr double FRAME_TIME_S = 1.0 / 60.0;
+
+//------------------------------------------------------------------------------
+struct Image
+{
+  int width  = 0;
+  int height = 0;
+  std::vector<uint8_t> rgb;
+};
+
+//------------------------------------------------------------------------------
+// Converts the renderer's B8G8R8A8 pixels to tightly packed RGB.
+Image
+CaptureImage(const CpuRenderer& renderer)
+{
+  Image image;
+  image.width  = renderer.GetWidth();
+  image.height = renderer.GetHeight();
+
+  size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+  image.rgb.resize(pixelCount * 3);
+
+  const uint32_t* pixels = renderer.GetPixels();
+  for (size_t i = 0; i < pixelCount; ++i)
+  {
+    image.rgb[i * 3 + 0] = static_cast<uint8_t>(pixels[i] >> 16);
+    image.rgb[i * 3 + 1] = static_cast<uint8_t>(pixels[i] >> 8);
+    image.rgb[i * 3 + 2] = static_cast<uint8_t>(pixels[i]);
+  }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+// Reads a binary PPM as written by CpuRenderer::SaveImage.
+Image
+LoadImage(const std::wstring& fileName)
+{
+  std::ifstream inFile(fileName, std::ios::in | std::ios::binary);
+
+  std::string magic;
+  int maxValue = 0;
+  Image image;
+  inFile >> magic >> image.width >> image.height >> maxValue;
+  inFile.get();
+  if (!inFile || magic != "P6" || maxValue != 255)
+  {
+    throw std::runtime_error("LoadImage: expected an 8-bit binary PPM");
+  }
+
+  image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+  inFile.read(
+    reinterpret_cast<char*>(image.rgb.data()),
+    static_cast<std::streamsize>(image.rgb.size()));
+  if (!inFile)
+  {
+    throw std::runtime_error("LoadImage: truncated file");
+  }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+struct ImageDiff
+{
+  size_t pixelsDifferent = 0;
+  int maxChannelDelta    = 0;
+};
+
+ImageDiff
+CompareImages(const Image& a, const Image& b, int tolerance)
+{
+  if (a.width != b.width || a.height != b.height)
+  {
+    throw std::runtime_error("CompareImages: image sizes differ");
+  }
+
+  ImageDiff diff;
+  for (size_t i = 0; i < a.rgb.size(); i += 3)
+  {
+    int delta = 0;
+    for (size_t c = 0; c < 3; ++c)
+    {
+      delta = std::max(delta, std::abs(int(a.rgb[i + c]) - int(b.rgb[i + c])));
+    }
+    diff.maxChannelDelta = std::max(diff.maxChannelDelta, delta);
+    if (delta > tolerance)
+    {
+      ++diff.pixelsDifferent;
+    }
+  }
+  return diff;
+}
+
+//------------------------------------------------------------------------------
+std::vector<int>
+DefaultThreadCounts()
+{
+  int hardware = std::max(1, int(std::thread::hardware_concurrency()));
+
+  std::vector<int> counts;
+  for (int count = 1; count < hardware; count *= 2)
+  {
+    counts.push_back(count);
+  }
+  counts.push_back(hardware);
+  return counts;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Renders the scene with each requested thread count, reporting frame times and
+// speed-up over the first count. Every count must produce the same image, and
+// that image is compared against (or written to) a golden file when given.
+//------------------------------------------------------------------------------
+int
+Bench::RunCpuBench(const Options& options)
+{
+  const int width      = options.GetInt(L"width", 1024);
+  const int height     = options.GetInt(L"height", 768);
+  const int frames     = std::max(1, options.GetInt(L"frames", 120));
+  const int tolerance  = options.GetInt(L"tolerance", 0);
+  const auto threads   = options.GetIntList(L"threads", DefaultThreadCounts());
+  const auto golden    = options.GetString(L"golden", L"");
+  const bool writeGold = options.Has(L"update-golden");
+
+  printf(
+    "cpu: %dx%d, %d frames, %d tiles of %dx%d\n",
+    width,
+    height,
+    frames,
+    ((width + CpuRenderer::TileSize - 1) / CpuRenderer::TileSize)
+      * ((height + CpuRenderer::TileSize - 1) / CpuRenderer::TileSize),
+    CpuRenderer::TileSize,
+    CpuRenderer::TileSize);
+  printf(
+    "%8s %10s %10s %10s %10s %12s %8s\n",
+    "threads",
+    "mean ms",
+    "p50 ms",
+    "p95 ms",
+    "max ms",
+    "Mpixels/s",
+    "speedup");
+
+  Image reference;
+  double baselineMs = 0.0;
+  int result        = 0;
+
+  for (int threadCount : threads)
+  {
+    // The worker count excludes the calling thread.
+    Game game;
+    game.InitializeHeadless(width, height, std::max(0, threadCount - 1));
+    const CpuRenderer& renderer = *game.GetCpuRenderer();
+
+    // Warm up, and capture the image for the determinism check.
+    game.RenderHeadless(GOLDEN_TIME_S);
+    Image image = CaptureImage(renderer);
+
+    std::vector<double> frameMs;
+    frameMs.reserve(static_cast<size_t>(frames));
+    uint64_t pixelsShaded = 0;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+      double start = NowMs();
+      game.RenderHeadless(frame * FRAME_TIME_S);
+      frameMs.push_back(NowMs() - start);
+      pixelsShaded += renderer.GetFrameStats().pixelsShaded;
+    }
+
+    Summary summary = Summarize(frameMs);
+    if (baselineMs == 0.0)
+    {
+      baselineMs = summary.mean;
+    }
+
+    double totalMs = summary.mean * frames;
+    printf(
+      "%8zu %10.3f %10.3f %10.3f %10.3f %12.2f %7.2fx\n",
+      renderer.GetConcurrency(),
+      summary.mean,
+      summary.p50,
+      summary.p95,
+      summary.max,
+      static_cast<double>(pixelsShaded) / (totalMs * 1000.0),
+      baselineMs / summary.mean);
+
+    if (reference.rgb.empty())
+    {
+      reference = std::move(image);
+    }
+    else if (CompareImages(reference, image, 0).pixelsDifferent != 0)
+    {
+      printf("  FAIL: image differs from the first thread count\n");
+      result = 1;
+    }
+  }
+
+  if (!golden.empty())
+  {
+    if (writeGold)
+    {
+      Game game;
+      game.InitializeHeadless(width, height, 0);
+      game.RenderHeadless(GOLDEN_TIME_S);
+      game.GetCpuRenderer()->SaveImage(golden.c_str());
+      printf("golden: wrote %ls\n", golden.c_str());
+    }
+    else
+    {
+      ImageDiff diff = CompareImages(LoadImage(golden), reference, tolerance);
+      printf(
+        "golden: %zu pixels differ by more than %d (max delta %d)\n",
+        diff.pixelsDifferent,
+        tolerance,
+        diff.maxChannelDelta);
+      if (diff.pixelsDifferent != 0)
+      {
+        result = 1;
+      }
+    }
+  }
+
+  return result;
+}
+
+//------------------------------------------------------------------------------
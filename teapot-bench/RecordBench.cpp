@@ -0,0 +1,191 @@
+//
+// RecordBench.cpp - "record" mode: Game::Tick submission counts as JSON
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "Game.h"
+
+using namespace DirectX;
+
+namespace
+{
+constexpr uint64_t FRAME_TICKS = DX::StepTimer::TicksPerSecond / 60;
+
+//------------------------------------------------------------------------------
+// The same path as the "frames" mode, so that the two can be compared.
+Game::ScenePose
+CameraPath(double totalSeconds)
+{
+  const double t = totalSeconds;
+
+  Game::ScenePose pose;
+  pose.cameraRotationX = static_cast<float>(0.35 * sin(0.7 * t));
+  pose.cameraRotationY = static_cast<float>(0.5 * t);
+  pose.modelRotationY =
+    static_cast<float>(XMConvertToRadians(45.0f) * t + 0.3 * sin(2.0 * t));
+  return pose;
+}
+
+//------------------------------------------------------------------------------
+uint64_t
+UploadBytes(const DX::RecordingStats& stats)
+{
+  return stats.mapBytes + stats.updateBytes;
+}
+
+//------------------------------------------------------------------------------
+void
+PrintCount(
+  const char* name, uint64_t total, uint64_t max, int frames, bool last)
+{
+  printf(
+    "    \"%s\": {\"mean\": %.2f, \"max\": %llu}%s\n",
+    name,
+    static_cast<double>(total) / frames,
+    static_cast<unsigned long long>(max),
+    last ? "" : ",");
+}
+
+//------------------------------------------------------------------------------
+// A limit of zero or less is no limit.
+bool
+CheckLimit(const char* name, uint64_t value, double limit)
+{
+  if (limit <= 0.0 || static_cast<double>(value) <= limit)
+  {
+    return true;
+  }
+
+  fprintf(
+    stderr,
+    "record: FAIL %s %llu exceeds %.0f\n",
+    name,
+    static_cast<unsigned long long>(value),
+    limit);
+  return false;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Runs Game::Tick on a RecordingDevice for a fixed number of scripted frames,
+// counting what each frame submits: context calls, state changes and those
+// that changed nothing, draws, and the bytes written to buffers. Nothing is
+// drawn, so this runs anywhere the shaders and font can be loaded from, and
+// the counts are the same on every run. The report is a JSON object on stdout.
+//
+// --max-draws, --max-state-changes and --max-upload-kb fail the run if any
+// frame exceeds them, for use as regression checks.
+//------------------------------------------------------------------------------
+int
+Bench::RunRecordBench(const Options& options)
+{
+  const int width  = options.GetInt(L"width", 1024);
+  const int height = options.GetInt(L"height", 768);
+  const int frames = std::max(1, options.GetInt(L"frames", 120));
+
+  const double maxDraws        = options.GetDouble(L"max-draws", 0.0);
+  const double maxStateChanges = options.GetDouble(L"max-state-changes", 0.0);
+  const double maxUploadKb     = options.GetDouble(L"max-upload-kb", 0.0);
+
+  Game::SceneOptions scene;
+  scene.teapotCount  = options.GetInt(L"teapots", 1);
+  scene.tessellation = static_cast<size_t>(options.GetInt(L"tessellation", 8));
+  scene.grid.divisions =
+    static_cast<uint32_t>(std::max(1, options.GetInt(L"grid-divisions", 20)));
+  scene.grid.lodLevels =
+    static_cast<uint32_t>(std::max(1, options.GetInt(L"grid-lod", 1)));
+
+  auto clock = std::make_shared<DX::ReplayClock>(DX::StepTimer::TicksPerSecond);
+
+  Game game;
+  game.SetSceneOptions(scene);
+  game.SetSceneScript(CameraPath);
+  game.InitializeRecording(width, height);
+  game.SetClock(clock);
+
+  DX::RecordingDevice& device = *game.GetRecordingDevice();
+
+  // What initialization created, kept apart from the frames.
+  device.EndFrame();
+  const DX::RecordingStats setup = device.GetLastFrameStats();
+
+  DX::RecordingStats total;
+  DX::RecordingStats max;
+  uint64_t maxUploadBytes = 0;
+  std::vector<double> frameMs;
+  frameMs.reserve(static_cast<size_t>(frames));
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    clock->Advance(FRAME_TICKS);
+
+    double start = NowMs();
+    game.Tick();
+    frameMs.push_back(NowMs() - start);
+
+    device.EndFrame();
+    const DX::RecordingStats& stats = device.GetLastFrameStats();
+    total += stats;
+
+    max.calls        = std::max(max.calls, stats.calls);
+    max.stateChanges = std::max(max.stateChanges, stats.stateChanges);
+    max.redundantStateChanges =
+      std::max(max.redundantStateChanges, stats.redundantStateChanges);
+    max.draws          = std::max(max.draws, stats.draws);
+    max.vertices       = std::max(max.vertices, stats.vertices);
+    max.maps           = std::max(max.maps, stats.maps);
+    max.updates        = std::max(max.updates, stats.updates);
+    max.objectsCreated = std::max(max.objectsCreated, stats.objectsCreated);
+    maxUploadBytes     = std::max(maxUploadBytes, UploadBytes(stats));
+  }
+
+  Summary summary = Summarize(frameMs);
+
+  printf("{\n");
+  printf("  \"mode\": \"record\",\n");
+  printf("  \"width\": %d,\n", width);
+  printf("  \"height\": %d,\n", height);
+  printf("  \"teapots\": %d,\n", scene.teapotCount);
+  printf("  \"tessellation\": %zu,\n", scene.tessellation);
+  printf("  \"grid_divisions\": %u,\n", scene.grid.divisions);
+  printf("  \"grid_lod\": %u,\n", scene.grid.lodLevels);
+  printf("  \"frames\": %d,\n", frames);
+  printf(
+    "  \"setup\": {\"objects\": %llu, \"bytes\": %llu},\n",
+    static_cast<unsigned long long>(setup.objectsCreated),
+    static_cast<unsigned long long>(setup.bytesCreated));
+  printf("  \"per_frame\": {\n");
+  PrintCount("calls", total.calls, max.calls, frames, false);
+  PrintCount(
+    "state_changes", total.stateChanges, max.stateChanges, frames, false);
+  PrintCount(
+    "redundant_state_changes",
+    total.redundantStateChanges,
+    max.redundantStateChanges,
+    frames,
+    false);
+  PrintCount("draws", total.draws, max.draws, frames, false);
+  PrintCount("vertices", total.vertices, max.vertices, frames, false);
+  PrintCount("maps", total.maps, max.maps, frames, false);
+  PrintCount("updates", total.updates, max.updates, frames, false);
+  PrintCount(
+    "upload_bytes", UploadBytes(total), maxUploadBytes, frames, false);
+  PrintCount(
+    "objects_created", total.objectsCreated, max.objectsCreated, frames, true);
+  printf("  },\n");
+  printf("  \"frame_ms\": {\n");
+  printf("    \"min\": %.4f,\n", summary.min);
+  printf("    \"mean\": %.4f,\n", summary.mean);
+  printf("    \"p50\": %.4f,\n", summary.p50);
+  printf("    \"p95\": %.4f,\n", summary.p95);
+  printf("    \"max\": %.4f\n", summary.max);
+  printf("  }\n");
+  printf("}\n");
+
+  bool passed = CheckLimit("draws", max.draws, maxDraws);
+  passed &= CheckLimit("state_changes", max.stateChanges, maxStateChanges);
+  passed &= CheckLimit("upload_bytes", maxUploadBytes, maxUploadKb * 1024.0);
+  return passed ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,213 @@
+//
+// ShadeBench.cpp - "shade" mode: ShadingKernel throughput and accuracy
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "ShadingKernel.h"
+
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+//------------------------------------------------------------------------------
+// Fragments resembling those of the teapot scene: interpolated (so not unit
+// length) normals, and positions around the model.
+struct FragmentSet
+{
+  std::vector<float> normal[3];
+  std::vector<float> worldPos[3];
+
+  ShadingKernel::Fragments Get() const
+  {
+    return {{normal[0].data(), normal[1].data(), normal[2].data()},
+            {worldPos[0].data(), worldPos[1].data(), worldPos[2].data()}};
+  }
+};
+
+FragmentSet
+MakeFragments(size_t count)
+{
+  std::mt19937 rng(12345);
+  std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> length(0.8f, 1.2f);
+  std::uniform_real_distribution<float> position(-0.5f, 0.5f);
+
+  FragmentSet set;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    set.normal[axis].resize(count);
+    set.worldPos[axis].resize(count);
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    XMVECTOR n = XMVector3Normalize(
+      XMVectorSet(direction(rng), direction(rng), direction(rng), 0.0f));
+    n = n * length(rng);
+
+    set.normal[0][i]   = XMVectorGetX(n);
+    set.normal[1][i]   = XMVectorGetY(n);
+    set.normal[2][i]   = XMVectorGetZ(n);
+    set.worldPos[0][i] = position(rng);
+    set.worldPos[1][i] = position(rng);
+    set.worldPos[2][i] = position(rng);
+  }
+  return set;
+}
+
+//------------------------------------------------------------------------------
+// Distance in units in the last place. Colours are saturated, so never
+// negative, and their bit patterns order like the values.
+uint32_t
+UlpDistance(float a, float b)
+{
+  uint32_t ua;
+  uint32_t ub;
+  memcpy(&ua, &a, sizeof(ua));
+  memcpy(&ub, &b, sizeof(ub));
+  return ua > ub ? ua - ub : ub - ua;
+}
+
+//------------------------------------------------------------------------------
+std::vector<ShadingKernel::Isa>
+SupportedIsas()
+{
+  std::vector<ShadingKernel::Isa> isas = {ShadingKernel::Isa::Scalar};
+
+  ShadingKernel::Isa best = ShadingKernel::DetectIsa();
+  if (best != ShadingKernel::Isa::Scalar)
+  {
+    isas.push_back(ShadingKernel::Isa::SSE4);
+  }
+  if (best == ShadingKernel::Isa::AVX2)
+  {
+    isas.push_back(ShadingKernel::Isa::AVX2);
+  }
+  return isas;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Times every instruction set the machine supports against the scalar path,
+// and checks the vector results stay within --max-ulp of it. The AVX2 path
+// fuses multiply-adds, and pow(x, 32) magnifies that rounding difference, so
+// it is not bit-exact with the scalar path.
+//------------------------------------------------------------------------------
+int
+Bench::RunShadeBench(const Options& options)
+{
+  const size_t count  = static_cast<size_t>(options.GetInt(L"count", 1 << 20));
+  const int runs      = std::max(1, options.GetInt(L"runs", 20));
+  const uint32_t ulps = static_cast<uint32_t>(options.GetInt(L"max-ulp", 128));
+
+  // Constants as MyEffect sets them for the default camera.
+  StaticConstantBuffer material;
+  InitStaticConstants(material);
+
+  DynamicConstantBuffer draw;
+  ComputeDynamicConstants(
+    draw,
+    XMMatrixIdentity(),
+    XMMatrixLookAtRH(
+      XMVectorSet(0.0f, 0.7f, 1.2f, 0.0f),
+      XMVectorSet(0.0f, -0.1f, 0.0f, 0.0f),
+      g_XMIdentityR1),
+    XMMatrixPerspectiveFovRH(
+      XMConvertToRadians(70.0f), 4.0f / 3.0f, 0.01f, 100.0f));
+
+  const FragmentSet fragments = MakeFragments(count);
+  std::vector<uint32_t> colors(count);
+
+  std::vector<float> reference[4];
+  std::vector<float> result[4];
+  for (int ch = 0; ch < 4; ++ch)
+  {
+    reference[ch].resize(count);
+    result[ch].resize(count);
+  }
+  float* referencePtrs[4] = {
+    reference[0].data(), reference[1].data(), reference[2].data(),
+    reference[3].data()};
+  float* resultPtrs[4] = {
+    result[0].data(), result[1].data(), result[2].data(), result[3].data()};
+
+  printf("shade: %zu fragments, best of %d runs\n", count, runs);
+  printf(
+    "%8s %8s %12s %12s %8s %9s %10s\n",
+    "isa",
+    "packet",
+    "ns/fragment",
+    "Mfragments/s",
+    "speedup",
+    "max ulp",
+    "bytes off");
+
+  double scalarNs = 0.0;
+  int exitCode    = 0;
+
+  for (ShadingKernel::Isa isa : SupportedIsas())
+  {
+    ShadingKernel kernel(material, isa);
+    kernel.SetDrawConstants(draw);
+
+    double bestMs = 0.0;
+    for (int run = 0; run < runs; ++run)
+    {
+      double start = NowMs();
+      kernel.Shade(fragments.Get(), count, colors.data());
+      double elapsed = NowMs() - start;
+      bestMs         = run == 0 ? elapsed : std::min(bestMs, elapsed);
+    }
+
+    // Accuracy against the scalar path, before and after quantization.
+    uint32_t maxUlp  = 0;
+    size_t bytesOff  = 0;
+    if (isa == ShadingKernel::Isa::Scalar)
+    {
+      kernel.ShadeFloat(fragments.Get(), count, referencePtrs);
+    }
+    else
+    {
+      kernel.ShadeFloat(fragments.Get(), count, resultPtrs);
+      for (int ch = 0; ch < 4; ++ch)
+      {
+        for (size_t i = 0; i < count; ++i)
+        {
+          float a = reference[ch][i];
+          float b = result[ch][i];
+          maxUlp  = std::max(maxUlp, UlpDistance(a, b));
+          bytesOff += uint32_t(a * 255.0f + 0.5f) != uint32_t(b * 255.0f + 0.5f);
+        }
+      }
+    }
+
+    double ns = bestMs * 1.0e6 / static_cast<double>(count);
+    if (isa == ShadingKernel::Isa::Scalar)
+    {
+      scalarNs = ns;
+    }
+
+    printf(
+      "%8s %8zu %12.3f %12.1f %7.2fx %9u %10zu\n",
+      ShadingKernel::GetIsaName(isa),
+      kernel.GetPacketSize(),
+      ns,
+      1.0e3 / ns,
+      scalarNs / ns,
+      maxUlp,
+      bytesOff);
+
+    if (maxUlp > ulps)
+    {
+      printf("  FAIL: more than %u ulp from the scalar path\n", ulps);
+      exitCode = 1;
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
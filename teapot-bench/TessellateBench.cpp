@@ -0,0 +1,118 @@
+//
+// TessellateBench.cpp - "tessellate" mode: teapot patches across threads
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "ThreadPool.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+using Vertices = std::vector<GeometricPrimitive::VertexType>;
+using Indices  = std::vector<uint32_t>;
+
+//------------------------------------------------------------------------------
+// Tessellates on threads threads, 0 meaning the serial path, and returns the
+// time each run took. The output of the last run is left in vertices and
+// indices.
+std::vector<double>
+Measure(
+  size_t tessellation,
+  int threads,
+  int runs,
+  Vertices& vertices,
+  Indices& indices)
+{
+  std::unique_ptr<DX::ThreadPool> pool;
+  GeometricPrimitive::ParallelFor parallelFor;
+  if (threads > 0)
+  {
+    pool        = std::make_unique<DX::ThreadPool>(threads - 1);
+    parallelFor = [&pool](size_t count, const auto& job) {
+      pool->ParallelFor(count, job);
+    };
+  }
+
+  std::vector<double> ms;
+  for (int run = 0; run < runs; ++run)
+  {
+    double start = Bench::NowMs();
+    GeometricPrimitive::CreateTeapot(
+      vertices, indices, 1.0f, tessellation, true, parallelFor);
+    ms.push_back(Bench::NowMs() - start);
+  }
+  return ms;
+}
+
+template<typename T>
+bool
+SameBits(const std::vector<T>& a, const std::vector<T>& b)
+{
+  return a.size() == b.size()
+         && memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Times GeometricPrimitive::CreateTeapot on the serial path and with its
+// patches spread over each thread count, and fails if any thread count
+// produces output that differs from the serial path in a single bit.
+//------------------------------------------------------------------------------
+int
+Bench::RunTessellateBench(const Options& options)
+{
+  const auto tessellations = options.GetIntList(L"tessellation", {64, 128});
+  const auto threadCounts  = options.GetIntList(L"threads", {1, 2, 4, 8, 16});
+  const int runs           = std::max(1, options.GetInt(L"runs", 10));
+
+  printf("tessellate: %d runs, median times\n", runs);
+
+  int exitCode = 0;
+  for (int tessellation : tessellations)
+  {
+    const size_t t = static_cast<size_t>(std::max(1, tessellation));
+
+    Vertices serialVertices;
+    Indices serialIndices;
+    Summary serial =
+      Summarize(Measure(t, 0, runs, serialVertices, serialIndices));
+    printf(
+      "  tessellation %zu: %zu vertices, %zu triangles, serial %.3f ms\n",
+      t,
+      serialVertices.size(),
+      serialIndices.size() / 3,
+      serial.p50);
+
+    for (int threads : threadCounts)
+    {
+      if (threads < 1)
+      {
+        continue;
+      }
+
+      Vertices vertices;
+      Indices indices;
+      Summary r = Summarize(Measure(t, threads, runs, vertices, indices));
+      bool same = SameBits(vertices, serialVertices)
+                  && SameBits(indices, serialIndices);
+      printf(
+        "    %2d threads: %8.3f ms (%.2fx)%s\n",
+        threads,
+        r.p50,
+        serial.p50 / std::max(r.p50, 1.0e-6),
+        same ? "" : "  FAIL: differs from serial");
+      if (!same)
+      {
+        exitCode = 1;
+      }
+    }
+  }
+
+  return exitCode;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,188 @@
+//
+// TimerBench.cpp - "timer" mode: StepTimer driven by a scripted ReplayClock
+//
+
+#include "pch.h"
+#include "Bench.h"
+#include "StepTimer.h"
+
+#include <random>
+
+using namespace DX;
+
+namespace
+{
+// StepTimer clamps larger deltas (see m_clockMaxDelta).
+constexpr uint64_t MAX_DELTA_TICKS = StepTimer::TicksPerSecond / 10;
+
+//------------------------------------------------------------------------------
+// Frame times around 60 Hz with jitter, and an occasional long hitch that
+// forces the fixed timestep into catch-up updates. Deltas are in StepTimer
+// ticks, so the ReplayClock runs at StepTimer::TicksPerSecond.
+std::vector<uint64_t>
+MakeScript(size_t count, unsigned seed, double jitterMs, double hitchRate)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> frameMs(1000.0 / 60.0, jitterMs);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  std::uniform_real_distribution<double> hitchMs(50.0, 500.0);
+
+  std::vector<uint64_t> script(count);
+  for (auto& delta : script)
+  {
+    double ms = chance(rng) < hitchRate ? hitchMs(rng) : frameMs(rng);
+    delta     = StepTimer::SecondsToTicks(std::max(0.0, ms) / 1000.0);
+  }
+  return script;
+}
+
+//------------------------------------------------------------------------------
+struct RunResult
+{
+  uint64_t updates      = 0;
+  uint64_t totalTicks   = 0;
+  uint32_t maxPerTick   = 0;
+  uint64_t sequenceHash = 0;
+  double ms             = 0.0;
+};
+
+// Steps the clock through the script once, ticking the timer after each step.
+RunResult
+Replay(bool fixed, uint64_t targetTicks, const std::vector<uint64_t>& script)
+{
+  auto clock = std::make_shared<ReplayClock>(StepTimer::TicksPerSecond);
+  clock->SetScript(script);
+
+  StepTimer timer(clock);
+  timer.SetFixedTimeStep(fixed);
+  timer.SetTargetElapsedTicks(targetTicks);
+
+  RunResult result;
+  result.sequenceHash = 14695981039346656037ull;
+
+  double start = Bench::NowMs();
+  for (size_t i = 0; i < script.size(); ++i)
+  {
+    clock->Step();
+
+    uint32_t updates = 0;
+    timer.Tick([&]() {
+      ++updates;
+      // FNV-1a over the elapsed time of every update.
+      result.sequenceHash ^= timer.GetElapsedTicks();
+      result.sequenceHash *= 1099511628211ull;
+    });
+
+    result.updates += updates;
+    result.maxPerTick = std::max(result.maxPerTick, updates);
+  }
+  result.ms         = Bench::NowMs() - start;
+  result.totalTicks = timer.GetTotalTicks();
+  return result;
+}
+
+//------------------------------------------------------------------------------
+void
+PrintRun(const char* name, size_t ticks, const RunResult& result)
+{
+  uint64_t updates = std::max<uint64_t>(1, result.updates);
+  printf(
+    "%12s %10zu %10llu %8u %12.1f %10.1f\n",
+    name,
+    ticks,
+    static_cast<unsigned long long>(result.updates),
+    result.maxPerTick,
+    result.ms * 1.0e6 / static_cast<double>(ticks),
+    result.ms * 1.0e6 / static_cast<double>(updates));
+}
+
+//------------------------------------------------------------------------------
+bool
+Check(bool condition, const char* what)
+{
+  if (!condition)
+  {
+    printf("  FAIL: %s\n", what);
+  }
+  return condition;
+}
+}    // namespace
+
+//------------------------------------------------------------------------------
+// Replays the same scripted frame times through StepTimer in variable and
+// fixed timestep modes, then a catch-up stress at a 1 kHz fixed step. Checks
+// the timing invariants and that two replays make identical update sequences.
+//------------------------------------------------------------------------------
+int
+Bench::RunTimerBench(const Options& options)
+{
+  const size_t ticks  = static_cast<size_t>(options.GetInt(L"ticks", 100000));
+  const unsigned seed = static_cast<unsigned>(options.GetInt(L"seed", 1));
+  const double jitter = options.GetDouble(L"jitter-ms", 2.0);
+  const double hitch  = options.GetDouble(L"hitch-rate", 0.01);
+
+  const std::vector<uint64_t> script = MakeScript(ticks, seed, jitter, hitch);
+
+  uint64_t clampedTotal = 0;
+  for (uint64_t delta : script)
+  {
+    clampedTotal += std::min(delta, MAX_DELTA_TICKS);
+  }
+
+  const uint64_t frameTicks  = StepTimer::TicksPerSecond / 60;
+  const uint64_t stressTicks = StepTimer::TicksPerSecond / 1000;
+
+  RunResult variable = Replay(false, frameTicks, script);
+  RunResult fixed    = Replay(true, frameTicks, script);
+  RunResult repeat   = Replay(true, frameTicks, script);
+  RunResult stress   = Replay(true, stressTicks, script);
+
+  printf(
+    "timer: %zu ticks, seed %u, jitter %.2f ms, hitch rate %.3f\n",
+    ticks,
+    seed,
+    jitter,
+    hitch);
+  printf(
+    "%12s %10s %10s %8s %12s %10s\n",
+    "mode",
+    "ticks",
+    "updates",
+    "max/tick",
+    "ns/tick",
+    "ns/update");
+  PrintRun("variable", ticks, variable);
+  PrintRun("fixed 60Hz", ticks, fixed);
+  PrintRun("fixed 1kHz", ticks, stress);
+
+  // Worst case catch-up: a clamped delta, plus almost a whole step left over,
+  // plus the 1/4 ms snap to the target.
+  auto maxCatchUp = [](uint64_t target) {
+    return static_cast<uint32_t>(
+      (MAX_DELTA_TICKS + target + StepTimer::TicksPerSecond / 4000) / target);
+  };
+
+  bool ok = true;
+  ok &= Check(variable.totalTicks == clampedTotal, "variable step lost time");
+  ok &= Check(variable.updates == ticks, "variable step missed an update");
+  ok &= Check(
+    fixed.totalTicks == fixed.updates * frameTicks,
+    "60 Hz total is not a whole number of steps");
+  ok &= Check(
+    stress.totalTicks == stress.updates * stressTicks,
+    "1 kHz total is not a whole number of steps");
+  ok &= Check(
+    fixed.maxPerTick <= maxCatchUp(frameTicks),
+    "too many catch-up updates in one tick at 60 Hz");
+  ok &= Check(
+    stress.maxPerTick <= maxCatchUp(stressTicks),
+    "too many catch-up updates in one tick at 1 kHz");
+  ok &= Check(
+    repeat.updates == fixed.updates
+      && repeat.sequenceHash == fixed.sequenceHash,
+    "replay is not deterministic");
+
+  return ok ? 0 : 1;
+}
+
+//------------------------------------------------------------------------------